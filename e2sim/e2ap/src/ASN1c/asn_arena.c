@@ -0,0 +1,289 @@
+/*
+ * Per-thread bump arena of the ASN.1 support code, see asn_arena.h.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "asn_arena.h"
+
+#define	ASN_ARENA_ALIGN	16	/* Alignment of malloc() on 64-bit systems */
+#define	ASN_ARENA_ROUND(n)	(((n) + ASN_ARENA_ALIGN - 1) & ~((size_t)ASN_ARENA_ALIGN - 1))
+
+/*
+ * Each allocation is preceded by its size, so REALLOC can copy it.
+ */
+typedef struct asn_arena_chunk_s {
+	struct asn_arena_chunk_s *next;	/* Older chunk */
+	size_t size;	/* Bytes of data */
+	size_t used;
+} asn_arena_chunk_t;
+
+#define	ASN_ARENA_CHUNK_HDR	ASN_ARENA_ROUND(sizeof(asn_arena_chunk_t))
+#define	ASN_ARENA_ALLOC_HDR	ASN_ARENA_ALIGN
+
+typedef struct asn_arena_s {
+	asn_arena_chunk_t *chunks;	/* Current chunk first */
+	char *last;	/* Last allocation, which can grow in place */
+	unsigned int depth;	/* Nested scopes */
+	unsigned int bypass;	/* Nested bypasses */
+	asn_arena_stats_t stats;
+	int registered;	/* Chunks are released on thread exit */
+} asn_arena_t;
+
+static __thread asn_arena_t arena;
+
+static pthread_key_t arena_key;
+static pthread_once_t arena_key_once = PTHREAD_ONCE_INIT;
+
+static char *
+chunk_data(asn_arena_chunk_t *chunk) {
+	return (char *)chunk + ASN_ARENA_CHUNK_HDR;
+}
+
+static void
+free_chunks(asn_arena_t *a) {
+	while(a->chunks) {
+		asn_arena_chunk_t *next = a->chunks->next;
+		free(a->chunks);
+		a->chunks = next;
+	}
+	a->last = NULL;
+	a->stats.used = 0;
+	a->stats.reserved = 0;
+}
+
+static void
+thread_exit(void *value) {
+	free_chunks((asn_arena_t *)value);
+}
+
+static void
+create_key(void) {
+	(void)pthread_key_create(&arena_key, thread_exit);
+}
+
+static asn_arena_chunk_t *
+new_chunk(size_t need) {
+	size_t size = ASN_ARENA_CHUNK_SIZE;
+	asn_arena_chunk_t *chunk;
+
+	if(arena.chunks && arena.chunks->size * 2 > size)
+		size = arena.chunks->size * 2;	/* Fewer chunks for large messages */
+	if(need > size)
+		size = need;
+
+	chunk = (asn_arena_chunk_t *)malloc(ASN_ARENA_CHUNK_HDR + size);
+	if(!chunk) return NULL;
+
+	chunk->next = arena.chunks;
+	chunk->size = size;
+	chunk->used = 0;
+	arena.chunks = chunk;
+	arena.stats.reserved += size;
+
+	if(!arena.registered) {
+		(void)pthread_once(&arena_key_once, create_key);
+		(void)pthread_setspecific(arena_key, &arena);
+		arena.registered = 1;
+	}
+
+	return chunk;
+}
+
+static void *
+arena_alloc(size_t size) {
+	size_t need = ASN_ARENA_ALLOC_HDR + ASN_ARENA_ROUND(size ? size : 1);	/* Distinct pointers */
+	asn_arena_chunk_t *chunk = arena.chunks;
+	char *ptr;
+
+	if(need < size) return NULL;	/* Overflow */
+
+	if(!chunk || chunk->size - chunk->used < need) {
+		chunk = new_chunk(need);
+		if(!chunk) return NULL;
+	}
+
+	ptr = chunk_data(chunk) + chunk->used;
+	*(size_t *)ptr = size;
+	chunk->used += need;
+
+	arena.last = ptr + ASN_ARENA_ALLOC_HDR;
+	arena.stats.allocs++;
+	arena.stats.used += need;
+	if(arena.stats.used > arena.stats.high_water)
+		arena.stats.high_water = arena.stats.used;
+
+	return arena.last;
+}
+
+static int
+in_arena(const void *ptr) {
+	asn_arena_chunk_t *chunk;
+
+	for(chunk = arena.chunks; chunk; chunk = chunk->next) {
+		const char *data = chunk_data(chunk);
+		if((const char *)ptr >= data && (const char *)ptr < data + chunk->used)
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Starts a scope, scopes can be nested.
+ */
+void
+asn_arena_begin(void) {
+	arena.depth++;
+}
+
+/*
+ * Ends a scope. Ending the outermost scope reclaims all arena memory,
+ * keeping a single chunk large enough for the next scopes.
+ */
+void
+asn_arena_end(void) {
+	asn_arena_chunk_t *chunk;
+
+	if(arena.depth == 0 || --arena.depth > 0)
+		return;
+
+	arena.stats.resets++;
+
+	if(arena.chunks && arena.chunks->next) {
+		size_t size = arena.stats.reserved;	/* Fits the largest scope so far */
+		free_chunks(&arena);
+		new_chunk(size);
+	}
+
+	for(chunk = arena.chunks; chunk; chunk = chunk->next)
+		chunk->used = 0;
+	arena.last = NULL;
+	arena.stats.used = 0;
+}
+
+/*
+ * Allocates from the heap until asn_arena_bypass_end(), e.g. long-lived
+ * structures built while a message is being handled.
+ */
+void
+asn_arena_bypass_begin(void) {
+	arena.bypass++;
+}
+
+void
+asn_arena_bypass_end(void) {
+	if(arena.bypass > 0)
+		arena.bypass--;
+}
+
+/*
+ * Returns 1 if allocations of the calling thread go to the arena.
+ */
+int
+asn_arena_active(void) {
+	return arena.depth > 0 && arena.bypass == 0;
+}
+
+void *
+asn_arena_malloc(size_t size) {
+	if(!asn_arena_active()) {
+		arena.stats.heap_allocs++;
+		return malloc(size);
+	}
+	return arena_alloc(size);
+}
+
+void *
+asn_arena_calloc(size_t nmemb, size_t size) {
+	void *ptr;
+
+	if(!asn_arena_active()) {
+		arena.stats.heap_allocs++;
+		return calloc(nmemb, size);
+	}
+
+	if(size && nmemb > SIZE_MAX / size) return NULL;
+
+	ptr = arena_alloc(nmemb * size);
+	if(ptr) memset(ptr, 0, nmemb * size);
+	return ptr;
+}
+
+/*
+ * Arena memory shrinks in place, e.g. a buffer trimmed to its encoded size.
+ * It grows in place if it is the last allocation of the current chunk,
+ * otherwise it is copied to a new allocation. Heap memory stays on the heap.
+ */
+void *
+asn_arena_realloc(void *ptr, size_t size) {
+	size_t old_size;
+	void *new_ptr;
+
+	if(!ptr)
+		return asn_arena_malloc(size);
+
+	if(!in_arena(ptr)) {
+		arena.stats.heap_allocs++;
+		return realloc(ptr, size);
+	}
+
+	old_size = *(size_t *)((char *)ptr - ASN_ARENA_ALLOC_HDR);
+
+	if(size <= old_size && (ptr != arena.last || !asn_arena_active())) {
+		*(size_t *)((char *)ptr - ASN_ARENA_ALLOC_HDR) = size;
+		return ptr;
+	}
+
+	if(ptr == arena.last && asn_arena_active()) {
+		asn_arena_chunk_t *chunk = arena.chunks;
+		size_t old_need = ASN_ARENA_ROUND(old_size ? old_size : 1);
+		size_t new_need = ASN_ARENA_ROUND(size ? size : 1);
+		if(new_need >= size && new_need <= old_need + (chunk->size - chunk->used)) {
+			chunk->used = chunk->used - old_need + new_need;
+			arena.stats.used = arena.stats.used - old_need + new_need;
+			if(arena.stats.used > arena.stats.high_water)
+				arena.stats.high_water = arena.stats.used;
+			*(size_t *)((char *)ptr - ASN_ARENA_ALLOC_HDR) = size;
+			return ptr;
+		}
+	}
+
+	new_ptr = asn_arena_malloc(size);
+	if(new_ptr)
+		memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+	return new_ptr;
+}
+
+/*
+ * Arena memory is reclaimed when its scope ends, so only heap memory is freed.
+ */
+void
+asn_arena_free(void *ptr) {
+	if(!ptr) return;
+
+	if(arena.chunks && in_arena(ptr))
+		return;
+
+	free(ptr);
+}
+
+/*
+ * Returns the statistics of the calling thread.
+ */
+void
+asn_arena_get_stats(asn_arena_stats_t *stats) {
+	*stats = arena.stats;
+}
+
+/*
+ * Gives the chunks of the calling thread back to the heap.
+ * Must not be called within a scope.
+ */
+void
+asn_arena_release(void) {
+	if(arena.depth == 0)
+		free_chunks(&arena);
+}
@@ -28,12 +28,20 @@
 #define VERSION             "1.2.0"      //May 2019
 #define DEFAULT_SCTP_IP     "127.0.0.1"
 #define X2AP_PPID           (452984832) //27 = 1b, PPID = 1b000000(hex) -> 452984832(dec)
+#define E2AP_PPID           (70)        //IANA assigned SCTP Payload Protocol Identifier for E2AP (host byte order)
 #define X2AP_SCTP_PORT      36421
 #define E2AP_SCTP_PORT      36422
 #define RIC_SCTP_SRC_PORT   36422
-#define MAX_SCTP_BUFFER     10000
+#define MAX_SCTP_BUFFER     10000       // size of each receive slot, larger messages are reassembled
+#define E2AP_SEND_BUFFER_SIZE 4096     // initial size of the per-connection send buffer, grows to fit larger PDUs
 #define WORKDIR_ENV         "E2SIM_DIR" //environment variable
 
+// SCTP streams carrying each class of E2AP messages, so that bursts of indications do not block other procedures
+#define E2AP_STREAM_GLOBAL      0   // E2 setup, reset, RIC service, E2 node configuration and removal procedures
+#define E2AP_STREAM_CONTROL     1   // RIC subscription, subscription delete and control procedures
+#define E2AP_STREAM_INDICATION  2   // RIC indications
+#define E2AP_NUM_STREAMS        3
+
 // char* time_stamp(void);
 
 // #define LOG_I(...) {printf("[%s]", time_stamp()); printf(__VA_ARGS__); printf("\n");}
@@ -49,11 +57,6 @@ typedef struct SCTP_DATA {
   int           len;
 } sctp_data_t;
 
-typedef struct {
-  unsigned char buffer[MAX_SCTP_BUFFER];
-  int           len;
-} sctp_buffer_t;
-
 typedef struct {
   char* server_ip;
   int   server_port;
@@ -62,6 +65,5 @@ typedef struct {
 
 options_t read_input_options(int argc, char *argv[]);
 
-#define min(a, b) ((a) < (b)) ? (a) : (b)
 
 #endif
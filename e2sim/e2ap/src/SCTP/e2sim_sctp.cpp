@@ -23,19 +23,25 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/sctp.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
 #include <arpa/inet.h>	//for inet_ntop()
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 
 #include "e2sim_sctp.hpp"
+#include "sctp_connector.hpp"
 #include "logger.h"
 
 #include <sys/types.h>
 #include <netdb.h>
-#include <signal.h>
 #include <time.h>
+#include <poll.h>
+#include <vector>
+#include <algorithm>
 
-int sctp_start_server(const char *server_ip_str, const int server_port)
+int sctp_start_server(const char *server_ip_str, const int server_port, const sctp_profile_t &profile)
 {
   if(server_port < 1 || server_port > 65535) {
       logger_error("Invalid port number (%d). Valid values are between 1 and 65535.", server_port);
@@ -80,16 +86,7 @@ int sctp_start_server(const char *server_ip_str, const int server_port)
     exit(1);
   }
 
-  //set send_buffer
-  // int sendbuff = 10000;
-  // socklen_t optlen = sizeof(sendbuff);
-  // if(getsockopt(server_fd, SOL_SOCKET, SO_SNDBUF, &sendbuff, &optlen) == -1) {
-  //   perror("getsockopt send");
-  //   exit(1);
-  // }
-  // else
-  //   LOG_D("[SCTP] send buffer size = %d\n", sendbuff);
-
+  sctp_profile_apply(server_fd, profile);  // inherited by the accepted associations
 
   if(bind(server_fd, server_addr, addr_len) == -1) {
     perror("bind");
@@ -109,88 +106,93 @@ int sctp_start_server(const char *server_ip_str, const int server_port)
 }
 
 /*
-  This is only used as a placeholder to handle alarms for SCTP connection timeout
+  Creates a SCTP client socket of the given address family, applies the transport profile
+  (e.g. one stream per class of E2AP messages), and subscribes to the SCTP data io events.
+
+  Returns the socket fd on success, -1 on error
 */
-void alarm_handler(int signal) {
-  logger_warn("[SCTP] The SCTP connection is taking too long... Received signal %d (%s)", signal, strsignal(signal));
+int sctp_client_socket(int family, const sctp_profile_t &profile)
+{
+  int client_fd = socket(family, SOCK_STREAM, IPPROTO_SCTP);
+  if (client_fd == -1) {
+    logger_error("[SCTP] Unable to create socket: %s", strerror(errno));
+    return -1;
+  }
+
+  sctp_profile_apply(client_fd, profile);
+
+  // data io events are required by sctp_recvmsg to report the stream of each received message,
+  // and address events report the state changes of each path of multihomed associations
+  struct sctp_event_subscribe events;
+  memset(&events, 0, sizeof(events));
+  events.sctp_data_io_event = 1;
+  events.sctp_address_event = 1;
+  if (setsockopt(client_fd, IPPROTO_SCTP, SCTP_EVENTS, &events, sizeof(events)) == -1) {
+    logger_warn("[SCTP] Unable to subscribe to SCTP events: %s", strerror(errno));
+  }
+
+  return client_fd;
 }
 
 /*
   Starts a client SCTP connection to a given server and port.
   Accepts IPv4, IPv6, or hostname as input values.
 
+  IPv4 and IPv6 addresses are raced happy eyeballs style, each attempt timing out
+  after SCTP_CONNECT_TIMEOUT_MS. This function blocks the caller thread on poll until
+  the connection is established or all attempts have failed.
+  See SctpConnector to connect without blocking.
+
   Returns the socket fd on success, -1 on error
 */
-int sctp_start_client(const char *server_addr_str, const int server_port) {
-  int client_fd;
-  struct addrinfo hints;
-  struct addrinfo *result, *rp;
-  int ret;
-
-  /* Obtain address(es) matching host/port */
-  memset(&hints, 0, sizeof(struct addrinfo));
-  hints.ai_family = AF_UNSPEC;    /* Allow IPv4 or IPv6 */
-  hints.ai_socktype = SOCK_STREAM;
-  hints.ai_flags = 0;
-  hints.ai_protocol = IPPROTO_SCTP;
-
-  char port_buf[6];
-  snprintf(port_buf, 6, "%d", server_port);
-
-  ret = getaddrinfo(server_addr_str, port_buf, &hints, &result);
-  if (ret != 0) {
-    fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(ret));
-    return -1;
-  }
-
-  logger_info("[SCTP] Connecting to server at %s:%d ...", server_addr_str, server_port);
-
-  /* getaddrinfo() returns a list of address structures (IPv4 and IPv6).
-    We have to try each address until we successfully connect. */
-  for (rp = result; rp != NULL; rp = rp->ai_next) {
-    client_fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
-    if (client_fd == -1)
-      continue;
-
-    // unmasking SIGALARM
-    sigset_t old_signals;
-    sigset_t monitored_signals;
-    int deliveredSignal;
-    sigemptyset(&old_signals);
-    sigemptyset(&monitored_signals);
-    sigaddset(&monitored_signals, SIGALRM);
-    sigprocmask(SIG_UNBLOCK, &monitored_signals, &old_signals);
-
-    // installing signal handlers for SCTP connection timeout
-    struct sigaction sa;
-    sa.sa_handler = &alarm_handler;
-    sa.sa_flags = 0;
-    sigemptyset(&sa.sa_mask);
-    sigaction(SIGALRM, &sa, NULL);
-
-    alarm(10);  // we wait for 10s to timeout
-    if (connect(client_fd, rp->ai_addr, rp->ai_addrlen) != -1) {
-      alarm(0); // disarm SIGALRM
-      logger_info("[SCTP] Connection established");
-      break;                  /* Success */
+int sctp_start_client(const char *server_addr_str, const int server_port, const sctp_profile_t &profile) {
+  std::vector<int> fds;   // sockets of the attempts in progress, must outlive the connector
+  SctpConnector connector;
+  connector.set_profile(profile);
+
+  bool started = connector.start(server_addr_str, server_port, [&fds](int fd, bool watch) {
+    if (watch) {
+      fds.push_back(fd);
     } else {
+      fds.erase(std::remove(fds.begin(), fds.end(), fd), fds.end());
+    }
+  });
+
+  std::vector<struct pollfd> pfds;
+  while (started && connector.in_progress()) {
+    pfds.resize(fds.size());
+    for (size_t i = 0; i < fds.size(); i++) {
+      pfds[i].fd = fds[i];
+      pfds[i].events = POLLOUT;
+      pfds[i].revents = 0;
+    }
+
+    int ret = poll(pfds.data(), pfds.size(), connector.next_timeout_ms());
+    if (ret == -1) {
       if (errno == EINTR) {
-        logger_fatal("[SCTP] Connection timed out");
+        continue;
       }
+      logger_error("[SCTP] poll error: %s", strerror(errno));
+      break;
     }
 
-    sigprocmask(SIG_BLOCK, &old_signals, NULL);  // restoring the previous signal mask
+    for (size_t i = 0; ret > 0 && i < pfds.size(); i++) {
+      if (pfds[i].revents) {
+        connector.handle_writable(pfds[i].fd);  // also handles POLLERR and POLLHUP through SO_ERROR
+      }
+    }
 
-    close(client_fd);
+    connector.handle_timeout();
   }
 
-  if (rp == NULL) {               /* No address succeeded */
-    logger_fatal("[SCTP] Unable to connect at %s:%d", server_addr_str, server_port);
-    client_fd = -1;
+  int client_fd = connector.release_fd();
+  if (client_fd != -1) {
+    int flags = fcntl(client_fd, F_GETFL, 0);
+    if (flags != -1) {
+      fcntl(client_fd, F_SETFL, flags & ~O_NONBLOCK);  // callers of this function expect blocking mode
+    }
   }
 
-  freeaddrinfo(result);           /* No longer needed */
-
   logger_debug("[SCTP] client_fd value is %d", client_fd);
 
   return client_fd;
@@ -230,29 +232,185 @@ int sctp_accept_connection(const char *server_ip_str, const int server_fd)
   return client_fd;
 }
 
-int sctp_send_data(int &socket_fd, sctp_buffer_t &data, struct timespec *ts)
+/*
+  Returns the number of outbound streams negotiated for the association of socket_fd, -1 on error
+*/
+int sctp_get_num_ostreams(int socket_fd)
+{
+  struct sctp_status status;
+  socklen_t optlen = sizeof(status);
+
+  memset(&status, 0, sizeof(status));
+  if (getsockopt(socket_fd, IPPROTO_SCTP, SCTP_STATUS, &status, &optlen) == -1) {
+    logger_error("[SCTP] Unable to get SCTP_STATUS: %s", strerror(errno));
+    return -1;
+  }
+
+  logger_info("[SCTP] Association has %u outbound and %u inbound streams", status.sstat_outstrms, status.sstat_instrms);
+
+  return status.sstat_outstrms;
+}
+
+/*
+  Enables software receive timestamps (SO_TIMESTAMPING) on socket_fd, so that sctp_receive_batch
+  reports the time each message has been received by the kernel, i.e. before any queueing and
+  scheduling delay of the application.
+
+  Note that Linux does not report transmit timestamps for SCTP, so sent messages are still
+  timestamped by the application right before handing them to the kernel.
+
+  Returns false if the kernel does not support it
+*/
+bool sctp_enable_timestamping(int socket_fd)
+{
+  int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+
+  if (setsockopt(socket_fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == -1) {
+    logger_warn("[SCTP] Unable to enable kernel timestamps: %s", strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+/*
+  Sends len bytes of buf as a single E2AP message on the given SCTP stream.
+  The kernel copies straight from buf, so callers can reuse it right after this call returns.
+  Passing MSG_DONTWAIT in flags does not block if the socket buffer is full.
+
+  Returns
+    -1 if an error occurred, errno is set to indicate the error.
+       EAGAIN or EWOULDBLOCK mean the socket buffer is full (MSG_DONTWAIT) and are not logged.
+    > 0 number of bytes sent.
+*/
+int sctp_send_data(int &socket_fd, const uint8_t *buf, size_t len, struct timespec *ts, uint16_t stream, int flags)
 {
+  struct msghdr msg;
+  struct iovec iov;
+  struct {
+    alignas(struct cmsghdr) char buf[CMSG_SPACE(sizeof(struct sctp_sndrcvinfo))];
+  } cmsg_buf;
+
   logger_trace("in func %s", __func__);
-  logger_debug("data.len is %d", data.len);
+  logger_debug("data.len is %zu, stream is %u", len, stream);
+
+  iov.iov_base = (void *)buf;
+  iov.iov_len = len;
+
+  memset(&msg, 0, sizeof(msg));
+  memset(&cmsg_buf, 0, sizeof(cmsg_buf));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cmsg_buf.buf;
+  msg.msg_controllen = sizeof(cmsg_buf.buf);
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = IPPROTO_SCTP;
+  cmsg->cmsg_type = SCTP_SNDRCV;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(struct sctp_sndrcvinfo));
+
+  struct sctp_sndrcvinfo *sinfo = (struct sctp_sndrcvinfo *)CMSG_DATA(cmsg);
+  sinfo->sinfo_stream = stream;
+  sinfo->sinfo_ppid = htonl(E2AP_PPID);
+
   if(ts != NULL) {
     clock_gettime(CLOCK_REALTIME, ts);
   }
-  int sent_len = send(socket_fd, (void*)(&(data.buffer[0])), data.len, 0);
+
+  int sent_len;
+  do {
+    sent_len = sendmsg(socket_fd, &msg, flags);
+  } while (sent_len == -1 && errno == EINTR);
 
   logger_trace("after getting sent_len");
 
-  if(sent_len == -1) {
-    perror("[SCTP] sctp_send_data");
-    exit(1);
+  if (sent_len == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+    int error = errno;
+    logger_error("[SCTP] unable to send message of %zu bytes: %s", len, strerror(errno)); // can change errno
+    errno = error;
   }
 
   return sent_len;
 }
 
-int sctp_send_data_X2AP(int &socket_fd, sctp_buffer_t &data)
+/*
+  Sends count E2AP messages with as few sendmmsg calls as possible (up to SCTP_SEND_BATCH each).
+  Each message is located within buf by its offset and length, and goes out on its own stream.
+  All messages share the same timestamp ts, taken right before handing them to the kernel.
+  Passing MSG_DONTWAIT in flags does not block if the socket buffer is full.
+
+  Returns the number of messages sent. If it is less than count, errno is set to indicate
+  why the remaining messages have not been sent (e.g. EAGAIN if the socket buffer is full).
+*/
+int sctp_send_batch(int &socket_fd, const uint8_t *buf, const sctp_msg_t *msgs, unsigned int count, struct timespec *ts, int flags)
+{
+  struct mmsghdr hdrs[SCTP_SEND_BATCH];
+  struct iovec iovs[SCTP_SEND_BATCH];
+  struct {
+    alignas(struct cmsghdr) char buf[CMSG_SPACE(sizeof(struct sctp_sndrcvinfo))];
+  } cmsgs[SCTP_SEND_BATCH];
+
+  logger_trace("in func %s", __func__);
+  logger_debug("sending a batch of %u messages", count);
+
+  if(ts != NULL) {
+    clock_gettime(CLOCK_REALTIME, ts);
+  }
+
+  unsigned int sent = 0;
+  while (sent < count) {
+    unsigned int n = count - sent;
+    if (n > SCTP_SEND_BATCH) {
+      n = SCTP_SEND_BATCH;
+    }
+
+    memset(hdrs, 0, n * sizeof(struct mmsghdr));
+    memset(cmsgs, 0, n * sizeof(cmsgs[0]));
+
+    for (unsigned int i = 0; i < n; i++) {
+      const sctp_msg_t &msg = msgs[sent + i];
+
+      iovs[i].iov_base = (void *)(buf + msg.offset);
+      iovs[i].iov_len = msg.len;
+
+      hdrs[i].msg_hdr.msg_iov = &iovs[i];
+      hdrs[i].msg_hdr.msg_iovlen = 1;
+      hdrs[i].msg_hdr.msg_control = cmsgs[i].buf;
+      hdrs[i].msg_hdr.msg_controllen = sizeof(cmsgs[i].buf);
+
+      struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdrs[i].msg_hdr);
+      cmsg->cmsg_level = IPPROTO_SCTP;
+      cmsg->cmsg_type = SCTP_SNDRCV;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(struct sctp_sndrcvinfo));
+
+      struct sctp_sndrcvinfo *sinfo = (struct sctp_sndrcvinfo *)CMSG_DATA(cmsg);
+      sinfo->sinfo_stream = msg.stream;
+      sinfo->sinfo_ppid = htonl(E2AP_PPID);
+    }
+
+    int ret = sendmmsg(socket_fd, hdrs, n, flags);
+    if (ret == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        int error = errno;
+        logger_error("[SCTP] unable to send batch of %u messages: %s", count - sent, strerror(errno)); // can change errno
+        errno = error;
+      }
+      break;
+    }
+
+    sent += ret;  // sendmmsg might have sent less messages than requested
+  }
+
+  return sent;
+}
+
+int sctp_send_data_X2AP(int &socket_fd, pdu_buffer_t &data)
 {
   /*
-  int sent_len = sctp_sendmsg(socket_fd, (void*)(&(data.buffer[0])), data.len,
+  int sent_len = sctp_sendmsg(socket_fd, (void*)data.buf, data.len,
                   NULL, 0, (uint32_t) X2AP_PPID, 0, 0, 0, 0);
 
   if(sent_len == -1) {
@@ -266,37 +424,289 @@ int sctp_send_data_X2AP(int &socket_fd, sctp_buffer_t &data)
 /*
 Receive data from SCTP socket
 
+The buffer grows to fit the whole message, since SCTP delivers messages larger than the
+room left in the buffer in more than one part (i.e. without MSG_EOR). SCTP notifications
+are consumed and ignored.
+
 Returns
   -1 if an error occurred, errno is set to indicate the error.
+     A connection closed by the remote peer sets errno to ENOTCONN.
   0 on socket timeout, the application should retry again.
   > 0 on new data.
 */
-int sctp_receive_data(int &socket_fd, sctp_buffer_t &data, struct timespec *ts)
+int sctp_receive_data(int &socket_fd, pdu_buffer_t &data, struct timespec *ts)
 {
   int error;
-  //clear out the data before receiving
+  struct sctp_sndrcvinfo sinfo;
+  int msg_flags;
+
   logger_trace("in func %s", __func__);
-  memset(data.buffer, 0, sizeof(data.buffer));
+  memset(&sinfo, 0, sizeof(sinfo));
   data.len = 0;
 
-  //receive data from the socket
-  int recv_len = recv(socket_fd, &(data.buffer), sizeof(data.buffer), 0);
+  do {
+    if (data.size - data.len == 0) {
+      if (!pdu_buffer_reserve(&data, data.size ? data.size * 2 : MAX_SCTP_BUFFER)) {
+        logger_error("[SCTP] unable to allocate memory to receive message of more than %zu bytes", data.len);
+        errno = ENOMEM;
+        return -1;
+      }
+    }
+
+    //receive data from the socket
+    msg_flags = 0;
+    int recv_len = sctp_recvmsg(socket_fd, data.buf + data.len, data.size - data.len, NULL, NULL, &sinfo, &msg_flags);
+
+    if (recv_len == -1) {
+      if (errno == EAGAIN && data.len == 0) {   // timeout
+        return 0;
+
+      } else if (errno == EINTR) {  // do not log expected interrupts, SIGINT or SIGTERM will shutdown the receiver
+        return -1;
+
+      } else {                      // all other errors are logged out
+        error = errno;
+        logger_error("[SCTP] recv error: %s", strerror(errno)); // can change errno
+        errno = error;
+        return -1;
+      }
+    }
+
+    if (recv_len == 0) {
+      logger_info("[SCTP] Connection closed by remote peer");
+      errno = ENOTCONN;   // the socket owner is responsible for closing socket_fd
+      return -1;
+    }
+
+    data.len += recv_len;
+  } while (!(msg_flags & MSG_EOR));
+
   if (ts != NULL) {
-    if (recv_len > 0) {
-      clock_gettime(CLOCK_REALTIME, ts);
+    clock_gettime(CLOCK_REALTIME, ts);
+  }
+
+  if (msg_flags & MSG_NOTIFICATION) {
+    logger_debug("[SCTP] Ignoring SCTP notification of %zu bytes", data.len);
+    data.len = 0;
+    return 0;
+  }
+
+  logger_debug("[SCTP] received %zu bytes on stream %u", data.len, sinfo.sinfo_stream);
+
+  return data.len;
+}
+
+/*
+  Allocates a receive ring for sctp_receive_batch.
+  It is the caller responsibility to release it with sctp_recv_ring_free.
+
+  Returns NULL if the memory could not be allocated.
+*/
+sctp_recv_ring_t *sctp_recv_ring_alloc()
+{
+  sctp_recv_ring_t *ring = (sctp_recv_ring_t *) malloc(sizeof(sctp_recv_ring_t));
+  if (ring == NULL) {
+    return NULL;
+  }
+
+  memset(ring->hdrs, 0, sizeof(ring->hdrs));  // buffers are not cleared since they are always overwritten
+  for (unsigned int i = 0; i < SCTP_RECV_BATCH; i++) {
+    ring->iovs[i].iov_base = ring->bufs[i];
+    ring->iovs[i].iov_len = MAX_SCTP_BUFFER;
+    ring->hdrs[i].msg_hdr.msg_iov = &ring->iovs[i];
+    ring->hdrs[i].msg_hdr.msg_iovlen = 1;
+    ring->hdrs[i].msg_hdr.msg_control = ring->cmsgs[i].buf;
+  }
+
+  sctp_reassembly_init(&ring->reasm);
+
+  return ring;
+}
+
+void sctp_recv_ring_free(sctp_recv_ring_t *ring)
+{
+  if (ring != NULL) {
+    sctp_reassembly_free(&ring->reasm);
+    free(ring);
+  }
+}
+
+/*
+  Returns the stream of a received message from its SCTP_SNDRCV ancillary data, or 0 if not present
+*/
+static uint16_t sctp_get_recv_stream(struct msghdr *msg)
+{
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+    if (cmsg->cmsg_level == IPPROTO_SCTP && cmsg->cmsg_type == SCTP_SNDRCV) {
+      return ((struct sctp_sndrcvinfo *)CMSG_DATA(cmsg))->sinfo_stream;
+    }
+  }
+  return 0;
+}
+
+/*
+  Returns the software receive timestamp of a message from its SCM_TIMESTAMPING ancillary data,
+  or NULL if not present
+*/
+static struct timespec *sctp_get_recv_kernel_ts(struct msghdr *msg)
+{
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING) {
+      struct timespec *stamps = ((struct scm_timestamping *)CMSG_DATA(cmsg))->ts;  // software stamp is the first one
+      return (stamps[0].tv_sec || stamps[0].tv_nsec) ? stamps : NULL;
+    }
+  }
+  return NULL;
+}
+
+void sctp_reassembly_init(sctp_reassembly_t *reasm)
+{
+  pdu_buffer_init(&reasm->partial);
+  reasm->partial_stream = 0;
+  reasm->skip_notification = false;
+}
+
+void sctp_reassembly_free(sctp_reassembly_t *reasm)
+{
+  pdu_buffer_release(&reasm->partial);
+  sctp_reassembly_init(reasm);
+}
+
+/*
+  Appends a part of a message to the reassembly buffer
+
+  Returns false if the memory could not be allocated.
+*/
+static bool sctp_append_partial(sctp_reassembly_t *reasm, const uint8_t *buf, size_t len, uint16_t stream)
+{
+  pdu_buffer_t *partial = &reasm->partial;
+
+  if (partial->len == 0) {
+    reasm->partial_stream = stream;
+  }
+
+  if (!pdu_buffer_reserve(partial, partial->len + len)) {
+    return false;
+  }
+
+  memcpy(partial->buf + partial->len, buf, len);
+  partial->len += len;
+
+  return true;
+}
+
+/*
+  Hands a message read from the SCTP socket to handler, or to notif_handler if it is a SCTP notification.
+  The flags and the ancillary data of the message are taken from msg, while its len bytes are in buf.
+  Messages delivered in more than one part (i.e. without MSG_EOR) are reassembled first.
+
+  Returns
+    -1 if an error occurred, errno is set to indicate the error.
+       A connection closed by the remote peer sets errno to ENOTCONN.
+    0 if no complete message has been handed to handler.
+    1 if a complete message has been handed to handler.
+*/
+int sctp_deliver_message(sctp_reassembly_t *reasm, struct msghdr *msg, const uint8_t *buf, size_t len,
+                         struct timespec *ts, SctpDataHandler &handler, SctpNotificationHandler &notif_handler)
+{
+  if (msg->msg_flags & MSG_NOTIFICATION) {
+    reasm->skip_notification = !(msg->msg_flags & MSG_EOR);
+    if (reasm->skip_notification || !notif_handler) {   // notifications are small, so we do not reassemble them
+      logger_debug("[SCTP] Ignoring SCTP notification of %zu bytes", len);
     } else {
-      memset(ts, 0, sizeof(struct timespec));
+      notif_handler((const union sctp_notification *)buf, len, ts);
+    }
+    return 0;
+  }
+
+  if (reasm->skip_notification) {  // remaining part of a notification
+    reasm->skip_notification = !(msg->msg_flags & MSG_EOR);
+    return 0;
+  }
+
+  if (len == 0) {
+    logger_info("[SCTP] Connection closed by remote peer");
+    errno = ENOTCONN;   // the socket owner is responsible for closing the socket
+    return -1;
+  }
+
+  uint16_t stream = sctp_get_recv_stream(msg);
+  struct timespec *kernel_ts = sctp_get_recv_kernel_ts(msg);   // reassembled messages get the stamp of their last part
+
+  if (!(msg->msg_flags & MSG_EOR)) {
+    logger_debug("[SCTP] received partial message of %zu bytes on stream %u", len, stream);
+    if (!sctp_append_partial(reasm, buf, len, stream)) {
+      logger_error("[SCTP] unable to allocate memory to reassemble message of %zu bytes", reasm->partial.len + len);
+      errno = ENOMEM;
+      return -1;
+    }
+    return 0;
+  }
+
+  if (reasm->partial.len > 0) {  // last part of a reassembled message
+    if (!sctp_append_partial(reasm, buf, len, stream)) {
+      logger_error("[SCTP] unable to allocate memory to reassemble message of %zu bytes", reasm->partial.len + len);
+      errno = ENOMEM;
+      return -1;
     }
+    logger_debug("[SCTP] received %zu bytes on stream %u", reasm->partial.len, reasm->partial_stream);
+    handler(reasm->partial.buf, reasm->partial.len, reasm->partial_stream, ts, kernel_ts);
+    pdu_buffer_release(&reasm->partial);   // back to the pool, large messages are rare
+
+  } else {
+    logger_debug("[SCTP] received %zu bytes on stream %u", len, stream);
+    handler(buf, len, stream, ts, kernel_ts);
+  }
+
+  return 1;
+}
+
+/*
+  Drains up to SCTP_RECV_BATCH messages from the SCTP socket in a single recvmmsg call
+  and hands each complete E2AP message to handler, in the order they were received.
+
+  Messages delivered in more than one part (i.e. larger than MAX_SCTP_BUFFER) are
+  reassembled using MSG_EOR, and complete messages are handed straight from the ring.
+  SCTP notifications are handed to notif_handler, if any. All messages of a call share the same timestamp,
+  while kernel timestamps (see sctp_enable_timestamping) are taken for each message.
+
+  Returns
+    -1 if an error occurred, errno is set to indicate the error.
+       A connection closed by the remote peer sets errno to ENOTCONN.
+    0 if there is no complete message to receive yet, the application should retry again.
+    > 0 number of complete messages handed to handler.
+*/
+int sctp_receive_batch(int &socket_fd, sctp_recv_ring_t *ring, SctpDataHandler handler, SctpNotificationHandler notif_handler)
+{
+  return sctp_receive_batch(socket_fd, ring, &ring->reasm, handler, notif_handler);
+}
+
+/*
+  Same as above, but partial messages are reassembled in reasm instead of the reassembly state of the ring.
+  This allows many sockets read by the same thread to share a single ring, each one keeping its own reasm.
+*/
+int sctp_receive_batch(int &socket_fd, sctp_recv_ring_t *ring, sctp_reassembly_t *reasm, SctpDataHandler handler,
+                       SctpNotificationHandler notif_handler)
+{
+  struct timespec ts;
+  int error;
+
+  logger_trace("in func %s", __func__);
+
+  for (unsigned int i = 0; i < SCTP_RECV_BATCH; i++) {
+    ring->hdrs[i].msg_hdr.msg_controllen = sizeof(ring->cmsgs[i].buf);  // overwritten by the kernel
+    ring->hdrs[i].msg_hdr.msg_flags = 0;
   }
 
-  if (recv_len == -1) {
-    if (errno == EAGAIN) {        // timeout
+  int count = recvmmsg(socket_fd, ring->hdrs, SCTP_RECV_BATCH, MSG_DONTWAIT, NULL);
+  if (count == -1) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
       return 0;
 
-    } else if (errno == EINTR) {  // do not log expected interrupts, SIGINT or SIGTERM will shutdown the receiver
+    } else if (errno == EINTR) {  // do not log expected interrupts
       return -1;
 
-    } else {                      // all other errors are logged out
+    } else {
       error = errno;
       logger_error("[SCTP] recv error: %s", strerror(errno)); // can change errno
       errno = error;
@@ -304,20 +714,50 @@ int sctp_receive_data(int &socket_fd, sctp_buffer_t &data, struct timespec *ts)
     }
   }
 
-  if (recv_len == 0) {
-    logger_info("[SCTP] Connection closed by remote peer");
+  clock_gettime(CLOCK_REALTIME, &ts);
 
-    if (close(socket_fd) == -1) {
-      error = errno;
-      logger_error("[SCTP] close: %s", strerror(errno));  // can change errno
-      errno = error;
+  int delivered = 0;
+  for (int i = 0; i < count; i++) {
+    int ret = sctp_deliver_message(reasm, &ring->hdrs[i].msg_hdr, ring->bufs[i], ring->hdrs[i].msg_len,
+                                   &ts, handler, notif_handler);
+    if (ret == -1) {
       return -1;
     }
+    delivered += ret;
+  }
+
+  return delivered;
+}
+
+/*
+  Returns the numeric host of an IPv4 or IPv6 address
+*/
+std::string sctp_addr_to_string(const struct sockaddr *addr)
+{
+  char buf[INET6_ADDRSTRLEN] = "unknown";
+
+  if (addr->sa_family == AF_INET6) {
+    inet_ntop(AF_INET6, &((const struct sockaddr_in6 *)addr)->sin6_addr, buf, sizeof(buf));
+  } else if (addr->sa_family == AF_INET) {
+    inet_ntop(AF_INET, &((const struct sockaddr_in *)addr)->sin_addr, buf, sizeof(buf));
   }
 
-  logger_debug("[SCTP] received %d bytes", recv_len);
+  return buf;
+}
+
+/*
+  Returns the primary peer address of the association, or an empty string on error
+*/
+std::string sctp_get_primary_addr(int socket_fd)
+{
+  struct sctp_prim prim;
+  socklen_t len = sizeof(prim);
 
-  data.len = recv_len;
+  memset(&prim, 0, sizeof(prim));
+  if (getsockopt(socket_fd, IPPROTO_SCTP, SCTP_PRIMARY_ADDR, &prim, &len) == -1) {
+    logger_warn("[SCTP] Unable to get the primary address: %s", strerror(errno));
+    return "";
+  }
 
-  return recv_len;
+  return sctp_addr_to_string((struct sockaddr *)&prim.ssp_addr);
 }
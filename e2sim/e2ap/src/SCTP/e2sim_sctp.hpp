@@ -20,20 +20,96 @@
 #ifndef E2SIM_SCTP_HPP
 #define E2SIM_SCTP_HPP
 
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/sctp.h>
+#include <linux/errqueue.h>   // struct scm_timestamping
+#include <functional>
+#include <string>
 #include "e2sim_defs.h"
+#include "sctp_profile.hpp"
+#include "pdu_buffer.hpp"
 
 const int SERVER_LISTEN_QUEUE_SIZE  = 10;
+const unsigned int SCTP_SEND_BATCH = 64;  // maximum number of messages handed to each sendmmsg call
 
-int sctp_start_server(const char *server_ip_str, const int server_port);
+const unsigned int SCTP_RECV_BATCH = 16;  // maximum number of messages received by each recvmmsg call
 
-int sctp_start_client(const char *server_addr_str, const int server_port);
+// an E2AP message within a batch buffer
+typedef struct {
+  size_t   offset;  // start of the message in the batch buffer
+  size_t   len;
+  uint16_t stream;  // SCTP stream to send the message on
+} sctp_msg_t;
+
+// receives each complete E2AP message, buf is only valid during the call
+// kernel_ts is the time the kernel received the message (SO_TIMESTAMPING), or NULL if not available
+typedef std::function<void(const uint8_t *buf, size_t len, uint16_t stream, struct timespec *ts, struct timespec *kernel_ts)> SctpDataHandler;
+
+// receives each complete SCTP notification, notif is only valid during the call
+typedef std::function<void(const union sctp_notification *notif, size_t len, struct timespec *ts)> SctpNotificationHandler;
+
+// reassembles messages delivered in more than one read (i.e. without MSG_EOR)
+typedef struct {
+  pdu_buffer_t partial;
+  uint16_t partial_stream;
+  bool     skip_notification;  // set while discarding the remaining parts of a SCTP notification
+} sctp_reassembly_t;
+
+// ring of buffers that receives many SCTP messages per recvmmsg call
+typedef struct {
+  struct mmsghdr hdrs[SCTP_RECV_BATCH];
+  struct iovec   iovs[SCTP_RECV_BATCH];
+  struct {
+    alignas(struct cmsghdr) char buf[CMSG_SPACE(sizeof(struct sctp_sndrcvinfo)) + CMSG_SPACE(sizeof(struct scm_timestamping))];
+  } cmsgs[SCTP_RECV_BATCH];
+  uint8_t bufs[SCTP_RECV_BATCH][MAX_SCTP_BUFFER];
+
+  sctp_reassembly_t reasm;
+} sctp_recv_ring_t;
+
+int sctp_start_server(const char *server_ip_str, const int server_port, const sctp_profile_t &profile = sctp_profile_t());
+
+int sctp_client_socket(int family, const sctp_profile_t &profile = sctp_profile_t());
+
+int sctp_start_client(const char *server_addr_str, const int server_port, const sctp_profile_t &profile = sctp_profile_t());
 
 int sctp_accept_connection(const char *server_ip_str, const int server_fd);
 
-int sctp_send_data(int &socket_fd, sctp_buffer_t &data, struct timespec *ts);
+int sctp_get_num_ostreams(int socket_fd);
+
+bool sctp_enable_timestamping(int socket_fd);
+
+int sctp_send_data(int &socket_fd, const uint8_t *buf, size_t len, struct timespec *ts, uint16_t stream = E2AP_STREAM_GLOBAL, int flags = 0);
+
+int sctp_send_batch(int &socket_fd, const uint8_t *buf, const sctp_msg_t *msgs, unsigned int count, struct timespec *ts, int flags = 0);
+
+int sctp_send_data_X2AP(int &socket_fd, pdu_buffer_t &data);
+
+int sctp_receive_data(int &socket_fd, pdu_buffer_t &data, struct timespec *ts);
+
+sctp_recv_ring_t *sctp_recv_ring_alloc();
+
+void sctp_recv_ring_free(sctp_recv_ring_t *ring);
+
+void sctp_reassembly_init(sctp_reassembly_t *reasm);
+
+void sctp_reassembly_free(sctp_reassembly_t *reasm);
+
+int sctp_deliver_message(sctp_reassembly_t *reasm, struct msghdr *msg, const uint8_t *buf, size_t len,
+                         struct timespec *ts, SctpDataHandler &handler, SctpNotificationHandler &notif_handler);
+
+int sctp_receive_batch(int &socket_fd, sctp_recv_ring_t *ring, SctpDataHandler handler,
+                       SctpNotificationHandler notif_handler = nullptr);
+
+int sctp_receive_batch(int &socket_fd, sctp_recv_ring_t *ring, sctp_reassembly_t *reasm, SctpDataHandler handler,
+                       SctpNotificationHandler notif_handler = nullptr);
 
-int sctp_send_data_X2AP(int &socket_fd, sctp_buffer_t &data);
+std::string sctp_addr_to_string(const struct sockaddr *addr);
 
-int sctp_receive_data(int &socket_fd, sctp_buffer_t &data, struct timespec *ts);
+std::string sctp_get_primary_addr(int socket_fd);
 
 #endif
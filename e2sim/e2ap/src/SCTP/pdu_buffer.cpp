@@ -0,0 +1,134 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "pdu_buffer.hpp"
+
+/*
+  Free buffers of each size class owned by a thread, released when the thread exits.
+  Buffers released by another thread than the one that reserved them just move between pools.
+*/
+class PduBufferPool {
+
+public:
+
+  std::vector<uint8_t *> free_bufs[PDU_BUFFER_CLASSES];
+
+  ~PduBufferPool() {
+    for (auto &bufs : free_bufs) {
+      for (uint8_t *buf : bufs) {
+        free(buf);
+      }
+    }
+  }
+
+};
+
+static thread_local PduBufferPool pool;
+
+/*
+  Returns the index of the size class of a buffer of size bytes, or -1 if it is larger than all pooled classes
+*/
+static int pdu_buffer_class(size_t size)
+{
+  size_t class_size = PDU_BUFFER_MIN_SIZE;
+  for (int i = 0; i < PDU_BUFFER_CLASSES; i++) {
+    if (size <= class_size) {
+      return i;
+    }
+    class_size <<= 1;
+  }
+  return -1;
+}
+
+/*
+  Returns the capacity of the buffer that holds size bytes
+*/
+size_t pdu_buffer_class_size(size_t size)
+{
+  int index = pdu_buffer_class(size);
+  if (index == -1) {
+    return size;  // not pooled
+  }
+  return (size_t)PDU_BUFFER_MIN_SIZE << index;
+}
+
+void pdu_buffer_init(pdu_buffer_t *pdu)
+{
+  pdu->buf = NULL;
+  pdu->len = 0;
+  pdu->size = 0;
+}
+
+/*
+  Makes room for at least size bytes in the buffer, keeping its len bytes in use
+
+  Returns false if the memory could not be allocated, then the buffer is left untouched.
+*/
+bool pdu_buffer_reserve(pdu_buffer_t *pdu, size_t size)
+{
+  if (size <= pdu->size) {
+    return true;
+  }
+
+  size_t new_size = pdu_buffer_class_size(size);
+  int index = pdu_buffer_class(new_size);
+
+  uint8_t *buf = NULL;
+  if (index != -1 && !pool.free_bufs[index].empty()) {
+    buf = pool.free_bufs[index].back();
+    pool.free_bufs[index].pop_back();
+  } else {
+    buf = (uint8_t *) malloc(new_size);
+    if (buf == NULL) {
+      return false;
+    }
+  }
+
+  if (pdu->len > 0) {
+    memcpy(buf, pdu->buf, pdu->len);
+  }
+
+  size_t len = pdu->len;
+  pdu_buffer_release(pdu);
+  pdu->buf = buf;
+  pdu->len = len;
+  pdu->size = new_size;
+
+  return true;
+}
+
+/*
+  Returns the memory of the buffer to the pool of the calling thread and empties the buffer
+*/
+void pdu_buffer_release(pdu_buffer_t *pdu)
+{
+  if (pdu->buf != NULL) {
+    int index = pdu_buffer_class(pdu->size);
+    if (index != -1 && pool.free_bufs[index].size() < PDU_BUFFER_POOL_DEPTH) {
+      pool.free_bufs[index].push_back(pdu->buf);
+    } else {
+      free(pdu->buf);
+    }
+  }
+
+  pdu_buffer_init(pdu);
+}
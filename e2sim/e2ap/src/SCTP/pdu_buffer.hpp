@@ -0,0 +1,51 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#ifndef PDU_BUFFER_HPP
+#define PDU_BUFFER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define PDU_BUFFER_MIN_SIZE     1024        // smallest size class, each next class doubles the size
+#define PDU_BUFFER_CLASSES      11          // pooled classes, from 1 KB up to 1 MB
+#define PDU_BUFFER_POOL_DEPTH   16          // free buffers each thread keeps per size class
+
+/*
+  Buffer of an encoded or received PDU, sized to fit the PDU rather than a fixed maximum.
+
+  Buffers come in power of two size classes and are recycled through per-thread pools,
+  so steady state sends and receives do not reach the heap. Buffers larger than the
+  largest class are allocated and released straight from the heap.
+  A zeroed pdu_buffer_t (see pdu_buffer_init) is an empty buffer with no memory.
+*/
+typedef struct {
+  uint8_t *buf;
+  size_t  len;    // bytes in use
+  size_t  size;   // capacity of buf
+} pdu_buffer_t;
+
+void pdu_buffer_init(pdu_buffer_t *pdu);
+
+bool pdu_buffer_reserve(pdu_buffer_t *pdu, size_t size);
+
+void pdu_buffer_release(pdu_buffer_t *pdu);
+
+size_t pdu_buffer_class_size(size_t size);
+
+#endif
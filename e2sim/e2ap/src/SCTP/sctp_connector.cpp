@@ -0,0 +1,445 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/sctp.h>
+
+#include "sctp_connector.hpp"
+#include "e2sim_sctp.hpp"
+#include "logger.h"
+
+SctpConnector::SctpConnector(int attempt_timeout_ms, int stagger_ms) {
+  this->attempt_timeout_ms = attempt_timeout_ms;
+  this->stagger_ms = stagger_ms;
+  next_candidate = 0;
+  connected_fd = -1;
+  failed = false;
+  local_v4_count = 0;
+  local_all_count = 0;
+}
+
+SctpConnector::~SctpConnector() {
+  while (!attempts.empty()) {
+    stop_attempt(attempts.size() - 1, true);
+  }
+
+  if (connected_fd != -1) {
+    close(connected_fd);
+  }
+}
+
+/*
+  Appends the address sa to the packed list of addresses
+*/
+static void pack_addr(std::vector<uint8_t> &packed, const struct sockaddr *sa) {
+  size_t len = sa->sa_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+  packed.insert(packed.end(), (const uint8_t *)sa, (const uint8_t *)sa + len);
+}
+
+/*
+  Returns the first address resolved from addr, or NULL on error.
+  It is the caller responsibility to release the result with freeaddrinfo.
+*/
+static struct addrinfo *resolve_first(const char *addr, int port, int flags) {
+  struct addrinfo hints;
+  struct addrinfo *result;
+
+  memset(&hints, 0, sizeof(struct addrinfo));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = flags;
+  hints.ai_protocol = IPPROTO_SCTP;
+
+  char port_buf[6];
+  snprintf(port_buf, 6, "%d", port);
+
+  int ret = getaddrinfo(addr, port_buf, &hints, &result);
+  if (ret != 0) {
+    logger_error("[SCTP] Unable to resolve %s: %s", addr, gai_strerror(ret));
+    return NULL;
+  }
+
+  return result;
+}
+
+/*
+  Resolves the server address into the list of candidate addresses,
+  alternating between address families as recommended by RFC 8305.
+*/
+bool SctpConnector::resolve(const char *addr, int port) {
+  struct addrinfo *result, *rp;
+
+  result = resolve_first(addr, port, 0);
+  if (result == NULL) {
+    return false;
+  }
+
+  std::vector<candidate_t> first;   // candidates of the preferred family, i.e. the family of the first result
+  std::vector<candidate_t> second;
+  for (rp = result; rp != NULL; rp = rp->ai_next) {
+    candidate_t c;
+    c.family = rp->ai_family;
+    c.count = 1;
+    pack_addr(c.addrs, rp->ai_addr);
+    c.name = sctp_addr_to_string(rp->ai_addr);
+
+    if (rp->ai_family == result->ai_family) {
+      first.push_back(c);
+    } else {
+      second.push_back(c);
+    }
+  }
+
+  freeaddrinfo(result);
+
+  candidates.clear();
+  for (size_t i = 0; i < first.size() || i < second.size(); i++) {
+    if (i < first.size()) {
+      candidates.push_back(first[i]);
+    }
+    if (i < second.size()) {
+      candidates.push_back(second[i]);
+    }
+  }
+
+  return true;
+}
+
+/*
+  Resolves the server address and the additional peer addresses into a single candidate
+  of a multihomed association. The server address is the primary path.
+*/
+bool SctpConnector::resolve_multihomed(const char *addr, int port) {
+  candidate_t c;
+  c.family = AF_INET;
+  c.count = 0;
+
+  std::vector<std::string> addrs;
+  addrs.push_back(addr);
+  addrs.insert(addrs.end(), peer_addrs.begin(), peer_addrs.end());
+
+  for (std::string &a : addrs) {
+    struct addrinfo *result = resolve_first(a.c_str(), port, 0);
+    if (result == NULL) {
+      return false;
+    }
+
+    if (result->ai_family == AF_INET6) {
+      c.family = AF_INET6;  // IPv6 sockets also carry IPv4 addresses
+    }
+    pack_addr(c.addrs, result->ai_addr);
+    c.count++;
+    c.name += (c.name.empty() ? "" : ",") + sctp_addr_to_string(result->ai_addr);
+
+    freeaddrinfo(result);
+  }
+
+  candidates.clear();
+  candidates.push_back(c);
+
+  return true;
+}
+
+/*
+  Resolves the local addresses to bind the association to
+*/
+bool SctpConnector::resolve_local() {
+  local_v4.clear();
+  local_all.clear();
+  local_v4_count = 0;
+  local_all_count = 0;
+
+  for (std::string &a : local_addrs) {
+    struct addrinfo *result = resolve_first(a.c_str(), 0, AI_NUMERICHOST | AI_PASSIVE);
+    if (result == NULL) {
+      return false;
+    }
+
+    if (result->ai_family == AF_INET) {
+      pack_addr(local_v4, result->ai_addr);
+      local_v4_count++;
+    }
+    pack_addr(local_all, result->ai_addr);
+    local_all_count++;
+
+    freeaddrinfo(result);
+  }
+
+  return true;
+}
+
+/*
+  Binds the socket fd to the local addresses supported by its address family
+*/
+bool SctpConnector::bind_local(int fd, int family) {
+  if (local_all_count == 0) {
+    return true;  // the kernel binds to all local addresses
+  }
+
+  std::vector<uint8_t> &packed = family == AF_INET6 ? local_all : local_v4;
+  int count = family == AF_INET6 ? local_all_count : local_v4_count;
+  if (count == 0) {
+    logger_warn("[SCTP] No local address of the same family of the socket to bind to");
+    return false;
+  }
+
+  if (sctp_bindx(fd, (struct sockaddr *)packed.data(), count, SCTP_BINDX_ADD_ADDR) == -1) {
+    logger_warn("[SCTP] Unable to bind to local addresses: %s", strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+/*
+  Sets the local addresses the association binds to. Must be called before start().
+*/
+void SctpConnector::set_local_addresses(const std::vector<std::string> &addrs) {
+  local_addrs = addrs;
+}
+
+/*
+  Sets the additional E2Term addresses of a multihomed association. Must be called before start().
+*/
+void SctpConnector::set_peer_addresses(const std::vector<std::string> &addrs) {
+  peer_addrs = addrs;
+}
+
+/*
+  Sets the transport profile applied to the socket of each attempt. Must be called before start().
+*/
+void SctpConnector::set_profile(const sctp_profile_t &profile) {
+  this->profile = profile;
+}
+
+/*
+  Starts the connection attempt of the next candidate if it is time to race it, i.e. either
+  the stagger interval has expired or there is no other attempt in progress.
+  Candidates that fail right away are skipped.
+*/
+void SctpConnector::start_attempts() {
+  clock::time_point now = clock::now();
+
+  while (connected_fd == -1 && next_candidate < candidates.size() && (attempts.empty() || now >= next_start)) {
+    candidate_t &c = candidates[next_candidate++];
+
+    int fd = sctp_client_socket(c.family, profile);
+    if (fd == -1) {
+      continue;
+    }
+
+    if (!bind_local(fd, c.family)) {
+      close(fd);
+      continue;
+    }
+
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+      logger_error("[SCTP] Unable to set non-blocking socket: %s", strerror(errno));
+      close(fd);
+      continue;
+    }
+
+    logger_debug("[SCTP] Trying to connect to %s", c.name.c_str());
+
+    int ret;
+    if (c.count > 1) {
+      ret = sctp_connectx(fd, (struct sockaddr *)c.addrs.data(), c.count, NULL);
+    } else {
+      ret = connect(fd, (struct sockaddr *)c.addrs.data(), c.addrs.size());
+    }
+
+    if (ret == 0) {
+      connected_fd = fd;
+      logger_info("[SCTP] Connection established to %s", c.name.c_str());
+      break;
+    }
+
+    if (errno != EINPROGRESS) {
+      logger_warn("[SCTP] Unable to connect to %s: %s", c.name.c_str(), strerror(errno));
+      close(fd);
+      continue;
+    }
+
+    attempt_t attempt;
+    attempt.fd = fd;
+    attempt.deadline = now + std::chrono::milliseconds(attempt_timeout_ms);
+    attempt.addr = c.name;
+    attempts.push_back(attempt);
+
+    next_start = now + std::chrono::milliseconds(stagger_ms);
+
+    watch(fd, true);
+  }
+
+  if (connected_fd != -1) {   // stopping other attempts
+    next_candidate = candidates.size();
+    while (!attempts.empty()) {
+      stop_attempt(attempts.size() - 1, true);
+    }
+  }
+
+  if (!in_progress() && connected_fd == -1 && !failed) {
+    failed = true;
+    logger_fatal("[SCTP] Unable to connect at %s", server.c_str());
+  }
+}
+
+/*
+  Removes a connection attempt. Its socket is closed unless it has been connected.
+*/
+void SctpConnector::stop_attempt(size_t index, bool close_fd) {
+  int fd = attempts[index].fd;
+
+  attempts.erase(attempts.begin() + index);
+
+  if (watch) {
+    watch(fd, false);
+  }
+  if (close_fd) {
+    close(fd);
+  }
+}
+
+/*
+  Starts connecting to the server at addr and port.
+  Accepts IPv4, IPv6, or hostname as addr.
+
+  Returns false if no connection attempt could be started.
+*/
+bool SctpConnector::start(const char *addr, int port, SctpWatchCallback watch) {
+  this->watch = watch;
+  server = std::string(addr) + ":" + std::to_string(port);
+
+  logger_info("[SCTP] Connecting to server at %s ...", server.c_str());
+
+  bool resolved = peer_addrs.empty() ? resolve(addr, port) : resolve_multihomed(addr, port);
+  if (!resolved || !resolve_local()) {
+    logger_fatal("[SCTP] Unable to connect at %s", server.c_str());
+    return false;
+  }
+
+  next_candidate = 0;
+  start_attempts();
+
+  return in_progress() || connected_fd != -1;
+}
+
+/*
+  Checks the outcome of the connection attempt on fd
+*/
+void SctpConnector::handle_writable(int fd) {
+  size_t index;
+  for (index = 0; index < attempts.size(); index++) {
+    if (attempts[index].fd == fd) {
+      break;
+    }
+  }
+  if (index == attempts.size()) {
+    return;   // the attempt has already been stopped
+  }
+
+  int error = 0;
+  socklen_t len = sizeof(error);
+  if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == -1) {
+    error = errno;
+  }
+
+  if (error == 0) {
+    logger_info("[SCTP] Connection established to %s", attempts[index].addr.c_str());
+    stop_attempt(index, false);
+    connected_fd = fd;
+    next_candidate = candidates.size();
+
+  } else {
+    logger_warn("[SCTP] Unable to connect to %s: %s", attempts[index].addr.c_str(), strerror(error));
+    stop_attempt(index, true);
+    next_start = clock::now();  // a failed attempt races the next candidate right away
+  }
+
+  start_attempts();
+}
+
+/*
+  Stops the attempts whose deadline has expired and races the next candidates
+*/
+void SctpConnector::handle_timeout() {
+  clock::time_point now = clock::now();
+
+  for (size_t i = attempts.size(); i > 0; i--) {
+    if (now >= attempts[i - 1].deadline) {
+      logger_warn("[SCTP] Connection to %s timed out", attempts[i - 1].addr.c_str());
+      stop_attempt(i - 1, true);
+    }
+  }
+
+  start_attempts();
+}
+
+/*
+  Returns the time (milliseconds) until handle_timeout should be called, or -1 if there is nothing to wait for
+*/
+int SctpConnector::next_timeout_ms() {
+  if (!in_progress()) {
+    return -1;
+  }
+
+  clock::time_point now = clock::now();
+  clock::time_point next = clock::time_point::max();
+
+  if (next_candidate < candidates.size()) {
+    next = attempts.empty() ? now : next_start;
+  }
+  for (attempt_t &attempt : attempts) {
+    if (attempt.deadline < next) {
+      next = attempt.deadline;
+    }
+  }
+
+  if (next <= now) {
+    return 0;
+  }
+
+  // rounding up so that the caller does not wake up right before the deadline
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(next - now).count();
+  return (int)((us + 999) / 1000);
+}
+
+/*
+  Returns true while the connection has not been established and there are attempts or candidates left
+*/
+bool SctpConnector::in_progress() {
+  return connected_fd == -1 && (!attempts.empty() || next_candidate < candidates.size());
+}
+
+/*
+  Returns the connected socket, or -1 if the connection could not be established.
+  The ownership of the socket is transferred to the caller.
+*/
+int SctpConnector::release_fd() {
+  int fd = connected_fd;
+  connected_fd = -1;
+  return fd;
+}
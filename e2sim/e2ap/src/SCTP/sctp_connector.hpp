@@ -0,0 +1,125 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#ifndef SCTP_CONNECTOR_HPP
+#define SCTP_CONNECTOR_HPP
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <functional>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "sctp_profile.hpp"
+
+#define SCTP_CONNECT_TIMEOUT_MS 10000   // time (milliseconds) each connection attempt waits before giving up
+#define SCTP_CONNECT_STAGGER_MS 250     // time (milliseconds) before racing the next candidate address (RFC 8305)
+
+typedef std::function<void(int fd, bool watch)> SctpWatchCallback;  // starts or stops watching fd for writability
+
+/*
+  Connects to an SCTP server racing its IPv4 and IPv6 addresses happy eyeballs style (RFC 8305).
+
+  Candidate addresses alternate between address families and a new attempt starts every
+  stagger interval, or as soon as the previous one fails. Each attempt is a non-blocking
+  connect with its own deadline, and the first one to succeed wins. The connected socket is
+  left in non-blocking mode.
+
+  This class does not wait for anything by itself. The event loop driving it (e.g. poll or
+  the Reactor) watches the sockets reported by the watch callback, calls handle_writable when
+  any of them is writable, and handle_timeout after next_timeout_ms has expired.
+  The watch callback starts watching the socket of each attempt as it starts, which happens in start,
+  handle_writable and handle_timeout. It stops watching the socket once its attempt connects, fails or
+  times out, or when the connector is destroyed.
+
+  Multihomed associations bind to a set of local addresses (sctp_bindx), and connect to all
+  E2Term addresses at once (sctp_connectx). In this case there is a single attempt, so nothing is raced.
+*/
+class SctpConnector {
+
+private:
+
+  typedef std::chrono::steady_clock clock;
+
+  typedef struct {
+    int family;                   // address family of the socket
+    std::vector<uint8_t> addrs;   // packed addresses of the association as expected by sctp_connectx
+    int count;                    // number of addresses
+    std::string name;             // used for logging
+  } candidate_t;
+
+  typedef struct {
+    int fd;
+    clock::time_point deadline;
+    std::string addr;     // used for logging
+  } attempt_t;
+
+  std::string server;   // used for logging
+  std::vector<std::string> local_addrs;   // local addresses to bind to, empty binds to all of them
+  std::vector<std::string> peer_addrs;    // additional E2Term addresses of a multihomed association
+  std::vector<uint8_t> local_v4;          // packed local IPv4 addresses
+  std::vector<uint8_t> local_all;         // packed local IPv4 and IPv6 addresses
+  int local_v4_count;
+  int local_all_count;
+  std::vector<candidate_t> candidates;
+  size_t next_candidate;
+  std::vector<attempt_t> attempts;    // connections in progress
+  clock::time_point next_start;       // time to race the next candidate
+  sctp_profile_t profile;             // transport profile of each attempt
+  int connected_fd;
+  bool failed;                        // all attempts have failed
+
+  int attempt_timeout_ms;
+  int stagger_ms;
+  SctpWatchCallback watch;
+
+  bool resolve(const char *addr, int port);
+  bool resolve_multihomed(const char *addr, int port);
+  bool resolve_local();
+  bool bind_local(int fd, int family);
+  void start_attempts();
+  void stop_attempt(size_t index, bool close_fd);
+
+public:
+
+  SctpConnector(int attempt_timeout_ms = SCTP_CONNECT_TIMEOUT_MS, int stagger_ms = SCTP_CONNECT_STAGGER_MS);
+
+  ~SctpConnector();
+
+  void set_local_addresses(const std::vector<std::string> &addrs);
+
+  void set_peer_addresses(const std::vector<std::string> &addrs);
+
+  void set_profile(const sctp_profile_t &profile);
+
+  bool start(const char *addr, int port, SctpWatchCallback watch);
+
+  void handle_writable(int fd);
+
+  void handle_timeout();
+
+  int next_timeout_ms();
+
+  bool in_progress();
+
+  int release_fd();
+
+};
+
+#endif
@@ -0,0 +1,318 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/sctp.h>
+#include <fstream>
+
+#include "sctp_profile.hpp"
+#include "logger.h"
+
+// names of the profile options, as used by the command line and profile files
+static const struct {
+  const char *key;
+  int sctp_profile_t::*field;
+} profile_keys[] = {
+  {"nodelay", &sctp_profile_t::nodelay},
+  {"sndbuf", &sctp_profile_t::sndbuf},
+  {"rcvbuf", &sctp_profile_t::rcvbuf},
+  {"rto_initial", &sctp_profile_t::rto_initial},
+  {"rto_min", &sctp_profile_t::rto_min},
+  {"rto_max", &sctp_profile_t::rto_max},
+  {"hb_interval", &sctp_profile_t::hb_interval},
+  {"path_max_retrans", &sctp_profile_t::path_max_retrans},
+  {"ostreams", &sctp_profile_t::ostreams},
+  {"instreams", &sctp_profile_t::instreams},
+  {"init_attempts", &sctp_profile_t::init_attempts},
+  {"init_timeout", &sctp_profile_t::init_timeout},
+  {"maxseg", &sctp_profile_t::maxseg}
+};
+
+static std::string trim(const std::string &s) {
+  size_t start = s.find_first_not_of(" \t\r\n");
+  if (start == std::string::npos) {
+    return "";
+  }
+  size_t end = s.find_last_not_of(" \t\r\n");
+  return s.substr(start, end - start + 1);
+}
+
+/*
+  Sets the option key of the profile to value, which is either a non-negative integer
+  or "default" to keep the kernel default.
+
+  Returns false if the key or the value is invalid
+*/
+bool sctp_profile_set(sctp_profile_t &profile, const std::string &key, const std::string &value) {
+  for (const auto &k : profile_keys) {
+    if (key != k.key) {
+      continue;
+    }
+
+    if (value == "default") {
+      profile.*k.field = SCTP_PROFILE_UNSET;
+      return true;
+    }
+
+    char *end;
+    errno = 0;
+    long v = strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || errno != 0 || v < 0 || v > INT32_MAX) {
+      logger_error("[SCTP] Invalid value \"%s\" for transport option %s", value.c_str(), key.c_str());
+      return false;
+    }
+
+    profile.*k.field = (int)v;
+    return true;
+  }
+
+  logger_error("[SCTP] Unknown transport option %s", key.c_str());
+  return false;
+}
+
+/*
+  Sets an option of the profile given as key=value
+*/
+bool sctp_profile_parse(sctp_profile_t &profile, const std::string &option) {
+  size_t pos = option.find('=');
+  if (pos == std::string::npos) {
+    logger_error("[SCTP] Transport option \"%s\" is not in the key=value format", option.c_str());
+    return false;
+  }
+
+  return sctp_profile_set(profile, trim(option.substr(0, pos)), trim(option.substr(pos + 1)));
+}
+
+/*
+  Loads the options of the profile from a file with one key=value per line.
+  Empty lines and anything after # are ignored.
+
+  Returns false if the file can not be read or has an invalid option
+*/
+bool sctp_profile_load(sctp_profile_t &profile, const char *path) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    logger_error("[SCTP] Unable to open transport profile %s: %s", path, strerror(errno));
+    return false;
+  }
+
+  std::string line;
+  int line_num = 0;
+  while (std::getline(file, line)) {
+    line_num++;
+
+    size_t comment = line.find('#');
+    if (comment != std::string::npos) {
+      line.erase(comment);
+    }
+    line = trim(line);
+    if (line.empty()) {
+      continue;
+    }
+
+    if (!sctp_profile_parse(profile, line)) {
+      logger_error("[SCTP] Invalid transport profile %s at line %d", path, line_num);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/*
+  Calls visitor with the name and the value of each option of the profile
+*/
+void sctp_profile_for_each(const sctp_profile_t &profile, SctpProfileVisitor visitor) {
+  for (const auto &k : profile_keys) {
+    visitor(k.key, profile.*k.field);
+  }
+}
+
+/*
+  Unsets all options of the profile, i.e. keeps the kernel defaults
+*/
+void sctp_profile_clear(sctp_profile_t &profile) {
+  for (const auto &k : profile_keys) {
+    profile.*k.field = SCTP_PROFILE_UNSET;
+  }
+}
+
+static void set_option(int socket_fd, int level, int name, const void *val, socklen_t len, const char *optname) {
+  if (setsockopt(socket_fd, level, name, val, len) == -1) {
+    logger_warn("[SCTP] Unable to set %s: %s", optname, strerror(errno));
+  }
+}
+
+static bool is_set(int value) {
+  return value != SCTP_PROFILE_UNSET;
+}
+
+/*
+  Applies the profile to socket_fd. Must be called before connecting (or listening),
+  so that the options are inherited by the association. Failures are only logged.
+*/
+void sctp_profile_apply(int socket_fd, const sctp_profile_t &profile) {
+  if (is_set(profile.nodelay)) {
+    int nodelay = profile.nodelay ? 1 : 0;
+    set_option(socket_fd, IPPROTO_SCTP, SCTP_NODELAY, &nodelay, sizeof(nodelay), "SCTP_NODELAY");
+  }
+
+  if (is_set(profile.sndbuf)) {
+    set_option(socket_fd, SOL_SOCKET, SO_SNDBUF, &profile.sndbuf, sizeof(profile.sndbuf), "SO_SNDBUF");
+  }
+
+  if (is_set(profile.rcvbuf)) {
+    set_option(socket_fd, SOL_SOCKET, SO_RCVBUF, &profile.rcvbuf, sizeof(profile.rcvbuf), "SO_RCVBUF");
+  }
+
+  // zeroed fields keep their current values
+  if (is_set(profile.rto_initial) || is_set(profile.rto_min) || is_set(profile.rto_max)) {
+    struct sctp_rtoinfo rto;
+    memset(&rto, 0, sizeof(rto));
+    rto.srto_initial = is_set(profile.rto_initial) ? profile.rto_initial : 0;
+    rto.srto_min = is_set(profile.rto_min) ? profile.rto_min : 0;
+    rto.srto_max = is_set(profile.rto_max) ? profile.rto_max : 0;
+    set_option(socket_fd, IPPROTO_SCTP, SCTP_RTOINFO, &rto, sizeof(rto), "SCTP_RTOINFO");
+  }
+
+  // without an address, these become the defaults of every path of the association
+  if (is_set(profile.hb_interval) || is_set(profile.path_max_retrans)) {
+    struct sctp_paddrparams params;
+    memset(&params, 0, sizeof(params));
+    if (profile.hb_interval == 0) {
+      params.spp_flags = SPP_HB_DISABLE;
+    } else if (is_set(profile.hb_interval)) {
+      params.spp_flags = SPP_HB_ENABLE;
+      params.spp_hbinterval = profile.hb_interval;
+    }
+    params.spp_pathmaxrxt = is_set(profile.path_max_retrans) ? profile.path_max_retrans : 0;
+    set_option(socket_fd, IPPROTO_SCTP, SCTP_PEER_ADDR_PARAMS, &params, sizeof(params), "SCTP_PEER_ADDR_PARAMS");
+  }
+
+  // the peer might grant less streams than requested
+  if (is_set(profile.ostreams) || is_set(profile.instreams) || is_set(profile.init_attempts) || is_set(profile.init_timeout)) {
+    struct sctp_initmsg initmsg;
+    memset(&initmsg, 0, sizeof(initmsg));
+    initmsg.sinit_num_ostreams = is_set(profile.ostreams) ? profile.ostreams : 0;
+    initmsg.sinit_max_instreams = is_set(profile.instreams) ? profile.instreams : 0;
+    initmsg.sinit_max_attempts = is_set(profile.init_attempts) ? profile.init_attempts : 0;
+    initmsg.sinit_max_init_timeo = is_set(profile.init_timeout) ? profile.init_timeout : 0;
+    set_option(socket_fd, IPPROTO_SCTP, SCTP_INITMSG, &initmsg, sizeof(initmsg), "SCTP_INITMSG");
+  }
+
+  if (is_set(profile.maxseg)) {
+    struct sctp_assoc_value maxseg;
+    memset(&maxseg, 0, sizeof(maxseg));
+    maxseg.assoc_value = profile.maxseg;
+    set_option(socket_fd, IPPROTO_SCTP, SCTP_MAXSEG, &maxseg, sizeof(maxseg), "SCTP_MAXSEG");
+  }
+}
+
+// clears ok on failure
+static bool get_option(int socket_fd, int level, int name, void *val, socklen_t len, const char *optname, bool &ok) {
+  if (getsockopt(socket_fd, level, name, val, &len) == -1) {
+    logger_warn("[SCTP] Unable to get %s: %s", optname, strerror(errno));
+    ok = false;
+    return false;
+  }
+  return true;
+}
+
+/*
+  Reads the effective values of the profile options from the association of socket_fd.
+  Note that the kernel doubles the requested socket buffer sizes, and streams are
+  the ones negotiated with the peer. Options that can not be read are left unset.
+
+  Returns false if any option can not be read
+*/
+bool sctp_profile_read(int socket_fd, sctp_profile_t &effective) {
+  bool ok = true;
+  int value;
+
+  sctp_profile_clear(effective);
+
+  if (get_option(socket_fd, IPPROTO_SCTP, SCTP_NODELAY, &value, sizeof(value), "SCTP_NODELAY", ok)) {
+    effective.nodelay = value;
+  }
+
+  if (get_option(socket_fd, SOL_SOCKET, SO_SNDBUF, &value, sizeof(value), "SO_SNDBUF", ok)) {
+    effective.sndbuf = value;
+  }
+
+  if (get_option(socket_fd, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value), "SO_RCVBUF", ok)) {
+    effective.rcvbuf = value;
+  }
+
+  struct sctp_rtoinfo rto;
+  memset(&rto, 0, sizeof(rto));
+  if (get_option(socket_fd, IPPROTO_SCTP, SCTP_RTOINFO, &rto, sizeof(rto), "SCTP_RTOINFO", ok)) {
+    effective.rto_initial = rto.srto_initial;
+    effective.rto_min = rto.srto_min;
+    effective.rto_max = rto.srto_max;
+  }
+
+  struct sctp_paddrparams params;
+  memset(&params, 0, sizeof(params));
+  if (get_option(socket_fd, IPPROTO_SCTP, SCTP_PEER_ADDR_PARAMS, &params, sizeof(params), "SCTP_PEER_ADDR_PARAMS", ok)) {
+    effective.hb_interval = (params.spp_flags & SPP_HB_DISABLE) ? 0 : params.spp_hbinterval;
+    effective.path_max_retrans = params.spp_pathmaxrxt;
+  }
+
+  struct sctp_initmsg initmsg;
+  memset(&initmsg, 0, sizeof(initmsg));
+  if (get_option(socket_fd, IPPROTO_SCTP, SCTP_INITMSG, &initmsg, sizeof(initmsg), "SCTP_INITMSG", ok)) {
+    effective.init_attempts = initmsg.sinit_max_attempts;
+    effective.init_timeout = initmsg.sinit_max_init_timeo;
+  }
+
+  struct sctp_status status;
+  memset(&status, 0, sizeof(status));
+  if (get_option(socket_fd, IPPROTO_SCTP, SCTP_STATUS, &status, sizeof(status), "SCTP_STATUS", ok)) {
+    effective.ostreams = status.sstat_outstrms;
+    effective.instreams = status.sstat_instrms;
+  }
+
+  struct sctp_assoc_value maxseg;
+  memset(&maxseg, 0, sizeof(maxseg));
+  if (get_option(socket_fd, IPPROTO_SCTP, SCTP_MAXSEG, &maxseg, sizeof(maxseg), "SCTP_MAXSEG", ok)) {
+    effective.maxseg = maxseg.assoc_value;
+  }
+
+  return ok;
+}
+
+/*
+  Logs all options of the profile in a single line
+*/
+void sctp_profile_log(const sctp_profile_t &profile, const char *title) {
+  std::string options;
+  sctp_profile_for_each(profile, [&options](const char *key, int value) {
+    options += " ";
+    options += key;
+    options += "=";
+    options += is_set(value) ? std::to_string(value) : "default";
+  });
+
+  logger_info("[SCTP] %s:%s", title, options.c_str());
+}
@@ -0,0 +1,68 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+
+#ifndef SCTP_PROFILE_HPP
+#define SCTP_PROFILE_HPP
+
+#include <string>
+#include <functional>
+#include "e2sim_defs.h"
+
+#define SCTP_PROFILE_UNSET  (-1)   // keeps the kernel default of an option
+
+/*
+  Transport profile applied to every SCTP association.
+  Options set to SCTP_PROFILE_UNSET keep the kernel defaults (see sysctl net.sctp).
+  Times are in milliseconds and sizes in bytes.
+*/
+typedef struct {
+  int nodelay = 1;              // SCTP_NODELAY, sends each message right away instead of bundling it with the next ones
+  int sndbuf = SCTP_PROFILE_UNSET;          // SO_SNDBUF
+  int rcvbuf = SCTP_PROFILE_UNSET;          // SO_RCVBUF
+  int rto_initial = SCTP_PROFILE_UNSET;     // SCTP_RTOINFO
+  int rto_min = SCTP_PROFILE_UNSET;
+  int rto_max = SCTP_PROFILE_UNSET;
+  int hb_interval = SCTP_PROFILE_UNSET;     // SCTP_PEER_ADDR_PARAMS heartbeat interval, 0 disables heartbeats
+  int path_max_retrans = SCTP_PROFILE_UNSET;  // SCTP_PEER_ADDR_PARAMS retransmissions before a path is unreachable
+  int ostreams = E2AP_NUM_STREAMS;          // SCTP_INITMSG, one stream per class of E2AP messages
+  int instreams = E2AP_NUM_STREAMS;
+  int init_attempts = SCTP_PROFILE_UNSET;
+  int init_timeout = SCTP_PROFILE_UNSET;
+  int maxseg = SCTP_PROFILE_UNSET;          // SCTP_MAXSEG, maximum size of each DATA chunk
+} sctp_profile_t;
+
+typedef std::function<void(const char *key, int value)> SctpProfileVisitor;
+
+bool sctp_profile_set(sctp_profile_t &profile, const std::string &key, const std::string &value);
+
+bool sctp_profile_parse(sctp_profile_t &profile, const std::string &option);
+
+bool sctp_profile_load(sctp_profile_t &profile, const char *path);
+
+void sctp_profile_clear(sctp_profile_t &profile);
+
+void sctp_profile_for_each(const sctp_profile_t &profile, SctpProfileVisitor visitor);
+
+void sctp_profile_apply(int socket_fd, const sctp_profile_t &profile);
+
+bool sctp_profile_read(int socket_fd, sctp_profile_t &effective);
+
+void sctp_profile_log(const sctp_profile_t &profile, const char *title);
+
+#endif
@@ -23,10 +23,14 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <signal.h>
 #include <chrono>
 #include <condition_variable>
 #include <mutex>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <string.h>
+#include <errno.h>
+#include <stdexcept>
 
 #include "e2sim.hpp"
 #include "e2sim_defs.h"
@@ -36,15 +40,44 @@
 
 using namespace std;
 
-std::mutex cond_mutex;
-std::condition_variable cond; // condition to wait/awake the connection helper thread
+/*
+  Receive ring shared by all E2Sims whose sockets are read by the same reactor thread.
+  It is only allocated on the first receive, so threads that never read SCTP sockets
+  (e.g. with the io_uring transport) do not hold one.
+*/
+class RecvRingHolder {
+
+public:
+
+  sctp_recv_ring_t *ring = NULL;
+
+  ~RecvRingHolder() {
+    sctp_recv_ring_free(ring);
+  }
+
+};
+
+static thread_local RecvRingHolder recv_ring_holder;
+
+/*
+  Returns the receive ring of the calling thread, or NULL if it could not be allocated
+*/
+static sctp_recv_ring_t *get_recv_ring() {
+  if (recv_ring_holder.ring == NULL) {
+    recv_ring_holder.ring = sctp_recv_ring_alloc();
+  }
+  return recv_ring_holder.ring;
+}
 
 /*
   E2Sim constructor
 
+  SCTP data is dispatched by the given reactor, or by the process-wide
+  default reactor if none is provided.
+
   throws std::invalid_argument
 */
-E2Sim::E2Sim(const char *mcc, const char *mnc, uint32_t gnb_id) {
+E2Sim::E2Sim(const char *mcc, const char *mnc, uint32_t gnb_id, Reactor *reactor) {
   logger_trace("in %s constructor", __func__);
 
   if (strlen(mcc) != 3) {
@@ -74,8 +107,44 @@ E2Sim::E2Sim(const char *mcc, const char *mnc, uint32_t gnb_id) {
   this->gnb_id.buf[2] = ((gnb_id & 0X0000FF00) >> 8);
   this->gnb_id.buf[3] = (gnb_id & 0X000000FF);
 
-  retryConnection = true;
+  ok2run = false;
   client_fd = -1;
+  num_ostreams = 1;
+  multistream = true;
+  timestamping = false;
+  sctp_profile_clear(transport_effective);
+
+  send_buf = NULL;
+  memset(&send_stats, 0, sizeof(send_stats_t));
+  max_batch = 1;
+  flush_us = 0;
+  batch_used = 0;
+  batch_timer_fd = -1;
+  batch_timer_armed = false;
+  watching_writable = false;
+  writable_pending = false;
+  connect_timer_fd = -1;
+  connecting = false;
+  setup_policy.max_attempts = E2_SETUP_MAX_ATTEMPTS;
+  setup_policy.timeout_ms = E2_SETUP_TIMEOUT_MS;
+  setup_policy.backoff_ms = E2_SETUP_BACKOFF_MS;
+  setup_policy.backoff_max_ms = E2_SETUP_BACKOFF_MAX_MS;
+  setup_state = E2_SETUP_IDLE;
+  setup_attempts = 0;
+  setup_response_ns = 0;
+  setup_timer = 0;
+  pdu_buffer_init(&setup_request);
+  if (!resize_send_buffer(E2AP_SEND_BUFFER_SIZE)) {
+    throw bad_alloc();
+  }
+
+  sctp_reassembly_init(&recv_reasm);
+
+  this->reactor = reactor;
+  if (this->reactor == NULL) {
+    this->reactor = Reactor::get_default();
+  }
+  uring = NULL;
 
   logger_trace("end of %s constructor", __func__);
 }
@@ -83,23 +152,27 @@ E2Sim::E2Sim(const char *mcc, const char *mnc, uint32_t gnb_id) {
 E2Sim::~E2Sim() {
   logger_trace("in func %s", __func__);
 
-  if(sctp_listener_th.joinable()) {
-    sctp_listener_th.join();
-  }
+  shutdown();   // no-op if it has already been called
+
+  reactor->cancel(setup_timer);   // waits for a running E2 setup step
+  pdu_buffer_release(&setup_request);
   ASN_STRUCT_FREE(asn_DEF_PLMN_Identity, this->plmn_id);
   ASN_STRUCT_RESET(asn_DEF_BIT_STRING, &this->gnb_id);
 
-  for(auto reg_func : ran_functions_registered ) {
-    ASN_STRUCT_RESET(asn_DEF_PrintableString, &reg_func.second->oid);
-    ASN_STRUCT_RESET(asn_DEF_OCTET_STRING, &reg_func.second->ran_function_ostr);
-    free(reg_func.second);
+  if (client_fd != -1) {
+    logger_debug("about to close client_fd %d", client_fd);
+    close(client_fd);
+  }
+
+  if (batch_timer_fd != -1) {
+    close(batch_timer_fd);
   }
 
-  logger_debug("about to close client_fd %d", client_fd);
-  close(client_fd);
+  free(send_buf);
+  sctp_reassembly_free(&recv_reasm);
 }
 
-std::unordered_map<long, encoded_ran_function_t *> E2Sim::getRegistered_ran_functions() {
+std::unordered_map<long, RanFunctionRef> E2Sim::getRegistered_ran_functions() {
   return ran_functions_registered;
 }
 
@@ -118,6 +191,41 @@ void E2Sim::register_control_callback(long func_id, ControlCallback cb) {
   control_callbacks[func_id] = cb;
 }
 
+/*
+  Registers a callback that receives the state changes of each path of the SCTP association.
+  It runs in the reactor thread. Must be called before run().
+*/
+void E2Sim::register_path_event_callback(PathEventCallback cb) {
+  path_event_cb = cb;
+}
+
+/*
+  Registers a callback that receives each message leaving the send queue (see setSendQueue),
+  either sent or dropped. Messages dropped without entering the queue are also reported.
+  Must be called before run().
+*/
+void E2Sim::register_send_queue_callback(SendQueueCallback cb) {
+  send_queue_cb = cb;
+}
+
+/*
+  Registers a callback that tells the senders waiting on a full send queue (see is_send_queue_full)
+  that it has room again, or that it has been discarded. It runs in the reactor thread or in the
+  transport thread with the send path locked, so it must only schedule the senders, not send messages.
+  Must be called before run().
+*/
+void E2Sim::register_writable_callback(WritableCallback cb) {
+  writable_cb = cb;
+}
+
+/*
+  Sets the callback that receives the failed attempts and the outcome of the E2 setup.
+  Must be called before run().
+*/
+void E2Sim::register_e2_setup_callback(E2SetupCallback cb) {
+  setup_cb = cb;
+}
+
 SubscriptionCallback E2Sim::get_subscription_callback(long func_id) {
   logger_debug("we are getting the subscription callback for func id %ld", func_id);
   SubscriptionCallback cb;
@@ -192,7 +300,11 @@ bool E2Sim::is_e2term_endpoint(std::string addr, int port) {
   return false;
 }
 
-void E2Sim::register_e2sm(long func_id, encoded_ran_function_t *ran_func)
+/*
+  Registers a RAN function of this E2Sim. The RAN function is shared, so it must not be changed afterwards
+  (see RanFunctionRegistry).
+*/
+void E2Sim::register_e2sm(long func_id, RanFunctionRef ran_func)
 {
 
   //Error conditions:
@@ -204,58 +316,698 @@ void E2Sim::register_e2sm(long func_id, encoded_ran_function_t *ran_func)
   if (res == ran_functions_registered.end()) {
     ran_functions_registered[func_id] = ran_func;
   } else {
-    logger_error("function with id %ld is already registered");
+    logger_error("function with id %ld is already registered", func_id);
+  }
+}
+
+/*
+  Registers a RAN function owned by this E2Sim, which is freed with it
+*/
+void E2Sim::register_e2sm(long func_id, encoded_ran_function_t *ran_func) {
+  register_e2sm(func_id, ran_function_ref(ran_func));
+}
+
+/*
+  Resizes the send buffer to fit at least size bytes, keeping its content
+  (i.e. queued messages are kept at the same offsets). Requires send_lock.
+
+  Returns false if the memory could not be allocated.
+*/
+bool E2Sim::resize_send_buffer(size_t size)
+{
+  size = (size + E2AP_SEND_BUFFER_SIZE - 1) / E2AP_SEND_BUFFER_SIZE * E2AP_SEND_BUFFER_SIZE; // avoids growing byte by byte
+
+  uint8_t *buf = (uint8_t *) realloc(send_buf, size);
+  if (buf == NULL) {
+    logger_error("unable to allocate %zu bytes for the send buffer", size);
+    return false;
+  }
+
+  send_buf = buf;
+  send_stats.buffer_size = size;
+  send_stats.allocations++;
+
+  logger_debug("send buffer resized to %zu bytes", size);
+
+  return true;
+}
+
+/*
+  Returns the E2AP class (one of E2AP_STREAM_*) of the pdu, regardless of the streams in use.
+  Must be called before encoding since it releases the pdu.
+*/
+uint16_t E2Sim::get_class(E2AP_PDU_t *pdu)
+{
+  return e2ap_asn1c_get_stream(pdu);
+}
+
+/*
+  Returns the SCTP stream that carries the messages of the given E2AP class
+*/
+uint16_t E2Sim::get_stream(uint16_t msg_class)
+{
+  uint16_t stream = E2AP_STREAM_GLOBAL;
+
+  if (multistream) {
+    stream = msg_class;
+    if (stream >= num_ostreams) {
+      stream = E2AP_STREAM_GLOBAL;  // the E2Term has not granted enough streams
+    }
+  }
+
+  return stream;
+}
+
+/*
+  Encodes the pdu straight into the send buffer starting at offset. Requires send_lock.
+
+  The send buffer is only resized when a PDU does not fit in the space left, so
+  no heap allocation is done on steady state (see get_send_stats).
+  The pdu is not released.
+
+  Returns the encoded size, or -1 on error.
+*/
+ssize_t E2Sim::encode_to_send_buffer(E2AP_PDU_t *pdu, size_t offset)
+{
+  asn_enc_rval_t er = asn_encode_to_buffer(NULL, ATS_ALIGNED_BASIC_PER, &asn_DEF_E2AP_PDU, pdu,
+                                           send_buf + offset, send_stats.buffer_size - offset);
+
+  if (er.encoded > 0 && (size_t)er.encoded > send_stats.buffer_size - offset) {
+    // the encoder reports the required size when the buffer is too small, so we encode it again only once
+    if (!resize_send_buffer(offset + er.encoded)) {
+      return -1;
+    }
+    er = asn_encode_to_buffer(NULL, ATS_ALIGNED_BASIC_PER, &asn_DEF_E2AP_PDU, pdu,
+                              send_buf + offset, send_stats.buffer_size - offset);
+  }
+
+  if (er.encoded <= 0) {
+    logger_error("[E2AP ASN] Unable to aper encode %s", er.failed_type ? er.failed_type->name : "E2AP-PDU");
+    return -1;
+  }
+
+  logger_debug("[E2AP ASN] Encoded succesfully, encoded size = %ld", er.encoded);
+
+  return er.encoded;
+}
+
+/*
+  Sends all queued messages in a single batch and reports their timestamp
+  to the sent callbacks. Messages that do not fit in the socket buffer (or in
+  the io_uring window) go to the send queue. Requires send_lock.
+*/
+void E2Sim::flush_batch()
+{
+  struct timespec ts;
+
+  if (batch.empty()) {
+    return;
+  }
+
+  unsigned int sent = 0;
+  bool failed = false;    // the association has failed, rather than running out of socket buffer
+  if (!send_queue.empty()) {
+    // the batch would overtake the queued messages
+
+  } else if (uring) {
+    sent = batch.size() < uring_room() ? batch.size() : uring_room();
+    if (sent > 0 && !uring->send_batch(client_fd, send_buf, batch.data(), sent, &ts)) {
+      sent = 0;
+      failed = true;
+    }
+    for (unsigned int i = 0; i < sent; i++) {
+      track_uring_message(batch_classes[i], batch_cbs[i], &ts, false, 0);   // reported once the transport completes it
+    }
+
+  } else {
+    sent = sctp_send_batch(client_fd, send_buf, batch.data(), batch.size(), &ts, MSG_DONTWAIT);
+    failed = sent < batch.size() && errno != EAGAIN && errno != EWOULDBLOCK;
+    send_stats.messages += sent;
+
+    for (unsigned int i = 0; i < sent; i++) {
+      if (batch_cbs[i]) {
+        batch_cbs[i](&ts);
+      }
+    }
+  }
+  send_stats.batches++;
+
+  for (unsigned int i = sent; i < batch.size(); i++) {
+    if (failed) {
+      report_queue_event(batch_classes[i], true, 0);
+      continue;
+    }
+    queue_message(send_buf + batch[i].offset, batch[i].len, batch[i].stream, batch_classes[i], batch_cbs[i]);
+  }
+
+  batch.clear();
+  batch_cbs.clear();
+  batch_classes.clear();
+  batch_used = 0;
+}
+
+/*
+  Flushes the queued messages on deadline. Runs in the reactor thread.
+*/
+void E2Sim::handle_batch_timer(uint32_t events)
+{
+  uint64_t expirations;
+  if (read(batch_timer_fd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) {
+    logger_error("unable to read batch timer: %s", strerror(errno));
+  }
+
+  std::lock_guard<std::mutex> guard(send_lock);
+  batch_timer_armed = false;
+  flush_batch();
+}
+
+/*
+  Hands len bytes of buf to the SCTP socket without blocking, or queues them in the send queue
+  if the socket buffer is full or other messages are already waiting. Requires send_lock.
+
+  The callback cb receives the timestamp taken when the message is handed to the kernel, while ts
+  receives either that timestamp or the time the message has been queued. With io_uring, the
+  io_uring window takes the place of the socket buffer, and cb runs once the send completes.
+*/
+void E2Sim::send_message(const uint8_t *buf, size_t len, uint16_t stream, uint16_t msg_class, SentCallback cb, struct timespec *ts)
+{
+  struct timespec sent_ts;
+  if (ts == NULL) {
+    ts = &sent_ts;
+  }
+
+  if (uring) {
+    if (send_queue.empty() && uring_room() > 0) {   // otherwise the message would overtake the queued ones
+      if (uring->send(client_fd, buf, len, stream, ts)) {
+        track_uring_message(msg_class, cb, ts, false, 0);
+      } else {
+        report_queue_event(msg_class, true, 0);   // no longer in the transport, this E2Sim is shutting down
+      }
+      return;
+    }
+
+  } else if (send_queue.empty()) {   // otherwise the message would overtake the queued ones
+    if (sctp_send_data(client_fd, buf, len, ts, stream, MSG_DONTWAIT) > 0) {
+      send_stats.messages++;
+      if (cb) {
+        cb(ts);
+      }
+      return;
+    }
+
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      report_queue_event(msg_class, true, 0);   // the reactor shuts down this E2Sim once it detects the failure
+      return;
+    }
+  }
+
+  queue_message(buf, len, stream, msg_class, cb);
+  clock_gettime(CLOCK_REALTIME, ts);
+}
+
+/*
+  Copies a message to the tail of the send queue, making room for it according to the
+  queue policy, and watches the socket to send it once the socket buffer has room. Requires send_lock.
+*/
+void E2Sim::queue_message(const uint8_t *buf, size_t len, uint16_t stream, uint16_t msg_class, SentCallback cb)
+{
+  uint16_t evicted_class;
+
+  /*
+    The block policy never waits here, as this runs in the shard thread of the sender, which
+    also serves other nodes. Senders that can wait check is_send_queue_full before sending instead.
+  */
+  while (send_queue.get_policy() != SEND_QUEUE_BLOCK && !send_queue.has_room(len)) {
+    if (send_queue.evict(msg_class, evicted_class)) {
+      report_queue_event(evicted_class, true, 0);
+
+    } else {
+      report_queue_event(msg_class, true, 0);   // drop-newest, or nothing less important to shed
+      return;
+    }
+  }
+
+  send_queue.push(buf, len, stream, msg_class, cb);
+  send_stats.queued++;
+  watch_writable(true);
+}
+
+/*
+  Sends the queued messages until the socket buffer (or the io_uring window) is full again. Requires send_lock.
+*/
+void E2Sim::drain_send_queue()
+{
+  struct timespec ts;
+  struct timespec now;
+
+  while (!send_queue.empty()) {
+    queued_msg_t &msg = send_queue.front();
+    uint16_t msg_class = msg.msg_class;
+    int ret;
+
+    if (uring) {
+      if (uring_room() == 0) {
+        break;    // resumed by the completions of the transport
+      }
+      ret = uring->send(client_fd, msg.data.data(), msg.data.size(), msg.stream, &ts) ? 0 : -1;
+
+    } else {
+      ret = sctp_send_data(client_fd, msg.data.data(), msg.data.size(), &ts, msg.stream, MSG_DONTWAIT);
+      if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        break;
+      }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    unsigned long delay_ns = (now.tv_sec - msg.queued.tv_sec) * 1000000000UL + now.tv_nsec - msg.queued.tv_nsec;
+
+    if (ret == -1) {
+      send_queue.pop();
+      report_queue_event(msg_class, true, delay_ns);   // the association has failed
+      continue;
+    }
+
+    if (uring) {
+      track_uring_message(msg_class, msg.cb, &ts, true, delay_ns);  // reported once the transport completes it
+      send_queue.pop();
+      continue;
+    }
+
+    send_stats.messages++;
+    if (msg.cb) {
+      msg.cb(&ts);
+    }
+    send_queue.pop();
+    report_queue_event(msg_class, false, delay_ns);
+  }
+
+  if (send_queue.empty()) {
+    watch_writable(false);
+  }
+
+  if (!send_queue.full()) {
+    notify_writable();
+  }
+}
+
+/*
+  Tells the senders waiting on a full send queue to resume, if any. Requires send_lock.
+*/
+void E2Sim::notify_writable()
+{
+  if (writable_pending) {
+    writable_pending = false;
+    if (writable_cb) {
+      writable_cb();
+    }
+  }
+}
+
+/*
+  Tells if the send queue is full under the block policy, so the caller should stop sending until
+  the writable callback is called, rather than block the thread it shares with other nodes.
+  Always false under other policies, which make room in the queue themselves.
+*/
+bool E2Sim::is_send_queue_full()
+{
+  std::lock_guard<std::mutex> guard(send_lock);
+
+  if (send_queue.get_policy() != SEND_QUEUE_BLOCK || !send_queue.full()) {
+    return false;
+  }
+
+  send_stats.blocked++;
+  writable_pending = true;
+  return true;
+}
+
+/*
+  Starts or stops watching the socket for room in its buffer. Requires send_lock.
+*/
+void E2Sim::watch_writable(bool watch)
+{
+  if (watch == watching_writable || !ok2run || uring) {   // the completions of io_uring drain the queue instead
+    return;
+  }
+
+  try {
+    reactor->modify(client_fd, watch ? EPOLLIN | EPOLLOUT : EPOLLIN);
+    watching_writable = watch;
+  } catch (const std::runtime_error &e) {
+    logger_error("[SCTP] Unable to watch the socket buffer: %s", e.what());
+  }
+}
+
+/*
+  Accounts for a message leaving the send queue, or dropped before entering it. Requires send_lock.
+*/
+void E2Sim::report_queue_event(uint16_t msg_class, bool dropped, unsigned long delay_ns)
+{
+  if (dropped) {
+    send_stats.dropped++;
+  }
+
+  if (send_queue_cb) {
+    send_queue_event_t event;
+    event.msg_class = msg_class;
+    event.dropped = dropped;
+    event.delay_ns = delay_ns;
+    event.depth = send_queue.size();
+    event.bytes = send_queue.bytes();
+    send_queue_cb(event);
+  }
+}
+
+/*
+  Tells how many more messages can be in flight in the io_uring transport. Requires send_lock.
+*/
+size_t E2Sim::uring_room()
+{
+  return uring_inflight.size() < E2SIM_URING_WINDOW ? E2SIM_URING_WINDOW - uring_inflight.size() : 0;
+}
+
+/*
+  Keeps a message handed to the io_uring transport until its send completes. Requires send_lock.
+*/
+void E2Sim::track_uring_message(uint16_t msg_class, SentCallback cb, struct timespec *ts, bool queued, unsigned long delay_ns)
+{
+  uring_msg_t msg;
+  msg.msg_class = msg_class;
+  msg.cb = cb;
+  msg.sent = *ts;
+  msg.queued = queued;
+  msg.delay_ns = delay_ns;
+  uring_inflight.push_back(std::move(msg));
+}
+
+/*
+  Handles the completion of a message sent through the io_uring transport, which completes the sends
+  of an association in order, and sends the queued messages that now fit in the io_uring window.
+  Failed and cancelled sends are dropped, so their sent callbacks are never called. Runs in the transport thread.
+*/
+void E2Sim::handle_uring_sent(int res)
+{
+  std::lock_guard<std::mutex> guard(send_lock);
+
+  if (uring_inflight.empty()) {
+    return;   // discarded by shutdown
+  }
+
+  uring_msg_t msg = std::move(uring_inflight.front());
+  uring_inflight.pop_front();
+
+  if (res < 0) {
+    report_queue_event(msg.msg_class, true, msg.delay_ns);  // the transport shuts down this E2Sim once it detects the failure
+
+  } else {
+    send_stats.messages++;
+    if (msg.cb) {
+      msg.cb(&msg.sent);
+    }
+    if (msg.queued) {
+      report_queue_event(msg.msg_class, false, msg.delay_ns);
+    }
   }
+
+  drain_send_queue();
 }
 
+/*
+  Encodes the pdu straight into the send buffer and hands it to the SCTP socket.
+  Any batched message is sent first to keep the order of messages.
+  If the socket buffer is full, the message waits in the send queue (see setSendQueue),
+  and ts receives the time it has been queued. The pdu is released after encoding.
+*/
 void E2Sim::encode_and_send_sctp_data(E2AP_PDU_t* pdu, struct timespec *ts)
 {
-  uint8_t       *buf;
-  sctp_buffer_t data;
+  uint16_t msg_class = get_class(pdu);
+  uint16_t stream = get_stream(msg_class);
+
+  std::lock_guard<std::mutex> guard(send_lock);
+
+  flush_batch();
+
+  ssize_t len = encode_to_send_buffer(pdu, 0);
+  ASN_STRUCT_FREE(asn_DEF_E2AP_PDU, pdu);
+  if (len == -1) {
+    return;
+  }
+
+  send_message(send_buf, len, stream, msg_class, nullptr, ts);
+}
+
+/*
+  Same as encode_and_send_sctp_data, but for a message already encoded in APER (e.g. by a fast encoder)
+  of the given E2AP class. buf can be reused as soon as this returns.
+*/
+void E2Sim::send_encoded_sctp_data(const uint8_t *buf, size_t len, uint16_t msg_class, struct timespec *ts)
+{
+  uint16_t stream = get_stream(msg_class);
+
+  std::lock_guard<std::mutex> guard(send_lock);
+
+  flush_batch();
+
+  send_message(buf, len, stream, msg_class, nullptr, ts);
+}
+
+/*
+  Encodes the pdu into the send buffer and queues it to be sent in a batch, which goes out
+  either when it reaches max_batch messages or when the flush deadline of its first message expires.
+  Without batching (see setBatching) the pdu is sent right away.
+
+  The callback cb receives the timestamp taken when the message is handed to the kernel,
+  which is later if it has to wait in the send queue (see setSendQueue).
+  It runs with the send path locked, so it must not send messages.
+  The pdu is released after encoding.
+*/
+void E2Sim::encode_and_queue_sctp_data(E2AP_PDU_t* pdu, SentCallback cb)
+{
+  uint16_t msg_class = get_class(pdu);
+  uint16_t stream = get_stream(msg_class);
+
+  std::lock_guard<std::mutex> guard(send_lock);
+
+  if (max_batch <= 1) {
+    ssize_t len = encode_to_send_buffer(pdu, 0);
+    ASN_STRUCT_FREE(asn_DEF_E2AP_PDU, pdu);
+    if (len == -1) {
+      return;
+    }
+
+    send_message(send_buf, len, stream, msg_class, cb, NULL);
+    return;
+  }
+
+  ssize_t len = encode_to_send_buffer(pdu, batch_used);
+  ASN_STRUCT_FREE(asn_DEF_E2AP_PDU, pdu);
+  if (len == -1) {
+    return;
+  }
+
+  append_to_batch(len, stream, msg_class, cb);
+}
+
+/*
+  Same as encode_and_queue_sctp_data, but for a message already encoded in APER (e.g. from an IndicationTemplate)
+  of the given E2AP class. Without batching, buf is handed to the socket as is, and copied only if it has to wait
+  in the send queue, so buf can be reused as soon as this returns.
+*/
+void E2Sim::queue_encoded_sctp_data(const uint8_t *buf, size_t len, uint16_t msg_class, SentCallback cb)
+{
+  uint16_t stream = get_stream(msg_class);
+
+  std::lock_guard<std::mutex> guard(send_lock);
+
+  if (max_batch <= 1) {
+    send_message(buf, len, stream, msg_class, cb, NULL);
+    return;
+  }
 
-  data.len = e2ap_asn1c_encode_pdu(pdu, &buf);
-  memcpy(data.buffer, buf, min(data.len, MAX_SCTP_BUFFER));
-  if (buf) free(buf);
+  if (batch_used + len > send_stats.buffer_size && !resize_send_buffer(batch_used + len)) {
+    return;
+  }
+  memcpy(send_buf + batch_used, buf, len);
 
-  sctp_send_data(client_fd, data, ts);
+  append_to_batch(len, stream, msg_class, cb);
 }
 
+/*
+  Adds the message of len bytes at the end of the send buffer to the batch, and either flushes
+  the batch once it is full, or arms its flush deadline. Requires send_lock.
+*/
+void E2Sim::append_to_batch(size_t len, uint16_t stream, uint16_t msg_class, SentCallback cb)
+{
+  batch.push_back({batch_used, len, stream});
+  batch_cbs.push_back(cb);
+  batch_classes.push_back(msg_class);
+  batch_used += len;
+
+  if (batch.size() >= max_batch) {
+    flush_batch();
+
+  } else if (!batch_timer_armed) {
+    /*
+      The timer is not disarmed when a full batch is sent. Then, it might expire earlier
+      for the next batch, which is harmless and saves one syscall per batch.
+    */
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = flush_us / 1000000;
+    its.it_value.tv_nsec = (flush_us % 1000000) * 1000;
+    if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) {
+      its.it_value.tv_nsec = 1;   // zero would disarm the timer
+    }
+
+    if (timerfd_settime(batch_timer_fd, 0, &its, NULL) == -1) {
+      logger_error("unable to arm batch timer: %s", strerror(errno));
+      flush_batch();
+    } else {
+      batch_timer_armed = true;
+    }
+  }
+}
 
+/*
+  Receives a batch of messages from the SCTP socket and dispatches each one to the E2AP message handler
+*/
 void E2Sim::wait_for_sctp_data()
 {
-  struct timespec ts; // timestamp of the received message
-  sctp_buffer_t recv_buf;
-  if(sctp_receive_data(client_fd, recv_buf, &ts) > 0)
-  {
-    logger_info("[SCTP] Received new data of size %d", recv_buf.len);
-    e2ap_handle_sctp_data(client_fd, recv_buf, this, &ts);
+  sctp_recv_ring_t *recv_ring = get_recv_ring();
+  if (recv_ring == NULL) {
+    logger_error("[SCTP] unable to allocate the receive ring");
+    shutdown();
+    return;
+  }
+
+  logger_trace("about to call sctp_receive_batch");
+  int ret = sctp_receive_batch(client_fd, recv_ring, &recv_reasm,
+    [this](const uint8_t *buf, size_t len, uint16_t stream, struct timespec *ts, struct timespec *kernel_ts) {
+      if (ok2run) {   // a previous message of this batch might have shut down this E2Sim
+        e2ap_handle_sctp_data(client_fd, buf, len, this, ts, kernel_ts);
+      }
+    },
+    std::bind(&E2Sim::handle_sctp_notification, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+
+  switch (ret) {
+    case 0:
+      logger_trace("EAGAIN");
+      break;
+
+    case -1:
+      if (errno == EINTR) {
+        break;  // we expect E2AP-REMOVAL-RESPONSE, so do not stop yet
+      }
+
+      shutdown(); // we stop on any other error
+      break;
+
+    default:
+      logger_trace("dispatched %d messages", ret);
+      break;
   }
 }
 
-/**
- * Runs a thread that sends E2-SETUP-REQUEST.
- * In case a E2-SETUP-RESPONSE-SUCCESS is not received in a given interval
- * of time (currently 10s), then this thread resends the E2-SETUP-REQUEST.
- * This thread tries for 3 times and then give up closing the application.
- */
-void E2Sim::connection_helper() {
-  int retries = 3;
+/*
+  Reports the state changes of the paths of the SCTP association to the path event callback
+*/
+void E2Sim::handle_sctp_notification(const union sctp_notification *notif, size_t len, struct timespec *ts)
+{
+  if (len < sizeof(struct sctp_paddr_change) || notif->sn_header.sn_type != SCTP_PEER_ADDR_CHANGE) {
+    logger_debug("[SCTP] Ignoring SCTP notification of type %u", notif->sn_header.sn_type);
+    return;
+  }
 
-  std::vector<encoding::ran_func_info> all_funcs;
-  //Loop through RAN function definitions that are registered
-  for (std::pair<long, encoded_ran_function_t *> elem : ran_functions_registered) {
-    logger_trace("looping through ran func");
-    encoding::ran_func_info next_func;
+  const struct sctp_paddr_change *change = &notif->sn_paddr_change;
+  std::string addr = sctp_addr_to_string((const struct sockaddr *)&change->spc_aaddr);
+
+  const char *state;
+  switch (change->spc_state) {
+    case SCTP_ADDR_AVAILABLE:
+      state = "available";
+      break;
+    case SCTP_ADDR_UNREACHABLE:
+      state = "unreachable";
+      break;
+    case SCTP_ADDR_REMOVED:
+      state = "removed";
+      break;
+    case SCTP_ADDR_ADDED:
+      state = "added";
+      break;
+    case SCTP_ADDR_MADE_PRIM:
+      state = "made primary";
+      break;
+    case SCTP_ADDR_CONFIRMED:
+      state = "confirmed";
+      break;
+    default:
+      state = "unknown";
+  }
 
-    next_func.ranFunctionId = elem.first;
-    next_func.ranFunctionDesc = &elem.second->ran_function_ostr;
-    next_func.ranFunctionRev = (long)2;
-    next_func.ranFunctionOId = &elem.second->oid;
+  bool primary = addr == sctp_get_primary_addr(client_fd);
 
-    all_funcs.push_back(next_func);
+  if (change->spc_state == SCTP_ADDR_UNREACHABLE) {
+    logger_warn("[SCTP] %s path to %s is %s (error %d)", primary ? "Primary" : "Alternate", addr.c_str(), state, change->spc_error);
+  } else {
+    logger_info("[SCTP] %s path to %s is %s", primary ? "Primary" : "Alternate", addr.c_str(), state);
+  }
+
+  if (path_event_cb) {
+    path_event_cb(addr, change->spc_state, primary, ts);
+  }
+}
+
+/*
+  Handles the epoll events of the SCTP socket. Runs in the reactor thread.
+*/
+void E2Sim::handle_sctp_events(uint32_t events)
+{
+  if (events & EPOLLOUT) {
+    std::lock_guard<std::mutex> guard(send_lock);
+    drain_send_queue();
+  }
+
+  if (events & EPOLLIN) {
+    wait_for_sctp_data();   // also detects the connection has been closed by the remote peer
+
+  } else if (events & (EPOLLERR | EPOLLHUP)) {
+    logger_error("[SCTP] Connection error on fd %d (events 0x%x)", client_fd, events);
+    shutdown();
   }
+}
+
+/*
+  Sends an E2-SETUP-REQUEST and starts waiting for its response. Runs in the reactor thread.
+  The request is encoded on the first attempt, and resent as is on the following ones.
 
-  while (retryConnection && retries) {
+  The request goes through the send path of the other messages, so it never blocks the reactor thread.
+  A request that cannot be sent (e.g. dropped by the send queue) is resent once its response times out.
+*/
+void E2Sim::send_setup_request() {
+  std::unique_lock<std::mutex> lk(setup_lock);
+
+  if (setup_state != E2_SETUP_CONNECTING && setup_state != E2_SETUP_BACKOFF) {
+    return;   // stopped by shutdown()
+  }
+
+  setup_attempts++;
+  setup_response_ns = 0;
+
+  if (setup_request.len == 0) {
+    std::vector<encoding::ran_func_info> all_funcs;
+    //Loop through RAN function definitions that are registered
+    for (auto &elem : ran_functions_registered) {
+      logger_trace("looping through ran func");
+      encoding::ran_func_info next_func;
+
+      next_func.ranFunctionId = elem.first;
+      next_func.ranFunctionDesc = &elem.second->ran_function_ostr;
+      next_func.ranFunctionRev = (long)2;
+      next_func.ranFunctionOId = &elem.second->oid;
+
+      all_funcs.push_back(next_func);
+    }
 
     E2AP_PDU_t* pdu_setup = (E2AP_PDU_t*)calloc(1,sizeof(E2AP_PDU));
 
@@ -273,11 +1025,6 @@ void E2Sim::connection_helper() {
 
     logger_trace("After XER Encoding");
 
-    auto buffer_size = MAX_SCTP_BUFFER;
-    unsigned char buffer[MAX_SCTP_BUFFER];
-
-    sctp_buffer_t data;
-
     char error_buf[300] = {0, };
     size_t errlen = 0;
 
@@ -286,81 +1033,316 @@ void E2Sim::connection_helper() {
       logger_error("E2AP_PDU check constraints failed. error length = %ld, error buf %s", errlen, error_buf);
     }
 
-    auto er = asn_encode_to_buffer(NULL, ATS_ALIGNED_BASIC_PER, &asn_DEF_E2AP_PDU, pdu_setup, buffer, buffer_size);
+    ssize_t len = e2ap_encode_pdu(pdu_setup, setup_request);  // sized by the encoder, so any number of RAN functions fit
 
-    data.len = er.encoded;
+    logger_debug("encoded length is %zd", len);
 
-    logger_debug("er encded is %ld", er.encoded);
+    ASN_STRUCT_FREE(asn_DEF_E2AP_PDU, pdu_setup);
 
-    memcpy(data.buffer, buffer, er.encoded);
+    if (len <= 0) {
+      setup_request.len = 0;
+      logger_error("[E2AP] Unable to encode E2-SETUP-REQUEST");
+      fail_setup_attempt(lk, "unable to encode E2-SETUP-REQUEST");
+      return;
+    }
+  }
 
-    if(sctp_send_data(client_fd, data, NULL) > 0) {
-      logger_info("[SCTP] Sent E2-SETUP-REQUEST");
-    } else {
-      logger_error("[SCTP] Unable to send E2-SETUP-REQUEST to peer");
+  send_encoded_sctp_data(setup_request.buf, setup_request.len, E2AP_STREAM_GLOBAL, NULL);
+
+  setup_sent = std::chrono::steady_clock::now();
+  logger_info("[SCTP] Sent E2-SETUP-REQUEST (attempt %u)", setup_attempts);
+
+  setup_state = E2_SETUP_REQUESTED;
+  unsigned int attempt = setup_attempts;
+  setup_timer = reactor->schedule(setup_policy.timeout_ms * 1000UL, [this, attempt] { handle_setup_timeout(attempt); });
+}
+
+/*
+  Handles the deadline of the response of an E2-SETUP-REQUEST. Runs in the reactor thread.
+*/
+void E2Sim::handle_setup_timeout(unsigned int attempt) {
+  std::unique_lock<std::mutex> lk(setup_lock);
+
+  if (setup_state != E2_SETUP_REQUESTED || setup_attempts != attempt) {
+    return;   // answered or stopped meanwhile
+  }
+
+  logger_warn("[E2AP] No response to E2-SETUP-REQUEST within %lu ms", setup_policy.timeout_ms);
+  fail_setup_attempt(lk, "E2-SETUP-RESPONSE timeout");
+}
+
+/*
+  Schedules resending the E2-SETUP-REQUEST after the backoff, or gives up the E2 setup once all attempts have failed.
+
+  Requires lk to be locked, and returns with it unlocked.
+*/
+void E2Sim::fail_setup_attempt(std::unique_lock<std::mutex> &lk, const char *reason) {
+  if (setup_policy.max_attempts > 0 && setup_attempts >= setup_policy.max_attempts) {
+    fail_setup(lk, reason);
+    return;
+  }
+
+  unsigned long backoff = setup_policy.backoff_ms;
+  for (unsigned int i = 1; i < setup_attempts && backoff < setup_policy.backoff_max_ms; i++) {
+    backoff *= 2;
+  }
+  if (backoff > setup_policy.backoff_max_ms) {
+    backoff = setup_policy.backoff_max_ms;
+  }
+
+  setup_state = E2_SETUP_BACKOFF;
+  setup_timer = reactor->schedule(backoff * 1000UL, std::bind(&E2Sim::send_setup_request, this));
+  logger_warn("retrying E2-SETUP-REQUEST in %lu ms...", backoff);
+
+  e2_setup_event_t event = make_setup_event(reason);
+  lk.unlock();
+
+  if (setup_cb) {
+    setup_cb(event);
+  }
+}
+
+/*
+  Gives up the E2 setup and shuts down this E2Sim. Only this E2Sim is affected,
+  so the application decides what to do with a failed E2 node (see register_e2_setup_callback).
+
+  Requires lk to be locked, and returns with it unlocked.
+*/
+void E2Sim::fail_setup(std::unique_lock<std::mutex> &lk, const char *reason) {
+  setup_state = E2_SETUP_FAILED;
+  logger_error("[E2AP] Giving up E2 setup after %u attempts: %s", setup_attempts, reason);
+
+  e2_setup_event_t event = make_setup_event(reason);
+  lk.unlock();
+
+  if (setup_cb) {
+    setup_cb(event);
+  }
+
+  shutdown();
+}
+
+/*
+  Describes the current state of the E2 setup. Requires setup_lock.
+*/
+e2_setup_event_t E2Sim::make_setup_event(const char *reason) {
+  auto now = std::chrono::steady_clock::now();
+
+  e2_setup_event_t event;
+  event.state = setup_state;
+  event.attempts = setup_attempts;
+  event.connect_ns = 0;
+  if (setup_connected > setup_start) {
+    event.connect_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(setup_connected - setup_start).count();
+  }
+  event.setup_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - setup_start).count();
+  event.response_ns = setup_response_ns;
+  event.reason = reason;
+
+  return event;
+}
+
+/*
+  Handles the response of the E2Term to the E2-SETUP-REQUEST. Called by the E2AP message handler.
+  An E2-SETUP-FAILURE counts as a failed attempt, so the request is resent after the backoff.
+*/
+void E2Sim::handle_e2_setup_response(bool successful) {
+  std::unique_lock<std::mutex> lk(setup_lock);
+
+  if (setup_state != E2_SETUP_REQUESTED) {
+    logger_warn("[E2AP] Ignoring E2 setup response with no E2-SETUP-REQUEST waiting for it");
+    return;
+  }
+
+  reactor->cancel(setup_timer, false);  // a running timeout finds the request answered
+  setup_response_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - setup_sent).count();
+
+  if (!successful) {
+    fail_setup_attempt(lk, "E2-SETUP-FAILURE");
+    return;
+  }
+
+  setup_state = E2_SETUP_DONE;
+  e2_setup_event_t event = make_setup_event(NULL);
+  lk.unlock();
+
+  logger_info("[E2AP] E2 setup done in %.3f ms after %u attempts", event.setup_ns / 1000000.0, event.attempts);
+
+  if (setup_cb) {
+    setup_cb(event);
+  }
+}
+
+e2_setup_state_e E2Sim::get_e2_setup_state() {
+  std::lock_guard<std::mutex> guard(setup_lock);
+  return setup_state;
+}
+
+/*
+  Runs a step of the SCTP connection (e.g. handling the writability of a socket),
+  and finishes the connection if it is no longer in progress.
+*/
+void E2Sim::step_connect(std::function<void()> step) {
+  int fd;
+
+  {
+    std::lock_guard<std::mutex> guard(connect_lock);
+    if (!connector) {
+      return;   // already finished or cancelled by shutdown
     }
 
-    ASN_STRUCT_FREE(asn_DEF_E2AP_PDU, pdu_setup);
+    step();
+
+    if (connector->in_progress()) {
+      struct itimerspec its;
+      memset(&its, 0, sizeof(its));
+      int ms = connector->next_timeout_ms();
+      its.it_value.tv_sec = ms / 1000;
+      its.it_value.tv_nsec = (ms % 1000) * 1000000L;
+      if (ms <= 0) {
+        its.it_value.tv_nsec = 1;   // zero would disarm the timer
+      }
+      if (timerfd_settime(connect_timer_fd, 0, &its, NULL) == -1) {
+        logger_error("unable to arm connection timer: %s", strerror(errno));
+      }
+      return;
+    }
 
-    std::unique_lock<std::mutex> lk(cond_mutex);
-    cond.wait_for(lk, std::chrono::seconds(10));
-    lk.unlock();
+    fd = connector->release_fd();
+    connector.reset();
 
-    if (retryConnection) {
-      logger_warn("retrying E2-SETUP-REQUEST...");
+    if (fd != -1) {
+      sctp_profile_read(fd, transport_effective);
+      sctp_profile_log(transport_effective, "Transport profile in effect");
     }
-    retries--;
   }
 
-  if (retries == 0 && retryConnection) {
-    logger_fatal("giving up E2-SETUP-REQUEST. Closing the application...");
-    kill(getpid(), SIGTERM);  // main application should drive shutdown on SIGTERM
+  end_connect();
+  start_connection(fd);
+}
+
+/*
+  Starts or stops watching the socket of a connection attempt. Called by the SctpConnector.
+*/
+void E2Sim::watch_connect_fd(int fd, bool watch) {
+  if (watch) {
+    reactor->add(fd, EPOLLOUT, [this, fd](uint32_t events) {
+      step_connect([this, fd] { connector->handle_writable(fd); });  // also handles EPOLLERR and EPOLLHUP
+    });
+  } else {
+    reactor->remove(fd);
   }
 }
 
-void E2Sim::listener(){
-  // start this helper thread to resend E2-SETUP-REQUEST in case of any success response wasn't received
-  std::thread conn_helper_th(&E2Sim::connection_helper, this);
+/*
+  Handles the deadlines of the connection attempts. Runs in the reactor thread.
+*/
+void E2Sim::handle_connect_timer(uint32_t events) {
+  uint64_t expirations;
+  if (read(connect_timer_fd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) {
+    logger_error("unable to read connection timer: %s", strerror(errno));
+  }
 
-  sctp_buffer_t recv_buf;
-  struct timespec ts; // timestamp of the received message
+  step_connect([this] { connector->handle_timeout(); });
+}
 
-  logger_info("[SCTP] Waiting for SCTP data");
+/*
+  Releases the connection timer and wakes up run()
+*/
+void E2Sim::end_connect() {
+  if (connect_timer_fd != -1) {
+    reactor->remove(connect_timer_fd);
+    close(connect_timer_fd);
+    connect_timer_fd = -1;
+  }
 
-  ok2run = true;
-  while (ok2run) { // looking for data on SCTP interface
-    logger_trace("about to call sctp_receive_data");
-    int ret = sctp_receive_data(client_fd, recv_buf, &ts);
-    switch (ret) {
-      case 0:
-        logger_trace("EAGAIN");
-        continue;
-        break;
+  std::lock_guard<std::mutex> guard(connect_lock);
+  connecting = false;
+  connect_done.notify_all();
+}
 
-      case -1:
-        if (errno == EINTR) {
-          break;  // we expect E2AP-REMOVAL-RESPONSE, so do not stop yet
-        }
+/*
+  Starts the E2AP agent on the connected socket fd, or closes the application if the connection has failed
+*/
+void E2Sim::start_connection(int fd) {
+  std::unique_lock<std::mutex> lk(setup_lock);
 
-        shutdown(); // we stop on any other error
-        break;
+  client_fd = fd;
+  if (client_fd == -1) {
+    fail_setup(lk, "unable to connect to the E2Term");   // reconnecting is up to the application
+    return;
+  }
 
-      default:
-        e2ap_handle_sctp_data(client_fd, recv_buf, this, &ts);
-        break;
+  setup_connected = std::chrono::steady_clock::now();
+  lk.unlock();
+
+  logger_trace("After starting SCTP client");
+
+  num_ostreams = sctp_get_num_ostreams(client_fd);
+  if (num_ostreams < 1) {
+    num_ostreams = 1;
+  }
+  if (multistream && num_ostreams < E2AP_NUM_STREAMS) {
+    logger_warn("[SCTP] E2Term granted %d of %d streams, some E2AP messages will share streams", num_ostreams, E2AP_NUM_STREAMS);
+  }
+
+  if (timestamping && !sctp_enable_timestamping(client_fd)) {
+    logger_warn("[SCTP] Kernel timestamps disabled, only application timestamps are available");
+    timestamping = false;
+  }
+
+  ok2run = true;
+  try {
+    if (uring) {
+      uring->add(client_fd,
+        [this](const uint8_t *buf, size_t len, uint16_t stream, struct timespec *ts, struct timespec *kernel_ts) {
+          if (ok2run) {
+            e2ap_handle_sctp_data(client_fd, buf, len, this, ts, kernel_ts);
+          }
+        },
+        std::bind(&E2Sim::handle_sctp_notification, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3),
+        [this](int error) {
+          shutdown();   // also detects the connection has been closed by the remote peer
+        },
+        std::bind(&E2Sim::handle_uring_sent, this, std::placeholders::_1));
+    } else {
+      reactor->add(client_fd, EPOLLIN, std::bind(&E2Sim::handle_sctp_events, this, std::placeholders::_1));
     }
+  } catch (const std::runtime_error &e) {
+    logger_fatal("[SCTP] Unable to watch SCTP data: %s", e.what());
+    ok2run = false;
+    lk.lock();
+    fail_setup(lk, "unable to watch SCTP data");
+    return;
   }
 
-  std::unique_lock<std::mutex> lk(cond_mutex);
-  cond.notify_all();
-  lk.unlock();
+  if (max_batch > 1) {
+    batch_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    try {
+      if (batch_timer_fd == -1) {
+        throw std::runtime_error(std::string("unable to create timerfd: ") + strerror(errno));
+      }
+      reactor->add(batch_timer_fd, EPOLLIN, std::bind(&E2Sim::handle_batch_timer, this, std::placeholders::_1));
+    } catch (const std::runtime_error &e) {
+      logger_warn("[SCTP] Batching disabled: %s", e.what());
+      max_batch = 1;
+    }
+  }
 
-  conn_helper_th.join();
+  logger_info("[SCTP] Waiting for SCTP data");
 
-  logger_force(LOGGER_INFO, "Shutting down E2AP Agent");
+  lk.lock();
+  if (setup_state == E2_SETUP_CONNECTING) {
+    setup_timer = reactor->schedule(0, std::bind(&E2Sim::send_setup_request, this));  // also runs the retries
+  }
 }
 
-void E2Sim::run(const char *e2term_addr, int e2term_port) {
+/*
+  Starts connecting to the E2Term without blocking the caller.
+  The connection is driven by the reactor, racing the IPv4 and IPv6 addresses of the E2Term,
+  so that many E2Sims can connect at the same time. The E2AP agent starts as soon as it connects.
+*/
+void E2Sim::run_async(const char *e2term_addr, int e2term_port) {
   logger_force(LOGGER_INFO, "Starting E2AP Agent");
 
   char *addr = (char *)e2term_addr;
@@ -374,36 +1356,117 @@ void E2Sim::run(const char *e2term_addr, int e2term_port) {
     e2term_port = E2AP_SCTP_PORT;
   }
 
-  client_fd = sctp_start_client(addr, e2term_port);
-  if (client_fd == -1) {
-    retryConnection = false;
-    kill(getpid(), SIGTERM);
-    return;
+  e2_addr.assign(addr);
+  e2_port = e2term_port;
+
+  {
+    std::lock_guard<std::mutex> guard(setup_lock);
+    setup_state = E2_SETUP_CONNECTING;
+    setup_attempts = 0;
+    setup_start = std::chrono::steady_clock::now();
+    setup_connected = std::chrono::steady_clock::time_point();
   }
 
-  // set socket timeout to shutdown gracefully
-  struct timeval timeout;
-  timeout.tv_sec = 2;
-  timeout.tv_usec = 0;
-  if (setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0) {
-    perror("setsockopt failed");
-    kill(getpid(), SIGTERM);
+  connect_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  try {
+    if (connect_timer_fd == -1) {
+      throw std::runtime_error(std::string("unable to create timerfd: ") + strerror(errno));
+    }
+    reactor->add(connect_timer_fd, EPOLLIN, std::bind(&E2Sim::handle_connect_timer, this, std::placeholders::_1));
+  } catch (const std::runtime_error &e) {
+    logger_fatal("[SCTP] Unable to connect: %s", e.what());
+    if (connect_timer_fd != -1) {
+      close(connect_timer_fd);
+      connect_timer_fd = -1;
+    }
+    start_connection(-1);
     return;
   }
 
-  e2_addr.assign(e2term_addr);
-  e2_port = e2term_port;
+  {
+    std::lock_guard<std::mutex> guard(connect_lock);
+    connecting = true;
+    connector.reset(new SctpConnector());
+    connector->set_local_addresses(local_addrs);
+    connector->set_peer_addresses(peer_addrs);
+    connector->set_profile(transport);
+  }
 
-  logger_trace("After starting SCTP client");
+  step_connect([this, addr, e2term_port] {
+    connector->start(addr, e2term_port, std::bind(&E2Sim::watch_connect_fd, this, std::placeholders::_1, std::placeholders::_2));
+  });
+}
+
+/*
+  Connects to the E2Term and starts the E2AP agent.
+  This function blocks until the connection is established or has failed (see run_async).
+*/
+void E2Sim::run(const char *e2term_addr, int e2term_port) {
+  run_async(e2term_addr, e2term_port);
 
-  std::thread client_th(&E2Sim::listener, this);
-  sctp_listener_th = std::move(client_th);
+  if (reactor->in_loop_thread()) {
+    return;   // waiting here would block the reactor that drives the connection
+  }
+
+  std::unique_lock<std::mutex> lk(connect_lock);
+  connect_done.wait(lk, [this] { return !connecting; });
 }
 
 void E2Sim::shutdown() {
   logger_trace("in %s", __func__);
-  retryConnection = false;
-  ok2run = false;
+
+  {
+    std::lock_guard<std::mutex> guard(setup_lock);
+    if (setup_state == E2_SETUP_CONNECTING || setup_state == E2_SETUP_REQUESTED || setup_state == E2_SETUP_BACKOFF) {
+      setup_state = E2_SETUP_IDLE;
+    }
+    reactor->cancel(setup_timer, false);  // a running E2 setup step finds it stopped, the destructor waits for it
+  }
+
+  std::unique_ptr<SctpConnector> cancelled;
+  {
+    std::lock_guard<std::mutex> guard(connect_lock);
+    cancelled = std::move(connector);
+  }
+  if (cancelled) {
+    logger_info("[SCTP] Cancelling connection to %s:%d", e2_addr.c_str(), e2_port);
+    cancelled.reset();  // stops watching its sockets, so it has to run without connect_lock
+    end_connect();
+  }
+
+  if (ok2run.exchange(false)) {
+    if (uring) {
+      uring->remove(client_fd);   // waits for any running handler if not called from the transport thread
+    } else {
+      reactor->remove(client_fd);   // waits for any running handler if not called from the reactor thread
+    }
+    if (batch_timer_fd != -1) {
+      reactor->remove(batch_timer_fd);
+    }
+
+    {
+      std::lock_guard<std::mutex> guard(send_lock);
+      if (!batch.empty()) {
+        logger_warn("discarding %zu queued messages", batch.size());
+        batch.clear();
+        batch_cbs.clear();
+        batch_classes.clear();
+        batch_used = 0;
+      }
+      if (!send_queue.empty()) {
+        logger_warn("discarding %zu messages waiting in the send queue", send_queue.size());
+        send_queue.clear();
+      }
+      if (!uring_inflight.empty()) {
+        logger_warn("discarding %zu messages in flight in the io_uring transport", uring_inflight.size());
+        uring_inflight.clear();
+      }
+      watching_writable = false;
+      notify_writable();  // waiting senders move on, e.g. to the E2Sim of another E2Term
+    }
+
+    logger_force(LOGGER_INFO, "Shutting down E2AP Agent");
+  }
   // TODO Check how to implement E2AP-REMOVAL-RESPONSE and graceful shutdown
   /**
    * Currently, RIC does not implement E2-REMOVAL-REQUEST yet.
@@ -421,6 +1484,106 @@ void E2Sim::shutdown() {
   */
 }
 
-void E2Sim::setRetryConnection(bool retry) {
-  retryConnection = retry;
+/*
+  Sets how many times and how often the E2-SETUP-REQUEST is resent. Must be called before run().
+*/
+void E2Sim::setSetupPolicy(const e2_setup_policy_t &policy) {
+  setup_policy = policy;
+}
+
+/*
+  Enables or disables sending each class of E2AP messages on its own SCTP stream.
+  When disabled, all messages are sent on stream 0. Must be called before run().
+*/
+void E2Sim::setMultistream(bool enabled) {
+  multistream = enabled;
+}
+
+/*
+  Enables kernel timestamps of the received messages, which are handed to the control callbacks
+  along with the application timestamps. Must be called before run().
+*/
+void E2Sim::setTimestamping(bool enabled) {
+  timestamping = enabled;
+}
+
+/*
+  Enables sending messages queued by encode_and_queue_sctp_data in batches of up to
+  max_batch messages, each one waiting at most flush_us microseconds to be sent.
+  A max_batch of 0 or 1 disables batching. Must be called before run().
+*/
+void E2Sim::setBatching(unsigned int max_batch, unsigned long flush_us) {
+  this->max_batch = max_batch;
+  this->flush_us = flush_us;
+
+  if (max_batch > 1) {
+    batch.reserve(max_batch);   // avoids allocations on the send path
+    batch_cbs.reserve(max_batch);
+    batch_classes.reserve(max_batch);
+  }
+}
+
+/*
+  Sets what happens to messages that do not fit in the socket buffer of the SCTP association,
+  or in the E2SIM_URING_WINDOW messages in flight when sending through io_uring.
+  They wait in a send queue of up to max_messages messages and max_bytes bytes (0 keeps the defaults),
+  and the policy decides what to do when the queue is full: wait for room (block), drop queued
+  messages (drop-oldest), drop the new message (drop-newest), or drop the least important class
+  of messages first (shed-class). The block policy does not block: senders that can wait poll
+  is_send_queue_full, and other messages are admitted over the limits. Must be called before run().
+*/
+void E2Sim::setSendQueue(send_queue_policy_e policy, size_t max_messages, size_t max_bytes) {
+  send_queue.configure(policy, max_messages, max_bytes);
+}
+
+/*
+  Sets the local addresses the SCTP association binds to (multihoming).
+  By default, it binds to all local addresses. Must be called before run().
+*/
+void E2Sim::setLocalAddresses(const std::vector<std::string> &addrs) {
+  local_addrs = addrs;
+}
+
+/*
+  Sets additional E2Term addresses, so that the SCTP association connects to all of them
+  at once (multihoming). The address given to run() is the primary path. Must be called before run().
+*/
+void E2Sim::setPeerAddresses(const std::vector<std::string> &addrs) {
+  peer_addrs = addrs;
+}
+
+/*
+  Sets the transport profile (e.g. SCTP_NODELAY, socket buffers, RTO, heartbeat) applied
+  to the SCTP association. Must be called before run().
+*/
+void E2Sim::setTransportProfile(const sctp_profile_t &profile) {
+  transport = profile;
+}
+
+/*
+  Sends and receives the SCTP data of this E2Sim through the given io_uring transport,
+  or through the reactor if uring is NULL (default). Connecting and timers are always
+  driven by the reactor. Must be called before run().
+*/
+void E2Sim::setTransport(UringTransport *uring) {
+  this->uring = uring;
+}
+
+/*
+  Returns the effective values of the transport profile, as read from the association once connected.
+  Options are unset (SCTP_PROFILE_UNSET) while not connected.
+*/
+sctp_profile_t E2Sim::get_transport_profile() {
+  std::lock_guard<std::mutex> guard(connect_lock);
+  return transport_effective;
+}
+
+/*
+  Returns a snapshot of the send path counters
+*/
+send_stats_t E2Sim::get_send_stats() {
+  std::lock_guard<std::mutex> guard(send_lock);
+  send_stats.queue_depth = send_queue.size();
+  send_stats.queue_bytes = send_queue.bytes();
+  return send_stats;
 }
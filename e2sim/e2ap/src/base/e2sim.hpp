@@ -24,6 +24,20 @@
 #include <atomic>
 #include <functional>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <deque>
+
+#include "reactor.hpp"
+#include "uring_transport.hpp"
+#include "send_queue.hpp"
+#include "ran_function_registry.hpp"
+#include "e2sim_sctp.hpp"
+#include "sctp_connector.hpp"
 
 extern "C" {
   #include "E2AP-PDU.h"
@@ -34,20 +48,89 @@ extern "C" {
   #include "PLMN-Identity.h"
 }
 
+// counters of the E2AP send path of an E2Sim
 typedef struct {
-  PrintableString_t oid;
-  OCTET_STRING_t ran_function_ostr;  // RAN function definition octet string
-} encoded_ran_function_t;
+  unsigned long messages;     // E2AP messages sent
+  unsigned long batches;      // batches of messages sent, each one in a single sendmmsg call
+  unsigned long allocations;  // heap (re)allocations of the send buffer, does not grow on steady state
+  size_t buffer_size;         // current size of the send buffer
+  unsigned long queued;       // messages that had to wait in the send queue for room in the socket buffer (or in the io_uring window)
+  unsigned long dropped;      // messages dropped by the send queue policy or by send errors
+  unsigned long blocked;      // times a sender has been told to wait for room in the send queue (block policy)
+  size_t queue_depth;         // messages in the send queue
+  size_t queue_bytes;         // bytes in the send queue
+} send_stats_t;
+
+// a message leaving the send queue, either sent or dropped
+typedef struct {
+  uint16_t msg_class;       // E2AP class of the message (one of E2AP_STREAM_*)
+  bool dropped;             // dropped by the send queue policy or by a send error, sent otherwise
+  unsigned long delay_ns;   // time the message waited in the send queue
+  size_t depth;             // messages left in the send queue
+  size_t bytes;             // bytes left in the send queue
+} send_queue_event_t;
+
+// a message handed to the io_uring transport, waiting for the completion of its send
+typedef struct {
+  uint16_t msg_class;       // E2AP class of the message (one of E2AP_STREAM_*)
+  SentCallback cb;
+  struct timespec sent;     // time the message has been handed to the transport
+  bool queued;              // has waited in the send queue
+  unsigned long delay_ns;   // time the message waited in the send queue
+} uring_msg_t;
+
+#define E2SIM_URING_WINDOW  64  // messages of an association in flight in the io_uring transport, others wait in the send queue
+
+#define E2_SETUP_MAX_ATTEMPTS   3       // default E2-SETUP-REQUESTs sent before giving up
+#define E2_SETUP_TIMEOUT_MS     10000   // default time to wait for the response of each E2-SETUP-REQUEST
+#define E2_SETUP_BACKOFF_MS     1000    // default wait before resending the first failed E2-SETUP-REQUEST
+#define E2_SETUP_BACKOFF_MAX_MS 30000   // default maximum wait before resending an E2-SETUP-REQUEST
+
+// retry settings of the E2 setup procedure
+typedef struct {
+  unsigned int max_attempts;      // E2-SETUP-REQUESTs sent before giving up, 0 retries forever
+  unsigned long timeout_ms;       // time to wait for the response of each request
+  unsigned long backoff_ms;       // wait before resending a request, doubled on each failed attempt
+  unsigned long backoff_max_ms;   // maximum wait before resending a request
+} e2_setup_policy_t;
+
+typedef enum {
+  E2_SETUP_IDLE,          // not started or stopped by shutdown()
+  E2_SETUP_CONNECTING,    // waiting for the SCTP association
+  E2_SETUP_REQUESTED,     // waiting for the response of an E2-SETUP-REQUEST
+  E2_SETUP_BACKOFF,       // waiting to resend a failed E2-SETUP-REQUEST
+  E2_SETUP_DONE,          // the E2Term has accepted the E2 setup
+  E2_SETUP_FAILED         // gave up connecting or resending E2-SETUP-REQUESTs
+} e2_setup_state_e;
+
+// a transition of the E2 setup procedure to E2_SETUP_BACKOFF, E2_SETUP_DONE or E2_SETUP_FAILED
+typedef struct {
+  e2_setup_state_e state;
+  unsigned int attempts;    // E2-SETUP-REQUESTs sent so far
+  unsigned long connect_ns; // time the SCTP association took to connect
+  unsigned long setup_ns;   // time from connecting to the E2Term until the transition
+  unsigned long response_ns;  // time the E2Term took to answer the last E2-SETUP-REQUEST, 0 if not answered
+  const char *reason;       // why the attempt has failed, NULL on E2_SETUP_DONE
+} e2_setup_event_t;
 
 typedef std::function<void(E2AP_PDU_t*)> SubscriptionCallback;
 typedef std::function<void(E2AP_PDU_t*)> SubscriptionDeleteCallback;
-typedef std::function<void(E2AP_PDU_t*, struct timespec*)> ControlCallback;
+// receives the time the message was received by the application and by the kernel (NULL if kernel timestamps are disabled)
+typedef std::function<void(E2AP_PDU_t*, struct timespec *ts, struct timespec *kernel_ts)> ControlCallback;
+// receives each message leaving the send queue, it runs with the send path locked so it must not send messages
+typedef std::function<void(const send_queue_event_t &event)> SendQueueCallback;
+// tells the senders waiting on a full send queue (see is_send_queue_full) to resume, it runs with the send path locked
+typedef std::function<void()> WritableCallback;
+// receives the state (one of SCTP_ADDR_*) of a path of the association, primary tells if it is the primary path
+typedef std::function<void(const std::string &addr, int state, bool primary, struct timespec *ts)> PathEventCallback;
+// receives each transition of the E2 setup procedure, it runs in the reactor thread or in the transport thread
+typedef std::function<void(const e2_setup_event_t &event)> E2SetupCallback;
 
 class E2Sim {
 
 private:
 
-  std::unordered_map<long, encoded_ran_function_t *> ran_functions_registered;
+  std::unordered_map<long, RanFunctionRef> ran_functions_registered;
   std::unordered_map<long, SubscriptionCallback> subscription_callbacks;
   std::unordered_map<long, SubscriptionDeleteCallback> subscription_delete_callbacks;
   std::unordered_map<long, ControlCallback> control_callbacks;
@@ -58,21 +141,100 @@ private:
   int e2_port;          // E2Term port
 
   int client_fd;
-  bool ok2run;  // controls the sctp receiver run loop
-  std::atomic<bool> retryConnection;  // controls if the E2Sim should resend E2-SETUP-REQUEST
-
-  std::thread sctp_listener_th;
-
-  void listener();
+  int num_ostreams;     // outbound SCTP streams granted by the E2Term
+  bool multistream;     // sends each class of E2AP messages on its own SCTP stream
+  bool timestamping;    // requests kernel receive timestamps of the SCTP messages
+  std::atomic<bool> ok2run;  // true while client_fd is registered in the reactor
+
+  Reactor *reactor;   // event loop that dispatches the SCTP data of this E2Sim
+  UringTransport *uring;  // sends and receives the SCTP data instead of the reactor, if not NULL
+  std::deque<uring_msg_t> uring_inflight;   // messages sent through uring in completion order, guarded by send_lock
+
+  std::mutex send_lock;     // serializes senders, e.g. the reactor and the insert loop threads
+  uint8_t *send_buf;        // reusable buffer where PDUs are encoded into, guarded by send_lock
+  send_stats_t send_stats;  // guarded by send_lock
+
+  unsigned int max_batch;     // maximum number of queued messages before sending them, batching is disabled if <= 1
+  unsigned long flush_us;     // maximum time (microseconds) a queued message waits to be sent
+  std::vector<sctp_msg_t> batch;          // messages queued in send_buf, guarded by send_lock
+  std::vector<SentCallback> batch_cbs;    // sent callbacks of the queued messages, guarded by send_lock
+  size_t batch_used;                      // bytes of send_buf used by the queued messages, guarded by send_lock
+  std::vector<uint16_t> batch_classes;   // E2AP classes of the queued messages, guarded by send_lock
+  int batch_timer_fd;                     // timerfd that flushes the queued messages on deadline
+  bool batch_timer_armed;                 // guarded by send_lock
+
+  SendQueue send_queue;       // messages waiting for room in the socket buffer, guarded by send_lock
+  bool watching_writable;     // EPOLLOUT is watched on client_fd to drain send_queue, guarded by send_lock
+  SendQueueCallback send_queue_cb;
+  WritableCallback writable_cb;
+  bool writable_pending;      // a sender waits for room in the send queue, guarded by send_lock
+
+  bool resize_send_buffer(size_t size);
+  uint16_t get_class(E2AP_PDU_t *pdu);
+  uint16_t get_stream(uint16_t msg_class);
+  ssize_t encode_to_send_buffer(E2AP_PDU_t *pdu, size_t offset);
+  void flush_batch();
+  void send_message(const uint8_t *buf, size_t len, uint16_t stream, uint16_t msg_class, SentCallback cb, struct timespec *ts);
+  void append_to_batch(size_t len, uint16_t stream, uint16_t msg_class, SentCallback cb);
+  void queue_message(const uint8_t *buf, size_t len, uint16_t stream, uint16_t msg_class, SentCallback cb);
+  void drain_send_queue();
+  void notify_writable();
+  void watch_writable(bool watch);
+  void report_queue_event(uint16_t msg_class, bool dropped, unsigned long delay_ns);
+  size_t uring_room();
+  void track_uring_message(uint16_t msg_class, SentCallback cb, struct timespec *ts, bool queued, unsigned long delay_ns);
+  void handle_uring_sent(int res);
+  void handle_batch_timer(uint32_t events);
+  sctp_reassembly_t recv_reasm;   // partial message of the socket, the receive ring is shared by the reactor thread
+
+  std::vector<std::string> local_addrs;   // local addresses of the association, empty binds to all of them
+  std::vector<std::string> peer_addrs;    // additional E2Term addresses of a multihomed association
+  PathEventCallback path_event_cb;
+
+  sctp_profile_t transport;             // transport profile applied to the association
+  sctp_profile_t transport_effective;   // values in effect once connected, guarded by connect_lock
+
+  std::unique_ptr<SctpConnector> connector;   // in progress connection, guarded by connect_lock
+  std::mutex connect_lock;
+  std::condition_variable connect_done;       // signals that connecting has been set to false
+  bool connecting;                            // guarded by connect_lock
+  int connect_timer_fd;                       // timerfd that handles the deadlines of the connection attempts
+
+  void step_connect(std::function<void()> step);
+  void watch_connect_fd(int fd, bool watch);
+  void handle_connect_timer(uint32_t events);
+  void end_connect();
+  void start_connection(int fd);
+
+  e2_setup_policy_t setup_policy;
+  e2_setup_state_e setup_state;   // guarded by setup_lock
+  unsigned int setup_attempts;    // guarded by setup_lock
+  reactor_timer_t setup_timer;    // response timeout or backoff of the E2 setup, guarded by setup_lock
+  std::chrono::steady_clock::time_point setup_start;      // guarded by setup_lock
+  std::chrono::steady_clock::time_point setup_connected;  // guarded by setup_lock
+  std::chrono::steady_clock::time_point setup_sent;       // time the last request has been sent, guarded by setup_lock
+  unsigned long setup_response_ns;  // guarded by setup_lock
+  pdu_buffer_t setup_request;     // E2-SETUP-REQUEST encoded on the first attempt, guarded by setup_lock
+  std::mutex setup_lock;
+  E2SetupCallback setup_cb;
+
+  void send_setup_request();
+  void handle_setup_timeout(unsigned int attempt);
+  void fail_setup_attempt(std::unique_lock<std::mutex> &lk, const char *reason);
+  void fail_setup(std::unique_lock<std::mutex> &lk, const char *reason);
+  e2_setup_event_t make_setup_event(const char *reason);
+
+  void handle_sctp_events(uint32_t events);
   void wait_for_sctp_data();
+  void handle_sctp_notification(const union sctp_notification *notif, size_t len, struct timespec *ts);
 
 public:
 
-  E2Sim(const char *mcc, const char *mnc, uint32_t gnb_id);
+  E2Sim(const char *mcc, const char *mnc, uint32_t gnb_id, Reactor *reactor = NULL);
 
   ~E2Sim();
 
-  std::unordered_map<long, encoded_ran_function_t *> getRegistered_ran_functions();
+  std::unordered_map<long, RanFunctionRef> getRegistered_ran_functions();
 
   SubscriptionCallback get_subscription_callback(long func_id);
 
@@ -86,6 +248,8 @@ public:
 
   bool is_e2term_endpoint(std::string address, int port);
 
+  void register_e2sm(long func_id, RanFunctionRef ran_func);
+
   void register_e2sm(long func_id, encoded_ran_function_t* ran_func);
 
   void register_subscription_callback(long func_id, SubscriptionCallback cb);
@@ -94,15 +258,55 @@ public:
 
   void register_control_callback(long func_id, ControlCallback cb);
 
+  void register_path_event_callback(PathEventCallback cb);
+
+  void register_send_queue_callback(SendQueueCallback cb);
+
+  void register_writable_callback(WritableCallback cb);
+
+  void register_e2_setup_callback(E2SetupCallback cb);
+
   void encode_and_send_sctp_data(E2AP_PDU_t* pdu, struct timespec *ts);
 
+  void encode_and_queue_sctp_data(E2AP_PDU_t* pdu, SentCallback cb);
+
+  void send_encoded_sctp_data(const uint8_t *buf, size_t len, uint16_t msg_class, struct timespec *ts);
+
+  void queue_encoded_sctp_data(const uint8_t *buf, size_t len, uint16_t msg_class, SentCallback cb);
+
+  bool is_send_queue_full();
+
   void run(const char *e2term_addr, int e2term_port);
 
+  void run_async(const char *e2term_addr, int e2term_port);
+
   void shutdown();
 
-  void setRetryConnection(bool retry);
+  void handle_e2_setup_response(bool successful);
+
+  e2_setup_state_e get_e2_setup_state();
+
+  void setSetupPolicy(const e2_setup_policy_t &policy);
+
+  void setMultistream(bool enabled);
+
+  void setTimestamping(bool enabled);
+
+  void setBatching(unsigned int max_batch, unsigned long flush_us);
+
+  void setSendQueue(send_queue_policy_e policy, size_t max_messages, size_t max_bytes);
+
+  void setLocalAddresses(const std::vector<std::string> &addrs);
+
+  void setPeerAddresses(const std::vector<std::string> &addrs);
+
+  void setTransportProfile(const sctp_profile_t &profile);
+
+  void setTransport(UringTransport *uring);
+
+  sctp_profile_t get_transport_profile();
 
-  void connection_helper();
+  send_stats_t get_send_stats();
 
 };
 
@@ -0,0 +1,89 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#include <stdlib.h>
+
+#include "ran_function_registry.hpp"
+#include "logger.h"
+
+/*
+  Returns the RAN function registered as name, calling encoder to encode it if no E2Sim holds it.
+  The encoder runs at most once per name while the RAN function is in use, even if many
+  threads ask for it at the same time.
+
+  Returns an empty reference if the encoder fails.
+*/
+RanFunctionRef RanFunctionRegistry::get(const std::string &name, RanFunctionEncoder encoder) {
+  std::lock_guard<std::mutex> guard(lock);
+
+  auto &entry = functions[name];
+  RanFunctionRef ran_func = entry.lock();
+  if (ran_func) {
+    return ran_func;
+  }
+
+  encoded_ran_function_t *encoded = encoder();
+  if (encoded == NULL) {
+    logger_error("unable to encode RAN function %s", name.c_str());
+    functions.erase(name);
+    return ran_func;
+  }
+
+  ran_func = ran_function_ref(encoded);
+  entry = ran_func;
+
+  logger_debug("encoded RAN function %s with %zu bytes", name.c_str(), encoded->ran_function_ostr.size);
+
+  return ran_func;
+}
+
+/*
+  Returns the number of RAN functions in use
+*/
+size_t RanFunctionRegistry::size() {
+  std::lock_guard<std::mutex> guard(lock);
+
+  size_t count = 0;
+  for (auto &entry : functions) {
+    if (!entry.second.expired()) {
+      count++;
+    }
+  }
+  return count;
+}
+
+/*
+  Returns the process-wide registry shared by all E2Sim instances
+*/
+RanFunctionRegistry *RanFunctionRegistry::get_default() {
+  static RanFunctionRegistry registry;
+  return &registry;
+}
+
+/*
+  Takes the ownership of a heap-allocated RAN function, which is freed with its last reference
+*/
+RanFunctionRef ran_function_ref(encoded_ran_function_t *ran_func) {
+  return RanFunctionRef(ran_func, ran_function_free);
+}
+
+void ran_function_free(encoded_ran_function_t *ran_func) {
+  ASN_STRUCT_RESET(asn_DEF_PrintableString, &ran_func->oid);
+  ASN_STRUCT_RESET(asn_DEF_OCTET_STRING, &ran_func->ran_function_ostr);
+  free(ran_func);
+}
@@ -0,0 +1,73 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#ifndef RAN_FUNCTION_REGISTRY_HPP
+#define RAN_FUNCTION_REGISTRY_HPP
+
+#include <unordered_map>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <functional>
+
+extern "C" {
+  #include "OCTET_STRING.h"
+  #include "PrintableString.h"
+}
+
+typedef struct {
+  PrintableString_t oid;
+  OCTET_STRING_t ran_function_ostr;  // RAN function definition octet string
+} encoded_ran_function_t;
+
+// read-only RAN function, released once the last E2Sim that registered it is gone
+typedef std::shared_ptr<const encoded_ran_function_t> RanFunctionRef;
+
+// encodes a RAN function, returns NULL on error
+typedef std::function<encoded_ran_function_t *()> RanFunctionEncoder;
+
+/*
+  Registry of the encoded RAN functions shared by the E2Sim instances of a process.
+
+  The definition of a RAN function is the same for all simulated E2 nodes, so it is encoded once,
+  by the first E2Sim that asks for it, and all other E2Sims get a reference to the same buffers.
+  References are read-only: E2 Setup and RIC Service Update messages copy them into their PDUs.
+  The registry only keeps weak references, so a RAN function is freed with its last E2Sim.
+*/
+class RanFunctionRegistry {
+
+private:
+
+  std::mutex lock;
+  std::unordered_map<std::string, std::weak_ptr<const encoded_ran_function_t>> functions;
+
+public:
+
+  RanFunctionRef get(const std::string &name, RanFunctionEncoder encoder);
+
+  size_t size();
+
+  static RanFunctionRegistry *get_default();
+
+};
+
+RanFunctionRef ran_function_ref(encoded_ran_function_t *ran_func);
+
+void ran_function_free(encoded_ran_function_t *ran_func);
+
+#endif
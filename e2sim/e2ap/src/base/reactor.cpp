@@ -0,0 +1,425 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <stdexcept>
+#include <string>
+
+#include "reactor.hpp"
+#include "logger.h"
+
+static inline unsigned long monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+/*
+  throws std::runtime_error
+*/
+Reactor::Reactor() : tasks(monotonic_ns() / 1000) {
+  logger_trace("in %s constructor", __func__);
+
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd == -1) {
+    throw std::runtime_error(std::string("unable to create epoll instance: ") + strerror(errno));
+  }
+
+  wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeup_fd == -1) {
+    close(epoll_fd);
+    throw std::runtime_error(std::string("unable to create eventfd: ") + strerror(errno));
+  }
+
+  timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd == -1) {
+    close(wakeup_fd);
+    close(epoll_fd);
+    throw std::runtime_error(std::string("unable to create timerfd: ") + strerror(errno));
+  }
+
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = wakeup_fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &ev) == -1) {
+    close(timer_fd);
+    close(wakeup_fd);
+    close(epoll_fd);
+    throw std::runtime_error(std::string("unable to watch eventfd: ") + strerror(errno));
+  }
+
+  ev.data.fd = timer_fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) == -1) {
+    close(timer_fd);
+    close(wakeup_fd);
+    close(epoll_fd);
+    throw std::runtime_error(std::string("unable to watch timerfd: ") + strerror(errno));
+  }
+
+  cpu = -1;
+  running_timer = 0;
+  armed_us = TIMER_WHEEL_NEVER;
+  events_count = 0;
+  tasks_count = 0;
+  busy_ns = 0;
+  idle_ns = 0;
+  dispatching_fd = -1;
+  ok2run = true;  // a stopped reactor cannot be restarted
+}
+
+Reactor::~Reactor() {
+  logger_trace("in func %s", __func__);
+
+  stop();
+
+  close(timer_fd);
+  close(wakeup_fd);
+  close(epoll_fd);
+}
+
+/*
+  Registers a file descriptor to be watched for the given epoll events.
+
+  throws std::runtime_error
+*/
+void Reactor::add(int fd, uint32_t events, EventHandler handler) {
+  std::lock_guard<std::mutex> guard(handlers_lock);
+
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.fd = fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+    throw std::runtime_error(std::string("unable to add fd to epoll: ") + strerror(errno));
+  }
+
+  handlers[fd] = std::make_shared<EventHandler>(handler);
+
+  logger_debug("[Reactor] watching fd %d for events 0x%x", fd, events);
+}
+
+/*
+  Changes the epoll events of an already registered file descriptor.
+
+  throws std::runtime_error
+*/
+void Reactor::modify(int fd, uint32_t events) {
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.fd = fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+    throw std::runtime_error(std::string("unable to modify fd in epoll: ") + strerror(errno));
+  }
+}
+
+/*
+  Stops watching a file descriptor.
+
+  When called from another thread, this function only returns after
+  the handler of fd has finished running, so the caller can safely
+  release any resource the handler uses (e.g. close the fd).
+*/
+void Reactor::remove(int fd) {
+  std::unique_lock<std::mutex> lk(handlers_lock);
+
+  if (handlers.erase(fd) == 0) {
+    return; // not registered or already removed
+  }
+
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL) == -1) {
+    logger_warn("[Reactor] unable to remove fd %d from epoll: %s", fd, strerror(errno));
+  }
+
+  if (!in_loop_thread()) {
+    dispatch_done.wait(lk, [this, fd] { return dispatching_fd != fd; });
+  }
+
+  logger_debug("[Reactor] fd %d is no longer watched", fd);
+}
+
+/*
+  Runs task in the reactor thread once delay_us microseconds have elapsed.
+  Tasks with the same deadline run in the order they were scheduled.
+  Tasks still pending when the reactor stops are discarded.
+
+  Returns the timer of the task, which can be cancelled until the task runs
+*/
+reactor_timer_t Reactor::schedule(unsigned long delay_us, ReactorTask task) {
+  uint64_t deadline = monotonic_ns() / 1000 + delay_us;
+
+  std::lock_guard<std::mutex> guard(tasks_lock);   // only contended when scheduling from other threads
+
+  reactor_timer_t id = tasks.add(deadline, std::move(task));
+  if (deadline < armed_us) {
+    arm_timer(deadline);
+  }
+
+  return id;
+}
+
+/*
+  Cancels a scheduled task.
+
+  When called from another thread while the task is running, and wait is true, this function only
+  returns after the task has finished, so the caller can safely release any resource the task uses.
+
+  Returns true if the task was pending, false if it has already run or been cancelled
+*/
+bool Reactor::cancel(reactor_timer_t timer, bool wait) {
+  if (timer == 0) {
+    return false;
+  }
+
+  std::unique_lock<std::mutex> lk(tasks_lock);
+
+  if (!tasks.cancel(timer)) {   // the timerfd might expire with nothing to run, which is harmless
+    if (wait && !in_loop_thread()) {
+      task_done.wait(lk, [this, timer] { return running_timer != timer; });
+    }
+    return false;
+  }
+
+  return true;
+}
+
+/*
+  Sets the timerfd to expire on deadline_us, or disarms it if deadline_us is TIMER_WHEEL_NEVER. Requires tasks_lock.
+*/
+void Reactor::arm_timer(uint64_t deadline_us) {
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+
+  armed_us = deadline_us;
+  if (deadline_us != TIMER_WHEEL_NEVER) {
+    if (deadline_us == 0) {
+      deadline_us = 1;  // zero would disarm the timer
+    }
+    its.it_value.tv_sec = deadline_us / 1000000;
+    its.it_value.tv_nsec = (deadline_us % 1000000) * 1000;
+  }
+
+  if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL) == -1) {
+    logger_error("[Reactor] unable to arm the task timer: %s", strerror(errno));
+  }
+}
+
+/*
+  Runs the tasks whose deadline has expired and arms the timer for the next one.
+  The timer might also expire when tasks only have to move down the levels of the wheel.
+*/
+void Reactor::run_tasks() {
+  uint64_t expirations;
+  if (read(timer_fd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) {
+    logger_error("[Reactor] unable to read timerfd: %s", strerror(errno));
+  }
+
+  std::unique_lock<std::mutex> lk(tasks_lock);
+
+  tasks.advance(monotonic_ns() / 1000);   // tasks scheduled by tasks run on the next round
+
+  reactor_timer_t id;
+  ReactorTask task;
+  while (ok2run && tasks.pop_expired(id, task)) {
+    running_timer = id;
+
+    lk.unlock();
+    try {
+      task();
+    } catch (const std::exception &e) {
+      logger_error("[Reactor] scheduled task has thrown an exception: %s", e.what());
+    }
+    task = nullptr;   // releases what the task has captured out of the lock
+    tasks_count.fetch_add(1, std::memory_order_relaxed);
+    lk.lock();
+
+    running_timer = 0;
+    task_done.notify_all();
+  }
+
+  arm_timer(tasks.next_deadline());
+}
+
+/*
+  Pins the loop thread to cpu, or lets it run on any CPU if cpu is -1.
+  Must be called before start() or run().
+*/
+void Reactor::setAffinity(int cpu) {
+  this->cpu = cpu;
+}
+
+int Reactor::getAffinity() {
+  return cpu;
+}
+
+void Reactor::pin_loop_thread() {
+  if (cpu < 0) {
+    return;
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (ret != 0) {
+    logger_warn("[Reactor] unable to pin the event loop to CPU %d: %s", cpu, strerror(ret));
+  } else {
+    logger_info("[Reactor] Event loop pinned to CPU %d", cpu);
+  }
+}
+
+reactor_stats_t Reactor::get_stats() {
+  reactor_stats_t stats;
+  stats.events = events_count.load(std::memory_order_relaxed);
+  stats.tasks = tasks_count.load(std::memory_order_relaxed);
+  stats.busy_ns = busy_ns.load(std::memory_order_relaxed);
+  stats.idle_ns = idle_ns.load(std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> guard(tasks_lock);
+  stats.timers = tasks.size();
+
+  return stats;
+}
+
+/*
+  Event loop. Runs in the caller thread until stop() is called.
+*/
+void Reactor::run() {
+  struct epoll_event events[REACTOR_MAX_EVENTS];
+
+  loop_th_id = std::this_thread::get_id();
+  pin_loop_thread();
+
+  logger_info("[Reactor] Event loop started");
+
+  unsigned long busy_start = monotonic_ns();
+  while (ok2run) {
+    unsigned long idle_start = monotonic_ns();
+    busy_ns.fetch_add(idle_start - busy_start, std::memory_order_relaxed);
+
+    int nfds = epoll_wait(epoll_fd, events, REACTOR_MAX_EVENTS, -1);
+
+    busy_start = monotonic_ns();
+    idle_ns.fetch_add(busy_start - idle_start, std::memory_order_relaxed);
+
+    if (nfds == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      logger_error("[Reactor] epoll_wait error: %s", strerror(errno));
+      break;
+    }
+
+    for (int i = 0; i < nfds; i++) {
+      int fd = events[i].data.fd;
+
+      if (fd == wakeup_fd) {
+        uint64_t value;
+        if (read(wakeup_fd, &value, sizeof(value)) == -1 && errno != EAGAIN) {
+          logger_error("[Reactor] unable to read eventfd: %s", strerror(errno));
+        }
+        continue;   // ok2run has already been set by stop()
+      }
+
+      if (fd == timer_fd) {
+        run_tasks();
+        continue;
+      }
+
+      events_count.fetch_add(1, std::memory_order_relaxed);
+
+      std::shared_ptr<EventHandler> handler;
+      {
+        std::lock_guard<std::mutex> guard(handlers_lock);
+        auto it = handlers.find(fd);
+        if (it == handlers.end()) {
+          continue; // fd has been removed by a previous handler in this same batch
+        }
+        handler = it->second;
+        dispatching_fd = fd;
+      }
+
+      (*handler)(events[i].events);
+
+      {
+        std::lock_guard<std::mutex> guard(handlers_lock);
+        dispatching_fd = -1;
+      }
+      dispatch_done.notify_all();
+    }
+  }
+
+  logger_info("[Reactor] Event loop stopped");
+}
+
+/*
+  Spawns a thread to run the event loop
+*/
+void Reactor::start() {
+  if (loop_th.joinable()) {
+    return; // already running
+  }
+
+  loop_th = std::thread(&Reactor::run, this);
+  loop_th_id = loop_th.get_id();
+}
+
+/*
+  Wakes up the event loop and waits for it to finish
+*/
+void Reactor::stop() {
+  ok2run = false;
+
+  uint64_t value = 1;
+  if (write(wakeup_fd, &value, sizeof(value)) == -1) {
+    logger_error("[Reactor] unable to write eventfd: %s", strerror(errno));
+  }
+
+  if (loop_th.joinable() && !in_loop_thread()) {
+    loop_th.join();
+  }
+
+  std::lock_guard<std::mutex> guard(tasks_lock);
+  tasks.clear();  // pending tasks might reference resources released after stop()
+}
+
+bool Reactor::in_loop_thread() {
+  return std::this_thread::get_id() == loop_th_id;
+}
+
+/*
+  Returns the process-wide reactor shared by all E2Sim instances that
+  do not provide their own. It is created and started on the first call.
+*/
+Reactor *Reactor::get_default() {
+  static Reactor reactor;
+  static std::once_flag started;
+
+  std::call_once(started, [] { reactor.start(); });
+
+  return &reactor;
+}
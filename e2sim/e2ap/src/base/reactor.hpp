@@ -0,0 +1,129 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#ifndef REACTOR_HPP
+#define REACTOR_HPP
+
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <stdint.h>
+
+#include "timer_wheel.hpp"
+
+#define REACTOR_MAX_EVENTS 64   // maximum number of events handled on each epoll_wait call
+
+typedef std::function<void(uint32_t events)> EventHandler;
+typedef TimerTask ReactorTask;
+typedef timer_wheel_id_t reactor_timer_t;   // identifies a scheduled task, 0 is never a valid timer
+
+// load of the event loop, taken by the loop thread and readable from any thread
+typedef struct {
+  unsigned long events;     // fd events dispatched to handlers
+  unsigned long tasks;      // scheduled tasks run
+  unsigned long busy_ns;    // time spent running handlers and tasks
+  unsigned long idle_ns;    // time spent waiting for events
+  unsigned long timers;     // scheduled tasks waiting to run
+} reactor_stats_t;
+
+/*
+  Event loop built on epoll that dispatches readiness events of file descriptors
+  (e.g. SCTP sockets) to their registered handlers.
+
+  Handlers run in the reactor thread, so they must not block for long.
+  The loop sleeps until either a registered fd is ready or stop() is called,
+  which wakes it up immediately through an eventfd.
+
+  Tasks scheduled with a delay also run in the reactor thread, so the state they share with the
+  handlers needs no locking. They are kept in a TimerWheel driven by a single timerfd, so scheduling
+  and cancelling tasks are O(1) however many nodes and subscriptions the reactor serves.
+  The loop thread can be pinned to a CPU (see setAffinity) to run as a shard of a ShardPool.
+*/
+class Reactor {
+
+private:
+
+  int epoll_fd;
+  int wakeup_fd;  // eventfd used to wake up the event loop on stop()
+  int timer_fd;   // expires on the deadline of the first scheduled task
+
+  TimerWheel tasks;     // guarded by tasks_lock
+  std::mutex tasks_lock;
+  std::condition_variable task_done;  // signals that running_timer has returned
+  reactor_timer_t running_timer;      // task running in the loop thread, guarded by tasks_lock
+  uint64_t armed_us;                  // deadline the timerfd is armed to, guarded by tasks_lock
+
+  int cpu;        // CPU the loop thread is pinned to, -1 if not pinned
+
+  std::atomic<unsigned long> events_count;
+  std::atomic<unsigned long> tasks_count;
+  std::atomic<unsigned long> busy_ns;
+  std::atomic<unsigned long> idle_ns;
+
+  std::unordered_map<int, std::shared_ptr<EventHandler>> handlers; // guarded by handlers_lock
+  std::mutex handlers_lock;
+  std::condition_variable dispatch_done;  // signals that the handler of dispatching_fd has returned
+  int dispatching_fd;                     // fd whose handler is running, guarded by handlers_lock
+
+  std::atomic<bool> ok2run;
+  std::thread loop_th;
+  std::atomic<std::thread::id> loop_th_id;
+
+  void arm_timer(uint64_t deadline_us);
+  void run_tasks();
+  void pin_loop_thread();
+
+public:
+
+  Reactor();
+
+  ~Reactor();
+
+  void add(int fd, uint32_t events, EventHandler handler);
+
+  void modify(int fd, uint32_t events);
+
+  void remove(int fd);
+
+  reactor_timer_t schedule(unsigned long delay_us, ReactorTask task);
+
+  bool cancel(reactor_timer_t timer, bool wait = true);
+
+  void setAffinity(int cpu);
+
+  int getAffinity();
+
+  reactor_stats_t get_stats();
+
+  void run();
+
+  void start();
+
+  void stop();
+
+  bool in_loop_thread();
+
+  static Reactor *get_default();
+
+};
+
+#endif
@@ -0,0 +1,183 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#include <string.h>
+
+#include "send_queue.hpp"
+
+static const struct {
+  const char *name;
+  send_queue_policy_e policy;
+} policy_names[] = {
+  {"block", SEND_QUEUE_BLOCK},
+  {"drop-oldest", SEND_QUEUE_DROP_OLDEST},
+  {"drop-newest", SEND_QUEUE_DROP_NEWEST},
+  {"shed-class", SEND_QUEUE_SHED_CLASS}
+};
+
+SendQueue::SendQueue() {
+  used_bytes = 0;
+  policy = SEND_QUEUE_BLOCK;
+  max_messages = SEND_QUEUE_MAX_MESSAGES;
+  max_bytes = SEND_QUEUE_MAX_BYTES;
+}
+
+/*
+  Sets the policy and the limits of the queue. Limits of 0 keep the default ones.
+*/
+void SendQueue::configure(send_queue_policy_e policy, size_t max_messages, size_t max_bytes) {
+  this->policy = policy;
+  this->max_messages = max_messages > 0 ? max_messages : SEND_QUEUE_MAX_MESSAGES;
+  this->max_bytes = max_bytes > 0 ? max_bytes : SEND_QUEUE_MAX_BYTES;
+}
+
+send_queue_policy_e SendQueue::get_policy() {
+  return policy;
+}
+
+bool SendQueue::empty() {
+  return msgs.empty();
+}
+
+size_t SendQueue::size() {
+  return msgs.size();
+}
+
+size_t SendQueue::bytes() {
+  return used_bytes;
+}
+
+/*
+  Tells if a message of len bytes fits in the queue
+*/
+bool SendQueue::has_room(size_t len) {
+  return msgs.empty() || (msgs.size() < max_messages && used_bytes + len <= max_bytes);
+}
+
+/*
+  Tells if the queue has reached any of its limits
+*/
+bool SendQueue::full() {
+  return !msgs.empty() && (msgs.size() >= max_messages || used_bytes >= max_bytes);
+}
+
+/*
+  Copies len bytes of buf to the tail of the queue, regardless of its limits (see has_room)
+*/
+void SendQueue::push(const uint8_t *buf, size_t len, uint16_t stream, uint16_t msg_class, SentCallback cb) {
+  msgs.emplace_back();
+  queued_msg_t &msg = msgs.back();
+
+  if (!spare.empty()) {
+    msg.data.swap(spare.back());
+    spare.pop_back();
+  }
+  msg.data.assign(buf, buf + len);
+  msg.stream = stream;
+  msg.msg_class = msg_class;
+  msg.cb = cb;
+  clock_gettime(CLOCK_MONOTONIC, &msg.queued);
+
+  used_bytes += len;
+}
+
+queued_msg_t &SendQueue::front() {
+  return msgs.front();
+}
+
+/*
+  Removes the head of the queue, keeping its buffer for the next messages
+*/
+void SendQueue::pop() {
+  queued_msg_t &msg = msgs.front();
+  used_bytes -= msg.data.size();
+
+  spare.emplace_back();
+  spare.back().swap(msg.data);
+  msgs.pop_front();
+}
+
+/*
+  Drops a queued message to make room for a message of class msg_class, according to the policy.
+  Drop-oldest drops the head of the queue. Shed-class drops the oldest message of the least important
+  class in the queue, as long as it is not more important than msg_class. Other policies drop nothing.
+
+  Returns true if a message has been dropped, and sets evicted_class to its class.
+*/
+bool SendQueue::evict(uint16_t msg_class, uint16_t &evicted_class) {
+  if (msgs.empty()) {
+    return false;
+  }
+
+  auto victim = msgs.end();
+  if (policy == SEND_QUEUE_DROP_OLDEST) {
+    victim = msgs.begin();
+
+  } else if (policy == SEND_QUEUE_SHED_CLASS) {
+    for (auto it = msgs.begin(); it != msgs.end(); it++) {  // higher classes are less important
+      if (it->msg_class >= msg_class && (victim == msgs.end() || it->msg_class > victim->msg_class)) {
+        victim = it;
+      }
+    }
+  }
+
+  if (victim == msgs.end()) {
+    return false;
+  }
+
+  evicted_class = victim->msg_class;
+  used_bytes -= victim->data.size();
+  spare.emplace_back();
+  spare.back().swap(victim->data);
+  msgs.erase(victim);
+
+  return true;
+}
+
+/*
+  Drops all queued messages
+*/
+void SendQueue::clear() {
+  while (!msgs.empty()) {
+    pop();
+  }
+}
+
+/*
+  Parses the name of a policy: block, drop-oldest, drop-newest, or shed-class
+
+  Returns false if name is not a policy
+*/
+bool send_queue_parse_policy(const char *name, send_queue_policy_e &policy) {
+  for (auto &entry : policy_names) {
+    if (strcmp(name, entry.name) == 0) {
+      policy = entry.policy;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *send_queue_policy_name(send_queue_policy_e policy) {
+  for (auto &entry : policy_names) {
+    if (entry.policy == policy) {
+      return entry.name;
+    }
+  }
+  return "unknown";
+}
@@ -0,0 +1,104 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#ifndef SEND_QUEUE_HPP
+#define SEND_QUEUE_HPP
+
+#include <deque>
+#include <vector>
+#include <functional>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#define SEND_QUEUE_MAX_MESSAGES 1024        // default maximum number of queued messages of an association
+#define SEND_QUEUE_MAX_BYTES    (1 << 20)   // default maximum number of queued bytes of an association
+
+typedef std::function<void(struct timespec*)> SentCallback;  // receives the timestamp of a message handed to the kernel
+
+// what to do with a message that does not fit in a full send queue
+typedef enum {
+  SEND_QUEUE_BLOCK,         // senders that can wait stop until the queue drains, other messages are admitted over the limits
+  SEND_QUEUE_DROP_OLDEST,   // drops queued messages from the head of the queue
+  SEND_QUEUE_DROP_NEWEST,   // drops the message being sent
+  SEND_QUEUE_SHED_CLASS     // drops the oldest messages of the least important class (indications, control, then global procedures)
+} send_queue_policy_e;
+
+// a message that could not be handed to the kernel right away
+typedef struct {
+  std::vector<uint8_t> data;
+  uint16_t stream;          // SCTP stream to send the message on
+  uint16_t msg_class;       // E2AP class of the message (one of E2AP_STREAM_*), regardless of its stream
+  SentCallback cb;
+  struct timespec queued;   // CLOCK_MONOTONIC time the message has been queued
+} queued_msg_t;
+
+/*
+  Bounded FIFO of the E2AP messages of an association waiting for room in the socket buffer.
+
+  The queue is bounded by both messages and bytes, but it always admits a message if it is empty,
+  so a single message larger than the byte limit can still be sent. Buffers of sent messages are
+  reused, so the queue does not allocate on steady state. It is not thread-safe.
+*/
+class SendQueue {
+
+private:
+
+  std::deque<queued_msg_t> msgs;
+  std::vector<std::vector<uint8_t>> spare;  // buffers of sent messages
+  size_t used_bytes;
+
+  send_queue_policy_e policy;
+  size_t max_messages;
+  size_t max_bytes;
+
+public:
+
+  SendQueue();
+
+  void configure(send_queue_policy_e policy, size_t max_messages, size_t max_bytes);
+
+  send_queue_policy_e get_policy();
+
+  bool empty();
+
+  size_t size();
+
+  size_t bytes();
+
+  bool has_room(size_t len);
+
+  bool full();
+
+  void push(const uint8_t *buf, size_t len, uint16_t stream, uint16_t msg_class, SentCallback cb);
+
+  queued_msg_t &front();
+
+  void pop();
+
+  bool evict(uint16_t msg_class, uint16_t &evicted_class);
+
+  void clear();
+
+};
+
+bool send_queue_parse_policy(const char *name, send_queue_policy_e &policy);
+
+const char *send_queue_policy_name(send_queue_policy_e policy);
+
+#endif
@@ -0,0 +1,145 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#include <stdlib.h>
+#include <errno.h>
+#include <sched.h>
+#include <thread>
+#include <stdexcept>
+
+#include "shard_pool.hpp"
+#include "logger.h"
+
+/*
+  Creates and starts num_shards reactors. Shard i is pinned to cpus[i % cpus.size()],
+  or is not pinned if cpus is empty.
+
+  If num_shards is 0, creates one shard per listed CPU, or one per available CPU if cpus is empty.
+*/
+ShardPool::ShardPool(unsigned int num_shards, const std::vector<int> &cpus) {
+  if (num_shards == 0) {
+    num_shards = cpus.size();
+    if (num_shards == 0) {
+      num_shards = std::thread::hardware_concurrency();
+    }
+    if (num_shards == 0) {
+      num_shards = 1;
+    }
+  }
+
+  for (unsigned int i = 0; i < num_shards; i++) {
+    int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+
+    shards.emplace_back(new Reactor());
+    shards.back()->setAffinity(cpu);
+    shards.back()->start();
+    this->cpus.push_back(cpu);
+  }
+
+  logger_info("[ShardPool] Started %u shards on CPUs %s", num_shards,
+              cpus.empty() ? "any" : shard_pool_cpus_str(this->cpus).c_str());
+}
+
+ShardPool::~ShardPool() {
+  stop();
+}
+
+unsigned int ShardPool::size() {
+  return shards.size();
+}
+
+/*
+  Returns the shard of index, wrapping around the number of shards
+*/
+Reactor *ShardPool::get(unsigned int index) {
+  return shards[index % shards.size()].get();
+}
+
+int ShardPool::get_cpu(unsigned int index) {
+  return cpus[index % cpus.size()];
+}
+
+/*
+  Stops all shards, discarding their pending tasks
+*/
+void ShardPool::stop() {
+  for (auto &shard : shards) {
+    shard->stop();
+  }
+}
+
+/*
+  Parses a list of CPUs such as "0-3,8,10-11"
+
+  Returns false if list is malformed
+*/
+bool shard_pool_parse_cpus(const char *list, std::vector<int> &cpus) {
+  std::vector<int> parsed;
+  const char *p = list;
+
+  while (*p != '\0') {
+    char *end;
+    errno = 0;
+    long first = strtol(p, &end, 10);
+    if (end == p || errno != 0 || first < 0 || first >= CPU_SETSIZE) {
+      return false;
+    }
+
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      p++;
+      last = strtol(p, &end, 10);
+      if (end == p || errno != 0 || last < first || last >= CPU_SETSIZE) {
+        return false;
+      }
+      p = end;
+    }
+
+    for (long cpu = first; cpu <= last; cpu++) {
+      parsed.push_back(cpu);
+    }
+
+    if (*p == ',') {
+      p++;
+      if (*p == '\0') {
+        return false;
+      }
+    } else if (*p != '\0') {
+      return false;
+    }
+  }
+
+  if (parsed.empty()) {
+    return false;
+  }
+
+  cpus.swap(parsed);
+  return true;
+}
+
+std::string shard_pool_cpus_str(const std::vector<int> &cpus) {
+  std::string str;
+  for (size_t i = 0; i < cpus.size(); i++) {
+    if (i > 0) {
+      str += ",";
+    }
+    str += std::to_string(cpus[i]);
+  }
+  return str;
+}
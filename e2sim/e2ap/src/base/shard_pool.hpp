@@ -0,0 +1,63 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#ifndef SHARD_POOL_HPP
+#define SHARD_POOL_HPP
+
+#include <vector>
+#include <memory>
+#include <string>
+
+#include "reactor.hpp"
+
+/*
+  Set of reactors, each one running on its own thread optionally pinned to a CPU.
+
+  Each simulated E2 node is bound to a single shard, which runs all of its work: the
+  receive handlers of its association, its timers and the generation of its messages.
+  Since a shard owns a disjoint set of nodes, the state of a node is only touched by
+  the thread of its shard, and shards do not share locks on the hot path.
+*/
+class ShardPool {
+
+private:
+
+  std::vector<std::unique_ptr<Reactor>> shards;
+  std::vector<int> cpus;    // CPU of each shard, -1 if not pinned
+
+public:
+
+  ShardPool(unsigned int num_shards, const std::vector<int> &cpus);
+
+  ~ShardPool();
+
+  unsigned int size();
+
+  Reactor *get(unsigned int index);
+
+  int get_cpu(unsigned int index);
+
+  void stop();
+
+};
+
+bool shard_pool_parse_cpus(const char *list, std::vector<int> &cpus);
+
+std::string shard_pool_cpus_str(const std::vector<int> &cpus);
+
+#endif
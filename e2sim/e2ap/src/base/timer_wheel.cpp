@@ -0,0 +1,278 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#include <algorithm>
+
+#include "timer_wheel.hpp"
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+TimerWheel::TimerWheel(uint64_t now) {
+  this->now = now;
+  next_seq = 1;
+  count = 0;
+  clear();
+}
+
+/*
+  Adds a timer that expires at the absolute time expires (microseconds).
+  Timers that are already due expire on the next microsecond, so they are only
+  taken by pop_expired() after the next advance().
+
+  Returns the id of the timer, which can be cancelled until it is taken by pop_expired()
+*/
+timer_wheel_id_t TimerWheel::add(uint64_t expires, TimerTask task) {
+  uint32_t index;
+  if (!free_nodes.empty()) {
+    index = free_nodes.back();
+    free_nodes.pop_back();
+  } else {
+    index = nodes.size();
+    nodes.emplace_back();
+  }
+
+  uint32_t seq = (uint32_t)next_seq++;
+  if (seq == 0) {   // keeps 0 as an invalid id on wraparound
+    seq = (uint32_t)next_seq++;
+  }
+
+  timer_node_t &node = nodes[index];
+  node.id = ((timer_wheel_id_t)seq << 32) | index;
+  node.expires = expires > now ? expires : now + 1;
+  node.task = std::move(task);
+
+  place(index);
+  count++;
+
+  return node.id;
+}
+
+/*
+  Returns true if the timer was pending, false if it has already been taken or cancelled
+*/
+bool TimerWheel::cancel(timer_wheel_id_t id) {
+  uint32_t index = (uint32_t)id;
+  if (id == 0 || index >= nodes.size() || nodes[index].id != id) {
+    return false;
+  }
+
+  unlink(index);
+
+  timer_node_t &node = nodes[index];
+  node.id = 0;
+  node.task = nullptr;  // releases what the task has captured
+  free_nodes.push_back(index);
+  count--;
+
+  return true;
+}
+
+/*
+  Advances the wheel to now, making the timers that expire up to now available to pop_expired()
+*/
+void TimerWheel::advance(uint64_t now) {
+  while (this->now < now) {
+    // the next time in which a slot of any level is reached
+    uint64_t reached = next_deadline();
+    if (reached > now) {
+      break;
+    }
+    this->now = reached;
+
+    for (int level = TIMER_WHEEL_LEVELS - 1; level >= 0; level--) {
+      uint64_t bits = pending[level];
+      if (bits == 0) {
+        continue;
+      }
+
+      unsigned int slot = __builtin_ctzll(bits);  // slots of a level are always ahead of its digit of the current time
+      unsigned int shift = (level + 1) * TIMER_WHEEL_BITS;
+      uint64_t prefix = shift < 64 ? (this->now >> shift) << shift : 0;
+      if ((prefix | ((uint64_t)slot << (level * TIMER_WHEEL_BITS))) != reached) {
+        continue;
+      }
+
+      // timers of a reached slot either expire or move down to a lower level
+      timer_list_t &list = slots[level * TIMER_WHEEL_SLOTS + slot];
+      uint32_t index = list.head;
+      list.head = NIL;
+      list.tail = NIL;
+      pending[level] &= ~(1ULL << slot);
+
+      while (index != NIL) {
+        uint32_t next = nodes[index].next;
+        if (nodes[index].expires <= reached) {
+          expiring.push_back(index);
+        } else {
+          place(index);
+        }
+        index = next;
+      }
+    }
+  }
+
+  if (this->now < now) {
+    this->now = now;
+  }
+
+  if (expiring.empty()) {
+    return;
+  }
+
+  std::sort(expiring.begin(), expiring.end(), [this](uint32_t a, uint32_t b) {
+    const timer_node_t &na = nodes[a];
+    const timer_node_t &nb = nodes[b];
+    if (na.expires != nb.expires) {
+      return na.expires < nb.expires;
+    }
+    return (uint32_t)(na.id >> 32) - (uint32_t)(nb.id >> 32) > UINT32_MAX / 2;  // added first, also on wraparound
+  });
+
+  for (uint32_t index : expiring) {
+    link(index, READY_SLOT);
+  }
+  expiring.clear();
+}
+
+/*
+  Takes the next expired timer, releasing it from the wheel.
+
+  Returns false if there is no expired timer
+*/
+bool TimerWheel::pop_expired(timer_wheel_id_t &id, TimerTask &task) {
+  uint32_t index = slots[READY_SLOT].head;
+  if (index == NIL) {
+    return false;
+  }
+
+  unlink(index);
+
+  timer_node_t &node = nodes[index];
+  id = node.id;
+  task = std::move(node.task);
+  node.id = 0;
+  node.task = nullptr;
+  free_nodes.push_back(index);
+  count--;
+
+  return true;
+}
+
+/*
+  Returns the time the wheel has to be advanced to, which is either the expiration of a timer or the
+  time a slot of a higher level is reached and its timers move down. Returns the current time if there
+  are expired timers, or TIMER_WHEEL_NEVER if there are no timers.
+*/
+uint64_t TimerWheel::next_deadline() {
+  if (slots[READY_SLOT].head != NIL) {
+    return now;
+  }
+
+  uint64_t deadline = TIMER_WHEEL_NEVER;
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    if (pending[level] == 0) {
+      continue;
+    }
+
+    unsigned int slot = __builtin_ctzll(pending[level]);
+    unsigned int shift = (level + 1) * TIMER_WHEEL_BITS;
+    uint64_t prefix = shift < 64 ? (now >> shift) << shift : 0;
+    deadline = std::min(deadline, prefix | ((uint64_t)slot << (level * TIMER_WHEEL_BITS)));
+  }
+
+  return deadline;
+}
+
+uint64_t TimerWheel::get_time() {
+  return now;
+}
+
+/*
+  Returns the number of timers in the wheel, including the expired ones not taken yet
+*/
+size_t TimerWheel::size() {
+  return count;
+}
+
+/*
+  Removes all timers, ids of removed timers are never reused
+*/
+void TimerWheel::clear() {
+  nodes.clear();
+  free_nodes.clear();
+  expiring.clear();
+  for (auto &list : slots) {
+    list.head = NIL;
+    list.tail = NIL;
+  }
+  for (auto &bits : pending) {
+    bits = 0;
+  }
+  count = 0;
+}
+
+/*
+  Places a timer in the slot of the level in which its expiration first differs from the current time
+*/
+void TimerWheel::place(uint32_t index) {
+  uint64_t expires = nodes[index].expires;  // always after now
+
+  int level = (63 - __builtin_clzll(expires ^ now)) / TIMER_WHEEL_BITS;
+  unsigned int slot = (expires >> (level * TIMER_WHEEL_BITS)) & SLOT_MASK;
+
+  link(index, level * TIMER_WHEEL_SLOTS + slot);
+  pending[level] |= 1ULL << slot;
+}
+
+/*
+  Appends a timer to the tail of a slot
+*/
+void TimerWheel::link(uint32_t index, uint16_t slot) {
+  timer_node_t &node = nodes[index];
+  timer_list_t &list = slots[slot];
+
+  node.slot = slot;
+  node.next = NIL;
+  node.prev = list.tail;
+  if (list.tail != NIL) {
+    nodes[list.tail].next = index;
+  } else {
+    list.head = index;
+  }
+  list.tail = index;
+}
+
+void TimerWheel::unlink(uint32_t index) {
+  timer_node_t &node = nodes[index];
+  timer_list_t &list = slots[node.slot];
+
+  if (node.prev != NIL) {
+    nodes[node.prev].next = node.next;
+  } else {
+    list.head = node.next;
+  }
+  if (node.next != NIL) {
+    nodes[node.next].prev = node.prev;
+  } else {
+    list.tail = node.prev;
+  }
+
+  if (list.head == NIL && node.slot != READY_SLOT) {
+    pending[node.slot / TIMER_WHEEL_SLOTS] &= ~(1ULL << (node.slot % TIMER_WHEEL_SLOTS));
+  }
+}
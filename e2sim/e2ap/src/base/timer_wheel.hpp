@@ -0,0 +1,108 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <vector>
+#include <functional>
+#include <stdint.h>
+
+#define TIMER_WHEEL_BITS    6                         // each level of the wheel has 2^6 slots
+#define TIMER_WHEEL_SLOTS   (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS  ((64 + TIMER_WHEEL_BITS - 1) / TIMER_WHEEL_BITS)   // levels to cover 64-bit times
+
+#define TIMER_WHEEL_NEVER   UINT64_MAX
+
+typedef std::function<void()> TimerTask;
+typedef uint64_t timer_wheel_id_t;  // identifies a timer of the wheel, 0 is never a valid timer
+
+/*
+  Hierarchical timer wheel with microsecond resolution.
+
+  Each level has 64 slots, and slots of level n cover 64^n microseconds, so a timer is placed in the
+  level of the most significant bit in which its expiration differs from the current time. Adding and
+  cancelling a timer are O(1), as timers are nodes of intrusive lists, and timers are identified by
+  the index of their node and a sequence number, so stale ids are detected without any lookup.
+
+  The wheel is advanced to the current time with advance(). It only visits the slots that hold timers,
+  moving timers of higher levels down as their slots are reached, so each timer is moved at most once
+  per level regardless of how long the wheel has not been advanced. Expired timers are then taken
+  with pop_expired(), in the order of their expiration, and of their addition for equal expirations.
+
+  Times are absolute and in microseconds (e.g. of CLOCK_MONOTONIC). It is not thread-safe.
+*/
+class TimerWheel {
+
+private:
+
+  static const uint32_t NIL = UINT32_MAX;
+
+  typedef struct {
+    timer_wheel_id_t id;  // 0 if the node is free
+    uint64_t expires;
+    TimerTask task;
+    uint32_t prev;
+    uint32_t next;
+    uint16_t slot;        // level * TIMER_WHEEL_SLOTS + slot, or READY_SLOT
+  } timer_node_t;
+
+  typedef struct {
+    uint32_t head;
+    uint32_t tail;
+  } timer_list_t;
+
+  static const uint16_t READY_SLOT = TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS;
+
+  std::vector<timer_node_t> nodes;
+  std::vector<uint32_t> free_nodes;
+  timer_list_t slots[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS + 1];   // the last one is the list of expired timers
+  uint64_t pending[TIMER_WHEEL_LEVELS];   // bitmap of the non-empty slots of each level
+  std::vector<uint32_t> expiring;         // timers expired by the current advance()
+
+  uint64_t now;
+  uint64_t next_seq;
+  size_t count;
+
+  void link(uint32_t index, uint16_t slot);
+  void unlink(uint32_t index);
+  void place(uint32_t index);
+
+public:
+
+  TimerWheel(uint64_t now);
+
+  timer_wheel_id_t add(uint64_t expires, TimerTask task);
+
+  bool cancel(timer_wheel_id_t id);
+
+  void advance(uint64_t now);
+
+  bool pop_expired(timer_wheel_id_t &id, TimerTask &task);
+
+  uint64_t next_deadline();
+
+  uint64_t get_time();
+
+  size_t size();
+
+  void clear();
+
+};
+
+#endif
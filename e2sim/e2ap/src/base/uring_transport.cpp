@@ -0,0 +1,875 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <arpa/inet.h>
+#include <netinet/sctp.h>
+#include <linux/errqueue.h>
+#include <stdexcept>
+#include <string>
+
+#include "uring_transport.hpp"
+#include "logger.h"
+
+// kind of operation of each submission, stored in the upper 32 bits of its user_data
+#define URING_OP_RECV   1ULL
+#define URING_OP_SEND   2ULL
+#define URING_OP_CANCEL 3ULL
+#define URING_OP_WAKEUP 4ULL
+
+static inline uint64_t make_user_data(uint64_t op, uint32_t value) {
+  return (op << 32) | value;
+}
+
+/*
+  throws std::runtime_error
+*/
+UringTransport::UringTransport(unsigned int entries) {
+  logger_trace("in %s constructor", __func__);
+
+  sq_ptr = MAP_FAILED;
+  cq_ptr = MAP_FAILED;
+  sqes = (struct io_uring_sqe *) MAP_FAILED;
+  buf_ring = (struct io_uring_buf_ring *) MAP_FAILED;
+  recv_bufs = NULL;
+
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+  params.cq_entries = entries * 4;  // also receives the completions of the multishot receives
+
+  ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+  if (ring_fd == -1) {
+    throw std::runtime_error(std::string("unable to set up io_uring: ") + strerror(errno));
+  }
+
+  if (!(params.features & IORING_FEAT_NODROP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+    release_ring();
+    throw std::runtime_error("io_uring transport requires Linux 6.0 or later");
+  }
+
+  sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+  cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    sq_size = cq_size = (sq_size > cq_size ? sq_size : cq_size);
+  }
+
+  sq_ptr = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  if (sq_ptr == MAP_FAILED) {
+    int error = errno;
+    release_ring();
+    throw std::runtime_error(std::string("unable to map io_uring submission queue: ") + strerror(error));
+  }
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    cq_ptr = sq_ptr;
+  } else {
+    cq_ptr = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    if (cq_ptr == MAP_FAILED) {
+      int error = errno;
+      release_ring();
+      throw std::runtime_error(std::string("unable to map io_uring completion queue: ") + strerror(error));
+    }
+  }
+
+  sqes = (struct io_uring_sqe *) mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    int error = errno;
+    release_ring();
+    throw std::runtime_error(std::string("unable to map io_uring submission entries: ") + strerror(error));
+  }
+
+  sq_head = (unsigned int *)((char *)sq_ptr + params.sq_off.head);
+  sq_tail = (unsigned int *)((char *)sq_ptr + params.sq_off.tail);
+  sq_mask = *(unsigned int *)((char *)sq_ptr + params.sq_off.ring_mask);
+  sq_local_tail = *sq_tail;
+  cq_head = (unsigned int *)((char *)cq_ptr + params.cq_off.head);
+  cq_tail = (unsigned int *)((char *)cq_ptr + params.cq_off.tail);
+  cq_mask = *(unsigned int *)((char *)cq_ptr + params.cq_off.ring_mask);
+  cqes = (struct io_uring_cqe *)((char *)cq_ptr + params.cq_off.cqes);
+
+  unsigned int *sq_array = (unsigned int *)((char *)sq_ptr + params.sq_off.array);
+  for (unsigned int i = 0; i < params.sq_entries; i++) {
+    sq_array[i] = i;  // each entry is always submitted from its own slot
+  }
+
+  /*
+    Each receive buffer holds the recvmsg header, the ancillary data (stream and kernel
+    timestamp), and the payload of a message, so it must be larger than MAX_SCTP_BUFFER
+  */
+  recv_ctrl_len = CMSG_SPACE(sizeof(struct sctp_sndrcvinfo)) + CMSG_SPACE(sizeof(struct scm_timestamping));
+  recv_buf_size = sizeof(struct io_uring_recvmsg_out) + recv_ctrl_len + MAX_SCTP_BUFFER;
+  recv_bufs = (uint8_t *) malloc(recv_buf_size * URING_RECV_BUFFERS);
+
+  buf_ring_size = URING_RECV_BUFFERS * sizeof(struct io_uring_buf);
+  buf_ring = (struct io_uring_buf_ring *) mmap(NULL, buf_ring_size, PROT_READ | PROT_WRITE,
+                                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);   // must be page aligned
+  if (recv_bufs == NULL || buf_ring == MAP_FAILED) {
+    release_ring();
+    throw std::runtime_error("unable to allocate io_uring receive buffers");
+  }
+
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = (uint64_t) buf_ring;
+  reg.ring_entries = URING_RECV_BUFFERS;
+  reg.bgid = 0;
+  if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1) {
+    int error = errno;
+    release_ring();
+    throw std::runtime_error(std::string("unable to register io_uring receive buffers: ") + strerror(error));
+  }
+
+  buf_ring->tail = 0;
+  for (unsigned int bid = 0; bid < URING_RECV_BUFFERS; bid++) {
+    recycle_buffer(bid);
+  }
+
+  next_conn_id = 1;   // 0 means no connection
+  dispatching_id = 0;
+  unsubmitted = 0;
+  submit_batch = URING_SUBMIT_BATCH;
+  submit_us = URING_SUBMIT_US;
+  enters = 0;
+  sent = 0;
+  received = 0;
+  ok2run = true;  // a stopped transport cannot be restarted
+
+  logger_info("[io_uring] Transport ready with %u submission and %u completion entries", params.sq_entries, params.cq_entries);
+}
+
+UringTransport::~UringTransport() {
+  logger_trace("in func %s", __func__);
+
+  stop();
+
+  for (auto &it : conns) {
+    sctp_reassembly_free(&it.second->reasm);
+  }
+
+  release_ring();
+}
+
+/*
+  Releases the ring and its buffers, also unregistering the receive buffers
+*/
+void UringTransport::release_ring() {
+  if (sqes != MAP_FAILED) {
+    munmap(sqes, params.sq_entries * sizeof(struct io_uring_sqe));
+  }
+  if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) {
+    munmap(cq_ptr, cq_size);
+  }
+  if (sq_ptr != MAP_FAILED) {
+    munmap(sq_ptr, sq_size);
+  }
+  if (ring_fd != -1) {
+    close(ring_fd);
+  }
+  if (buf_ring != MAP_FAILED) {
+    munmap(buf_ring, buf_ring_size);
+  }
+  free(recv_bufs);
+
+  sq_ptr = cq_ptr = MAP_FAILED;
+  sqes = (struct io_uring_sqe *) MAP_FAILED;
+  buf_ring = (struct io_uring_buf_ring *) MAP_FAILED;
+  recv_bufs = NULL;
+  ring_fd = -1;
+}
+
+/*
+  Gives a receive buffer back to the kernel. Only called by the transport thread,
+  or by the constructor.
+*/
+void UringTransport::recycle_buffer(unsigned int bid) {
+  unsigned short tail = buf_ring->tail;
+  // the ring is an array of io_uring_buf, bufs cannot be used in C++ since its empty struct takes room
+  struct io_uring_buf *buf = (struct io_uring_buf *) buf_ring + (tail & (URING_RECV_BUFFERS - 1));
+
+  buf->addr = (uint64_t)(recv_bufs + bid * recv_buf_size);
+  buf->len = recv_buf_size;
+  buf->bid = bid;
+
+  __atomic_store_n(&buf_ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/*
+  Returns the next free submission entry, or NULL if the submission queue is full. Requires lock.
+*/
+struct io_uring_sqe *UringTransport::get_sqe_nowait() {
+  unsigned int head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+  if (sq_local_tail - head >= params.sq_entries) {
+    return NULL;
+  }
+
+  struct io_uring_sqe *sqe = &sqes[sq_local_tail & sq_mask];
+  sq_local_tail++;
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+  return sqe;
+}
+
+/*
+  Returns the next free submission entry, submitting the queued ones if it is full. Requires lock.
+*/
+struct io_uring_sqe *UringTransport::get_sqe() {
+  struct io_uring_sqe *sqe = get_sqe_nowait();
+  if (sqe == NULL) {
+    enter(publish(), 0, 0);
+    sqe = get_sqe_nowait();
+    if (sqe == NULL) {
+      logger_error("[io_uring] submission queue is full");
+    }
+  }
+
+  return sqe;
+}
+
+/*
+  Makes the prepared submission entries visible to the kernel. Requires lock.
+
+  Returns the number of entries the kernel has not consumed yet, since io_uring_enter
+  does not wait for completions if it submits fewer entries than it has been asked to.
+*/
+unsigned int UringTransport::publish() {
+  __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+  return sq_local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+}
+
+/*
+  Submits up to to_submit entries and waits for at least min_complete completions,
+  or until timeout_us expires (0 waits forever).
+
+  Returns the number of submitted entries, or -1 with errno set on error (ETIME on timeout)
+*/
+int UringTransport::enter(unsigned int to_submit, unsigned int min_complete, unsigned long timeout_us) {
+  unsigned int flags = 0;
+  struct io_uring_getevents_arg arg;
+  struct __kernel_timespec kts;
+  void *argp = NULL;
+  size_t argsz = 0;
+
+  if (min_complete > 0) {
+    flags |= IORING_ENTER_GETEVENTS;
+    if (timeout_us > 0) {
+      kts.tv_sec = timeout_us / 1000000;
+      kts.tv_nsec = (timeout_us % 1000000) * 1000;
+      memset(&arg, 0, sizeof(arg));
+      arg.ts = (uint64_t) &kts;
+      flags |= IORING_ENTER_EXT_ARG;
+      argp = &arg;
+      argsz = sizeof(arg);
+    }
+  }
+
+  enters++;
+
+  return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, argp, argsz);
+}
+
+/*
+  Arms the multishot receive of a connection. Requires lock.
+*/
+void UringTransport::arm_recv(conn_t *conn) {
+  struct io_uring_sqe *sqe = get_sqe();
+  if (sqe == NULL) {
+    return;
+  }
+
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = conn->fd;
+  sqe->addr = (uint64_t) &conn->msg;
+  sqe->len = 1;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = 0;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->user_data = make_user_data(URING_OP_RECV, conn->id);
+
+  conn->armed = true;
+}
+
+/*
+  Copies a message into a send slot and queues it on the connection. Requires lock.
+*/
+bool UringTransport::queue_send(conn_t *conn, const uint8_t *buf, size_t len, uint16_t stream) {
+  unsigned int idx;
+  if (free_slots.empty()) {
+    slots.emplace_back();
+    idx = slots.size() - 1;
+    slots[idx].buf.reserve(E2AP_SEND_BUFFER_SIZE);
+  } else {
+    idx = free_slots.back();
+    free_slots.pop_back();
+  }
+
+  send_slot_t &slot = slots[idx];
+  slot.buf.assign(buf, buf + len);  // only allocates if the slot has never sent such a large message
+  slot.conn_id = conn->id;
+
+  slot.iov.iov_base = slot.buf.data();
+  slot.iov.iov_len = len;
+
+  memset(&slot.msg, 0, sizeof(slot.msg));
+  memset(&slot.cmsg, 0, sizeof(slot.cmsg));
+  slot.msg.msg_iov = &slot.iov;
+  slot.msg.msg_iovlen = 1;
+  slot.msg.msg_control = slot.cmsg.buf;
+  slot.msg.msg_controllen = sizeof(slot.cmsg.buf);
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&slot.msg);
+  cmsg->cmsg_level = IPPROTO_SCTP;
+  cmsg->cmsg_type = SCTP_SNDRCV;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(struct sctp_sndrcvinfo));
+  struct sctp_sndrcvinfo *sinfo = (struct sctp_sndrcvinfo *) CMSG_DATA(cmsg);
+  sinfo->sinfo_stream = stream;
+  sinfo->sinfo_ppid = htonl(E2AP_PPID);
+
+  conn->queued.push_back(idx);
+  if (!conn->pending && conn->inflight == 0) {
+    conn->pending = true;
+    pending_conns.push_back(conn->id);
+  }
+  unsubmitted++;
+
+  return true;
+}
+
+/*
+  Prepares a chain of linked sends for each connection with queued messages and no chain
+  in flight, so that the messages of each connection are sent in order. Requires lock.
+*/
+void UringTransport::push_chains() {
+  size_t i = 0;
+  while (i < pending_conns.size()) {
+    auto it = conns.find(pending_conns[i]);
+    if (it == conns.end()) {
+      pending_conns[i] = pending_conns.back();
+      pending_conns.pop_back();
+      continue;
+    }
+
+    conn_t *conn = it->second.get();
+    struct io_uring_sqe *last = NULL;
+    unsigned int n = 0;
+    for (; n < conn->queued.size(); n++) {
+      struct io_uring_sqe *sqe = get_sqe_nowait();
+      if (sqe == NULL) {
+        break;
+      }
+
+      send_slot_t &slot = slots[conn->queued[n]];
+      sqe->opcode = IORING_OP_SENDMSG;
+      sqe->fd = conn->fd;
+      sqe->addr = (uint64_t) &slot.msg;
+      sqe->len = 1;
+      sqe->flags = IOSQE_IO_LINK;
+      sqe->user_data = make_user_data(URING_OP_SEND, conn->queued[n]);
+      last = sqe;
+    }
+
+    if (last == NULL) {
+      return;   // submission queue is full, remaining connections stay pending
+    }
+
+    last->flags &= ~IOSQE_IO_LINK;  // ends the chain
+    conn->inflight = n;
+    conn->queued.erase(conn->queued.begin(), conn->queued.begin() + n);
+    conn->pending = false;   // listed again once the chain completes, if there is anything left
+
+    pending_conns[i] = pending_conns.back();
+    pending_conns.pop_back();
+  }
+}
+
+/*
+  Submits all queued sends and prepared entries. Requires lock.
+*/
+void UringTransport::submit() {
+  bool more;
+  do {
+    push_chains();
+    more = !pending_conns.empty();    // submission queue was full
+
+    unsigned int to_submit = publish();
+    if (to_submit > 0) {
+      if (enter(to_submit, 0, 0) == -1) {
+        logger_error("[io_uring] unable to submit: %s", strerror(errno));
+        break;  // retried by the transport thread
+      }
+    }
+  } while (more);
+
+  unsubmitted = 0;
+}
+
+/*
+  Starts receiving the SCTP messages of fd. Each complete message is handed to handler,
+  and SCTP notifications to notif_handler, if any. Both run in the transport thread.
+  The error_handler is called once if receiving stops for any reason other than remove().
+  The sent_handler, if any, receives the completion of each message sent on fd until remove(),
+  also in the transport thread, so callers can bound their messages in flight.
+
+  throws std::runtime_error
+*/
+void UringTransport::add(int fd, SctpDataHandler handler, SctpNotificationHandler notif_handler, UringErrorHandler error_handler,
+                         UringSentHandler sent_handler) {
+  std::lock_guard<std::mutex> guard(lock);
+
+  if (conn_ids.find(fd) != conn_ids.end()) {
+    throw std::runtime_error("fd " + std::to_string(fd) + " is already in the io_uring transport");
+  }
+
+  std::shared_ptr<conn_t> conn = std::make_shared<conn_t>();
+  conn->fd = fd;
+  conn->id = next_conn_id++;
+  if (next_conn_id == 0) {
+    next_conn_id = 1;
+  }
+  conn->handler = handler;
+  conn->notif_handler = notif_handler;
+  conn->error_handler = error_handler;
+  conn->sent_handler = sent_handler;
+  memset(&conn->msg, 0, sizeof(conn->msg));
+  conn->msg.msg_controllen = recv_ctrl_len;   // the kernel places the ancillary data in the selected buffer
+  sctp_reassembly_init(&conn->reasm);
+  conn->inflight = 0;
+  conn->pending = false;
+  conn->armed = false;
+  conn->failed = false;
+  conn->removing = false;
+
+  conns[conn->id] = conn;
+  conn_ids[fd] = conn->id;
+
+  arm_recv(conn.get());
+  if (!conn->armed) {
+    conns.erase(conn->id);
+    conn_ids.erase(fd);
+    throw std::runtime_error("unable to receive on fd " + std::to_string(fd) + ": submission queue is full");
+  }
+  submit();
+
+  logger_debug("[io_uring] receiving on fd %d", fd);
+}
+
+/*
+  Stops receiving from fd and discards its queued messages.
+
+  When called from another thread, this function only returns after the handlers of fd
+  have finished running and the kernel no longer receives on fd, so the caller can safely
+  release any resource the handlers use (e.g. close the fd).
+*/
+void UringTransport::remove(int fd) {
+  std::unique_lock<std::mutex> lk(lock);
+
+  auto it = conn_ids.find(fd);
+  if (it == conn_ids.end()) {
+    return; // not registered or already removed
+  }
+
+  uint32_t id = it->second;
+  conn_ids.erase(it);
+
+  std::shared_ptr<conn_t> conn = conns[id];
+  conn->removing = true;
+  for (unsigned int idx : conn->queued) {
+    free_slots.push_back(idx);
+  }
+  conn->queued.clear();
+
+  if (conn->armed) {
+    struct io_uring_sqe *sqe = get_sqe();
+    if (sqe != NULL) {
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->addr = make_user_data(URING_OP_RECV, id);
+      sqe->user_data = make_user_data(URING_OP_CANCEL, id);
+    }
+    submit();
+
+  } else {
+    release_conn(id);
+  }
+
+  if (!in_loop_thread() && loop_th.joinable() && ok2run) {
+    removed.wait(lk, [this, id] { return conns.find(id) == conns.end() && dispatching_id != id; });
+  }
+
+  logger_debug("[io_uring] fd %d is no longer received", fd);
+}
+
+/*
+  Releases a removed connection once the kernel no longer receives on it. Requires lock.
+*/
+void UringTransport::release_conn(uint32_t id) {
+  auto it = conns.find(id);
+  if (it != conns.end()) {
+    sctp_reassembly_free(&it->second->reasm);
+    conns.erase(it);
+  }
+  removed.notify_all();
+}
+
+/*
+  Copies len bytes of buf as a single E2AP message to be sent on the given SCTP stream of fd.
+  The timestamp ts is taken when the message is queued, so it includes the submission delay.
+
+  Returns false if fd is not in the transport
+*/
+bool UringTransport::send(int fd, const uint8_t *buf, size_t len, uint16_t stream, struct timespec *ts) {
+  std::lock_guard<std::mutex> guard(lock);
+
+  auto it = conn_ids.find(fd);
+  if (it == conn_ids.end()) {
+    logger_error("[io_uring] unable to send on fd %d: not in the transport", fd);
+    errno = EBADF;
+    return false;
+  }
+
+  if (ts != NULL) {
+    clock_gettime(CLOCK_REALTIME, ts);
+  }
+
+  queue_send(conns[it->second].get(), buf, len, stream);
+
+  if (unsubmitted >= submit_batch) {
+    submit();
+  }
+
+  return true;
+}
+
+/*
+  Copies count E2AP messages located within buf (see sctp_send_batch) to be sent on fd,
+  and submits them right away, since they are already a batch.
+
+  Returns false if fd is not in the transport
+*/
+bool UringTransport::send_batch(int fd, const uint8_t *buf, const sctp_msg_t *msgs, unsigned int count, struct timespec *ts) {
+  std::lock_guard<std::mutex> guard(lock);
+
+  auto it = conn_ids.find(fd);
+  if (it == conn_ids.end()) {
+    logger_error("[io_uring] unable to send on fd %d: not in the transport", fd);
+    errno = EBADF;
+    return false;
+  }
+
+  if (ts != NULL) {
+    clock_gettime(CLOCK_REALTIME, ts);
+  }
+
+  conn_t *conn = conns[it->second].get();
+  for (unsigned int i = 0; i < count; i++) {
+    queue_send(conn, buf + msgs[i].offset, msgs[i].len, msgs[i].stream);
+  }
+
+  submit();
+
+  return true;
+}
+
+/*
+  Sets the submission policy. Queued messages are submitted once submit_batch of them are queued,
+  or after submit_us microseconds. A submit_batch of 0 or 1 submits each message right away.
+*/
+void UringTransport::setSubmitPolicy(unsigned int submit_batch, unsigned long submit_us) {
+  std::lock_guard<std::mutex> guard(lock);
+
+  this->submit_batch = submit_batch > 1 ? submit_batch : 1;
+  this->submit_us = submit_us > 0 ? submit_us : 1;
+}
+
+uring_stats_t UringTransport::get_stats() {
+  uring_stats_t stats;
+  stats.enters = enters;
+  stats.sent = sent;
+  stats.received = received;
+  return stats;
+}
+
+/*
+  Handles a completion of the multishot receive of a connection. Runs in the transport thread.
+*/
+void UringTransport::handle_recv(struct io_uring_cqe *cqe, struct timespec *ts) {
+  uint32_t id = (uint32_t) cqe->user_data;
+  bool more = cqe->flags & IORING_CQE_F_MORE;
+  bool has_buffer = cqe->flags & IORING_CQE_F_BUFFER;
+  unsigned int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+  std::shared_ptr<conn_t> conn;
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = conns.find(id);
+    if (it == conns.end()) {
+      if (has_buffer) {
+        recycle_buffer(bid);
+      }
+      return;
+    }
+    conn = it->second;
+    if (!more) {
+      conn->armed = false;
+    }
+    if (conn->removing) {
+      if (has_buffer) {
+        recycle_buffer(bid);
+      }
+      if (!more) {
+        release_conn(id);
+      }
+      return;
+    }
+    dispatching_id = id;
+  }
+
+  int error = 0;
+  if (cqe->res < 0) {
+    error = -cqe->res;
+
+  } else if (has_buffer) {
+    uint8_t *buf = recv_bufs + bid * recv_buf_size;
+    struct io_uring_recvmsg_out *out = (struct io_uring_recvmsg_out *) buf;
+
+    // the buffer holds the header, the name (not requested), the ancillary data, and the payload
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = buf + sizeof(struct io_uring_recvmsg_out);
+    msg.msg_controllen = out->controllen;
+    msg.msg_flags = out->flags;
+
+    size_t room = cqe->res - sizeof(struct io_uring_recvmsg_out) - recv_ctrl_len;
+    size_t len = out->payloadlen < room ? out->payloadlen : room;
+
+    int ret = sctp_deliver_message(&conn->reasm, &msg, buf + sizeof(struct io_uring_recvmsg_out) + recv_ctrl_len,
+                                   len, ts, conn->handler, conn->notif_handler);
+    if (ret == -1) {
+      error = errno;
+    } else {
+      received += ret;
+    }
+
+  } else if (!more) {
+    error = ENOTCONN;   // end of file
+  }
+
+  if (has_buffer) {
+    recycle_buffer(bid);
+  }
+
+  bool notify_error = false;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    dispatching_id = 0;
+
+    if (!conn->removing && !conn->failed) {
+      if (error == 0 || error == ENOBUFS) {
+        if (!more) {
+          logger_debug("[io_uring] rearming receive on fd %d", conn->fd);  // e.g. receive buffers were exhausted
+          arm_recv(conn.get());
+          submit();
+        }
+      } else {
+        conn->failed = true;
+        notify_error = true;
+      }
+    }
+
+    if (conn->removing && !conn->armed) {
+      release_conn(id);
+    }
+  }
+  removed.notify_all();
+
+  if (notify_error) {
+    if (error != ENOTCONN) {
+      logger_error("[io_uring] receive error on fd %d: %s", conn->fd, strerror(error));
+    }
+    conn->error_handler(error);
+  }
+}
+
+/*
+  Handles the completion of a send, releasing its slot and handing its result
+  to the sent handler of the connection. Runs in the transport thread.
+*/
+void UringTransport::handle_send(struct io_uring_cqe *cqe) {
+  unsigned int idx = (uint32_t) cqe->user_data;
+  std::shared_ptr<conn_t> conn;
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+
+    send_slot_t &slot = slots[idx];
+    if (cqe->res == -ECANCELED) {
+      logger_debug("[io_uring] message of %zu bytes cancelled by an earlier failed send", slot.iov.iov_len);
+    } else if (cqe->res < 0) {
+      logger_error("[io_uring] unable to send message of %zu bytes: %s", slot.iov.iov_len, strerror(-cqe->res));
+    } else {
+      sent++;
+    }
+
+    free_slots.push_back(idx);
+
+    auto it = conns.find(slot.conn_id);
+    if (it == conns.end()) {
+      return;
+    }
+    conn = it->second;
+    conn->inflight--;
+    if (conn->inflight == 0 && !conn->queued.empty() && !conn->pending) {
+      conn->pending = true;
+      pending_conns.push_back(conn->id);
+    }
+    if (conn->removing || !conn->sent_handler) {
+      return;
+    }
+    dispatching_id = conn->id;
+  }
+
+  conn->sent_handler(cqe->res);   // runs unlocked, as it usually sends the next messages
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    dispatching_id = 0;
+  }
+  removed.notify_all();
+}
+
+/*
+  Event loop. Runs in the caller thread until stop() is called.
+*/
+void UringTransport::run() {
+  struct timespec ts;
+
+  loop_th_id = std::this_thread::get_id();
+
+  logger_info("[io_uring] Event loop started");
+
+  while (ok2run) {
+    unsigned int to_submit;
+    unsigned long timeout_us;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      push_chains();
+      to_submit = publish();
+      unsubmitted = 0;
+      timeout_us = submit_batch > 1 ? submit_us : 0;  // queued messages are only submitted by the senders otherwise
+    }
+
+    // submits everything that has been queued so far and waits for completions
+    if (enter(to_submit, 1, timeout_us) == -1) {
+      if (errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+        logger_error("[io_uring] unable to wait for completions: %s", strerror(errno));
+        break;
+      }
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ts);   // all messages of a loop iteration share the same timestamp
+
+    unsigned int head = *cq_head;
+    while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+      struct io_uring_cqe cqe = cqes[head & cq_mask];   // copied, so the kernel can reuse its entry right away
+      head++;
+      __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+      switch (cqe.user_data >> 32) {
+        case URING_OP_RECV:
+          handle_recv(&cqe, &ts);
+          break;
+
+        case URING_OP_SEND:
+          handle_send(&cqe);
+          break;
+
+        default:  // cancellations and wake ups
+          break;
+      }
+    }
+  }
+
+  logger_info("[io_uring] Event loop stopped");
+}
+
+/*
+  Spawns a thread to run the event loop
+*/
+void UringTransport::start() {
+  if (loop_th.joinable()) {
+    return; // already running
+  }
+
+  loop_th = std::thread(&UringTransport::run, this);
+  loop_th_id = loop_th.get_id();
+}
+
+/*
+  Wakes up the event loop and waits for it to finish
+*/
+void UringTransport::stop() {
+  ok2run = false;
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if (ring_fd == -1) {
+      return;
+    }
+
+    struct io_uring_sqe *sqe = get_sqe();
+    if (sqe != NULL) {
+      sqe->opcode = IORING_OP_NOP;
+      sqe->user_data = make_user_data(URING_OP_WAKEUP, 0);
+    }
+    submit();
+  }
+
+  if (loop_th.joinable() && !in_loop_thread()) {
+    loop_th.join();
+  }
+}
+
+bool UringTransport::in_loop_thread() {
+  return std::this_thread::get_id() == loop_th_id;
+}
+
+/*
+  Returns the process-wide io_uring transport shared by all E2Sim instances that use it.
+  It is created and started on the first call.
+
+  Returns NULL if io_uring is not available (e.g. older kernels or disabled by seccomp)
+*/
+UringTransport *UringTransport::get_default() {
+  static std::unique_ptr<UringTransport> transport;
+  static std::once_flag started;
+
+  std::call_once(started, [] {
+    try {
+      transport.reset(new UringTransport());
+      transport->start();
+    } catch (const std::runtime_error &e) {
+      logger_error("[io_uring] %s", e.what());
+    }
+  });
+
+  return transport.get();
+}
@@ -0,0 +1,192 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#ifndef URING_TRANSPORT_HPP
+#define URING_TRANSPORT_HPP
+
+#include <unordered_map>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+
+#include "e2sim_sctp.hpp"
+
+#define URING_ENTRIES       256   // submission queue entries, the completion queue is four times larger
+#define URING_RECV_BUFFERS  256   // receive buffers shared by all associations (power of 2)
+#define URING_SUBMIT_BATCH  1     // queued messages that trigger a submission, 1 submits each message right away
+#define URING_SUBMIT_US     1000  // time (microseconds) a queued message waits to be submitted
+
+// receives the error that stopped receiving from an association (e.g. ENOTCONN if closed by the peer)
+typedef std::function<void(int error)> UringErrorHandler;
+// receives the result of each send of an association, in the order the messages have been queued:
+// the bytes sent, or a negative errno (-ECANCELED if an earlier send of the same chain has failed)
+typedef std::function<void(int res)> UringSentHandler;
+
+typedef struct {
+  unsigned long enters;       // io_uring_enter syscalls
+  unsigned long sent;         // messages sent
+  unsigned long received;     // messages received (i.e. completions of the multishot receives)
+} uring_stats_t;
+
+/*
+  Transport backend built on io_uring that sends and receives the SCTP messages of many
+  associations with as few syscalls as possible, as an alternative to the Reactor and
+  the sctp_send_data / sctp_receive_batch pair, which cost at least two syscalls per round trip.
+
+  Each association has a single multishot recvmsg that stays armed, picking buffers from a
+  ring of buffers registered with the kernel and shared by all associations. Received
+  messages are handed to their handlers in the transport thread, as the Reactor does.
+
+  Messages to send are copied into send slots, so callers can reuse their buffers right away.
+  Sends of an association are linked (IOSQE_IO_LINK) to keep them in order, and are submitted
+  together with the sends of all other associations according to the submission policy:
+  either once submit_batch messages are queued, or after submit_us microseconds.
+  The transport does not bound the messages in flight, callers do it by counting completions.
+
+  The ring is set up with raw syscalls, so it does not depend on liburing,
+  but it requires Linux 6.0 or later (multishot recvmsg and registered buffer rings).
+*/
+class UringTransport {
+
+private:
+
+  typedef struct {
+    std::vector<uint8_t> buf;
+    struct msghdr msg;
+    struct iovec iov;
+    struct {
+      alignas(struct cmsghdr) char buf[CMSG_SPACE(sizeof(struct sctp_sndrcvinfo))];
+    } cmsg;
+    uint32_t conn_id;
+  } send_slot_t;
+
+  typedef struct {
+    int fd;
+    uint32_t id;
+    SctpDataHandler handler;
+    SctpNotificationHandler notif_handler;
+    UringErrorHandler error_handler;
+    UringSentHandler sent_handler;
+    struct msghdr msg;          // template of the multishot recvmsg, only its lengths are used by the kernel
+    sctp_reassembly_t reasm;    // only used by the transport thread
+    std::vector<unsigned int> queued;   // send slots waiting to be submitted
+    unsigned int inflight;      // send slots submitted and not completed yet
+    bool pending;               // listed in pending_conns
+    bool armed;                 // the multishot recvmsg is in progress
+    bool failed;                // the error handler has been called
+    bool removing;
+  } conn_t;
+
+  int ring_fd;
+  struct io_uring_params params;
+  void *sq_ptr;
+  void *cq_ptr;
+  size_t sq_size;
+  size_t cq_size;
+  struct io_uring_sqe *sqes;
+  unsigned int *sq_head;
+  unsigned int *sq_tail;
+  unsigned int sq_local_tail;   // entries prepared but not published to the kernel yet, guarded by lock
+  unsigned int sq_mask;
+  unsigned int *cq_head;
+  unsigned int *cq_tail;
+  unsigned int cq_mask;
+  struct io_uring_cqe *cqes;
+
+  struct io_uring_buf_ring *buf_ring;   // registered receive buffers
+  size_t buf_ring_size;
+  uint8_t *recv_bufs;
+  size_t recv_buf_size;
+  size_t recv_ctrl_len;   // ancillary data room of each received message
+
+  std::mutex lock;        // guards the submission queue, the connections and the send slots
+  std::condition_variable removed;  // signals that a connection has been released
+  std::unordered_map<uint32_t, std::shared_ptr<conn_t>> conns;
+  std::unordered_map<int, uint32_t> conn_ids;   // fd to connection id
+  uint32_t next_conn_id;
+  uint32_t dispatching_id;    // connection whose handler is running
+  std::deque<send_slot_t> slots;      // stable addresses, grows to the high-water mark of messages in flight (see add)
+  std::vector<unsigned int> free_slots;
+  std::vector<uint32_t> pending_conns;  // connections with queued sends and no chain in flight
+  unsigned int unsubmitted;             // messages queued since the last submission
+
+  unsigned int submit_batch;
+  unsigned long submit_us;
+
+  std::atomic<unsigned long> enters;
+  std::atomic<unsigned long> sent;
+  std::atomic<unsigned long> received;
+
+  std::atomic<bool> ok2run;
+  std::thread loop_th;
+  std::atomic<std::thread::id> loop_th_id;
+
+  void release_ring();
+  struct io_uring_sqe *get_sqe_nowait();
+  struct io_uring_sqe *get_sqe();
+  unsigned int publish();
+  void arm_recv(conn_t *conn);
+  bool queue_send(conn_t *conn, const uint8_t *buf, size_t len, uint16_t stream);
+  void push_chains();
+  void submit();
+  int enter(unsigned int to_submit, unsigned int min_complete, unsigned long timeout_us);
+  void handle_recv(struct io_uring_cqe *cqe, struct timespec *ts);
+  void handle_send(struct io_uring_cqe *cqe);
+  void recycle_buffer(unsigned int bid);
+  void release_conn(uint32_t id);
+
+public:
+
+  UringTransport(unsigned int entries = URING_ENTRIES);
+
+  ~UringTransport();
+
+  void add(int fd, SctpDataHandler handler, SctpNotificationHandler notif_handler, UringErrorHandler error_handler,
+           UringSentHandler sent_handler = nullptr);
+
+  void remove(int fd);
+
+  bool send(int fd, const uint8_t *buf, size_t len, uint16_t stream, struct timespec *ts);
+
+  bool send_batch(int fd, const uint8_t *buf, const sctp_msg_t *msgs, unsigned int count, struct timespec *ts);
+
+  void setSubmitPolicy(unsigned int submit_batch, unsigned long submit_us);
+
+  uring_stats_t get_stats();
+
+  void run();
+
+  void start();
+
+  void stop();
+
+  bool in_loop_thread();
+
+  static UringTransport *get_default();
+
+};
+
+#endif
@@ -0,0 +1,222 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+/*
+  Compares the asn1c encoder with the fast APER encoders (see fast_aper.hpp) on the PDUs both can encode:
+    asn1c      builds the asn1c structures of the PDU with its generate_e2ap_* function and encodes them,
+               within an arena scope, as the simulator does for each message
+    asn1c-enc  only encodes the asn1c structures of a PDU built once
+    fast       encodes the PDU with its fast encoder
+
+  The encodings of both encoders are compared before the timed runs, and the benchmark fails if they differ.
+
+  Build with -DBENCHMARK=1
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <vector>
+
+#include "encode_e2ap.hpp"
+#include "fast_aper.hpp"
+#include "validation_policy.hpp"
+#include "asn_arena.h"
+
+extern "C" {
+  #include "E2AP-PDU.h"
+  #include "asn_application.h"
+}
+
+typedef struct {
+  unsigned long iterations;       // PDUs encoded by each encoder
+  size_t header_size;             // bytes of the E2SM header of the indications
+  size_t message_size;            // bytes of the E2SM message of the indications
+  int actions;                    // admitted actions of the subscription responses
+  validation_policy_t validation; // of the asn1c PDUs, as set in the simulator
+} bench_args_t;
+
+static volatile size_t sink;  // keeps the encodings from being optimized away
+
+static unsigned long elapsed_ns(const struct timespec &start, const struct timespec &end) {
+  return (end.tv_sec - start.tv_sec) * 1000000000UL + end.tv_nsec - start.tv_nsec;
+}
+
+/*
+  Runs the encoders of a PDU. The generate function builds the asn1c structures of the PDU,
+  and the fast function encodes the same PDU into a buffer with the fast encoder.
+
+  Returns false if the encoders do not write the same bytes
+*/
+template <typename Generate, typename Fast>
+static bool run_pdu(const char *name, const bench_args_t &args, Generate generate, Fast fast) {
+  size_t size = args.header_size + args.message_size + 4096;
+  std::vector<uint8_t> asn_buf(size);
+  std::vector<uint8_t> fast_buf(size);
+  struct timespec start;
+  struct timespec end;
+
+  E2AP_PDU_t *pdu = (E2AP_PDU_t *) calloc(1, sizeof(E2AP_PDU_t));
+  generate(pdu);
+  asn_enc_rval_t er = asn_encode_to_buffer(NULL, ATS_ALIGNED_BASIC_PER, &asn_DEF_E2AP_PDU, pdu, asn_buf.data(), size);
+  ssize_t len = fast(fast_buf.data(), size);
+
+  if (er.encoded <= 0 || er.encoded != len || memcmp(asn_buf.data(), fast_buf.data(), len) != 0) {
+    fprintf(stderr, "%s: the fast encoder wrote %zd bytes that differ from the %zd bytes of asn1c\n", name, len, er.encoded);
+    ASN_STRUCT_FREE(asn_DEF_E2AP_PDU, pdu);
+    return false;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (unsigned long i = 0; i < args.iterations; i++) {
+    AsnArenaScope arena;
+    E2AP_PDU_t *tmp = (E2AP_PDU_t *) calloc(1, sizeof(E2AP_PDU_t));
+    generate(tmp);
+    sink = sink + asn_encode_to_buffer(NULL, ATS_ALIGNED_BASIC_PER, &asn_DEF_E2AP_PDU, tmp, asn_buf.data(), size).encoded;
+    ASN_STRUCT_FREE(asn_DEF_E2AP_PDU, tmp);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double asn_ns = (double) elapsed_ns(start, end) / args.iterations;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (unsigned long i = 0; i < args.iterations; i++) {
+    sink = sink + asn_encode_to_buffer(NULL, ATS_ALIGNED_BASIC_PER, &asn_DEF_E2AP_PDU, pdu, asn_buf.data(), size).encoded;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double enc_ns = (double) elapsed_ns(start, end) / args.iterations;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (unsigned long i = 0; i < args.iterations; i++) {
+    sink = sink + fast(fast_buf.data(), size);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double fast_ns = (double) elapsed_ns(start, end) / args.iterations;
+
+  ASN_STRUCT_FREE(asn_DEF_E2AP_PDU, pdu);
+
+  printf("%-30s %8zd %12.1f %12.1f %12.1f %10.1f\n", name, len, asn_ns, enc_ns, fast_ns, asn_ns / fast_ns);
+
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  bench_args_t args;
+  args.iterations = 200000;
+  args.header_size = 32;
+  args.message_size = 256;
+  args.actions = 1;
+  args.validation.mode = VALIDATION_ALWAYS;
+  args.validation.n = 1;
+
+  int c;
+  while ((c = getopt(argc, argv, "n:H:s:a:V:h")) != -1) {
+    switch (c) {
+      case 'n':
+        args.iterations = strtoul(optarg, NULL, 10);
+        break;
+      case 'H':
+        args.header_size = strtoul(optarg, NULL, 10);
+        break;
+      case 's':
+        args.message_size = strtoul(optarg, NULL, 10);
+        break;
+      case 'a':
+        args.actions = atoi(optarg);
+        break;
+      case 'V':
+        if (!validation_parse_policy(optarg, args.validation)) {
+          fprintf(stderr, "invalid validation policy %s, expected always, sample:N, first:N, or off\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      default:
+        fprintf(stderr,
+          "\nUsage: %s [options]\n\n"
+          "Options:\n"
+          "  -n  PDUs encoded by each encoder (default 200000)\n"
+          "  -H  Bytes of the E2SM header of the indications (default 32)\n"
+          "  -s  Bytes of the E2SM message of the indications (default 256)\n"
+          "  -a  Admitted actions of the subscription responses, from 1 to 16 (default 1)\n"
+          "  -V  Constraint checks of the asn1c PDUs: always (default), sample:N, first:N, or off\n\n",
+          argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  if (args.iterations == 0 || args.actions < 1 || args.actions > 16) {
+    fprintf(stderr, "invalid arguments\n");
+    exit(EXIT_FAILURE);
+  }
+
+  validation_set_policy(args.validation);
+
+  std::vector<uint8_t> header(args.header_size);
+  std::vector<uint8_t> message(args.message_size);
+  for (size_t i = 0; i < header.size(); i++) {
+    header[i] = (uint8_t) (i * 7 + 1);
+  }
+  for (size_t i = 0; i < message.size(); i++) {
+    message[i] = (uint8_t) (i * 13 + 5);
+  }
+  unsigned int cpid = 0x12345678;
+  OCTET_STRING_t ostr_cpid;
+  memset(&ostr_cpid, 0, sizeof(ostr_cpid));
+  ostr_cpid.buf = (uint8_t *) &cpid;
+  ostr_cpid.size = sizeof(cpid);
+
+  std::vector<long> actions(args.actions);
+  for (int i = 0; i < args.actions; i++) {
+    actions[i] = i + 1;
+  }
+
+  printf("%lu PDUs per encoder, indications of %zu + %zu bytes, %d admitted actions, validation %s\n\n", args.iterations,
+         args.header_size, args.message_size, args.actions, validation_policy_name(args.validation).c_str());
+  printf("%-30s %8s %12s %12s %12s %10s\n", "pdu", "bytes", "asn1c-ns", "asn1c-enc-ns", "fast-ns", "speedup");
+
+  bool ok = true;
+
+  ok &= run_pdu("RICindication", args,
+    [&](E2AP_PDU_t *pdu) {
+      encoding::generate_e2ap_indication_request_parameterized(pdu, RICindicationType_insert, 123, 7, 3, 1, 4242,
+          header.data(), header.size(), message.data(), message.size(), &ostr_cpid);
+    },
+    [&](uint8_t *buf, size_t size) {
+      return encoding::fast_encode_indication(buf, size, RICindicationType_insert, 123, 7, 3, 1, 4242,
+          header.data(), header.size(), message.data(), message.size(), ostr_cpid.buf, ostr_cpid.size);
+    });
+
+  ok &= run_pdu("RICsubscriptionResponse", args,
+    [&](E2AP_PDU_t *pdu) {
+      encoding::generate_e2ap_subscription_response_success(pdu, actions.data(), NULL, actions.size(), 0, 123, 7, 3);
+    },
+    [&](uint8_t *buf, size_t size) {
+      return encoding::fast_encode_subscription_response(buf, size, 3, 123, 7, actions.data(), actions.size());
+    });
+
+  ok &= run_pdu("RICsubscriptionDeleteResponse", args,
+    [&](E2AP_PDU_t *pdu) {
+      encoding::generate_e2ap_subscription_delete_response_success(pdu, 3, 123, 7);
+    },
+    [&](uint8_t *buf, size_t size) {
+      return encoding::fast_encode_subscription_delete_response(buf, size, 3, 123, 7);
+    });
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
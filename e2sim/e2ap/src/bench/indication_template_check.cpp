@@ -0,0 +1,212 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+/*
+  Differential check of the RIC-INDICATION template (see indication_template.hpp) against the asn1c encoder.
+
+  Builds templates of random IDs, E2SM payload sizes and call process ID sizes, with sizes around the
+  APER length determinant boundaries, and compares each patched template with random SN and call process
+  ID pairs against asn_encode_to_new_buffer of the same PDU built by generate_e2ap_indication_request_parameterized.
+  It also checks that patching a call process ID of another size is refused.
+
+  Templates that cannot be built (e.g. a field split by an APER fragment) are counted as fallbacks, as the
+  simulator fully encodes those PDUs. The check fails if any patched template differs from asn1c.
+
+  Build with -DBENCHMARK=1
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <vector>
+
+#include "indication_template.hpp"
+#include "encode_e2ap.hpp"
+#include "validation_policy.hpp"
+
+extern "C" {
+  #include "E2AP-PDU.h"
+  #include "asn_application.h"
+}
+
+// sizes around the APER length determinants (1 byte, 2 bytes, and fragments of 16K)
+static const size_t boundaries[] = {1, 2, 126, 127, 128, 129, 255, 256, 16382, 16383, 16384, 16385, 16386};
+
+typedef struct {
+  unsigned long templates;    // templates built
+  unsigned long patches;      // SN and call process ID pairs compared on each template
+  size_t max_size;            // maximum bytes of the E2SM header and message
+  unsigned int seed;
+} check_args_t;
+
+static long pick(long max) {
+  return random() % (max + 1);
+}
+
+/*
+  Returns a random payload size from 1 to max, half of the times around a length determinant boundary
+*/
+static size_t pick_size(size_t max) {
+  size_t size;
+  if (random() % 2) {
+    size = boundaries[random() % (sizeof(boundaries) / sizeof(boundaries[0]))];
+  } else {
+    size = 1 + random() % max;
+  }
+  return size > max ? max : size;
+}
+
+static void fill(std::vector<uint8_t> &buf) {
+  for (auto &b : buf) {
+    b = (uint8_t) random();
+  }
+}
+
+/*
+  Encodes the RIC-INDICATION with the asn1c encoder into out
+
+  Returns false on error
+*/
+static bool reference_encode(e_RICindicationType type, long requestorId, long instanceId, long ranFunctionId, long actionId,
+                             uint16_t sn, std::vector<uint8_t> &header, std::vector<uint8_t> &message,
+                             std::vector<uint8_t> &cpid, std::vector<uint8_t> &out) {
+  OCTET_STRING_t ostr_cpid;
+  memset(&ostr_cpid, 0, sizeof(ostr_cpid));
+  ostr_cpid.buf = cpid.data();
+  ostr_cpid.size = cpid.size();
+
+  E2AP_PDU_t *pdu = (E2AP_PDU_t *) calloc(1, sizeof(E2AP_PDU_t));
+  encoding::generate_e2ap_indication_request_parameterized(pdu, type, requestorId, instanceId, ranFunctionId, actionId, sn,
+          header.data(), header.size(), message.data(), message.size(), &ostr_cpid);
+
+  asn_encode_to_new_buffer_result_t res = asn_encode_to_new_buffer(NULL, ATS_ALIGNED_BASIC_PER, &asn_DEF_E2AP_PDU, pdu);
+  ASN_STRUCT_FREE(asn_DEF_E2AP_PDU, pdu);
+
+  if (res.buffer == NULL) {
+    return false;
+  }
+
+  out.assign((uint8_t *) res.buffer, (uint8_t *) res.buffer + res.result.encoded);
+  free(res.buffer);
+
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  check_args_t args;
+  args.templates = 200;
+  args.patches = 100;
+  args.max_size = 20000;
+  args.seed = 1;
+
+  int c;
+  while ((c = getopt(argc, argv, "n:p:m:S:h")) != -1) {
+    switch (c) {
+      case 'n':
+        args.templates = strtoul(optarg, NULL, 10);
+        break;
+      case 'p':
+        args.patches = strtoul(optarg, NULL, 10);
+        break;
+      case 'm':
+        args.max_size = strtoul(optarg, NULL, 10);
+        break;
+      case 'S':
+        args.seed = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        fprintf(stderr,
+          "\nUsage: %s [options]\n\n"
+          "Options:\n"
+          "  -n  Templates built with random IDs and payload sizes (default 200)\n"
+          "  -p  SN and call process ID pairs compared on each template (default 100)\n"
+          "  -m  Maximum bytes of the E2SM header and message (default 20000)\n"
+          "  -S  Seed of the random values, to reproduce a failure (default 1)\n\n",
+          argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  if (args.templates == 0 || args.max_size == 0) {
+    fprintf(stderr, "invalid arguments\n");
+    exit(EXIT_FAILURE);
+  }
+
+  validation_policy_t validation;
+  validation.mode = VALIDATION_OFF;   // the reference PDUs are valid by construction
+  validation.n = 0;
+  validation_set_policy(validation);
+
+  srandom(args.seed);
+
+  unsigned long compared = 0;
+  unsigned long fallbacks = 0;
+  unsigned long mismatches = 0;
+  std::vector<uint8_t> expected;
+
+  for (unsigned long t = 0; t < args.templates; t++) {
+    e_RICindicationType type = random() % 2 ? RICindicationType_insert : RICindicationType_report;
+    long requestorId = pick(65535);
+    long instanceId = pick(65535);
+    long ranFunctionId = pick(4095);
+    long actionId = pick(255);
+    std::vector<uint8_t> header(pick_size(args.max_size));
+    std::vector<uint8_t> message(pick_size(args.max_size));
+    std::vector<uint8_t> cpid(random() % 2 ? 4 : 1 + random() % 16);
+    fill(header);
+    fill(message);
+
+    IndicationTemplate ind_template;
+    if (!ind_template.build(type, requestorId, instanceId, ranFunctionId, actionId, header.data(), header.size(),
+                            message.data(), message.size(), cpid.size())) {
+      fallbacks++;
+      continue;
+    }
+
+    std::vector<uint8_t> other(cpid.size() + 1);
+    if (ind_template.patch(0, other.data(), other.size()) != NULL) {
+      fprintf(stderr, "template %lu: patched a call process ID of %zu bytes, built for %zu bytes\n", t, other.size(), cpid.size());
+      mismatches++;
+    }
+
+    for (unsigned long p = 0; p < args.patches; p++) {
+      uint16_t sn = (uint16_t) random();
+      fill(cpid);
+
+      const uint8_t *patched = ind_template.patch(sn, cpid.data(), cpid.size());
+      if (!reference_encode(type, requestorId, instanceId, ranFunctionId, actionId, sn, header, message, cpid, expected)) {
+        fprintf(stderr, "template %lu: unable to encode the reference PDU\n", t);
+        exit(EXIT_FAILURE);
+      }
+      compared++;
+
+      if (patched == NULL || expected.size() != ind_template.size() || memcmp(expected.data(), patched, expected.size()) != 0) {
+        fprintf(stderr, "template %lu: SN %u, header %zu, message %zu, call process ID %zu bytes: "
+                "patched template of %zu bytes differs from the %zu bytes of asn1c\n", t, sn, header.size(),
+                message.size(), cpid.size(), ind_template.size(), expected.size());
+        mismatches++;
+      }
+    }
+  }
+
+  printf("%lu templates, %lu patched PDUs compared, %lu fallbacks to full encoding, %lu mismatches\n",
+         args.templates, compared, fallbacks, mismatches);
+
+  return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,431 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+/*
+  Compares the SCTP transport backends of the E2 simulator on a loopback echo server:
+    blocking  one thread per association, sctp_send_data + sctp_receive_data
+    epoll     all associations on a Reactor, sctp_send_data + sctp_receive_batch
+    uring     all associations on a UringTransport
+
+  Each association runs a number of round trips, sending the next message as soon as the
+  previous one is echoed back. The echo server runs in a child process, so the CPU time
+  reported is only spent by the client side of the backend.
+
+  Build with -DBENCHMARK=1
+*/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/sctp.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+#include "e2sim_sctp.hpp"
+#include "reactor.hpp"
+#include "uring_transport.hpp"
+#include "logger.h"
+
+typedef struct {
+  std::string mode;             // blocking, epoll, uring, or all
+  unsigned int connections;     // number of SCTP associations
+  unsigned long round_trips;    // round trips per association
+  size_t size;                  // bytes of each message
+  int port;                     // port of the echo server
+  unsigned int submit_batch;    // io_uring submission batch
+  unsigned long submit_us;      // io_uring submission wait
+} bench_args_t;
+
+typedef struct {
+  int fd;
+  unsigned long done;                 // round trips finished
+  struct timespec sent;               // time the message in flight has been sent
+  std::vector<unsigned long> rtts;    // round trip times in nanoseconds
+} bench_conn_t;
+
+typedef struct {
+  double seconds;
+  double cpu_seconds;       // user and system time of the client
+  unsigned long syscalls;   // send, receive, and wait syscalls of the client
+  std::vector<unsigned long> rtts;
+} bench_result_t;
+
+static unsigned long elapsed_ns(const struct timespec &start, const struct timespec &end) {
+  return (end.tv_sec - start.tv_sec) * 1000000000UL + end.tv_nsec - start.tv_nsec;
+}
+
+static double cpu_seconds() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+/*
+  Echoes every message back on the same stream of the association it came from
+*/
+static void echo(int fd) {
+  uint8_t buf[MAX_SCTP_BUFFER];
+  struct sctp_sndrcvinfo sinfo;
+  int flags;
+
+  while (true) {
+    flags = 0;
+    int len = sctp_recvmsg(fd, buf, sizeof(buf), NULL, NULL, &sinfo, &flags);
+    if (len <= 0) {
+      break;
+    }
+    if (sctp_sendmsg(fd, buf, len, NULL, 0, sinfo.sinfo_ppid, 0, sinfo.sinfo_stream, 0, 0) == -1) {
+      break;
+    }
+  }
+
+  close(fd);
+}
+
+/*
+  Runs the echo server in a child process and returns its pid once it is listening
+*/
+static pid_t start_echo_server(int port) {
+  int ready[2];
+  if (pipe(ready) == -1) {
+    perror("pipe");
+    exit(EXIT_FAILURE);
+  }
+
+  pid_t pid = fork();
+  if (pid == -1) {
+    perror("fork");
+    exit(EXIT_FAILURE);
+  }
+
+  if (pid == 0) {
+    close(ready[0]);
+    int server_fd = sctp_start_server("127.0.0.1", port);
+    if (write(ready[1], "1", 1) == -1) {
+      exit(EXIT_FAILURE);
+    }
+    close(ready[1]);
+
+    while (true) {
+      int fd = accept(server_fd, NULL, NULL);
+      if (fd == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+        exit(EXIT_FAILURE);
+      }
+      std::thread(echo, fd).detach();
+    }
+  }
+
+  char c;
+  close(ready[1]);
+  if (read(ready[0], &c, 1) != 1) {
+    fprintf(stderr, "echo server has failed to start\n");
+    exit(EXIT_FAILURE);
+  }
+  close(ready[0]);
+
+  return pid;
+}
+
+static bench_result_t run_blocking(std::vector<bench_conn_t> &conns, bench_args_t &args) {
+  bench_result_t result;
+  std::vector<std::thread> threads;
+  std::vector<uint8_t> msg(args.size, 0xE2);
+
+  for (bench_conn_t &conn : conns) {
+    threads.emplace_back([&conn, &msg, &args] {
+      pdu_buffer_t data;
+      pdu_buffer_init(&data);
+      struct timespec recv_ts;
+      for (conn.done = 0; conn.done < args.round_trips; conn.done++) {
+        sctp_send_data(conn.fd, msg.data(), msg.size(), &conn.sent);
+        if (sctp_receive_data(conn.fd, data, &recv_ts) <= 0) {
+          break;
+        }
+        conn.rtts.push_back(elapsed_ns(conn.sent, recv_ts));
+      }
+      pdu_buffer_release(&data);
+    });
+  }
+
+  for (std::thread &th : threads) {
+    th.join();
+  }
+
+  result.syscalls = 0;
+  for (bench_conn_t &conn : conns) {
+    result.syscalls += 2 * conn.done;   // exactly one send and one receive per round trip
+  }
+
+  return result;
+}
+
+static bench_result_t run_epoll(std::vector<bench_conn_t> &conns, bench_args_t &args) {
+  bench_result_t result;
+  std::vector<uint8_t> msg(args.size, 0xE2);
+  std::mutex lock;
+  std::condition_variable finished;
+  unsigned int running = conns.size();
+  std::atomic<unsigned long> calls(0);   // sends and recvmmsg calls, each wake up also costs an epoll_wait
+  std::atomic<unsigned long> wakeups(0);
+
+  Reactor reactor;
+  reactor.start();
+
+  std::vector<sctp_recv_ring_t *> rings;
+  for (bench_conn_t &conn : conns) {
+    sctp_recv_ring_t *ring = sctp_recv_ring_alloc();
+    rings.push_back(ring);
+
+    reactor.add(conn.fd, EPOLLIN, [&, ring](uint32_t events) {
+      wakeups++;
+      calls++;
+      sctp_receive_batch(conn.fd, ring,
+        [&](const uint8_t *buf, size_t len, uint16_t stream, struct timespec *ts, struct timespec *kernel_ts) {
+          conn.rtts.push_back(elapsed_ns(conn.sent, *ts));
+          if (++conn.done < args.round_trips) {
+            calls++;
+            sctp_send_data(conn.fd, msg.data(), msg.size(), &conn.sent);
+          } else {
+            std::lock_guard<std::mutex> guard(lock);
+            running--;
+            finished.notify_one();
+          }
+        });
+    });
+  }
+
+  for (bench_conn_t &conn : conns) {
+    calls++;
+    sctp_send_data(conn.fd, msg.data(), msg.size(), &conn.sent);
+  }
+
+  std::unique_lock<std::mutex> lk(lock);
+  finished.wait(lk, [&running] { return running == 0; });
+  lk.unlock();
+
+  for (bench_conn_t &conn : conns) {
+    reactor.remove(conn.fd);
+  }
+  reactor.stop();
+
+  for (sctp_recv_ring_t *ring : rings) {
+    sctp_recv_ring_free(ring);
+  }
+
+  result.syscalls = calls + wakeups;   // at most one epoll_wait per wake up, fewer if it reports many fds
+  return result;
+}
+
+static bench_result_t run_uring(std::vector<bench_conn_t> &conns, bench_args_t &args) {
+  bench_result_t result;
+  std::vector<uint8_t> msg(args.size, 0xE2);
+  std::mutex lock;
+  std::condition_variable finished;
+  unsigned int running = conns.size();
+
+  UringTransport transport;
+  transport.setSubmitPolicy(args.submit_batch, args.submit_us);
+  transport.start();
+
+  for (bench_conn_t &conn : conns) {
+    transport.add(conn.fd,
+      [&](const uint8_t *buf, size_t len, uint16_t stream, struct timespec *ts, struct timespec *kernel_ts) {
+        conn.rtts.push_back(elapsed_ns(conn.sent, *ts));
+        if (++conn.done < args.round_trips) {
+          transport.send(conn.fd, msg.data(), msg.size(), 0, &conn.sent);
+        } else {
+          std::lock_guard<std::mutex> guard(lock);
+          running--;
+          finished.notify_one();
+        }
+      },
+      nullptr,
+      [&](int error) {
+        fprintf(stderr, "association %d has failed: %s\n", conn.fd, strerror(error));
+        exit(EXIT_FAILURE);
+      });
+  }
+
+  for (bench_conn_t &conn : conns) {
+    transport.send(conn.fd, msg.data(), msg.size(), 0, &conn.sent);
+  }
+
+  std::unique_lock<std::mutex> lk(lock);
+  finished.wait(lk, [&running] { return running == 0; });
+  lk.unlock();
+
+  for (bench_conn_t &conn : conns) {
+    transport.remove(conn.fd);
+  }
+  transport.stop();
+
+  result.syscalls = transport.get_stats().enters;
+  return result;
+}
+
+static void run_mode(const std::string &mode, bench_args_t &args) {
+  std::vector<bench_conn_t> conns(args.connections);
+  for (bench_conn_t &conn : conns) {
+    conn.fd = sctp_start_client("127.0.0.1", args.port);
+    if (conn.fd == -1) {
+      fprintf(stderr, "unable to connect to the echo server\n");
+      exit(EXIT_FAILURE);
+    }
+    conn.done = 0;
+    conn.rtts.reserve(args.round_trips);
+  }
+
+  struct timespec start, end;
+  double cpu_start = cpu_seconds();
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  bench_result_t result;
+  if (mode == "blocking") {
+    result = run_blocking(conns, args);
+  } else if (mode == "epoll") {
+    result = run_epoll(conns, args);
+  } else {
+    result = run_uring(conns, args);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  result.cpu_seconds = cpu_seconds() - cpu_start;
+  result.seconds = elapsed_ns(start, end) / 1e9;
+
+  for (bench_conn_t &conn : conns) {
+    result.rtts.insert(result.rtts.end(), conn.rtts.begin(), conn.rtts.end());
+    close(conn.fd);
+  }
+
+  unsigned long total = result.rtts.size();
+  if (total == 0) {
+    fprintf(stderr, "%s: no round trips\n", mode.c_str());
+    return;
+  }
+  std::sort(result.rtts.begin(), result.rtts.end());
+
+  printf("%-9s %12.0f %12.2f %12.2f %12.2f %12.2f\n", mode.c_str(),
+          total / result.seconds,
+          result.cpu_seconds * 1e6 / total,
+          (double) result.syscalls / total,
+          result.rtts[total / 2] / 1e3,
+          result.rtts[total * 99 / 100] / 1e3);
+}
+
+int main(int argc, char *argv[]) {
+  bench_args_t args;
+  args.mode = "all";
+  args.connections = 8;
+  args.round_trips = 20000;
+  args.size = 256;
+  args.port = 36499;
+  args.submit_batch = URING_SUBMIT_BATCH;
+  args.submit_us = URING_SUBMIT_US;
+
+  int c;
+  while ((c = getopt(argc, argv, "m:c:n:s:p:u:U:h")) != -1) {
+    switch (c) {
+      case 'm':
+        args.mode = optarg;
+        break;
+      case 'c':
+        args.connections = strtoul(optarg, NULL, 10);
+        break;
+      case 'n':
+        args.round_trips = strtoul(optarg, NULL, 10);
+        break;
+      case 's':
+        args.size = strtoul(optarg, NULL, 10);
+        break;
+      case 'p':
+        args.port = atoi(optarg);
+        break;
+      case 'u':
+        args.submit_batch = strtoul(optarg, NULL, 10);
+        break;
+      case 'U':
+        args.submit_us = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        fprintf(stderr,
+          "\nUsage: %s [options]\n\n"
+          "Options:\n"
+          "  -m  Backend: blocking, epoll, uring, or all (default)\n"
+          "  -c  Number of SCTP associations (default 8)\n"
+          "  -n  Round trips per association (default 20000)\n"
+          "  -s  Message size in bytes (default 256)\n"
+          "  -p  Port of the loopback echo server (default 36499)\n"
+          "  -u  Messages queued before an io_uring submission (default %d)\n"
+          "  -U  Maximum time in microseconds a message waits for an io_uring submission (default %d)\n\n",
+          argv[0], URING_SUBMIT_BATCH, URING_SUBMIT_US);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  if (args.size == 0 || args.size > MAX_SCTP_BUFFER || args.connections == 0 || args.round_trips == 0) {
+    fprintf(stderr, "invalid arguments\n");
+    exit(EXIT_FAILURE);
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  pid_t server = start_echo_server(args.port);
+
+  printf("%u associations, %lu round trips each, %zu bytes per message\n\n", args.connections, args.round_trips, args.size);
+  printf("%-9s %12s %12s %12s %12s %12s\n", "backend", "rt/s", "cpu-us/rt", "syscalls/rt", "p50-us", "p99-us");
+
+  std::vector<std::string> modes;
+  if (args.mode == "all") {
+    modes = {"blocking", "epoll", "uring"};
+  } else {
+    modes.push_back(args.mode);
+  }
+
+  for (const std::string &mode : modes) {
+    if (mode != "blocking" && mode != "epoll" && mode != "uring") {
+      fprintf(stderr, "unknown backend %s\n", mode.c_str());
+      continue;
+    }
+    try {
+      run_mode(mode, args);
+    } catch (const std::runtime_error &e) {
+      fprintf(stderr, "%s: %s\n", mode.c_str(), e.what());
+    }
+  }
+
+  kill(server, SIGTERM);
+  waitpid(server, NULL, 0);
+
+  return 0;
+}
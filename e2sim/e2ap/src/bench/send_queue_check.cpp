@@ -0,0 +1,297 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+/*
+  Randomized check of the send queue (see send_queue.hpp) of each policy against a reference queue.
+
+  Random limits and messages of random sizes and E2AP classes are queued the way the simulator does
+  (see E2Sim::queue_message), evicting queued messages until the new one fits or dropping it, and the
+  head is drained at random. The messages evicted or dropped, the messages and bytes in the queue, its
+  limits, and the content and order of the drained messages must match the reference queue of the policy.
+  A queue also has to admit a message larger than its byte limit when it is empty, and limits of 0 have
+  to keep the default ones.
+
+  Build with -DBENCHMARK=1
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <deque>
+#include <vector>
+
+#include "send_queue.hpp"
+#include "e2sim_defs.h"
+
+static const send_queue_policy_e policies[] = {SEND_QUEUE_BLOCK, SEND_QUEUE_DROP_OLDEST, SEND_QUEUE_DROP_NEWEST, SEND_QUEUE_SHED_CLASS};
+
+typedef struct {
+  unsigned long rounds;       // rounds of each policy, each with its own limits
+  unsigned long msgs;         // messages sent on each round
+  unsigned int seed;
+} check_args_t;
+
+// a message of the reference queue
+typedef struct {
+  unsigned long number;       // order in which the message has been sent
+  size_t len;
+  uint16_t msg_class;
+} ref_msg_t;
+
+/*
+  Fills the payload of a message with bytes derived from its number, so drained messages can be told apart
+*/
+static void fill(std::vector<uint8_t> &buf, unsigned long number) {
+  for (size_t i = 0; i < buf.size(); i++) {
+    buf[i] = (uint8_t)(number * 31 + i);
+  }
+}
+
+/*
+  Returns the position of the message the policy evicts to make room for a message of msg_class,
+  or -1 if the policy evicts nothing
+*/
+static long ref_victim(send_queue_policy_e policy, std::deque<ref_msg_t> &ref, uint16_t msg_class) {
+  if (ref.empty()) {
+    return -1;
+  }
+
+  if (policy == SEND_QUEUE_DROP_OLDEST) {
+    return 0;
+  }
+
+  long victim = -1;
+  if (policy == SEND_QUEUE_SHED_CLASS) {
+    for (size_t i = 0; i < ref.size(); i++) {
+      if (ref[i].msg_class >= msg_class && (victim == -1 || ref[i].msg_class > ref[victim].msg_class)) {
+        victim = i;
+      }
+    }
+  }
+
+  return victim;
+}
+
+static unsigned long check_policy(send_queue_policy_e policy, unsigned long round, unsigned long count,
+                                  unsigned long &dropped) {
+  const char *name = send_queue_policy_name(policy);
+  unsigned long mismatches = 0;
+
+  size_t max_messages = 1 + random() % 32;
+  size_t max_bytes = 64 + random() % 4096;
+  size_t ref_bytes = 0;
+
+  SendQueue queue;
+  queue.configure(policy, max_messages, max_bytes);
+  if (queue.get_policy() != policy) {
+    fprintf(stderr, "%s round %lu: queue has the policy %s\n", name, round, send_queue_policy_name(queue.get_policy()));
+    mismatches++;
+  }
+
+  std::deque<ref_msg_t> ref;
+  std::vector<uint8_t> buf;
+  std::vector<uint8_t> expected;
+
+  for (unsigned long n = 0; n < count; n++) {
+    // sizes up to twice the byte limit, so single messages may not fit even in an empty queue
+    size_t len = 1 + random() % (random() % 8 == 0 ? 2 * max_bytes : max_bytes / 4);
+    uint16_t msg_class = random() % 3;    // one of E2AP_STREAM_*
+
+    bool ref_room = ref.empty() || (ref.size() < max_messages && ref_bytes + len <= max_bytes);
+    if (queue.has_room(len) != ref_room) {
+      fprintf(stderr, "%s round %lu: room for %zu bytes is %d with %zu messages and %zu bytes, expected %d\n", name, round,
+              len, !ref_room, ref.size(), ref_bytes, ref_room);
+      mismatches++;
+    }
+
+    bool ref_full = !ref.empty() && (ref.size() >= max_messages || ref_bytes >= max_bytes);
+    if (queue.full() != ref_full) {
+      fprintf(stderr, "%s round %lu: queue full is %d with %zu messages and %zu bytes\n", name, round, !ref_full,
+              ref.size(), ref_bytes);
+      mismatches++;
+    }
+
+    bool admitted = true;
+    if (policy == SEND_QUEUE_BLOCK) {
+      admitted = !ref_full;   // a sender that can wait checks the queue before sending
+
+    } else {
+      while (!(ref.empty() || (ref.size() < max_messages && ref_bytes + len <= max_bytes))) {
+        long victim = ref_victim(policy, ref, msg_class);
+        uint16_t evicted_class = UINT16_MAX;
+        bool evicted = queue.evict(msg_class, evicted_class);
+
+        if (evicted != (victim != -1) || (evicted && evicted_class != ref[victim].msg_class)) {
+          fprintf(stderr, "%s round %lu: message %lu of class %u evicted %s of class %u, expected %s of class %d\n", name,
+                  round, n, msg_class, evicted ? "a message" : "nothing", evicted_class,
+                  victim != -1 ? "message" : "nothing", victim != -1 ? ref[victim].msg_class : -1);
+          mismatches++;
+        }
+
+        if (victim == -1) {
+          admitted = false;
+          break;
+        }
+        ref_bytes -= ref[victim].len;
+        ref.erase(ref.begin() + victim);
+        dropped++;
+      }
+    }
+
+    if (admitted) {
+      buf.resize(len);
+      fill(buf, n);
+      queue.push(buf.data(), buf.size(), msg_class, msg_class, nullptr);
+      ref.push_back({n, len, msg_class});
+      ref_bytes += len;
+    } else {
+      dropped++;
+    }
+
+    if (policy != SEND_QUEUE_BLOCK && ref.size() > 1 && (ref.size() > max_messages || ref_bytes > max_bytes)) {
+      fprintf(stderr, "%s round %lu: %zu messages and %zu bytes exceed the limits of %zu messages and %zu bytes\n", name,
+              round, ref.size(), ref_bytes, max_messages, max_bytes);
+      mismatches++;
+    }
+
+    // drains a few messages, as when the socket buffer has room again
+    unsigned long drained = random() % 4 == 0 ? random() % 8 : 0;
+    for (unsigned long d = 0; d < drained && !ref.empty(); d++) {
+      queued_msg_t &msg = queue.front();
+      expected.resize(ref.front().len);
+      fill(expected, ref.front().number);
+
+      if (msg.data != expected || msg.msg_class != ref.front().msg_class || msg.stream != ref.front().msg_class) {
+        fprintf(stderr, "%s round %lu: head of %zu bytes and class %u is not message %lu of %zu bytes and class %u\n",
+                name, round, msg.data.size(), msg.msg_class, ref.front().number, ref.front().len, ref.front().msg_class);
+        mismatches++;
+      }
+      queue.pop();
+      ref_bytes -= ref.front().len;
+      ref.pop_front();
+    }
+
+    if (queue.size() != ref.size() || queue.bytes() != ref_bytes || queue.empty() != ref.empty()) {
+      fprintf(stderr, "%s round %lu: queue has %zu messages and %zu bytes, expected %zu messages and %zu bytes\n", name,
+              round, queue.size(), queue.bytes(), ref.size(), ref_bytes);
+      mismatches++;
+      break;  // the next comparisons would only repeat this one
+    }
+  }
+
+  queue.clear();
+  if (!queue.empty() || queue.bytes() != 0) {
+    fprintf(stderr, "%s round %lu: queue has %zu messages and %zu bytes after clear\n", name, round, queue.size(), queue.bytes());
+    mismatches++;
+  }
+
+  return mismatches;
+}
+
+/*
+  Checks that limits of 0 keep the default limits, and that an empty queue admits any message
+*/
+static unsigned long check_defaults() {
+  unsigned long mismatches = 0;
+  std::vector<uint8_t> buf(SEND_QUEUE_MAX_BYTES + 1);
+
+  SendQueue queue;
+  queue.configure(SEND_QUEUE_DROP_NEWEST, 0, 0);
+
+  if (!queue.has_room(buf.size())) {
+    fprintf(stderr, "empty queue has no room for %zu bytes\n", buf.size());
+    mismatches++;
+  }
+  queue.push(buf.data(), buf.size(), E2AP_STREAM_INDICATION, E2AP_STREAM_INDICATION, nullptr);
+  if (!queue.full() || queue.has_room(1)) {
+    fprintf(stderr, "queue of %zu bytes is not full with the default byte limit\n", queue.bytes());
+    mismatches++;
+  }
+  queue.clear();
+
+  for (size_t i = 0; i < SEND_QUEUE_MAX_MESSAGES; i++) {
+    if (queue.full()) {
+      fprintf(stderr, "queue is full with %zu messages, default limit is %d\n", queue.size(), SEND_QUEUE_MAX_MESSAGES);
+      mismatches++;
+      break;
+    }
+    queue.push(buf.data(), 1, E2AP_STREAM_INDICATION, E2AP_STREAM_INDICATION, nullptr);
+  }
+  if (!queue.full() || queue.has_room(1)) {
+    fprintf(stderr, "queue is not full with %zu messages, default limit is %d\n", queue.size(), SEND_QUEUE_MAX_MESSAGES);
+    mismatches++;
+  }
+
+  return mismatches;
+}
+
+int main(int argc, char *argv[]) {
+  check_args_t args;
+  args.rounds = 200;
+  args.msgs = 500;
+  args.seed = 1;
+
+  int c;
+  while ((c = getopt(argc, argv, "n:m:S:h")) != -1) {
+    switch (c) {
+      case 'n':
+        args.rounds = strtoul(optarg, NULL, 10);
+        break;
+      case 'm':
+        args.msgs = strtoul(optarg, NULL, 10);
+        break;
+      case 'S':
+        args.seed = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        fprintf(stderr,
+          "\nUsage: %s [options]\n\n"
+          "Options:\n"
+          "  -n  Rounds of each policy, each with random limits (default 200)\n"
+          "  -m  Messages sent on each round (default 500)\n"
+          "  -S  Seed of the random values, to reproduce a failure (default 1)\n\n",
+          argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  if (args.rounds == 0 || args.msgs == 0) {
+    fprintf(stderr, "invalid arguments\n");
+    exit(EXIT_FAILURE);
+  }
+
+  srandom(args.seed);
+
+  unsigned long mismatches = check_defaults();
+
+  for (send_queue_policy_e policy : policies) {
+    unsigned long dropped = 0;
+    unsigned long policy_mismatches = 0;
+
+    for (unsigned long r = 0; r < args.rounds; r++) {
+      policy_mismatches += check_policy(policy, r, args.msgs, dropped);
+    }
+
+    printf("%-12s %lu messages sent, %lu dropped, %lu mismatches\n", send_queue_policy_name(policy),
+           args.rounds * args.msgs, dropped, policy_mismatches);
+    mismatches += policy_mismatches;
+  }
+
+  return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
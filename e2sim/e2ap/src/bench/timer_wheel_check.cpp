@@ -0,0 +1,224 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+/*
+  Randomized check of the timer wheel (see timer_wheel.hpp) against a reference ordered set of timers.
+
+  Runs rounds of random additions, cancellations of pending, taken and cancelled timers, and advances of
+  random lengths, with expirations from a few microseconds to many hours ahead so timers move down across
+  levels. After each advance, the expired timers taken from the wheel must be exactly the reference timers
+  due by then, in the order of their expiration and of their addition for equal expirations, each running
+  its own task. The size and the next deadline of the wheel are also compared on every round.
+
+  Build with -DBENCHMARK=1
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <getopt.h>
+#include <iterator>
+#include <map>
+#include <vector>
+#include <utility>
+
+#include "timer_wheel.hpp"
+
+typedef struct {
+  unsigned long rounds;       // rounds of additions, cancellations and advances
+  unsigned long ops;          // additions and cancellations of each round
+  unsigned int seed;
+} check_args_t;
+
+// reference timers, ordered by expiration and then by addition
+typedef std::pair<uint64_t, unsigned long> timer_key_t;
+
+static uint64_t random64() {
+  return ((uint64_t)random() << 33) ^ ((uint64_t)random() << 16) ^ (uint64_t)random();
+}
+
+/*
+  Returns a random delay, spread over all the levels the wheel uses for the times of the check
+*/
+static uint64_t pick_delay() {
+  switch (random() % 4) {
+    case 0:
+      return random() % 4;                  // already due, or due on the next advances
+    case 1:
+      return random() % TIMER_WHEEL_SLOTS;  // first level
+    default:
+      return random64() & ((1ULL << (1 + random() % 40)) - 1);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  check_args_t args;
+  args.rounds = 20000;
+  args.ops = 16;
+  args.seed = 1;
+
+  int c;
+  while ((c = getopt(argc, argv, "n:o:S:h")) != -1) {
+    switch (c) {
+      case 'n':
+        args.rounds = strtoul(optarg, NULL, 10);
+        break;
+      case 'o':
+        args.ops = strtoul(optarg, NULL, 10);
+        break;
+      case 'S':
+        args.seed = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        fprintf(stderr,
+          "\nUsage: %s [options]\n\n"
+          "Options:\n"
+          "  -n  Rounds of additions, cancellations and advances (default 20000)\n"
+          "  -o  Additions and cancellations of each round (default 16)\n"
+          "  -S  Seed of the random values, to reproduce a failure (default 1)\n\n",
+          argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  if (args.rounds == 0) {
+    fprintf(stderr, "invalid arguments\n");
+    exit(EXIT_FAILURE);
+  }
+
+  srandom(args.seed);
+
+  uint64_t now = random64() & ((1ULL << 48) - 1);
+  TimerWheel wheel(now);
+
+  std::map<timer_key_t, timer_wheel_id_t> pending;          // reference timers
+  std::map<timer_wheel_id_t, timer_key_t> ids;               // keys of the pending ids
+  std::vector<timer_wheel_id_t> released;                    // ids of taken and cancelled timers
+
+  unsigned long added = 0;
+  unsigned long cancelled = 0;
+  unsigned long fired = 0;
+  unsigned long mismatches = 0;
+  unsigned long ran;    // addition number of the last task run
+
+  for (unsigned long r = 0; r < args.rounds; r++) {
+    for (unsigned long o = 0; o < args.ops; o++) {
+      if (pending.empty() || random() % 3 != 0) {
+        uint64_t expires = random() % 8 == 0 ? now - (random() % 4) : now + pick_delay();
+        unsigned long number = added++;
+        timer_key_t key(expires > now ? expires : now + 1, number);   // due timers expire on the next microsecond
+
+        timer_wheel_id_t id = wheel.add(expires, [&ran, number]() { ran = number; });
+        if (id == 0 || ids.count(id)) {
+          fprintf(stderr, "round %lu: timer %lu got the id %llx, which is invalid or pending\n", r, number, (unsigned long long)id);
+          mismatches++;
+          continue;
+        }
+        pending[key] = id;
+        ids[id] = key;
+
+      } else if (released.empty() || random() % 4 != 0) {
+        auto it = ids.begin();
+        std::advance(it, random() % ids.size());
+        timer_wheel_id_t id = it->first;
+
+        if (!wheel.cancel(id)) {
+          fprintf(stderr, "round %lu: unable to cancel the pending timer %lu\n", r, it->second.second);
+          mismatches++;
+        }
+        pending.erase(it->second);
+        ids.erase(it);
+        released.push_back(id);
+        cancelled++;
+
+      } else {
+        timer_wheel_id_t id = released[random() % released.size()];
+        if (wheel.cancel(id)) {
+          fprintf(stderr, "round %lu: cancelled the id %llx, which has already been released\n", r, (unsigned long long)id);
+          mismatches++;
+        }
+      }
+    }
+
+    if (wheel.size() != pending.size()) {
+      fprintf(stderr, "round %lu: wheel has %zu timers, expected %zu\n", r, wheel.size(), pending.size());
+      mismatches++;
+    }
+
+    // the deadline may be a move down of a higher level, but never after the first expiration
+    uint64_t deadline = wheel.next_deadline();
+    if (pending.empty() ? deadline != TIMER_WHEEL_NEVER : (deadline < now || deadline > pending.begin()->first.first)) {
+      fprintf(stderr, "round %lu: next deadline %llu, now %llu, first expiration %llu\n", r, (unsigned long long)deadline,
+              (unsigned long long)now, pending.empty() ? 0ULL : (unsigned long long)pending.begin()->first.first);
+      mismatches++;
+    }
+
+    // advances either to the deadline, as the reactor does, or by a random step that may skip many slots
+    if (random() % 2 && deadline != TIMER_WHEEL_NEVER) {
+      now = deadline;
+    } else {
+      now += pick_delay();
+    }
+    wheel.advance(now);
+
+    timer_wheel_id_t id;
+    TimerTask task;
+    while (wheel.pop_expired(id, task)) {
+      auto it = pending.begin();
+      if (it == pending.end() || it->first.first > now || it->second != id) {
+        fprintf(stderr, "round %lu: took the id %llx at %llu, expected %s %lu\n", r, (unsigned long long)id,
+                (unsigned long long)now, it == pending.end() || it->first.first > now ? "no timer, next" : "timer",
+                it == pending.end() ? 0UL : it->first.second);
+        mismatches++;
+        if (ids.count(id)) {
+          pending.erase(ids[id]);
+          ids.erase(id);
+        }
+        released.push_back(id);
+        continue;
+      }
+
+      ran = ULONG_MAX;
+      task();
+      if (ran != it->first.second) {
+        fprintf(stderr, "round %lu: timer %lu ran the task of timer %lu\n", r, it->first.second, ran);
+        mismatches++;
+      }
+
+      ids.erase(id);
+      pending.erase(it);
+      released.push_back(id);
+      fired++;
+    }
+
+    if (!pending.empty() && pending.begin()->first.first <= now) {
+      fprintf(stderr, "round %lu: timer %lu expired at %llu, not taken at %llu\n", r, pending.begin()->first.second,
+              (unsigned long long)pending.begin()->first.first, (unsigned long long)now);
+      mismatches++;
+    }
+
+    if (released.size() > 4096) {
+      released.erase(released.begin(), released.begin() + 2048);
+    }
+  }
+
+  printf("%lu timers added, %lu cancelled, %lu fired, %zu pending, %lu mismatches\n",
+         added, cancelled, fired, pending.size(), mismatches);
+
+  return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
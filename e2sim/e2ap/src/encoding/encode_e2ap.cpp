@@ -28,6 +28,8 @@
 #include <vector>
 
 #include "encode_e2ap.hpp"
+#include "asn_arena.h"
+#include "validation_policy.hpp"
 
 extern "C" {
 
@@ -209,16 +211,19 @@ void encoding::generate_e2ap_service_update(E2AP_PDU_t *e2ap_pdu, std::vector<en
 
     encoding::ran_func_info nextRanFunc = all_funcs.at(i);
     long nextRanFuncId = nextRanFunc.ranFunctionId;
-    OCTET_STRING_t *nextRanFuncDesc = nextRanFunc.ranFunctionDesc;
+    const OCTET_STRING_t *nextRanFuncDesc = nextRanFunc.ranFunctionDesc;
     long nextRanFuncRev = nextRanFunc.ranFunctionRev;
 
     auto *itemIes = (RANfunction_ItemIEs_t *)calloc(1, sizeof(RANfunction_ItemIEs_t));
     itemIes->id = ProtocolIE_ID_id_RANfunction_Item;
     itemIes->criticality = Criticality_reject;
     itemIes->value.present = RANfunction_ItemIEs__value_PR_RANfunction_Item;
-    itemIes->value.choice.RANfunction_Item.ranFunctionID = 1;
+    itemIes->value.choice.RANfunction_Item.ranFunctionID = nextRanFuncId;
 
-    itemIes->value.choice.RANfunction_Item.ranFunctionDefinition = *nextRanFuncDesc;
+    OCTET_STRING_fromBuf(&itemIes->value.choice.RANfunction_Item.ranFunctionDefinition, (char *)nextRanFuncDesc->buf, nextRanFuncDesc->size);
+    if (nextRanFunc.ranFunctionOId != NULL) {
+      OCTET_STRING_fromBuf(&itemIes->value.choice.RANfunction_Item.ranFunctionOID, (char *)nextRanFunc.ranFunctionOId->buf, nextRanFunc.ranFunctionOId->size);
+    }
     itemIes->value.choice.RANfunction_Item.ranFunctionRevision = nextRanFuncRev + 1;
 
     ASN_SEQUENCE_ADD(&e2serviceUpdateList->value.choice.RANfunctions_List.list, itemIes);
@@ -617,9 +622,141 @@ void encoding::generate_e2ap_subscription_request(E2AP_PDU *e2ap_pdu) {
   }
 }
 
+/*
+  RIC-SUBSCRIPTION-REQUEST of a RAN function with action_count actions of actionType, whose IDs go from 1 to action_count.
+  The event trigger definition is copied into the PDU.
+*/
+void encoding::generate_e2ap_subscription_request_parameterized(E2AP_PDU_t *e2ap_pdu,
+                long requestorId,
+                long instanceId,
+                long ranFunctionId,
+                e_RICactionType actionType,
+                int action_count,
+                const uint8_t *trigger_buf,
+                size_t trigger_length) {
+
+  logger_trace("in function %s", __func__);
+
+  e2ap_pdu->choice.initiatingMessage = (InitiatingMessage_t *) calloc(1, sizeof(InitiatingMessage_t));
+  InitiatingMessage_t *init_msg = e2ap_pdu->choice.initiatingMessage;
+  init_msg->procedureCode = ProcedureCode_id_RICsubscription;
+  init_msg->criticality = Criticality_reject;
+  init_msg->value.present = InitiatingMessage__value_PR_RICsubscriptionRequest;
+  e2ap_pdu->present = E2AP_PDU_PR_initiatingMessage;
+
+  RICsubscriptionRequest_t *sub_req = &init_msg->value.choice.RICsubscriptionRequest;
+
+  RICsubscriptionRequest_IEs_t *req_id = (RICsubscriptionRequest_IEs_t *) calloc(1, sizeof(RICsubscriptionRequest_IEs_t));
+  req_id->id = ProtocolIE_ID_id_RICrequestID;
+  req_id->criticality = Criticality_reject;
+  req_id->value.choice.RICrequestID.ricRequestorID = requestorId;
+  req_id->value.choice.RICrequestID.ricInstanceID = instanceId;
+  req_id->value.present = RICsubscriptionRequest_IEs__value_PR_RICrequestID;
+  ASN_SEQUENCE_ADD(&sub_req->protocolIEs.list, req_id);
+
+  RICsubscriptionRequest_IEs_t *func_id = (RICsubscriptionRequest_IEs_t *) calloc(1, sizeof(RICsubscriptionRequest_IEs_t));
+  func_id->id = ProtocolIE_ID_id_RANfunctionID;
+  func_id->criticality = Criticality_reject;
+  func_id->value.choice.RANfunctionID = ranFunctionId;
+  func_id->value.present = RICsubscriptionRequest_IEs__value_PR_RANfunctionID;
+  ASN_SEQUENCE_ADD(&sub_req->protocolIEs.list, func_id);
+
+  RICsubscriptionRequest_IEs_t *details = (RICsubscriptionRequest_IEs_t *) calloc(1, sizeof(RICsubscriptionRequest_IEs_t));
+  details->id = ProtocolIE_ID_id_RICsubscriptionDetails;
+  details->criticality = Criticality_reject;
+  details->value.present = RICsubscriptionRequest_IEs__value_PR_RICsubscriptionDetails;
+  RICsubscriptionDetails_t *sub_details = &details->value.choice.RICsubscriptionDetails;
+  OCTET_STRING_fromBuf(&sub_details->ricEventTriggerDefinition, (const char *) trigger_buf, trigger_length);
+
+  for (int i = 0; i < action_count; i++) {
+    RICaction_ToBeSetup_ItemIEs_t *action = (RICaction_ToBeSetup_ItemIEs_t *) calloc(1, sizeof(RICaction_ToBeSetup_ItemIEs_t));
+    action->id = ProtocolIE_ID_id_RICaction_ToBeSetup_Item;
+    action->criticality = Criticality_ignore;
+    action->value.choice.RICaction_ToBeSetup_Item.ricActionID = i + 1;
+    action->value.choice.RICaction_ToBeSetup_Item.ricActionType = actionType;
+    action->value.present = RICaction_ToBeSetup_ItemIEs__value_PR_RICaction_ToBeSetup_Item;
+    ASN_SEQUENCE_ADD(&sub_details->ricAction_ToBeSetup_List.list, action);
+  }
+  ASN_SEQUENCE_ADD(&sub_req->protocolIEs.list, details);
+
+  validate_constraints(&asn_DEF_E2AP_PDU, e2ap_pdu);   // according to the validation policy
+
+  if (LOGGER_LEVEL >= LOGGER_DEBUG) {
+    xer_fprint(stderr, &asn_DEF_E2AP_PDU, e2ap_pdu);
+  }
+}
+
+/*
+  RIC-CONTROL-REQUEST of a RAN function with no acknowledgement requested. The call process ID,
+  the control header and the control message are copied into the PDU.
+*/
+void encoding::generate_e2ap_control_request_parameterized(E2AP_PDU_t *e2ap_pdu,
+                long requestorId,
+                long instanceId,
+                long ranFunctionId,
+                const OCTET_STRING_t *call_proc_id,
+                const uint8_t *ctrl_header_buf,
+                size_t header_length,
+                const uint8_t *ctrl_message_buf,
+                size_t message_length) {
+
+  logger_trace("in function %s", __func__);
+
+  e2ap_pdu->choice.initiatingMessage = (InitiatingMessage_t *) calloc(1, sizeof(InitiatingMessage_t));
+  InitiatingMessage_t *init_msg = e2ap_pdu->choice.initiatingMessage;
+  init_msg->procedureCode = ProcedureCode_id_RICcontrol;
+  init_msg->criticality = Criticality_reject;
+  init_msg->value.present = InitiatingMessage__value_PR_RICcontrolRequest;
+  e2ap_pdu->present = E2AP_PDU_PR_initiatingMessage;
+
+  RICcontrolRequest_t *ctrl_req = &init_msg->value.choice.RICcontrolRequest;
+
+  RICcontrolRequest_IEs_t *req_id = (RICcontrolRequest_IEs_t *) calloc(1, sizeof(RICcontrolRequest_IEs_t));
+  req_id->id = ProtocolIE_ID_id_RICrequestID;
+  req_id->criticality = Criticality_reject;
+  req_id->value.choice.RICrequestID.ricRequestorID = requestorId;
+  req_id->value.choice.RICrequestID.ricInstanceID = instanceId;
+  req_id->value.present = RICcontrolRequest_IEs__value_PR_RICrequestID;
+  ASN_SEQUENCE_ADD(&ctrl_req->protocolIEs.list, req_id);
+
+  RICcontrolRequest_IEs_t *func_id = (RICcontrolRequest_IEs_t *) calloc(1, sizeof(RICcontrolRequest_IEs_t));
+  func_id->id = ProtocolIE_ID_id_RANfunctionID;
+  func_id->criticality = Criticality_reject;
+  func_id->value.choice.RANfunctionID = ranFunctionId;
+  func_id->value.present = RICcontrolRequest_IEs__value_PR_RANfunctionID;
+  ASN_SEQUENCE_ADD(&ctrl_req->protocolIEs.list, func_id);
+
+  RICcontrolRequest_IEs_t *cpid = (RICcontrolRequest_IEs_t *) calloc(1, sizeof(RICcontrolRequest_IEs_t));
+  cpid->id = ProtocolIE_ID_id_RICcallProcessID;
+  cpid->criticality = Criticality_reject;
+  OCTET_STRING_fromBuf(&cpid->value.choice.RICcallProcessID, (const char *) call_proc_id->buf, call_proc_id->size);
+  cpid->value.present = RICcontrolRequest_IEs__value_PR_RICcallProcessID;
+  ASN_SEQUENCE_ADD(&ctrl_req->protocolIEs.list, cpid);
+
+  RICcontrolRequest_IEs_t *header = (RICcontrolRequest_IEs_t *) calloc(1, sizeof(RICcontrolRequest_IEs_t));
+  header->id = ProtocolIE_ID_id_RICcontrolHeader;
+  header->criticality = Criticality_reject;
+  OCTET_STRING_fromBuf(&header->value.choice.RICcontrolHeader, (const char *) ctrl_header_buf, header_length);
+  header->value.present = RICcontrolRequest_IEs__value_PR_RICcontrolHeader;
+  ASN_SEQUENCE_ADD(&ctrl_req->protocolIEs.list, header);
+
+  RICcontrolRequest_IEs_t *message = (RICcontrolRequest_IEs_t *) calloc(1, sizeof(RICcontrolRequest_IEs_t));
+  message->id = ProtocolIE_ID_id_RICcontrolMessage;
+  message->criticality = Criticality_reject;
+  OCTET_STRING_fromBuf(&message->value.choice.RICcontrolMessage, (const char *) ctrl_message_buf, message_length);
+  message->value.present = RICcontrolRequest_IEs__value_PR_RICcontrolMessage;
+  ASN_SEQUENCE_ADD(&ctrl_req->protocolIEs.list, message);
+
+  validate_constraints(&asn_DEF_E2AP_PDU, e2ap_pdu);   // according to the validation policy
+
+  if (LOGGER_LEVEL >= LOGGER_DEBUG) {
+    xer_fprint(stderr, &asn_DEF_E2AP_PDU, e2ap_pdu);
+  }
+}
+
 void encoding::generate_e2ap_subscription_response_success(E2AP_PDU *e2ap_pdu, long reqActionIdsAccepted[],
 						   long reqActionIdsRejected[], int accept_size, int reject_size,
-						   long reqRequestorId, long reqInstanceId) {
+						   long reqRequestorId, long reqInstanceId, long ranFunctionId) {
 
   logger_trace("in function %s", __func__);
 
@@ -638,7 +775,7 @@ void encoding::generate_e2ap_subscription_response_success(E2AP_PDU *e2ap_pdu, l
   respfuncid->id = ProtocolIE_ID_id_RANfunctionID;
   respfuncid->criticality = 0;
   respfuncid->value.present = RICsubscriptionResponse_IEs__value_PR_RANfunctionID;
-  respfuncid->value.choice.RANfunctionID = (long)0;
+  respfuncid->value.choice.RANfunctionID = ranFunctionId;
 
 
   RICsubscriptionResponse_IEs_t *ricactionadmitted =
@@ -1010,14 +1147,14 @@ void encoding::generate_e2ap_indication_request_parameterized(E2AP_PDU *e2ap_pdu
 
   logger_trace("in function %s", __func__);
 
-  RICindication_IEs_t *ricind_ies = (RICindication_IEs_t*)calloc(1, sizeof(RICindication_IEs_t));
-  RICindication_IEs_t *ricind_ies2 = (RICindication_IEs_t*)calloc(1, sizeof(RICindication_IEs_t));
-  RICindication_IEs_t *ricind_ies3 = (RICindication_IEs_t*)calloc(1, sizeof(RICindication_IEs_t));
-  RICindication_IEs_t *ricind_ies4 = (RICindication_IEs_t*)calloc(1, sizeof(RICindication_IEs_t));
-  RICindication_IEs_t *ricind_ies5 = (RICindication_IEs_t*)calloc(1, sizeof(RICindication_IEs_t));
-  RICindication_IEs_t *ricind_ies6 = (RICindication_IEs_t*)calloc(1, sizeof(RICindication_IEs_t));
-  RICindication_IEs_t *ricind_ies7 = (RICindication_IEs_t*)calloc(1, sizeof(RICindication_IEs_t));
-  RICindication_IEs_t *ricind_ies8 = (RICindication_IEs_t*)calloc(1, sizeof(RICindication_IEs_t));
+  RICindication_IEs_t *ricind_ies = (RICindication_IEs_t*)asn_arena_calloc(1, sizeof(RICindication_IEs_t));
+  RICindication_IEs_t *ricind_ies2 = (RICindication_IEs_t*)asn_arena_calloc(1, sizeof(RICindication_IEs_t));
+  RICindication_IEs_t *ricind_ies3 = (RICindication_IEs_t*)asn_arena_calloc(1, sizeof(RICindication_IEs_t));
+  RICindication_IEs_t *ricind_ies4 = (RICindication_IEs_t*)asn_arena_calloc(1, sizeof(RICindication_IEs_t));
+  RICindication_IEs_t *ricind_ies5 = (RICindication_IEs_t*)asn_arena_calloc(1, sizeof(RICindication_IEs_t));
+  RICindication_IEs_t *ricind_ies6 = (RICindication_IEs_t*)asn_arena_calloc(1, sizeof(RICindication_IEs_t));
+  RICindication_IEs_t *ricind_ies7 = (RICindication_IEs_t*)asn_arena_calloc(1, sizeof(RICindication_IEs_t));
+  RICindication_IEs_t *ricind_ies8 = (RICindication_IEs_t*)asn_arena_calloc(1, sizeof(RICindication_IEs_t));
 
   RICindication_IEs__value_PR pres3;
 
@@ -1052,16 +1189,18 @@ void encoding::generate_e2ap_indication_request_parameterized(E2AP_PDU *e2ap_pdu
   ricind_ies5->value.present = pres3;
   ricind_ies5->value.choice.RICindicationType = indicationType;
 
-  ricind_ies6->value.choice.RICindicationHeader.buf = (uint8_t*)calloc(1,header_length);
+  ricind_ies6->value.choice.RICindicationHeader.buf = (uint8_t*)asn_arena_calloc(1,header_length);
 
   pres3 = RICindication_IEs__value_PR_RICindicationHeader;
   ricind_ies6->id = ProtocolIE_ID_id_RICindicationHeader;
   ricind_ies6->criticality = 0;
   ricind_ies6->value.present = pres3;
   ricind_ies6->value.choice.RICindicationHeader.size = header_length;
-  memcpy(ricind_ies6->value.choice.RICindicationHeader.buf, ind_header_buf, header_length);
+  if (header_length > 0) {   // an empty buffer might be NULL
+    memcpy(ricind_ies6->value.choice.RICindicationHeader.buf, ind_header_buf, header_length);
+  }
 
-  ricind_ies7->value.choice.RICindicationMessage.buf = (uint8_t*)calloc(1,8192);
+  ricind_ies7->value.choice.RICindicationMessage.buf = (uint8_t*)asn_arena_calloc(1,message_length);
 
   pres3 = RICindication_IEs__value_PR_RICindicationMessage;
   ricind_ies7->id = ProtocolIE_ID_id_RICindicationMessage;
@@ -1069,7 +1208,9 @@ void encoding::generate_e2ap_indication_request_parameterized(E2AP_PDU *e2ap_pdu
   ricind_ies7->value.present = pres3;
 
   ricind_ies7->value.choice.RICindicationMessage.size = message_length;
-  memcpy(ricind_ies7->value.choice.RICindicationMessage.buf, ind_message_buf, message_length);
+  if (message_length > 0) {
+    memcpy(ricind_ies7->value.choice.RICindicationMessage.buf, ind_message_buf, message_length);
+  }
 
   uint8_t *cpid_buf = (uint8_t *)"cpid";
   OCTET_STRING_t cpid_str;
@@ -1081,12 +1222,12 @@ void encoding::generate_e2ap_indication_request_parameterized(E2AP_PDU *e2ap_pdu
   ricind_ies8->criticality = 0;
   ricind_ies8->value.present = pres3;
 
-  ricind_ies8->value.choice.RICcallProcessID.buf = (uint8_t*)calloc(1,cpid_buf_len);
+  ricind_ies8->value.choice.RICcallProcessID.buf = (uint8_t*)asn_arena_calloc(1,cpid_buf_len);
   ricind_ies8->value.choice.RICcallProcessID.size = cpid_buf_len;
 
   memcpy(ricind_ies8->value.choice.RICcallProcessID.buf, cpid_buf, cpid_buf_len);
 
-  RICindication_t *ricindication = (RICindication_t*)calloc(1, sizeof(RICindication_t));
+  RICindication_t *ricindication = (RICindication_t*)asn_arena_calloc(1, sizeof(RICindication_t));
 
   ASN_SEQUENCE_ADD(&ricindication->protocolIEs.list, ricind_ies);
   ASN_SEQUENCE_ADD(&ricindication->protocolIEs.list, ricind_ies2);
@@ -1099,25 +1240,20 @@ void encoding::generate_e2ap_indication_request_parameterized(E2AP_PDU *e2ap_pdu
 
   InitiatingMessage__value_PR pres4;
   pres4 = InitiatingMessage__value_PR_RICindication;
-  InitiatingMessage_t *initmsg = (InitiatingMessage_t*)calloc(1, sizeof(InitiatingMessage_t));
+  InitiatingMessage_t *initmsg = (InitiatingMessage_t*)asn_arena_calloc(1, sizeof(InitiatingMessage_t));
   initmsg->procedureCode = 5;
   initmsg->criticality = 1;
   initmsg->value.present = pres4;
   initmsg->value.choice.RICindication = *ricindication;
-  if (ricindication) free(ricindication);
+  if (ricindication) asn_arena_free(ricindication);
 
   E2AP_PDU_PR pres5;
   pres5 = E2AP_PDU_PR_initiatingMessage;
 
   e2ap_pdu->present = pres5;
   e2ap_pdu->choice.initiatingMessage = initmsg;
-  char error_buf[300] = {0, };
-  size_t errlen = 0;
 
-  int ret = asn_check_constraints(&asn_DEF_E2AP_PDU, e2ap_pdu, error_buf, &errlen);
-  if (ret != 0) {
-    logger_error("E2AP_PDU check constraints failed. error length = %lu, error buf = %s", errlen, error_buf);
-  }
+  validate_constraints(&asn_DEF_E2AP_PDU, e2ap_pdu);   // according to the validation policy
 
   if (LOGGER_LEVEL >= LOGGER_DEBUG) {
     xer_fprint(stderr, &asn_DEF_E2AP_PDU, e2ap_pdu);
@@ -1137,11 +1273,47 @@ void encoding::generate_e2ap_indication_request_parameterized(E2AP_PDU_t *e2ap_p
 								int message_length,
                 OCTET_STRING_t *call_proc_id) {
 
+  OCTET_STRING_t header;
+  memset(&header, 0, sizeof(header));
+  header.buf = (uint8_t *) asn_arena_calloc(header_length, sizeof(uint8_t));
+  header.size = header_length;
+  if (header_length > 0) {   // an empty buffer might be NULL
+    memcpy(header.buf, ind_header_buf, header_length);
+  }
+
+  OCTET_STRING_t message;
+  memset(&message, 0, sizeof(message));
+  message.buf = (uint8_t *) asn_arena_calloc(message_length, sizeof(uint8_t));
+  message.size = message_length;
+  if (message_length > 0) {
+    memcpy(message.buf, ind_message_buf, message_length);
+  }
+
+  generate_e2ap_indication_request_parameterized(e2ap_pdu, indicationType, requestorId, instanceId, ranFunctionId, actionId,
+                                                 seqNum, &header, &message, call_proc_id);
+}
+
+/*
+  Same as the overload above, but the buffers of ind_header and ind_message are moved into the PDU instead of copied,
+  and both are left empty. Their buffers must be releasable with FREEMEM, e.g. allocated by encode_to_octet_string.
+  Within an arena scope this writes the E2SM payload once, straight into the memory the PDU is encoded from.
+*/
+void encoding::generate_e2ap_indication_request_parameterized(E2AP_PDU_t *e2ap_pdu,
+                e_RICindicationType indicationType,
+                long requestorId,
+                long instanceId,
+                long ranFunctionId,
+                long actionId,
+                uint16_t seqNum,
+                OCTET_STRING_t *ind_header,
+                OCTET_STRING_t *ind_message,
+                OCTET_STRING_t *call_proc_id) {
+
   logger_trace("in function %s", __func__);
 
   // Implements E2AP-v02.01
 
-  e2ap_pdu->choice.initiatingMessage = (InitiatingMessage_t *) calloc(1, sizeof(InitiatingMessage_t));
+  e2ap_pdu->choice.initiatingMessage = (InitiatingMessage_t *) asn_arena_calloc(1, sizeof(InitiatingMessage_t));
   InitiatingMessage_t *init_msg = e2ap_pdu->choice.initiatingMessage;
   ASN_STRUCT_RESET(asn_DEF_InitiatingMessage, init_msg);
   init_msg->procedureCode = ProcedureCode_id_RICindication;
@@ -1151,7 +1323,7 @@ void encoding::generate_e2ap_indication_request_parameterized(E2AP_PDU_t *e2ap_p
 
   RICindication_t *ric_indication = &init_msg->value.choice.RICindication;
 
-  RICindication_IEs_t *req_id = (RICindication_IEs_t *) calloc(1, sizeof(RICindication_IEs_t));
+  RICindication_IEs_t *req_id = (RICindication_IEs_t *) asn_arena_calloc(1, sizeof(RICindication_IEs_t));
   req_id->id = ProtocolIE_ID_id_RICrequestID;
   req_id->criticality = Criticality_reject;
   req_id->value.choice.RICrequestID.ricRequestorID = requestorId;
@@ -1159,68 +1331,62 @@ void encoding::generate_e2ap_indication_request_parameterized(E2AP_PDU_t *e2ap_p
   req_id->value.present = RICindication_IEs__value_PR_RICrequestID;
   ASN_SEQUENCE_ADD(&ric_indication->protocolIEs.list, req_id);
 
-  RICindication_IEs_t *func_id = (RICindication_IEs_t *) calloc(1, sizeof(RICindication_IEs_t));
+  RICindication_IEs_t *func_id = (RICindication_IEs_t *) asn_arena_calloc(1, sizeof(RICindication_IEs_t));
   func_id->id = ProtocolIE_ID_id_RANfunctionID;
   func_id->criticality = Criticality_reject;
   func_id->value.choice.RANfunctionID = ranFunctionId;
   func_id->value.present = RICindication_IEs__value_PR_RANfunctionID;
   ASN_SEQUENCE_ADD(&ric_indication->protocolIEs.list, func_id);
 
-  RICindication_IEs_t *action_id = (RICindication_IEs_t *) calloc(1, sizeof(RICindication_IEs_t));
+  RICindication_IEs_t *action_id = (RICindication_IEs_t *) asn_arena_calloc(1, sizeof(RICindication_IEs_t));
   action_id->id = ProtocolIE_ID_id_RICactionID;
   action_id->criticality = Criticality_reject;
   action_id->value.choice.RICactionID = actionId;
   action_id->value.present = RICindication_IEs__value_PR_RICactionID;
   ASN_SEQUENCE_ADD(&ric_indication->protocolIEs.list, action_id);
 
-  RICindication_IEs_t *seq_num = (RICindication_IEs_t *) calloc(1, sizeof(RICindication_IEs_t));
+  RICindication_IEs_t *seq_num = (RICindication_IEs_t *) asn_arena_calloc(1, sizeof(RICindication_IEs_t));
   seq_num->id = ProtocolIE_ID_id_RICindicationSN;
   seq_num->criticality = Criticality_reject;
   seq_num->value.choice.RICindicationSN = seqNum; // 0..65535
   seq_num->value.present = RICindication_IEs__value_PR_RICindicationSN;
   ASN_SEQUENCE_ADD(&ric_indication->protocolIEs.list, seq_num);
 
-  RICindication_IEs_t *ind_type = (RICindication_IEs_t *) calloc(1, sizeof(RICindication_IEs_t));
+  RICindication_IEs_t *ind_type = (RICindication_IEs_t *) asn_arena_calloc(1, sizeof(RICindication_IEs_t));
   ind_type->id = ProtocolIE_ID_id_RICindicationType;
   ind_type->criticality = Criticality_reject;
   ind_type->value.choice.RICindicationType = indicationType;
   ind_type->value.present = RICindication_IEs__value_PR_RICindicationType;
   ASN_SEQUENCE_ADD(&ric_indication->protocolIEs.list, ind_type);
 
-  RICindication_IEs_t *header = (RICindication_IEs_t *) calloc(1, sizeof(RICindication_IEs_t));
+  RICindication_IEs_t *header = (RICindication_IEs_t *) asn_arena_calloc(1, sizeof(RICindication_IEs_t));
   header->id = ProtocolIE_ID_id_RICindicationHeader;
   header->criticality = Criticality_reject;
-  header->value.choice.RICindicationHeader.buf = (uint8_t *) calloc(header_length, sizeof(uint8_t));
-  header->value.choice.RICindicationHeader.size = header_length;
-  memcpy(header->value.choice.RICindicationHeader.buf, ind_header_buf, header_length);
+  header->value.choice.RICindicationHeader = *ind_header;
+  memset(ind_header, 0, sizeof(OCTET_STRING_t));
   header->value.present = RICindication_IEs__value_PR_RICindicationHeader;
   ASN_SEQUENCE_ADD(&ric_indication->protocolIEs.list, header);
 
-  RICindication_IEs_t *message = (RICindication_IEs_t *) calloc(1, sizeof(RICindication_IEs_t));
+  RICindication_IEs_t *message = (RICindication_IEs_t *) asn_arena_calloc(1, sizeof(RICindication_IEs_t));
   message->id = ProtocolIE_ID_id_RICindicationMessage;
   message->criticality = Criticality_reject;
-  message->value.choice.RICindicationMessage.buf = (uint8_t *) calloc(message_length, sizeof(uint8_t));
-  message->value.choice.RICindicationMessage.size = message_length;
-  memcpy(message->value.choice.RICindicationMessage.buf, ind_message_buf, message_length);
+  message->value.choice.RICindicationMessage = *ind_message;
+  memset(ind_message, 0, sizeof(OCTET_STRING_t));
   message->value.present = RICindication_IEs__value_PR_RICindicationMessage;
   ASN_SEQUENCE_ADD(&ric_indication->protocolIEs.list, message);
 
-  RICindication_IEs_t *cpid = (RICindication_IEs_t *) calloc(1, sizeof(RICindication_IEs_t));
+  RICindication_IEs_t *cpid = (RICindication_IEs_t *) asn_arena_calloc(1, sizeof(RICindication_IEs_t));
   cpid->id = ProtocolIE_ID_id_RICcallProcessID;
   cpid->criticality = Criticality_reject;
-  cpid->value.choice.RICcallProcessID.buf = (uint8_t *) calloc(call_proc_id->size, sizeof(uint8_t));
+  cpid->value.choice.RICcallProcessID.buf = (uint8_t *) asn_arena_calloc(call_proc_id->size, sizeof(uint8_t));
   cpid->value.choice.RICcallProcessID.size = call_proc_id->size;
-  memcpy(cpid->value.choice.RICcallProcessID.buf, call_proc_id->buf, call_proc_id->size);
+  if (call_proc_id->size > 0) {   // an empty buffer might be NULL
+    memcpy(cpid->value.choice.RICcallProcessID.buf, call_proc_id->buf, call_proc_id->size);
+  }
   cpid->value.present = RICindication_IEs__value_PR_RICcallProcessID;
   ASN_SEQUENCE_ADD(&ric_indication->protocolIEs.list, cpid);
 
-  char error_buf[300] = {0, };
-  size_t errlen = 0;
-
-  int ret = asn_check_constraints(&asn_DEF_E2AP_PDU, e2ap_pdu, error_buf, &errlen);
-  if (ret != 0) {
-    logger_error("E2AP_PDU check constraints failed. error length = %lu, error buf = %s", errlen, error_buf);
-  }
+  validate_constraints(&asn_DEF_E2AP_PDU, e2ap_pdu);   // according to the validation policy
 
   logger_debug("E2AP indication request PDU encoded");
 
@@ -1229,6 +1395,48 @@ void encoding::generate_e2ap_indication_request_parameterized(E2AP_PDU_t *e2ap_p
   }
 }
 
+/*
+  APER-encodes sptr into the buffer of ostr, which is allocated with MALLOC, so it comes from the arena of
+  the calling thread within an arena scope. The buffer starts at ENCODE_OSTR_GUESS bytes, with no zeroing,
+  and is trimmed to the encoded size, which takes no copy as arena memory shrinks in place.
+  Larger encodings are encoded again, only once, in a buffer of their size.
+  The previous contents of ostr are overwritten, not released.
+
+  Returns false on error, then ostr is left untouched
+*/
+bool encoding::encode_to_octet_string(const asn_TYPE_descriptor_t *type, const void *sptr, OCTET_STRING_t *ostr) {
+  size_t size = ENCODE_OSTR_GUESS;
+  uint8_t *buf = (uint8_t *) asn_arena_malloc(size);
+  if (buf == NULL) {
+    return false;
+  }
+
+  asn_enc_rval_t er = asn_encode_to_buffer(NULL, ATS_ALIGNED_BASIC_PER, type, sptr, buf, size);
+
+  if (er.encoded > 0 && (size_t) er.encoded > size) {
+    // the encoder reports the required size when the buffer is too small
+    asn_arena_free(buf);
+    size = er.encoded;
+    buf = (uint8_t *) asn_arena_malloc(size);
+    if (buf == NULL) {
+      return false;
+    }
+    er = asn_encode_to_buffer(NULL, ATS_ALIGNED_BASIC_PER, type, sptr, buf, size);
+  }
+
+  if (er.encoded <= 0 || (size_t) er.encoded > size) {
+    logger_error("[E2AP ASN] Unable to encode %s", er.failed_type ? er.failed_type->name : type->name);
+    asn_arena_free(buf);
+    return false;
+  }
+
+  memset(ostr, 0, sizeof(OCTET_STRING_t));
+  ostr->buf = (uint8_t *) asn_arena_realloc(buf, er.encoded);
+  ostr->size = er.encoded;
+
+  return true;
+}
+
 void encoding::generate_e2ap_removal_request(E2AP_PDU_t *e2ap_pdu) {
   logger_trace("in function %s", __func__);
 
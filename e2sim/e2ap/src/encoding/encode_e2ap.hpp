@@ -29,19 +29,22 @@ extern "C" {
   #include "OCTET_STRING.h"
   #include "RANfunctionOID.h"
   #include "RICindicationType.h"
+  #include "RICactionType.h"
   #include "Cause.h"
   #include "CriticalityDiagnostics.h"
   #include "BIT_STRING.h"
   #include "PLMN-Identity.h"
 }
 
+#define ENCODE_OSTR_GUESS 1024   // first guess of the size of a nested encoding (see encode_to_octet_string)
+
 namespace encoding {
 
   struct ran_func_info {
     long ranFunctionId;
-    OCTET_STRING_t *ranFunctionDesc;
+    const OCTET_STRING_t *ranFunctionDesc;  // copied into the PDU, as it can be shared by many E2Sims
     long ranFunctionRev;
-    RANfunctionOID_t *ranFunctionOId;
+    const RANfunctionOID_t *ranFunctionOId;
   };
 
   long get_function_id_from_subscription(E2AP_PDU_t *e2ap_pdu);
@@ -56,9 +59,13 @@ namespace encoding {
 
   void generate_e2ap_subscription_request(E2AP_PDU_t *sub_req_pdu);
 
+  void generate_e2ap_subscription_request_parameterized(E2AP_PDU_t *e2ap_pdu, long requestorId, long instanceId, long ranFunctionId, e_RICactionType actionType, int action_count, const uint8_t *trigger_buf, size_t trigger_length);
+
+  void generate_e2ap_control_request_parameterized(E2AP_PDU_t *e2ap_pdu, long requestorId, long instanceId, long ranFunctionId, const OCTET_STRING_t *call_proc_id, const uint8_t *ctrl_header_buf, size_t header_length, const uint8_t *ctrl_message_buf, size_t message_length);
+
   void generate_e2ap_subscription_response(E2AP_PDU_t *sub_resp_pdu, E2AP_PDU_t *sub_req_pdu);
 
-  void generate_e2ap_subscription_response_success(E2AP_PDU *e2ap_pdu, long reqActionIdsAccepted[], long reqActionIdsRejected[], int accept_size, int reject_size, long reqRequestorId, long reqInstanceId);
+  void generate_e2ap_subscription_response_success(E2AP_PDU *e2ap_pdu, long reqActionIdsAccepted[], long reqActionIdsRejected[], int accept_size, int reject_size, long reqRequestorId, long reqInstanceId, long ranFunctionId);
 
   void generate_e2ap_subscription_response_failure(E2AP_PDU *e2ap_pdu, long reqRequestorId, long reqInstanceId, long func_id, Cause_t *cause, CriticalityDiagnostics_t *crit_diagnostics);
 
@@ -68,6 +75,10 @@ namespace encoding {
 
   void generate_e2ap_indication_request_parameterized(E2AP_PDU *e2ap_pdu, e_RICindicationType indicationType, long requestorId, long instanceId, long ranFunctionId, long actionId, uint16_t seqNum, uint8_t *ind_header_buf, int header_length, uint8_t *ind_message_buf, int message_length, OCTET_STRING_t *call_proc_id);
 
+  void generate_e2ap_indication_request_parameterized(E2AP_PDU *e2ap_pdu, e_RICindicationType indicationType, long requestorId, long instanceId, long ranFunctionId, long actionId, uint16_t seqNum, OCTET_STRING_t *ind_header, OCTET_STRING_t *ind_message, OCTET_STRING_t *call_proc_id);
+
+  bool encode_to_octet_string(const asn_TYPE_descriptor_t *type, const void *sptr, OCTET_STRING_t *ostr);
+
   void generate_e2ap_service_update(E2AP_PDU_t *e2ap_pdu, std::vector<ran_func_info> all_funcs);
 
   void generate_e2ap_config_update(E2AP_PDU_t *e2ap_edu);
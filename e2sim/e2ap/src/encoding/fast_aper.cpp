@@ -0,0 +1,364 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#include <string.h>
+
+#include "fast_aper.hpp"
+
+extern "C" {
+  #include "E2AP-PDU.h"
+  #include "ProtocolIE-ID.h"
+  #include "ProcedureCode.h"
+  #include "Criticality.h"
+}
+
+#ifdef FAST_APER_CROSSCHECK
+#include <vector>
+#include <stdlib.h>
+#include "encode_e2ap.hpp"
+#include "logger.h"
+#endif
+
+#define APER_MAX_LENGTH   16383   // largest length determinant written without fragmentation
+#define APER_MAX_ADMITTED 16      // maxofRICactionID
+
+// APER layout of the value of a protocol IE
+typedef enum {
+  IE_REQUEST_ID,      // RICrequestID
+  IE_INTEGER,         // constrained whole number from 0 to ub, where ub is 255 or above (i.e. whole octets)
+  IE_ENUMERATED,      // extensible enumerated whose root has values from 0 to ub, up to 1 (e.g. RICindicationType)
+  IE_OCTET_STRING,    // unconstrained OCTET STRING
+  IE_ADMITTED_LIST    // RICaction-Admitted-List
+} ie_layout_e;
+
+typedef struct {
+  long id;
+  long criticality;
+  ie_layout_e layout;
+  long ub;
+} ie_desc_t;
+
+typedef struct {
+  long procedure;
+  long criticality;
+  E2AP_PDU_PR present;  // initiating message or successful outcome
+} msg_desc_t;
+
+// value of a protocol IE, read according to the layout of its descriptor
+typedef struct {
+  long value;           // integer and enumerated values, or the requestor ID of a RICrequestID
+  long instance;        // instance ID of a RICrequestID
+  const uint8_t *buf;   // contents of an OCTET STRING
+  const long *actions;  // action IDs of an admitted list
+  size_t len;           // bytes of an OCTET STRING, or number of action IDs
+} ie_value_t;
+
+constexpr msg_desc_t ric_indication = {
+  ProcedureCode_id_RICindication, Criticality_reject, E2AP_PDU_PR_initiatingMessage
+};
+constexpr msg_desc_t ric_subscription_response = {
+  ProcedureCode_id_RICsubscription, Criticality_reject, E2AP_PDU_PR_successfulOutcome
+};
+constexpr msg_desc_t ric_subscription_delete_response = {
+  ProcedureCode_id_RICsubscriptionDelete, Criticality_reject, E2AP_PDU_PR_successfulOutcome
+};
+
+constexpr ie_desc_t ie_request_id = {ProtocolIE_ID_id_RICrequestID, Criticality_reject, IE_REQUEST_ID, 65535};
+constexpr ie_desc_t ie_function_id = {ProtocolIE_ID_id_RANfunctionID, Criticality_reject, IE_INTEGER, 4095};
+constexpr ie_desc_t ie_action_id = {ProtocolIE_ID_id_RICactionID, Criticality_reject, IE_INTEGER, 255};
+constexpr ie_desc_t ie_indication_sn = {ProtocolIE_ID_id_RICindicationSN, Criticality_reject, IE_INTEGER, 65535};
+constexpr ie_desc_t ie_indication_type = {ProtocolIE_ID_id_RICindicationType, Criticality_reject, IE_ENUMERATED, 1};
+constexpr ie_desc_t ie_indication_header = {ProtocolIE_ID_id_RICindicationHeader, Criticality_reject, IE_OCTET_STRING, 0};
+constexpr ie_desc_t ie_indication_message = {ProtocolIE_ID_id_RICindicationMessage, Criticality_reject, IE_OCTET_STRING, 0};
+constexpr ie_desc_t ie_call_process_id = {ProtocolIE_ID_id_RICcallProcessID, Criticality_reject, IE_OCTET_STRING, 0};
+constexpr ie_desc_t ie_actions_admitted = {ProtocolIE_ID_id_RICactions_Admitted, Criticality_reject, IE_ADMITTED_LIST, 255};
+
+static inline bool in_range(long value, long ub) {
+  return value >= 0 && value <= ub;
+}
+
+static inline size_t length_size(size_t len) {
+  return len < 128 ? 1 : 2;
+}
+
+static inline uint8_t *put_u16(uint8_t *p, unsigned long value) {
+  p[0] = (uint8_t) (value >> 8);
+  p[1] = (uint8_t) value;
+  return p + 2;
+}
+
+/*
+  Writes an aligned length determinant of an unconstrained length, which must be below 16K
+*/
+static inline uint8_t *put_length(uint8_t *p, size_t len) {
+  if (len < 128) {
+    *p = (uint8_t) len;
+    return p + 1;
+  }
+  return put_u16(p, 0x8000 | len);
+}
+
+/*
+  Returns the size of the encoding of the value of an IE of descriptor D, or 0 if v is out of its range
+*/
+template <const ie_desc_t &D>
+static inline size_t value_size(const ie_value_t &v) {
+  switch (D.layout) {
+    case IE_REQUEST_ID:   // extension bit, then two aligned 16-bit integers
+      return in_range(v.value, D.ub) && in_range(v.instance, D.ub) ? 5 : 0;
+
+    case IE_INTEGER:
+      return in_range(v.value, D.ub) ? (D.ub < 256 ? 1 : 2) : 0;
+
+    case IE_ENUMERATED:   // extension bit and index of the root value, padded to an octet
+      return in_range(v.value, D.ub) ? 1 : 0;
+
+    case IE_OCTET_STRING:
+      return v.len <= APER_MAX_LENGTH ? length_size(v.len) + v.len : 0;
+
+    case IE_ADMITTED_LIST:  // 4-bit count, then items of 6 octets (id, criticality, length, extension bit and action ID)
+      if (v.len < 1 || v.len > APER_MAX_ADMITTED) {
+        return 0;
+      }
+      for (size_t i = 0; i < v.len; i++) {
+        if (!in_range(v.actions[i], D.ub)) {
+          return 0;
+        }
+      }
+      return 1 + 6 * v.len;
+  }
+
+  return 0;
+}
+
+/*
+  Writes the ProtocolIE-Field of descriptor D whose value v takes len octets (see value_size)
+*/
+template <const ie_desc_t &D>
+static inline uint8_t *put_ie(uint8_t *p, const ie_value_t &v, size_t len) {
+  p = put_u16(p, D.id);
+  *p++ = (uint8_t) (D.criticality << 6);  // 2-bit criticality, padded as the open type value is aligned
+  p = put_length(p, len);
+
+  switch (D.layout) {
+    case IE_REQUEST_ID:
+      *p++ = 0;   // extension bit
+      p = put_u16(p, v.value);
+      p = put_u16(p, v.instance);
+      break;
+
+    case IE_INTEGER:
+      if (D.ub < 256) {
+        *p++ = (uint8_t) v.value;
+      } else {
+        p = put_u16(p, v.value);
+      }
+      break;
+
+    case IE_ENUMERATED:
+      *p++ = (uint8_t) (v.value << 6);  // cleared extension bit, then the index
+      break;
+
+    case IE_OCTET_STRING:
+      p = put_length(p, v.len);
+      if (v.len > 0) {
+        memcpy(p, v.buf, v.len);
+        p += v.len;
+      }
+      break;
+
+    case IE_ADMITTED_LIST:
+      *p++ = (uint8_t) ((v.len - 1) << 4);
+      for (size_t i = 0; i < v.len; i++) {
+        p = put_u16(p, ProtocolIE_ID_id_RICaction_Admitted_Item);
+        *p++ = (uint8_t) (Criticality_reject << 6);
+        *p++ = 2;   // RICaction-Admitted-Item: extension bit, then the aligned action ID
+        *p++ = 0;
+        *p++ = (uint8_t) v.actions[i];
+      }
+      break;
+  }
+
+  return p;
+}
+
+/*
+  Encodes the E2AP PDU of descriptor M whose message has the IEs of descriptors Ds, in this order, with the given values.
+  The whole layout is known at compile time, so the sizes of all open types are computed ahead, and the PDU
+  is written in a single pass with no length fixups.
+
+  Returns the size of the PDU, which is larger than size if it does not fit in buf, or -1 if it cannot be encoded
+*/
+template <const msg_desc_t &M, const ie_desc_t &... Ds>
+static ssize_t encode_pdu(uint8_t *buf, size_t size, const ie_value_t (&values)[sizeof...(Ds)]) {
+  size_t i = 0;
+  const size_t lens[] = {value_size<Ds>(values[i++])...};
+
+  size_t body = 3;  // extension bit of the message, then the aligned number of IEs of its ProtocolIE-Container
+  for (size_t len : lens) {
+    if (len == 0 || len > APER_MAX_LENGTH) {
+      return -1;
+    }
+    body += 3 + length_size(len) + len;
+  }
+  if (body > APER_MAX_LENGTH) {
+    return -1;
+  }
+
+  size_t total = 3 + length_size(body) + body;
+  if (total > size) {
+    return total;
+  }
+
+  uint8_t *p = buf;
+  *p++ = (uint8_t) ((M.present - 1) << 5);   // extension bit of E2AP-PDU, then the 2-bit index of its alternative
+  *p++ = (uint8_t) M.procedure;
+  *p++ = (uint8_t) (M.criticality << 6);
+  p = put_length(p, body);
+  *p++ = 0;   // extension bit of the message
+  p = put_u16(p, sizeof...(Ds));
+
+  i = 0;
+  const int expand[] = {(p = put_ie<Ds>(p, values[i], lens[i]), i++, 0)...};
+  (void) expand;
+
+  return total;
+}
+
+#ifdef FAST_APER_CROSSCHECK
+/*
+  Encodes pdu with asn1c, compares it with the len bytes of buf written by a fast encoder, and releases pdu.
+  On a mismatch, logs the first byte that differs and copies the asn1c encoding into buf.
+
+  Returns the size of the encoding left in buf
+*/
+static ssize_t crosscheck(const char *name, E2AP_PDU_t *pdu, uint8_t *buf, size_t size, ssize_t len) {
+  std::vector<uint8_t> expected(size);
+  asn_enc_rval_t er = asn_encode_to_buffer(NULL, ATS_ALIGNED_BASIC_PER, &asn_DEF_E2AP_PDU, pdu, expected.data(), size);
+  ASN_STRUCT_FREE(asn_DEF_E2AP_PDU, pdu);
+
+  if (er.encoded < 0 || (size_t) er.encoded > size) {
+    logger_error("[FAST APER] unable to cross-check %s with asn1c", name);
+    return len;
+  }
+
+  if (er.encoded == len && memcmp(expected.data(), buf, len) == 0) {
+    return len;
+  }
+
+  ssize_t offset = 0;
+  while (offset < len && offset < er.encoded && buf[offset] == expected[offset]) {
+    offset++;
+  }
+  logger_error("[FAST APER] %s differs from asn1c at byte %zd (%zd bytes, asn1c %zd bytes)", name, offset, len, er.encoded);
+
+  memcpy(buf, expected.data(), er.encoded);
+  return er.encoded;
+}
+#endif
+
+/*
+  Same PDU as generate_e2ap_indication_request_parameterized, which always includes the call process ID
+*/
+ssize_t encoding::fast_encode_indication(uint8_t *buf, size_t size, e_RICindicationType indicationType, long requestorId,
+                                         long instanceId, long ranFunctionId, long actionId, uint16_t seqNum,
+                                         const uint8_t *header, size_t header_len, const uint8_t *message, size_t message_len,
+                                         const uint8_t *call_proc_id, size_t call_proc_id_len) {
+  const ie_value_t values[] = {
+    {requestorId, instanceId, NULL, NULL, 0},
+    {ranFunctionId, 0, NULL, NULL, 0},
+    {actionId, 0, NULL, NULL, 0},
+    {seqNum, 0, NULL, NULL, 0},
+    {indicationType, 0, NULL, NULL, 0},
+    {0, 0, header, NULL, header_len},
+    {0, 0, message, NULL, message_len},
+    {0, 0, call_proc_id, NULL, call_proc_id_len}
+  };
+
+  ssize_t len = encode_pdu<ric_indication, ie_request_id, ie_function_id, ie_action_id, ie_indication_sn,
+                           ie_indication_type, ie_indication_header, ie_indication_message, ie_call_process_id>(buf, size, values);
+
+#ifdef FAST_APER_CROSSCHECK
+  if (len > 0 && (size_t) len <= size) {
+    OCTET_STRING_t cpid;
+    memset(&cpid, 0, sizeof(cpid));
+    cpid.buf = (uint8_t *) call_proc_id;
+    cpid.size = call_proc_id_len;
+
+    E2AP_PDU_t *pdu = (E2AP_PDU_t *) calloc(1, sizeof(E2AP_PDU_t));
+    generate_e2ap_indication_request_parameterized(pdu, indicationType, requestorId, instanceId, ranFunctionId, actionId,
+                                                   seqNum, (uint8_t *) header, header_len, (uint8_t *) message,
+                                                   message_len, &cpid);
+    len = crosscheck("RICindication", pdu, buf, size, len);
+  }
+#endif
+
+  return len;
+}
+
+/*
+  Same PDU as generate_e2ap_subscription_response_success with no rejected actions
+*/
+ssize_t encoding::fast_encode_subscription_response(uint8_t *buf, size_t size, long ranFunctionId, long requestorId,
+                                                    long instanceId, const long *admitted, int admitted_count) {
+  if (admitted_count < 0) {
+    return -1;
+  }
+
+  const ie_value_t values[] = {
+    {requestorId, instanceId, NULL, NULL, 0},
+    {ranFunctionId, 0, NULL, NULL, 0},
+    {0, 0, NULL, admitted, (size_t) admitted_count}
+  };
+
+  ssize_t len = encode_pdu<ric_subscription_response, ie_request_id, ie_function_id, ie_actions_admitted>(buf, size, values);
+
+#ifdef FAST_APER_CROSSCHECK
+  if (len > 0 && (size_t) len <= size) {
+    E2AP_PDU_t *pdu = (E2AP_PDU_t *) calloc(1, sizeof(E2AP_PDU_t));
+    generate_e2ap_subscription_response_success(pdu, (long *) admitted, NULL, admitted_count, 0, requestorId,
+                                                instanceId, ranFunctionId);
+    len = crosscheck("RICsubscriptionResponse", pdu, buf, size, len);
+  }
+#endif
+
+  return len;
+}
+
+/*
+  Same PDU as generate_e2ap_subscription_delete_response_success
+*/
+ssize_t encoding::fast_encode_subscription_delete_response(uint8_t *buf, size_t size, long ranFunctionId,
+                                                           long requestorId, long instanceId) {
+  const ie_value_t values[] = {
+    {requestorId, instanceId, NULL, NULL, 0},
+    {ranFunctionId, 0, NULL, NULL, 0}
+  };
+
+  ssize_t len = encode_pdu<ric_subscription_delete_response, ie_request_id, ie_function_id>(buf, size, values);
+
+#ifdef FAST_APER_CROSSCHECK
+  if (len > 0 && (size_t) len <= size) {
+    E2AP_PDU_t *pdu = (E2AP_PDU_t *) calloc(1, sizeof(E2AP_PDU_t));
+    generate_e2ap_subscription_delete_response_success(pdu, ranFunctionId, requestorId, instanceId);
+    len = crosscheck("RICsubscriptionDeleteResponse", pdu, buf, size, len);
+  }
+#endif
+
+  return len;
+}
@@ -0,0 +1,63 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#ifndef FAST_APER_HPP
+#define FAST_APER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+extern "C" {
+  #include "RICindicationType.h"
+}
+
+#define FAST_APER_INDICATION_OVERHEAD 64  // most bytes a RIC indication adds to its header, message and call process ID
+#define FAST_APER_RESPONSE_SIZE       128 // room for any RIC subscription (delete) response of the fast encoders
+
+/*
+  Hand-written APER encoders of the E2AP PDUs sent the most, as an alternative to building the asn1c structures
+  of a PDU and walking them with the generic encoder. Each encoder writes the same bytes as the matching
+  generate_e2ap_* function followed by asn1c, straight into the caller buffer, with no allocations.
+
+  The layout of each PDU is fixed at compile time by constant descriptors of its protocol IEs, so the
+  encoders only check the ranges of the values and copy them in place (see fast_aper.cpp).
+
+  As asn_encode_to_buffer, encoders return the size of the PDU, which is larger than size if it does not fit in buf.
+  They return -1 for PDUs they do not encode, e.g. with values out of range or open types that need fragmentation
+  (16K or more), which callers then encode with asn1c.
+
+  When built with FAST_APER_CROSSCHECK, every PDU is also encoded with asn1c and compared byte by byte,
+  logging the first mismatch and returning the asn1c encoding instead.
+*/
+namespace encoding {
+
+  ssize_t fast_encode_indication(uint8_t *buf, size_t size, e_RICindicationType indicationType, long requestorId,
+                                 long instanceId, long ranFunctionId, long actionId, uint16_t seqNum,
+                                 const uint8_t *header, size_t header_len, const uint8_t *message, size_t message_len,
+                                 const uint8_t *call_proc_id, size_t call_proc_id_len);
+
+  ssize_t fast_encode_subscription_response(uint8_t *buf, size_t size, long ranFunctionId, long requestorId,
+                                            long instanceId, const long *admitted, int admitted_count);
+
+  ssize_t fast_encode_subscription_delete_response(uint8_t *buf, size_t size, long ranFunctionId, long requestorId,
+                                                   long instanceId);
+
+}
+
+#endif
@@ -0,0 +1,222 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#include <string.h>
+
+#include "indication_template.hpp"
+#include "encode_e2ap.hpp"
+#include "logger.h"
+#include "asn_arena.h"
+
+extern "C" {
+  #include "E2AP-PDU.h"
+  #include "asn_application.h"
+}
+
+#define TEMPLATE_PROBE_SN 0xA55A  // value of the self-check, with both set and cleared bits on each byte
+
+/*
+  Finds the only run of bits that differ between a and b, which have the same size
+
+  Returns false if the bits that differ are not a single run of the expected size
+*/
+static bool find_field(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b, size_t expected_bits, template_field_t &field) {
+  size_t first = 0;
+  size_t last = 0;
+  bool found = false;
+
+  for (size_t i = 0; i < a.size(); i++) {
+    uint8_t diff = a[i] ^ b[i];
+    for (int bit = 7; diff != 0 && bit >= 0; bit--) {
+      if (diff & (1 << bit)) {
+        size_t pos = i * 8 + (7 - bit);
+        if (!found) {
+          first = pos;
+          found = true;
+        }
+        last = pos;
+      }
+    }
+  }
+
+  field.bit_offset = first;
+  field.bits = found ? last - first + 1 : 0;
+
+  return found && field.bits == expected_bits;
+}
+
+/*
+  Overwrites a field of buf with the field.bits / 8 bytes of value, most significant bit first
+*/
+static void write_field(uint8_t *buf, const template_field_t &field, const uint8_t *value) {
+  if (field.bit_offset % 8 == 0) {  // APER aligns both fields to octets
+    memcpy(buf + field.bit_offset / 8, value, field.bits / 8);
+    return;
+  }
+
+  for (size_t i = 0; i < field.bits; i++) {
+    size_t pos = field.bit_offset + i;
+    uint8_t mask = 1 << (7 - pos % 8);
+    if (value[i / 8] & (1 << (7 - i % 8))) {
+      buf[pos / 8] |= mask;
+    } else {
+      buf[pos / 8] &= ~mask;
+    }
+  }
+}
+
+IndicationTemplate::IndicationTemplate() {
+  reset();
+}
+
+/*
+  Discards the template, so is_valid returns false until the next build
+*/
+void IndicationTemplate::reset() {
+  valid = false;
+  encoded.clear();
+  sn_field = {0, 0};
+  cpid_field = {0, 0};
+}
+
+/*
+  Encodes the RIC-INDICATION with the given SN and call process ID into out, using the asn1c encoder
+
+  Returns false on error
+*/
+bool IndicationTemplate::encode(uint16_t sn, const uint8_t *cpid, size_t cpid_len, std::vector<uint8_t> &out) {
+  OCTET_STRING_t ostr_cpid;
+  memset(&ostr_cpid, 0, sizeof(ostr_cpid));
+  ostr_cpid.buf = (uint8_t *) cpid;   // copied into the pdu
+  ostr_cpid.size = cpid_len;
+
+  E2AP_PDU_t *pdu = (E2AP_PDU_t *) calloc(1, sizeof(E2AP_PDU_t));
+  encoding::generate_e2ap_indication_request_parameterized(pdu, type, requestorId, instanceId, ranFunctionId, actionId, sn,
+          header.data(), header.size(), message.data(), message.size(), &ostr_cpid);
+
+  asn_encode_to_new_buffer_result_t res;
+  {
+    AsnArenaBypass bypass;  // the buffer is released with free() below
+    res = asn_encode_to_new_buffer(NULL, ATS_ALIGNED_BASIC_PER, &asn_DEF_E2AP_PDU, pdu);
+  }
+  ASN_STRUCT_FREE(asn_DEF_E2AP_PDU, pdu);
+
+  if (res.buffer == NULL) {
+    logger_error("[E2AP ASN] Unable to aper encode %s", res.result.failed_type ? res.result.failed_type->name : "E2AP-PDU");
+    return false;
+  }
+
+  out.assign((uint8_t *) res.buffer, (uint8_t *) res.buffer + res.result.encoded);
+  free(res.buffer);
+
+  return true;
+}
+
+/*
+  Encodes the template of the RIC-INDICATION of a RIC subscription action, for call process IDs of cpid_len bytes.
+  The E2SM header and message are copied, so the caller can release them.
+
+  Returns false if the fields cannot be patched in place, in which case the template is not valid
+*/
+bool IndicationTemplate::build(e_RICindicationType type, long requestorId, long instanceId, long ranFunctionId, long actionId,
+                               const uint8_t *header, size_t header_len, const uint8_t *message, size_t message_len, size_t cpid_len) {
+  reset();
+
+  this->type = type;
+  this->requestorId = requestorId;
+  this->instanceId = instanceId;
+  this->ranFunctionId = ranFunctionId;
+  this->actionId = actionId;
+  this->header.assign(header, header + header_len);
+  this->message.assign(message, message + message_len);
+
+  std::vector<uint8_t> cleared(cpid_len, 0x00);
+  std::vector<uint8_t> set(cpid_len, 0xFF);
+  std::vector<uint8_t> sn_set;
+  std::vector<uint8_t> cpid_set;
+
+  if (cpid_len == 0 || !encode(0, cleared.data(), cpid_len, encoded) ||
+      !encode(0xFFFF, cleared.data(), cpid_len, sn_set) || !encode(0, set.data(), cpid_len, cpid_set)) {
+    return false;
+  }
+
+  if (sn_set.size() != encoded.size() || cpid_set.size() != encoded.size() ||
+      !find_field(encoded, sn_set, 16, sn_field) || !find_field(encoded, cpid_set, cpid_len * 8, cpid_field)) {
+    logger_warn("[E2AP] RIC-INDICATION fields cannot be patched in place, falling back to full encoding");
+    return false;
+  }
+
+  valid = true;
+
+  std::vector<uint8_t> probe(cpid_len);
+  for (size_t i = 0; i < cpid_len; i++) {
+    probe[i] = (uint8_t) (i * 37 + 1);
+  }
+  if (!verify(TEMPLATE_PROBE_SN, probe.data(), cpid_len)) {
+    logger_error("[E2AP] RIC-INDICATION template does not match the asn1c encoder, falling back to full encoding");
+    reset();
+    return false;
+  }
+
+  logger_debug("[E2AP] RIC-INDICATION template of %zu bytes, SN at bit %zu, call process ID at bit %zu",
+               encoded.size(), sn_field.bit_offset, cpid_field.bit_offset);
+
+  return true;
+}
+
+bool IndicationTemplate::is_valid() {
+  return valid;
+}
+
+/*
+  Writes the SN and the call process ID in place. The returned buffer of size() bytes
+  is only valid until the next call.
+
+  Returns NULL if the template is not valid, or if cpid_len would change the length of the PDU
+*/
+const uint8_t *IndicationTemplate::patch(uint16_t sn, const uint8_t *cpid, size_t cpid_len) {
+  if (!valid || cpid_len * 8 != cpid_field.bits) {
+    return NULL;
+  }
+
+  uint8_t sn_bytes[2] = {(uint8_t) (sn >> 8), (uint8_t) (sn & 0xFF)};
+  write_field(encoded.data(), sn_field, sn_bytes);
+  write_field(encoded.data(), cpid_field, cpid);
+
+  return encoded.data();
+}
+
+size_t IndicationTemplate::size() {
+  return encoded.size();
+}
+
+/*
+  Compares the patched template against the encoding of the same fields by the asn1c encoder
+
+  Returns true if both are equal
+*/
+bool IndicationTemplate::verify(uint16_t sn, const uint8_t *cpid, size_t cpid_len) {
+  std::vector<uint8_t> expected;
+
+  const uint8_t *patched = patch(sn, cpid, cpid_len);
+  if (patched == NULL || !encode(sn, cpid, cpid_len, expected)) {
+    return false;
+  }
+
+  return expected.size() == encoded.size() && memcmp(expected.data(), patched, expected.size()) == 0;
+}
@@ -0,0 +1,87 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#ifndef INDICATION_TEMPLATE_HPP
+#define INDICATION_TEMPLATE_HPP
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+extern "C" {
+  #include "RICindicationType.h"
+}
+
+// a field of an encoded PDU that can be overwritten in place
+typedef struct {
+  size_t bit_offset;  // first bit of the field, counting from the most significant bit of the first byte
+  size_t bits;
+} template_field_t;
+
+/*
+  RIC-INDICATION encoded once in APER, whose RICindicationSN and RICcallProcessID are patched in place
+  for each message, as they are the only IEs that change between the messages of a RIC subscription action.
+
+  Both fields have a fixed size in APER (SN is a 16-bit constrained integer, and the call process ID
+  keeps its size), so they do not shift the rest of the PDU. Their offsets are not computed from the
+  ASN.1 definition, but found by encoding the PDU with all bits of each field cleared and set, so the
+  template follows whatever the encoder does. A template is only valid once a PDU patched with probe
+  values matches the encoding of the same values by the asn1c encoder.
+
+  Callers fall back to a full encoding when the template is not valid, or when a call process ID of
+  a different size would change the length of the PDU. It is not thread-safe.
+*/
+class IndicationTemplate {
+
+private:
+
+  std::vector<uint8_t> encoded;
+  template_field_t sn_field;
+  template_field_t cpid_field;
+  bool valid;
+
+  e_RICindicationType type;
+  long requestorId;
+  long instanceId;
+  long ranFunctionId;
+  long actionId;
+  std::vector<uint8_t> header;
+  std::vector<uint8_t> message;
+
+  bool encode(uint16_t sn, const uint8_t *cpid, size_t cpid_len, std::vector<uint8_t> &out);
+
+public:
+
+  IndicationTemplate();
+
+  bool build(e_RICindicationType type, long requestorId, long instanceId, long ranFunctionId, long actionId,
+             const uint8_t *header, size_t header_len, const uint8_t *message, size_t message_len, size_t cpid_len);
+
+  bool is_valid();
+
+  const uint8_t *patch(uint16_t sn, const uint8_t *cpid, size_t cpid_len);
+
+  size_t size();
+
+  bool verify(uint16_t sn, const uint8_t *cpid, size_t cpid_len);
+
+  void reset();
+
+};
+
+#endif
@@ -0,0 +1,162 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#include <atomic>
+#include <string.h>
+#include <stdlib.h>
+
+#include "validation_policy.hpp"
+#include "logger.h"
+
+#define VALIDATION_UNSCOPED -1    // no scope has decided for the checks of the thread
+
+static std::atomic<int> policy_mode(VALIDATION_ALWAYS);
+static std::atomic<unsigned long> policy_n(1);
+static std::atomic<unsigned long> unscoped_messages(0);
+
+static thread_local int scope_decision = VALIDATION_UNSCOPED;
+static thread_local validation_stats_t stats = {};
+
+/*
+  Tells if the message-th message (starting from 1) of a counter is checked
+*/
+static bool should_check(unsigned long message) {
+  unsigned long n = policy_n.load(std::memory_order_relaxed);
+
+  switch (policy_mode.load(std::memory_order_relaxed)) {
+    case VALIDATION_ALWAYS:
+      return true;
+    case VALIDATION_SAMPLE:
+      return n <= 1 || (message - 1) % n == 0;
+    case VALIDATION_FIRST:
+      return message <= n;
+    default:
+      return false;
+  }
+}
+
+ValidationScope::ValidationScope(unsigned long &messages) {
+  saved = scope_decision;
+  scope_decision = should_check(++messages);
+}
+
+ValidationScope::~ValidationScope() {
+  scope_decision = saved;
+}
+
+/*
+  Checks the constraints of sptr if the policy selects the current message, logging any violation
+
+  Returns false on a violation, and true if the constraints hold or the check has been skipped
+*/
+bool validate_constraints(const asn_TYPE_descriptor_t *type, const void *sptr) {
+  bool check = scope_decision == VALIDATION_UNSCOPED ?
+               should_check(unscoped_messages.fetch_add(1, std::memory_order_relaxed) + 1) : scope_decision;
+  if (!check) {
+    stats.skipped++;
+    return true;
+  }
+
+  char error_buf[300] = {0, };
+  size_t errlen = sizeof(error_buf);
+
+  stats.checks++;
+  if (asn_check_constraints(type, sptr, error_buf, &errlen) != 0) {
+    stats.violations++;
+    logger_error("%s check constraints failed. error length = %lu, error buf = %s", type->name, errlen, error_buf);
+    return false;
+  }
+
+  return true;
+}
+
+/*
+  Sets the policy of all threads, which applies from their next message on
+*/
+void validation_set_policy(const validation_policy_t &policy) {
+  policy_n.store(policy.n, std::memory_order_relaxed);
+  policy_mode.store(policy.mode, std::memory_order_relaxed);
+}
+
+validation_policy_t validation_get_policy() {
+  validation_policy_t policy;
+  policy.mode = (validation_mode_e) policy_mode.load(std::memory_order_relaxed);
+  policy.n = policy_n.load(std::memory_order_relaxed);
+  return policy;
+}
+
+/*
+  Returns the stats of the calling thread
+*/
+validation_stats_t validation_get_stats() {
+  return stats;
+}
+
+/*
+  Parses a policy: always, off, sample:N (one in every N messages), or first:N (the first N messages)
+
+  Returns false if spec is not a policy
+*/
+bool validation_parse_policy(const char *spec, validation_policy_t &policy) {
+  if (strcmp(spec, "always") == 0) {
+    policy.mode = VALIDATION_ALWAYS;
+    policy.n = 1;
+    return true;
+  }
+  if (strcmp(spec, "off") == 0) {
+    policy.mode = VALIDATION_OFF;
+    policy.n = 0;
+    return true;
+  }
+
+  validation_mode_e mode;
+  const char *value;
+  if (strncmp(spec, "sample:", 7) == 0) {
+    mode = VALIDATION_SAMPLE;
+    value = spec + 7;
+  } else if (strncmp(spec, "first:", 6) == 0) {
+    mode = VALIDATION_FIRST;
+    value = spec + 6;
+  } else {
+    return false;
+  }
+
+  char *end;
+  unsigned long n = strtoul(value, &end, 10);
+  if (*value < '0' || *value > '9' || *end != '\0' || (mode == VALIDATION_SAMPLE && n == 0)) {
+    return false;
+  }
+
+  policy.mode = mode;
+  policy.n = n;
+  return true;
+}
+
+std::string validation_policy_name(const validation_policy_t &policy) {
+  switch (policy.mode) {
+    case VALIDATION_ALWAYS:
+      return "always";
+    case VALIDATION_SAMPLE:
+      return "sample:" + std::to_string(policy.n);
+    case VALIDATION_FIRST:
+      return "first:" + std::to_string(policy.n);
+    case VALIDATION_OFF:
+      return "off";
+  }
+  return "unknown";
+}
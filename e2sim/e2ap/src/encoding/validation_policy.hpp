@@ -0,0 +1,82 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#ifndef VALIDATION_POLICY_HPP
+#define VALIDATION_POLICY_HPP
+
+#include <string>
+
+extern "C" {
+  #include "asn_application.h"
+}
+
+// which encoded messages have their ASN.1 constraints checked
+typedef enum {
+  VALIDATION_ALWAYS,    // every message
+  VALIDATION_SAMPLE,    // the first message and then one in every n messages
+  VALIDATION_FIRST,     // the first n messages
+  VALIDATION_OFF        // none
+} validation_mode_e;
+
+typedef struct {
+  validation_mode_e mode;
+  unsigned long n;      // sampling period or number of first messages
+} validation_policy_t;
+
+// constraint checks of the calling thread
+typedef struct {
+  unsigned long checks;       // checks that ran
+  unsigned long skipped;      // checks skipped by the policy
+  unsigned long violations;   // checks that failed
+} validation_stats_t;
+
+/*
+  Counts a message against a counter of messages, e.g. of a subscription, and applies the policy to it,
+  so all constraint checks of the message in the calling thread run or are skipped together until the
+  scope ends. Checks outside of a scope count as messages of their own, against a counter of the process.
+*/
+class ValidationScope {
+
+private:
+
+  int saved;  // decision of the enclosing scope
+
+public:
+
+  ValidationScope(unsigned long &messages);
+
+  ~ValidationScope();
+
+  ValidationScope(const ValidationScope &) = delete;
+  ValidationScope &operator=(const ValidationScope &) = delete;
+
+};
+
+bool validate_constraints(const asn_TYPE_descriptor_t *type, const void *sptr);
+
+void validation_set_policy(const validation_policy_t &policy);
+
+validation_policy_t validation_get_policy();
+
+validation_stats_t validation_get_stats();
+
+bool validation_parse_policy(const char *spec, validation_policy_t &policy);
+
+std::string validation_policy_name(const validation_policy_t &policy);
+
+#endif
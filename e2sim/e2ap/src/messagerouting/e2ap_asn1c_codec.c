@@ -187,3 +187,23 @@ int e2ap_asn1c_get_procedureCode(E2AP_PDU_t* pdu)
 
   return procedureCode;
 }
+
+/*
+  Returns the SCTP stream (E2AP_STREAM_*) that carries the procedure of the given PDU
+*/
+int e2ap_asn1c_get_stream(E2AP_PDU_t* pdu)
+{
+  switch(e2ap_asn1c_get_procedureCode(pdu))
+  {
+    case ProcedureCode_id_RICindication:
+      return E2AP_STREAM_INDICATION;
+
+    case ProcedureCode_id_RICsubscription:
+    case ProcedureCode_id_RICsubscriptionDelete:
+    case ProcedureCode_id_RICcontrol:
+      return E2AP_STREAM_CONTROL;
+
+    default:
+      return E2AP_STREAM_GLOBAL;
+  }
+}
@@ -45,4 +45,6 @@ void e2ap_asn1c_decode_pdu(E2AP_PDU_t* pdu, unsigned char *buffer, int len);
 
 int e2ap_asn1c_get_procedureCode(E2AP_PDU_t* pdu);
 
+int e2ap_asn1c_get_stream(E2AP_PDU_t* pdu);
+
 #endif
@@ -25,12 +25,24 @@
 
 #include "encode_e2ap.hpp"
 #include "logger.h"
+#include "asn_arena.h"
 
 #include <unistd.h>
 
-void e2ap_handle_sctp_data(int &socket_fd, sctp_buffer_t &data, E2Sim *e2sim, struct timespec *ts)
+void e2ap_handle_sctp_data(int &socket_fd, pdu_buffer_t &data, E2Sim *e2sim, struct timespec *ts)
+{
+  e2ap_handle_sctp_data(socket_fd, data.buf, data.len, e2sim, ts);
+}
+
+/*
+  Decodes a complete E2AP message of len bytes and dispatches it to its procedure handler
+*/
+void e2ap_handle_sctp_data(int &socket_fd, const uint8_t *buf, size_t len, E2Sim *e2sim, struct timespec *ts, struct timespec *kernel_ts)
 {
   logger_trace("in func %s", __func__);
+
+  AsnArenaScope arena;  // the pdu and the responses built by its handlers are released at once when leaving
+
   //decode the data into E2AP-PDU
   E2AP_PDU_t* pdu = (E2AP_PDU_t*)calloc(1, sizeof(E2AP_PDU));
   ASN_STRUCT_RESET(asn_DEF_E2AP_PDU, pdu);
@@ -41,7 +53,7 @@ void e2ap_handle_sctp_data(int &socket_fd, sctp_buffer_t &data, E2Sim *e2sim, st
   logger_debug("decoding E2AP_PDU from SCTP data...");
 
   auto rval = asn_decode(nullptr, syntax, &asn_DEF_E2AP_PDU, (void **) &pdu,
-		    data.buffer, data.len);
+		    buf, len);
 
   int index = (int)pdu->present;
 
@@ -67,11 +79,12 @@ void e2ap_handle_sctp_data(int &socket_fd, sctp_buffer_t &data, E2Sim *e2sim, st
 
     case E2AP_PDU_PR_successfulOutcome:
       logger_info("[E2AP] Received SETUP-RESPONSE-SUCCESS");
-      e2sim->setRetryConnection(false);
+      e2sim->handle_e2_setup_response(true);
       break;
 
     case E2AP_PDU_PR_unsuccessfulOutcome:
       logger_warn("[E2AP] Received SETUP-RESPONSE-FAILURE");
+      e2sim->handle_e2_setup_response(false);
       break;
 
     default:
@@ -229,7 +242,7 @@ void e2ap_handle_sctp_data(int &socket_fd, sctp_buffer_t &data, E2Sim *e2sim, st
       try {
         cb = e2sim->get_control_callback(func_id);
         logger_trace("Calling callback function");
-        cb(pdu, ts);  // timestamp of the received message is sent to the callback function
+        cb(pdu, ts, kernel_ts);  // timestamps of the received message are sent to the callback function
 
       } catch (const std::out_of_range &e) {
         logger_error("No RAN Function with ID %ld exists", func_id);
@@ -333,8 +346,6 @@ void e2ap_handle_sctp_data(int &socket_fd, sctp_buffer_t &data, E2Sim *e2sim, st
 void e2ap_handle_E2SeviceRequest(E2AP_PDU_t* pdu, int &socket_fd, E2Sim *e2sim) {
   logger_trace("in func %s", __func__);
 
-  auto buffer_size = MAX_SCTP_BUFFER;
-  unsigned char buffer[MAX_SCTP_BUFFER];
   E2AP_PDU_t* res_pdu = (E2AP_PDU_t*)calloc(1,sizeof(E2AP_PDU));
 
   // prepare ran function defination
@@ -342,12 +353,13 @@ void e2ap_handle_E2SeviceRequest(E2AP_PDU_t* pdu, int &socket_fd, E2Sim *e2sim)
 
   //Loop through RAN function definitions that are registered
 
-  for (std::pair<long, encoded_ran_function_t *> elem : e2sim->getRegistered_ran_functions()) {
+  for (auto &elem : e2sim->getRegistered_ran_functions()) {
     encoding::ran_func_info next_func;
 
     next_func.ranFunctionId = elem.first;
     next_func.ranFunctionDesc = &elem.second->ran_function_ostr;
     next_func.ranFunctionRev = (long)3;
+    next_func.ranFunctionOId = &elem.second->oid;
     all_funcs.push_back(next_func);
   }
 
@@ -361,7 +373,8 @@ void e2ap_handle_E2SeviceRequest(E2AP_PDU_t* pdu, int &socket_fd, E2Sim *e2sim)
     e2ap_asn1c_print_pdu(res_pdu);
   }
 
-  sctp_buffer_t data;
+  pdu_buffer_t data;
+  pdu_buffer_init(&data);
 
   char error_buf[300] = {0, };
   size_t errlen = 0;
@@ -371,26 +384,24 @@ void e2ap_handle_E2SeviceRequest(E2AP_PDU_t* pdu, int &socket_fd, E2Sim *e2sim)
     logger_error("E2AP_PDU check constraints failed. error length = %lu, error buf %s", errlen, error_buf);
   }
 
-  auto er = asn_encode_to_buffer(nullptr, ATS_ALIGNED_BASIC_PER, &asn_DEF_E2AP_PDU, res_pdu, buffer, buffer_size);
-
-  data.len = er.encoded;
-  logger_debug("er encoded is %ld", er.encoded);
-
-  memcpy(data.buffer, buffer, er.encoded);
+  ssize_t len = e2ap_encode_pdu(res_pdu, data);
+  logger_debug("encoded length is %zd", len);
 
-  //send response data over sctp
-  if(sctp_send_data(socket_fd, data, NULL) > 0) {
+  //send response data through the send path of the E2Sim, as its socket is non-blocking
+  if(len > 0) {
+    e2sim->send_encoded_sctp_data(data.buf, data.len, E2AP_STREAM_GLOBAL, NULL);
     logger_info("[SCTP] Sent E2-SERVICE-UPDATE");
   } else {
     logger_error("[SCTP] Unable to send E2-SERVICE-UPDATE to peer");
   }
+
+  pdu_buffer_release(&data);
+  ASN_STRUCT_FREE(asn_DEF_E2AP_PDU, res_pdu);
 }
 
 void e2ap_send_e2nodeConfigUpdate(int &socket_fd) {
   logger_trace("in func %s", __func__);
 
-  auto buffer_size = MAX_SCTP_BUFFER;
-  unsigned char buffer[MAX_SCTP_BUFFER];
   E2AP_PDU_t* pdu = (E2AP_PDU_t*)calloc(1,sizeof(E2AP_PDU));
 
   logger_trace("about to call e2nodeconfigUpdate encode");
@@ -403,7 +414,8 @@ void e2ap_send_e2nodeConfigUpdate(int &socket_fd) {
     e2ap_asn1c_print_pdu(pdu);
   }
 
-  sctp_buffer_t data;
+  pdu_buffer_t data;
+  pdu_buffer_init(&data);
 
   char error_buf[300] = {0, };
   size_t errlen = 0;
@@ -413,19 +425,17 @@ void e2ap_send_e2nodeConfigUpdate(int &socket_fd) {
     logger_error("E2AP_PDU check constraints failed. error length = %lu, error buf %s", errlen, error_buf);
   }
 
-  auto er = asn_encode_to_buffer(nullptr, ATS_ALIGNED_BASIC_PER, &asn_DEF_E2AP_PDU, pdu, buffer, buffer_size);
-
-  data.len = er.encoded;
-  logger_debug("er encoded is %ld", er.encoded);
-
-  memcpy(data.buffer, buffer, er.encoded);
+  ssize_t len = e2ap_encode_pdu(pdu, data);
+  logger_debug("encoded length is %zd", len);
 
   //send response data over sctp
-  if(sctp_send_data(socket_fd, data, NULL) > 0) {
+  if(len > 0 && sctp_send_data(socket_fd, data.buf, data.len, NULL) > 0) {
     logger_info("[SCTP] Sent E2nodeConfigUpdate");
   } else {
     logger_error("[SCTP] Unable to send E2nodeConfigUpdate to peer");
   }
+
+  pdu_buffer_release(&data);
 }
 
 void e2ap_handle_E2SetupRequest(E2AP_PDU_t* pdu, int &socket_fd) {
@@ -440,19 +450,14 @@ void e2ap_handle_E2SetupRequest(E2AP_PDU_t* pdu, int &socket_fd) {
     e2ap_asn1c_print_pdu(res_pdu);
   }
 
-  auto buffer_size = MAX_SCTP_BUFFER;
-  unsigned char buffer[MAX_SCTP_BUFFER];
-
-  sctp_buffer_t data;
-  auto er = asn_encode_to_buffer(nullptr, ATS_BASIC_XER, &asn_DEF_E2AP_PDU, res_pdu, buffer, buffer_size);
-
-  data.len = er.encoded;
-  logger_debug("er encoded is %ld", er.encoded);
+  pdu_buffer_t data;
+  pdu_buffer_init(&data);
 
-  memcpy(data.buffer, buffer, er.encoded);
+  ssize_t len = e2ap_encode_pdu(res_pdu, data, ATS_BASIC_XER);
+  logger_debug("encoded length is %zd", len);
 
   //send response data over sctp
-  if(sctp_send_data(socket_fd, data, NULL) > 0) {
+  if(len > 0 && sctp_send_data(socket_fd, data.buf, data.len, NULL) > 0) {
     logger_info("[SCTP] Sent E2-SETUP-RESPONSE");
   } else {
     logger_error("[SCTP] Unable to send E2-SETUP-RESPONSE to peer");
@@ -470,24 +475,17 @@ void e2ap_handle_E2SetupRequest(E2AP_PDU_t* pdu, int &socket_fd) {
     xer_fprint(stderr, &asn_DEF_E2AP_PDU, pdu_sub);
   }
 
-  auto buffer_size2 = MAX_SCTP_BUFFER;
-  unsigned char buffer2[MAX_SCTP_BUFFER];
-
-  sctp_buffer_t data2;
-
-  auto er2 = asn_encode_to_buffer(nullptr, ATS_ALIGNED_BASIC_PER, &asn_DEF_E2AP_PDU, pdu_sub, buffer2, buffer_size2);
+  len = e2ap_encode_pdu(pdu_sub, data);   // reuses the buffer of the setup response
+  logger_debug("encoded length is %zd", len);
 
-  data2.len = er2.encoded;
-  memcpy(data2.buffer, buffer2, er2.encoded);
-
-  logger_debug("er encded is %ld", er2.encoded);
-
-  if(sctp_send_data(socket_fd, data2, NULL) > 0) {
+  if(len > 0 && sctp_send_data(socket_fd, data.buf, data.len, NULL) > 0) {
     logger_info("[SCTP] Sent E2-SUBSCRIPTION-REQUEST");
   } else {
     logger_error("[SCTP] Unable to send E2-SUBSCRIPTION-REQUEST to peer");
   }
 
+  pdu_buffer_release(&data);
+
 }
 
 /*
@@ -552,5 +550,36 @@ void e2ap_handle_RICSubscriptionRequest(E2AP_PDU_t* pdu, int &socket_fd)
 }
 */
 
+/*
+  Encodes the pdu into data, which grows to the size reported by the encoder,
+  so PDUs of any size fit. The pdu is not released.
 
+  Returns the encoded length, or -1 if the pdu could not be encoded.
+*/
+ssize_t e2ap_encode_pdu(E2AP_PDU_t *pdu, pdu_buffer_t &data, enum asn_transfer_syntax syntax)
+{
+  data.len = 0;
+  if (!pdu_buffer_reserve(&data, PDU_BUFFER_MIN_SIZE)) {
+    return -1;
+  }
 
+  asn_enc_rval_t er = asn_encode_to_buffer(nullptr, syntax, &asn_DEF_E2AP_PDU, pdu, data.buf, data.size);
+
+  if (er.encoded > 0 && (size_t)er.encoded > data.size) {
+    // the encoder reports the required size when the buffer is too small, so we encode it again only once
+    if (!pdu_buffer_reserve(&data, er.encoded)) {
+      logger_error("[E2AP ASN] unable to allocate memory to encode %ld bytes", er.encoded);
+      return -1;
+    }
+    er = asn_encode_to_buffer(nullptr, syntax, &asn_DEF_E2AP_PDU, pdu, data.buf, data.size);
+  }
+
+  if (er.encoded <= 0) {
+    logger_error("[E2AP ASN] Unable to encode %s", er.failed_type ? er.failed_type->name : "E2AP-PDU");
+    return -1;
+  }
+
+  data.len = er.encoded;
+
+  return er.encoded;
+}
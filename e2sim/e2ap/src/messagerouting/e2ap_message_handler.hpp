@@ -29,7 +29,9 @@ extern "C" {
   #include "e2ap_asn1c_codec.h"
 }
 
-void e2ap_handle_sctp_data(int &socket_fd, sctp_buffer_t &data, E2Sim *e2sim, struct timespec *ts);
+void e2ap_handle_sctp_data(int &socket_fd, pdu_buffer_t &data, E2Sim *e2sim, struct timespec *ts);
+
+void e2ap_handle_sctp_data(int &socket_fd, const uint8_t *buf, size_t len, E2Sim *e2sim, struct timespec *ts, struct timespec *kernel_ts = NULL);
 
 void e2ap_handle_X2SetupRequest(E2AP_PDU_t* pdu, int &socket_fd);
 
@@ -49,4 +51,6 @@ void e2ap_handle_E2SeviceRequest(E2AP_PDU_t* pdu, int &socket_fd, E2Sim *e2sim);
 
 void e2ap_send_e2nodeConfigUpdate(int &socket_fd);
 
+ssize_t e2ap_encode_pdu(E2AP_PDU_t *pdu, pdu_buffer_t &data, enum asn_transfer_syntax syntax = ATS_ALIGNED_BASIC_PER);
+
 #endif
@@ -837,7 +837,7 @@ void callback_kpm_subscription_request(E2AP_PDU_t *sub_req_pdu) {
   int accept_size = actionIdsAccept.size();
   int reject_size = actionIdsReject.size();
 
-  encoding::generate_e2ap_subscription_response_success(e2ap_pdu, accept_array, reject_array, accept_size, reject_size, reqRequestorId, reqInstanceId);
+  encoding::generate_e2ap_subscription_response_success(e2ap_pdu, accept_array, reject_array, accept_size, reject_size, reqRequestorId, reqInstanceId, 0);
 
   e2sim.encode_and_send_sctp_data(e2ap_pdu);
 
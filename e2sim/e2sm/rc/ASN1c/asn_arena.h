@@ -0,0 +1,78 @@
+/*
+ * Per-thread bump arena behind the CALLOC/MALLOC/REALLOC/FREEMEM macros
+ * of the ASN.1 support code (see asn_internal.h).
+ *
+ * Outside of an arena scope every allocation goes to the heap, so the
+ * generated code behaves as usual. Within a scope (asn_arena_begin/end)
+ * allocations are carved from chunks owned by the calling thread, FREEMEM
+ * of arena memory does nothing, and all of it is reclaimed at once when
+ * the outermost scope ends, e.g. once per encoded or decoded message.
+ * FREEMEM of heap memory (e.g. structures built with plain calloc by the
+ * application) still calls free(), whether a scope is active or not.
+ *
+ * Arena memory must not outlive its scope nor leave its thread, and must not
+ * be released with free(). Structures that do (e.g. kept after the message
+ * has been handled, or buffers from asn_encode_to_new_buffer released with
+ * free()) must be allocated within asn_arena_bypass_begin/end.
+ */
+#ifndef	ASN_ARENA_H
+#define	ASN_ARENA_H
+
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define	ASN_ARENA_CHUNK_SIZE	(64 * 1024)	/* Minimum size of a chunk */
+
+typedef struct asn_arena_stats_s {
+	unsigned long allocs;		/* Allocations served by the arena */
+	unsigned long heap_allocs;	/* Allocations served by the heap */
+	unsigned long resets;		/* Outermost scopes ended */
+	size_t used;			/* Bytes in use by the current scope */
+	size_t high_water;		/* Most bytes used by a single scope */
+	size_t reserved;		/* Bytes of the chunks kept by the thread */
+} asn_arena_stats_t;
+
+void asn_arena_begin(void);
+void asn_arena_end(void);
+void asn_arena_bypass_begin(void);
+void asn_arena_bypass_end(void);
+int asn_arena_active(void);
+
+void *asn_arena_malloc(size_t size);
+void *asn_arena_calloc(size_t nmemb, size_t size);
+void *asn_arena_realloc(void *ptr, size_t size);
+void asn_arena_free(void *ptr);
+
+void asn_arena_get_stats(asn_arena_stats_t *stats);
+void asn_arena_release(void);
+
+#ifdef	__cplusplus
+}
+
+/*
+ * Arena scope of a block, e.g. the handling of a received message.
+ */
+class AsnArenaScope {
+public:
+	AsnArenaScope() { asn_arena_begin(); }
+	~AsnArenaScope() { asn_arena_end(); }
+	AsnArenaScope(const AsnArenaScope &) = delete;
+	AsnArenaScope &operator=(const AsnArenaScope &) = delete;
+};
+
+/*
+ * Allocates from the heap within a block, even inside of an arena scope.
+ */
+class AsnArenaBypass {
+public:
+	AsnArenaBypass() { asn_arena_bypass_begin(); }
+	~AsnArenaBypass() { asn_arena_bypass_end(); }
+	AsnArenaBypass(const AsnArenaBypass &) = delete;
+	AsnArenaBypass &operator=(const AsnArenaBypass &) = delete;
+};
+#endif
+
+#endif	/* ASN_ARENA_H */
@@ -24,7 +24,9 @@
 #include <vector>
 
 #include "encode_rc.hpp"
+#include "asn_arena.h"
 #include "logger.h"
+#include "validation_policy.hpp"
 
 using namespace std;
 
@@ -134,89 +136,85 @@ void encode_rc_function_definition(E2SM_RC_RANFunctionDefinition_t* ranfunc_def)
 void encode_rc_indication_message(E2SM_RC_IndicationMessage_t *ind_msg, PLMNIdentity_t *plmn_id, BIT_STRING_t *gnb_id) {
     logger_trace("in %s function", __func__);
 
-    char error_buf[300] = {0, };
-    size_t errlen = 0;
-    int ret;
-
     ASN_STRUCT_RESET(asn_DEF_E2SM_RC_IndicationMessage, ind_msg);
 
     ind_msg->ric_indicationMessage_formats.present = E2SM_RC_IndicationMessage__ric_indicationMessage_formats_PR_indicationMessage_Format5;
-    E2SM_RC_IndicationMessage_Format5_t *indicationMessage_Format5 = (E2SM_RC_IndicationMessage_Format5_t *) calloc(1, sizeof(E2SM_RC_IndicationMessage_Format5_t));
+    E2SM_RC_IndicationMessage_Format5_t *indicationMessage_Format5 = (E2SM_RC_IndicationMessage_Format5_t *) asn_arena_calloc(1, sizeof(E2SM_RC_IndicationMessage_Format5_t));
     ind_msg->ric_indicationMessage_formats.choice.indicationMessage_Format5 = indicationMessage_Format5;
 
     E2SM_RC_IndicationMessage_Format5_Item_t *format_item =
-            (E2SM_RC_IndicationMessage_Format5_Item_t *) calloc(1, sizeof(E2SM_RC_IndicationMessage_Format5_Item_t));
+            (E2SM_RC_IndicationMessage_Format5_Item_t *) asn_arena_calloc(1, sizeof(E2SM_RC_IndicationMessage_Format5_Item_t));
     ASN_SEQUENCE_ADD(&indicationMessage_Format5->ranP_Requested_List.list, format_item);
 
     format_item->ranParameter_ID = 1; // Primary Cell ID as in E2SM-RC v01.02 section 8.4.5.1
     format_item->ranParameter_valueType.present = RANParameter_ValueType_PR_ranP_Choice_Structure;
     format_item->ranParameter_valueType.choice.ranP_Choice_Structure =
-            (RANParameter_ValueType_Choice_Structure_t *) calloc(1, sizeof(RANParameter_ValueType_Choice_Structure_t));
+            (RANParameter_ValueType_Choice_Structure_t *) asn_arena_calloc(1, sizeof(RANParameter_ValueType_Choice_Structure_t));
 
     RANParameter_STRUCTURE_t *ranp_struct_item1 =
-            (RANParameter_STRUCTURE_t *) calloc(1, sizeof(RANParameter_STRUCTURE_t));
+            (RANParameter_STRUCTURE_t *) asn_arena_calloc(1, sizeof(RANParameter_STRUCTURE_t));
     format_item->ranParameter_valueType.choice.ranP_Choice_Structure->ranParameter_Structure = ranp_struct_item1;
 
     ranp_struct_item1->sequence_of_ranParameters = (struct RANParameter_STRUCTURE::RANParameter_STRUCTURE__sequence_of_ranParameters *)
-                                    calloc(1, sizeof(struct RANParameter_STRUCTURE::RANParameter_STRUCTURE__sequence_of_ranParameters));
+                                    asn_arena_calloc(1, sizeof(struct RANParameter_STRUCTURE::RANParameter_STRUCTURE__sequence_of_ranParameters));
 
-    RANParameter_STRUCTURE_Item_t *ranp_struct_item2 = (RANParameter_STRUCTURE_Item_t *) calloc(1, sizeof(RANParameter_STRUCTURE_Item_t));
+    RANParameter_STRUCTURE_Item_t *ranp_struct_item2 = (RANParameter_STRUCTURE_Item_t *) asn_arena_calloc(1, sizeof(RANParameter_STRUCTURE_Item_t));
     ASN_SEQUENCE_ADD(&ranp_struct_item1->sequence_of_ranParameters->list, ranp_struct_item2);
 
     ranp_struct_item2->ranParameter_ID = 2; // CHOICE Primary Cell as in E2SM-RC v01.02 section 8.4.5.1
-    ranp_struct_item2->ranParameter_valueType = (RANParameter_ValueType_t *) calloc(1, sizeof(RANParameter_ValueType_t));
+    ranp_struct_item2->ranParameter_valueType = (RANParameter_ValueType_t *) asn_arena_calloc(1, sizeof(RANParameter_ValueType_t));
     ranp_struct_item2->ranParameter_valueType->present = RANParameter_ValueType_PR_ranP_Choice_Structure;
     ranp_struct_item2->ranParameter_valueType->choice.ranP_Choice_Structure =
-            (RANParameter_ValueType_Choice_Structure_t *) calloc(1, sizeof(RANParameter_ValueType_Choice_Structure_t));
+            (RANParameter_ValueType_Choice_Structure_t *) asn_arena_calloc(1, sizeof(RANParameter_ValueType_Choice_Structure_t));
 
-    RANParameter_STRUCTURE_t *ranp_struct2 = (RANParameter_STRUCTURE_t *) calloc(1, sizeof(RANParameter_STRUCTURE_t));
+    RANParameter_STRUCTURE_t *ranp_struct2 = (RANParameter_STRUCTURE_t *) asn_arena_calloc(1, sizeof(RANParameter_STRUCTURE_t));
     ranp_struct_item2->ranParameter_valueType->choice.ranP_Choice_Structure->ranParameter_Structure = ranp_struct2;
 
     ranp_struct2->sequence_of_ranParameters =
-            (struct RANParameter_STRUCTURE::RANParameter_STRUCTURE__sequence_of_ranParameters *) calloc(1, sizeof(struct RANParameter_STRUCTURE::RANParameter_STRUCTURE__sequence_of_ranParameters));
+            (struct RANParameter_STRUCTURE::RANParameter_STRUCTURE__sequence_of_ranParameters *) asn_arena_calloc(1, sizeof(struct RANParameter_STRUCTURE::RANParameter_STRUCTURE__sequence_of_ranParameters));
 
     RANParameter_STRUCTURE_Item *ranp_struct_item3 =
-            (RANParameter_STRUCTURE_Item *) calloc(1, sizeof(RANParameter_STRUCTURE_Item));
+            (RANParameter_STRUCTURE_Item *) asn_arena_calloc(1, sizeof(RANParameter_STRUCTURE_Item));
     ASN_SEQUENCE_ADD(&ranp_struct2->sequence_of_ranParameters->list, ranp_struct_item3);
 
     ranp_struct_item3->ranParameter_ID = 3; // NR Cell as in E2SM-RC v01.02 section 8.4.5.1
-    ranp_struct_item3->ranParameter_valueType = (RANParameter_ValueType_t *) calloc(1, sizeof(RANParameter_ValueType_t));
+    ranp_struct_item3->ranParameter_valueType = (RANParameter_ValueType_t *) asn_arena_calloc(1, sizeof(RANParameter_ValueType_t));
     ranp_struct_item3->ranParameter_valueType->present = RANParameter_ValueType_PR_ranP_Choice_Structure;
     ranp_struct_item3->ranParameter_valueType->choice.ranP_Choice_Structure =
-            (RANParameter_ValueType_Choice_Structure_t *) calloc(1, sizeof(RANParameter_ValueType_Choice_Structure_t));
+            (RANParameter_ValueType_Choice_Structure_t *) asn_arena_calloc(1, sizeof(RANParameter_ValueType_Choice_Structure_t));
 
-    RANParameter_STRUCTURE_t *ranp_struct3 = (RANParameter_STRUCTURE_t *) calloc(1, sizeof(RANParameter_STRUCTURE_t));
+    RANParameter_STRUCTURE_t *ranp_struct3 = (RANParameter_STRUCTURE_t *) asn_arena_calloc(1, sizeof(RANParameter_STRUCTURE_t));
     ranp_struct_item3->ranParameter_valueType->choice.ranP_Choice_Structure->ranParameter_Structure = ranp_struct3;
 
     ranp_struct3->sequence_of_ranParameters =
-            (struct RANParameter_STRUCTURE::RANParameter_STRUCTURE__sequence_of_ranParameters *) calloc(1, sizeof(struct RANParameter_STRUCTURE::RANParameter_STRUCTURE__sequence_of_ranParameters));
+            (struct RANParameter_STRUCTURE::RANParameter_STRUCTURE__sequence_of_ranParameters *) asn_arena_calloc(1, sizeof(struct RANParameter_STRUCTURE::RANParameter_STRUCTURE__sequence_of_ranParameters));
 
-    RANParameter_STRUCTURE_Item_t *ranp_struct_item4 = (RANParameter_STRUCTURE_Item_t *) calloc(1, sizeof(RANParameter_STRUCTURE_Item_t));
+    RANParameter_STRUCTURE_Item_t *ranp_struct_item4 = (RANParameter_STRUCTURE_Item_t *) asn_arena_calloc(1, sizeof(RANParameter_STRUCTURE_Item_t));
     ASN_SEQUENCE_ADD(&ranp_struct3->sequence_of_ranParameters->list, ranp_struct_item4);
 
     ranp_struct_item4->ranParameter_ID = 4; // NR CGI as in E2SM-RC v01.02 section 8.4.5.1
-    ranp_struct_item4->ranParameter_valueType = (RANParameter_ValueType_t *) calloc(1, sizeof(RANParameter_ValueType_t));
+    ranp_struct_item4->ranParameter_valueType = (RANParameter_ValueType_t *) asn_arena_calloc(1, sizeof(RANParameter_ValueType_t));
     ranp_struct_item4->ranParameter_valueType->choice.ranP_Choice_ElementFalse =
-            (RANParameter_ValueType_Choice_ElementFalse_t *) calloc(1, sizeof(RANParameter_ValueType_Choice_ElementFalse_t));
+            (RANParameter_ValueType_Choice_ElementFalse_t *) asn_arena_calloc(1, sizeof(RANParameter_ValueType_Choice_ElementFalse_t));
 
     ranp_struct_item4->ranParameter_valueType->present = RANParameter_ValueType_PR_ranP_Choice_ElementFalse;
 
     ranp_struct_item4->ranParameter_valueType->choice.ranP_Choice_ElementFalse->ranParameter_value =
-            (RANParameter_Value_t *) calloc(1, sizeof(RANParameter_Value_t));
+            (RANParameter_Value_t *) asn_arena_calloc(1, sizeof(RANParameter_Value_t));
 
     ranp_struct_item4->ranParameter_valueType->choice.ranP_Choice_ElementFalse->ranParameter_value->present = RANParameter_Value_PR_valueOctS;
 
-    NR_CGI_t *nr_cgi = (NR_CGI_t *) calloc(1, sizeof(NR_CGI_t));
+    NR_CGI_t *nr_cgi = (NR_CGI_t *) asn_arena_calloc(1, sizeof(NR_CGI_t));
 
     nr_cgi->pLMNIdentity = *plmn_id;    // Is this as same as the plmn id from Global gNodeB IE? or from a given UE?
-    if(plmn_id) free(plmn_id);
+    if(plmn_id) asn_arena_free(plmn_id);
 
     if(gnb_id == NULL) {
         logger_fatal("gnb_id must have a value. nil?");
         exit(1);
     }
 
-    nr_cgi->nRCellIdentity.buf = (uint8_t*)calloc(1,5); // required to have room for 36 bits
+    nr_cgi->nRCellIdentity.buf = (uint8_t*)asn_arena_calloc(1,5); // required to have room for 36 bits
     if(nr_cgi->nRCellIdentity.buf) {
         // currently we use a dummy value for cell id, should we get this from e2sim base class?
         uint8_t cellid = 127; // for now we leave 7 bits to identity cells on each gNodeB, so uint8_t is enough
@@ -234,14 +232,8 @@ void encode_rc_indication_message(E2SM_RC_IndicationMessage_t *ind_msg, PLMNIden
         xer_fprint(stdout, &asn_DEF_NR_CGI, nr_cgi);
     }
 
-    memset(error_buf, 0, sizeof(error_buf));    // ensuring it is clean
-    errlen = 0;
-
     logger_trace("about to check constraints of NR_CGI");
-    ret = asn_check_constraints(&asn_DEF_NR_CGI, nr_cgi, error_buf, &errlen);
-    if(ret != 0) {
-        logger_error("NR_CGI check constraints failed. error length = %lu, error buf = %s", errlen, error_buf);
-    }
+    validate_constraints(&asn_DEF_NR_CGI, nr_cgi);  // according to the validation policy
 
     logger_trace("NR_CGI set up");
 
@@ -300,30 +292,30 @@ void encode_rc_indication_header(E2SM_RC_IndicationHeader_t *ind_header, PLMNIde
     logger_trace("in %s function", __func__);
 
     ind_header->ric_indicationHeader_formats.choice.indicationHeader_Format2 =
-            (E2SM_RC_IndicationHeader_Format2_t *) calloc(1, sizeof(E2SM_RC_IndicationHeader_Format2_t));
+            (E2SM_RC_IndicationHeader_Format2_t *) asn_arena_calloc(1, sizeof(E2SM_RC_IndicationHeader_Format2_t));
     ind_header->ric_indicationHeader_formats.present =
             E2SM_RC_IndicationHeader__ric_indicationHeader_formats_PR_indicationHeader_Format2;
     ind_header->ric_indicationHeader_formats.choice.indicationHeader_Format2->ric_InsertStyle_Type = 4;
     ind_header->ric_indicationHeader_formats.choice.indicationHeader_Format2->ric_InsertIndication_ID = 1;
 
-    UEID_GNB_t *ueid_gnb = (UEID_GNB_t *) calloc(1, sizeof(UEID_GNB_t));
+    UEID_GNB_t *ueid_gnb = (UEID_GNB_t *) asn_arena_calloc(1, sizeof(UEID_GNB_t));
     ASN_STRUCT_RESET(asn_DEF_UEID_GNB, ueid_gnb);
     ind_header->ric_indicationHeader_formats.choice.indicationHeader_Format2->ueID.choice.gNB_UEID = ueid_gnb;
     ind_header->ric_indicationHeader_formats.choice.indicationHeader_Format2->ueID.present = UEID_PR_gNB_UEID;
     // an integer between 0..2^40-1, but we only alloc 1 byte to store values between 0..255
-    ueid_gnb->amf_UE_NGAP_ID.buf = (uint8_t *) calloc(1, sizeof(uint8_t));
+    ueid_gnb->amf_UE_NGAP_ID.buf = (uint8_t *) asn_arena_calloc(1, sizeof(uint8_t));
     ueid_gnb->amf_UE_NGAP_ID.buf[0] = (uint8_t) 1;
     ueid_gnb->amf_UE_NGAP_ID.size = sizeof(uint8_t);
 
     ueid_gnb->guami.pLMNIdentity = *plmn_id;    // Is this as same as the plmn id from Global gNodeB IE? or from a given UE?
-    if (plmn_id) free(plmn_id);
+    if (plmn_id) asn_arena_free(plmn_id);
 
-    ueid_gnb->guami.aMFRegionID.buf = (uint8_t *) calloc(1, sizeof(uint8_t)); // (8 bits)
+    ueid_gnb->guami.aMFRegionID.buf = (uint8_t *) asn_arena_calloc(1, sizeof(uint8_t)); // (8 bits)
     ueid_gnb->guami.aMFRegionID.buf[0] = (uint8_t) 128; // this is a dummy value
     ueid_gnb->guami.aMFRegionID.size = 1;
     ueid_gnb->guami.aMFRegionID.bits_unused = 0;
 
-    ueid_gnb->guami.aMFSetID.buf = (uint8_t *) calloc(2, sizeof(uint8_t)); // (10 bits)
+    ueid_gnb->guami.aMFSetID.buf = (uint8_t *) asn_arena_calloc(2, sizeof(uint8_t)); // (10 bits)
     uint16_t v = (uint16_t) 4; // this is a dummy vale (uint16_t is required to have room for 10 bits)
     v = v << 6; // we are only interested in 10 bits, so rotate them to the correct place
     ueid_gnb->guami.aMFSetID.buf[0] = (v >> 8); // only interested in the most significant bits (& 0x00ff only required for signed)
@@ -331,19 +323,13 @@ void encode_rc_indication_header(E2SM_RC_IndicationHeader_t *ind_header, PLMNIde
     ueid_gnb->guami.aMFSetID.size = 2;
     ueid_gnb->guami.aMFSetID.bits_unused = 6;
 
-    ueid_gnb->guami.aMFPointer.buf = (uint8_t *) calloc(1, sizeof(uint8_t)); // (6 bits)
+    ueid_gnb->guami.aMFPointer.buf = (uint8_t *) asn_arena_calloc(1, sizeof(uint8_t)); // (6 bits)
     ueid_gnb->guami.aMFPointer.buf[0] = (uint8_t) 1 << 2; // this is a dummy value
     ueid_gnb->guami.aMFPointer.size = 1;
     ueid_gnb->guami.aMFPointer.bits_unused = 2;
 
-    char error_buf[300] = {0, };
-    size_t errlen = 0;
-
     logger_trace("about to check constraints of E2SM_RC_IndicationHeader");
-    int ret = asn_check_constraints(&asn_DEF_E2SM_RC_IndicationHeader, ind_header, error_buf, &errlen);
-    if(ret != 0) {
-        printf("E2SM_RC_IndicationHeader check constraints failed. error length = %lu, error buf = %s", errlen, error_buf);
-    }
+    validate_constraints(&asn_DEF_E2SM_RC_IndicationHeader, ind_header);  // according to the validation policy
 
     logger_trace("E2SM_RC_IndicationHeader set up");
 
@@ -0,0 +1,126 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#include <netinet/in.h>
+#include <netinet/sctp.h>
+
+#include "failover_tracker.hpp"
+#include "rc_callbacks.hpp"
+#include "logger.h"
+
+FailoverTracker::FailoverTracker(Histogram *failover_seconds, Counter *failures, Counter *delayed, Counter *lost) {
+    this->failover_seconds = failover_seconds;
+    this->failures = failures;
+    this->delayed = delayed;
+    this->lost = lost;
+
+    failing = false;
+    recovering = false;
+    has_control = false;
+    has_sent = false;
+    last_control_ns = 0;
+    last_control_cpid = 0;
+    last_sent_cpid = 0;
+    gap_start_ns = 0;
+    gap_first_cpid = 0;
+    gap_last_cpid = 0;
+    gap_delayed = 0;
+}
+
+/*
+    Starts a failover when the primary path becomes unreachable. Runs in the reactor thread.
+*/
+void FailoverTracker::path_event(const std::string &addr, int state, bool primary, struct timespec *ts) {
+    if (state != SCTP_ADDR_UNREACHABLE || !primary) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (failing) {
+        return;     // still waiting for the current failover
+    }
+
+    if (recovering) {
+        finish_recovery();  // a new failure might happen before accounting for all messages of the previous one
+    }
+
+    failing = true;
+    gap_start_ns = has_control ? last_control_ns : elapsed_nanoseconds(*ts);
+    gap_first_cpid = has_control ? last_control_cpid + 1 : 0;
+    gap_delayed = 0;
+
+    failures->Increment();
+
+    logger_warn("Primary path to %s has failed, waiting for the Insert-Control loop to recover", addr.c_str());
+}
+
+/*
+    Keeps track of the last INSERT sent, so that the INSERT messages of the failover gap are known
+*/
+void FailoverTracker::insert_sent(unsigned int cpid) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    last_sent_cpid = cpid;
+    has_sent = true;
+}
+
+/*
+    Finishes the failover on the first CONTROL received after the failure, and accounts
+    for the INSERT messages of the failover gap. Runs in the reactor thread.
+*/
+void FailoverTracker::control_received(unsigned int cpid, unsigned long sent_ns, unsigned long recv_ns) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (failing) {
+        double seconds = elapsed_seconds(gap_start_ns, recv_ns);
+        failover_seconds->Observe(seconds);
+
+        failing = false;
+        recovering = true;
+        gap_last_cpid = has_sent ? last_sent_cpid : cpid;
+
+        logger_warn("Insert-Control loop has recovered from a path failure in %.3fms", seconds * 1000);
+    }
+
+    if (recovering) {
+        if (cpid >= gap_first_cpid && cpid <= gap_last_cpid) {
+            gap_delayed++;
+            delayed->Increment();
+        } else if (cpid > gap_last_cpid) {
+            finish_recovery();  // all INSERT messages of the gap that were still to be answered are lost
+        }
+    }
+
+    last_control_ns = recv_ns;
+    last_control_cpid = cpid;
+    has_control = true;
+}
+
+/*
+    Accounts for the INSERT messages of the failover gap that have not been answered. Requires lock.
+*/
+void FailoverTracker::finish_recovery() {
+    unsigned long gap_size = gap_last_cpid >= gap_first_cpid ? gap_last_cpid - gap_first_cpid + 1 : 0;
+    unsigned long gap_lost = gap_size > gap_delayed ? gap_size - gap_delayed : 0;
+
+    lost->Increment(gap_lost);
+    recovering = false;
+
+    logger_info("Path failover: %lu INSERT messages delayed and %lu lost", gap_delayed, gap_lost);
+}
@@ -0,0 +1,78 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#ifndef FAILOVER_TRACKER_HPP
+#define FAILOVER_TRACKER_HPP
+
+#include <mutex>
+#include <string>
+#include <prometheus/histogram.h>
+#include <prometheus/counter.h>
+
+using namespace prometheus;
+
+/*
+    Measures how much of the Insert-Control loop is lost when the primary path
+    of a multihomed SCTP association fails.
+
+    The failover time is the gap between the last CONTROL received before the
+    primary path has been reported unreachable and the first CONTROL received after it.
+    INSERT messages sent within this gap are delayed if their CONTROL is still received,
+    or lost otherwise. They are accounted for once the CONTROL of an INSERT sent
+    after the failover is received.
+*/
+class FailoverTracker {
+
+private:
+
+    std::mutex lock;
+
+    bool failing;           // the primary path is unreachable and no CONTROL has been received since then
+    bool recovering;        // the failover has finished and INSERT messages of its gap are being accounted for
+    bool has_control;       // at least one CONTROL has been received
+    bool has_sent;          // at least one INSERT has been sent
+
+    unsigned long last_control_ns;      // time of the last CONTROL received
+    unsigned int last_control_cpid;     // cpid of the last CONTROL received
+    unsigned int last_sent_cpid;        // cpid of the last INSERT sent
+
+    unsigned long gap_start_ns;         // time of the last CONTROL received before the failure
+    unsigned int gap_first_cpid;        // first INSERT sent within the failover gap
+    unsigned int gap_last_cpid;         // last INSERT sent within the failover gap
+    unsigned long gap_delayed;          // INSERT messages of the gap whose CONTROL has been received
+
+    Histogram *failover_seconds;
+    Counter *failures;
+    Counter *delayed;
+    Counter *lost;
+
+    void finish_recovery();
+
+public:
+
+    FailoverTracker(Histogram *failover_seconds, Counter *failures, Counter *delayed, Counter *lost);
+
+    void path_event(const std::string &addr, int state, bool primary, struct timespec *ts);
+
+    void insert_sent(unsigned int cpid);
+
+    void control_received(unsigned int cpid, unsigned long sent_ns, unsigned long recv_ns);
+
+};
+
+#endif
@@ -0,0 +1,583 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+
+#include "metrics_relay.hpp"
+#include "logger.h"
+
+/*
+    Snapshots are framed as a 32-bit length followed by the worker id and its families. Values are kept in the
+    host byte order, since the coordinator and its workers always run on the same box.
+*/
+
+static void put_raw(std::string &out, const void *value, size_t len) {
+    out.append((const char *) value, len);
+}
+
+static void put_u32(std::string &out, uint32_t value) {
+    put_raw(out, &value, sizeof(value));
+}
+
+static void put_u64(std::string &out, uint64_t value) {
+    put_raw(out, &value, sizeof(value));
+}
+
+static void put_double(std::string &out, double value) {
+    put_raw(out, &value, sizeof(value));
+}
+
+static void put_string(std::string &out, const std::string &value) {
+    put_u32(out, value.size());
+    out.append(value);
+}
+
+typedef struct {
+    const uint8_t *ptr;
+    const uint8_t *end;
+} reader_t;
+
+static bool get_raw(reader_t &in, void *value, size_t len) {
+    if ((size_t) (in.end - in.ptr) < len) {
+        return false;
+    }
+    memcpy(value, in.ptr, len);
+    in.ptr += len;
+    return true;
+}
+
+static bool get_u32(reader_t &in, uint32_t &value) {
+    return get_raw(in, &value, sizeof(value));
+}
+
+static bool get_u64(reader_t &in, uint64_t &value) {
+    return get_raw(in, &value, sizeof(value));
+}
+
+static bool get_double(reader_t &in, double &value) {
+    return get_raw(in, &value, sizeof(value));
+}
+
+static bool get_string(reader_t &in, std::string &value) {
+    uint32_t len;
+    if (!get_u32(in, len) || (size_t) (in.end - in.ptr) < len) {
+        return false;
+    }
+    value.assign((const char *) in.ptr, len);
+    in.ptr += len;
+    return true;
+}
+
+/*
+    Appends a frame with the families of a worker to frame
+
+    Returns false if the families do not fit in a single frame
+*/
+bool metrics_relay_encode(uint32_t worker_id, const std::vector<MetricFamily> &families, std::string &frame) {
+    size_t start = frame.size();
+    put_u32(frame, 0);  // length, set once the payload is done
+    put_u32(frame, worker_id);
+    put_u32(frame, families.size());
+
+    for (const MetricFamily &family : families) {
+        put_string(frame, family.name);
+        put_string(frame, family.help);
+        put_u32(frame, (uint32_t) family.type);
+        put_u32(frame, family.metric.size());
+
+        for (const ClientMetric &metric : family.metric) {
+            put_u32(frame, metric.label.size());
+            for (const ClientMetric::Label &label : metric.label) {
+                put_string(frame, label.name);
+                put_string(frame, label.value);
+            }
+            put_u64(frame, metric.timestamp_ms);
+
+            switch (family.type) {
+                case MetricType::Counter:
+                    put_double(frame, metric.counter.value);
+                    break;
+                case MetricType::Gauge:
+                    put_double(frame, metric.gauge.value);
+                    break;
+                case MetricType::Summary:
+                    put_u64(frame, metric.summary.sample_count);
+                    put_double(frame, metric.summary.sample_sum);
+                    put_u32(frame, metric.summary.quantile.size());
+                    for (const ClientMetric::Quantile &quantile : metric.summary.quantile) {
+                        put_double(frame, quantile.quantile);
+                        put_double(frame, quantile.value);
+                    }
+                    break;
+                case MetricType::Histogram:
+                    put_u64(frame, metric.histogram.sample_count);
+                    put_double(frame, metric.histogram.sample_sum);
+                    put_u32(frame, metric.histogram.bucket.size());
+                    for (const ClientMetric::Bucket &bucket : metric.histogram.bucket) {
+                        put_u64(frame, bucket.cumulative_count);
+                        put_double(frame, bucket.upper_bound);
+                    }
+                    break;
+                case MetricType::Untyped:
+                    put_double(frame, metric.untyped.value);
+                    break;
+                default:
+                    break;  // labels only (e.g. info)
+            }
+        }
+    }
+
+    size_t len = frame.size() - start - sizeof(uint32_t);
+    if (len > METRICS_RELAY_MAX_FRAME) {
+        frame.resize(start);
+        return false;
+    }
+    uint32_t len32 = len;
+    memcpy(&frame[start], &len32, sizeof(len32));
+
+    return true;
+}
+
+/*
+    Decodes the payload of a frame, i.e. without its length
+
+    Returns false if the payload is truncated or malformed
+*/
+bool metrics_relay_decode(const uint8_t *buf, size_t len, uint32_t &worker_id, std::vector<MetricFamily> &families) {
+    reader_t in = {buf, buf + len};
+    uint32_t num_families;
+
+    if (!get_u32(in, worker_id) || !get_u32(in, num_families)) {
+        return false;
+    }
+
+    families.clear();
+    for (uint32_t i = 0; i < num_families; i++) {
+        families.emplace_back();
+        MetricFamily &family = families.back();
+        uint32_t type, num_metrics;
+
+        if (!get_string(in, family.name) || !get_string(in, family.help) ||
+                !get_u32(in, type) || type > (uint32_t) MetricType::Info || !get_u32(in, num_metrics)) {
+            return false;
+        }
+        family.type = (MetricType) type;
+
+        for (uint32_t j = 0; j < num_metrics; j++) {
+            family.metric.emplace_back();
+            ClientMetric &metric = family.metric.back();
+            uint32_t num_labels, count;
+            uint64_t timestamp;
+
+            if (!get_u32(in, num_labels)) {
+                return false;
+            }
+            for (uint32_t k = 0; k < num_labels; k++) {
+                metric.label.emplace_back();
+                if (!get_string(in, metric.label.back().name) || !get_string(in, metric.label.back().value)) {
+                    return false;
+                }
+            }
+            if (!get_u64(in, timestamp)) {
+                return false;
+            }
+            metric.timestamp_ms = timestamp;
+
+            bool ok = true;
+            switch (family.type) {
+                case MetricType::Counter:
+                    ok = get_double(in, metric.counter.value);
+                    break;
+                case MetricType::Gauge:
+                    ok = get_double(in, metric.gauge.value);
+                    break;
+                case MetricType::Summary:
+                    ok = get_u64(in, metric.summary.sample_count) && get_double(in, metric.summary.sample_sum) &&
+                         get_u32(in, count);
+                    for (uint32_t k = 0; ok && k < count; k++) {
+                        metric.summary.quantile.emplace_back();
+                        ok = get_double(in, metric.summary.quantile.back().quantile) &&
+                             get_double(in, metric.summary.quantile.back().value);
+                    }
+                    break;
+                case MetricType::Histogram:
+                    ok = get_u64(in, metric.histogram.sample_count) && get_double(in, metric.histogram.sample_sum) &&
+                         get_u32(in, count);
+                    for (uint32_t k = 0; ok && k < count; k++) {
+                        metric.histogram.bucket.emplace_back();
+                        ok = get_u64(in, metric.histogram.bucket.back().cumulative_count) &&
+                             get_double(in, metric.histogram.bucket.back().upper_bound);
+                    }
+                    break;
+                case MetricType::Untyped:
+                    ok = get_double(in, metric.untyped.value);
+                    break;
+                default:
+                    break;
+            }
+            if (!ok) {
+                return false;
+            }
+        }
+    }
+
+    return in.ptr == in.end;
+}
+
+static bool fill_unix_address(const std::string &path, struct sockaddr_un &addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        logger_error("[Metrics] socket path %s is too long", path.c_str());
+        return false;
+    }
+    strcpy(addr.sun_path, path.c_str());
+    return true;
+}
+
+MetricsRelay::MetricsRelay(Reactor *reactor, std::shared_ptr<Collectable> collectable, const std::string &path,
+                           uint32_t worker_id, unsigned long period_ms) {
+    this->reactor = reactor;
+    this->collectable = collectable;
+    this->path = path;
+    this->worker_id = worker_id;
+    this->period_us = period_ms * 1000;
+
+    fd = -1;
+    timer = 0;
+    stopped = false;
+}
+
+MetricsRelay::~MetricsRelay() {
+    stop();
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+/*
+    Starts pushing snapshots from the reactor thread, the first one right away
+*/
+void MetricsRelay::start() {
+    std::lock_guard<std::mutex> guard(lock);
+    stopped = false;
+    timer = reactor->schedule(0, std::bind(&MetricsRelay::tick, this));
+}
+
+/*
+    Stops the periodic snapshots, waiting for a running one to finish
+*/
+void MetricsRelay::stop() {
+    reactor_timer_t pending;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopped = true;
+        pending = timer;
+        timer = 0;
+    }
+    reactor->cancel(pending);
+}
+
+/*
+    Pushes a snapshot right away, e.g. the final values of a worker once its shards have stopped
+
+    Returns false if the snapshot could not be sent
+*/
+bool MetricsRelay::flush() {
+    std::lock_guard<std::mutex> guard(lock);
+    return push();
+}
+
+void MetricsRelay::tick() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (stopped) {
+        return;
+    }
+    push();
+    timer = reactor->schedule(period_us, std::bind(&MetricsRelay::tick, this));
+}
+
+/*
+    Connects to the coordinator. Sends are bounded by a timeout, so a stuck coordinator cannot stall the reactor.
+    Requires lock.
+*/
+bool MetricsRelay::connect_socket() {
+    struct sockaddr_un addr;
+    if (!fill_unix_address(path, addr)) {
+        return false;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        logger_error("[Metrics] unable to create socket: %s", strerror(errno));
+        return false;
+    }
+
+    struct timeval timeout = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+        logger_debug("[Metrics] unable to connect to %s: %s", path.c_str(), strerror(errno));
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    logger_info("[Metrics] worker %u relays its metrics to %s", worker_id, path.c_str());
+    return true;
+}
+
+/*
+    Sends a snapshot of the collectable, reconnecting if required. Requires lock.
+*/
+bool MetricsRelay::push() {
+    std::shared_ptr<Collectable> source = collectable.lock();
+    if (!source) {
+        return false;
+    }
+
+    std::string frame;
+    if (!metrics_relay_encode(worker_id, source->Collect(), frame)) {
+        logger_error("[Metrics] snapshot of worker %u is too large", worker_id);
+        return false;
+    }
+
+    if (fd == -1 && !connect_socket()) {
+        return false;
+    }
+
+    size_t sent = 0;
+    while (sent < frame.size()) {
+        ssize_t ret = send(fd, frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logger_warn("[Metrics] unable to send the metrics of worker %u: %s", worker_id, strerror(errno));
+            close(fd);  // a partial frame can only be discarded by dropping the connection
+            fd = -1;
+            return false;
+        }
+        sent += ret;
+    }
+
+    return true;
+}
+
+void MergedCollectable::update(uint32_t worker_id, std::vector<MetricFamily> &&families) {
+    std::lock_guard<std::mutex> guard(lock);
+    snapshots[worker_id] = std::move(families);
+}
+
+void MergedCollectable::remove(uint32_t worker_id) {
+    std::lock_guard<std::mutex> guard(lock);
+    snapshots.erase(worker_id);
+}
+
+size_t MergedCollectable::workers() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return snapshots.size();
+}
+
+/*
+    Returns the families of all workers, in the order they first appear, with the series of each worker labelled with its id
+*/
+std::vector<MetricFamily> MergedCollectable::Collect() const {
+    std::lock_guard<std::mutex> guard(lock);
+
+    std::vector<MetricFamily> merged;
+    std::unordered_map<std::string, size_t> index;  // family name to its position in merged
+
+    for (auto &snapshot : snapshots) {
+        std::string worker = std::to_string(snapshot.first);
+
+        for (const MetricFamily &family : snapshot.second) {
+            auto it = index.find(family.name);
+            if (it == index.end()) {
+                it = index.emplace(family.name, merged.size()).first;
+                merged.emplace_back();
+                merged.back().name = family.name;
+                merged.back().help = family.help;
+                merged.back().type = family.type;
+            }
+
+            MetricFamily &target = merged[it->second];
+            if (target.type != family.type) {
+                continue;   // different workers disagree on the family, which prometheus would reject
+            }
+            for (const ClientMetric &metric : family.metric) {
+                target.metric.push_back(metric);
+                ClientMetric::Label label;
+                label.name = "WORKER";
+                label.value = worker;
+                target.metric.back().label.push_back(label);
+            }
+        }
+    }
+
+    return merged;
+}
+
+MetricsCollector::MetricsCollector(Reactor *reactor, std::shared_ptr<MergedCollectable> merged, const std::string &path) {
+    this->reactor = reactor;
+    this->merged = merged;
+    this->path = path;
+
+    listen_fd = -1;
+}
+
+MetricsCollector::~MetricsCollector() {
+    if (listen_fd != -1) {
+        reactor->remove(listen_fd);
+        close(listen_fd);
+        unlink(path.c_str());
+    }
+
+    std::vector<int> fds;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto &conn : conns) {
+            fds.push_back(conn.first);
+        }
+    }
+    for (int fd : fds) {
+        close_conn(fd);
+    }
+}
+
+/*
+    Listens on the Unix domain socket, replacing a stale socket file left by a previous run
+
+    Returns false on error
+*/
+bool MetricsCollector::start() {
+    struct sockaddr_un addr;
+    if (!fill_unix_address(path, addr)) {
+        return false;
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
+        logger_error("[Metrics] unable to create socket: %s", strerror(errno));
+        return false;
+    }
+
+    unlink(path.c_str());
+    if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) == -1 || listen(listen_fd, SOMAXCONN) == -1) {
+        logger_error("[Metrics] unable to listen on %s: %s", path.c_str(), strerror(errno));
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    reactor->add(listen_fd, EPOLLIN, std::bind(&MetricsCollector::handle_accept, this, std::placeholders::_1));
+    logger_info("[Metrics] collecting the metrics of the workers on %s", path.c_str());
+
+    return true;
+}
+
+void MetricsCollector::handle_accept(uint32_t events) {
+    while (true) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                logger_warn("[Metrics] unable to accept a worker: %s", strerror(errno));
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            conns[fd].clear();
+        }
+        reactor->add(fd, EPOLLIN | EPOLLRDHUP, std::bind(&MetricsCollector::handle_read, this, fd, std::placeholders::_1));
+    }
+}
+
+/*
+    Reads all available bytes of a worker and decodes its complete frames, only the last snapshot is kept
+*/
+void MetricsCollector::handle_read(int fd, uint32_t events) {
+    std::unique_lock<std::mutex> lk(lock);
+    auto it = conns.find(fd);
+    if (it == conns.end()) {
+        return;
+    }
+    std::vector<uint8_t> &buf = it->second;
+
+    bool closed = false;
+    uint8_t chunk[65536];
+    while (true) {
+        ssize_t ret = recv(fd, chunk, sizeof(chunk), 0);
+        if (ret > 0) {
+            buf.insert(buf.end(), chunk, chunk + ret);
+        } else if (ret == 0) {
+            closed = true;
+            break;
+        } else if (errno == EINTR) {
+            continue;
+        } else {
+            closed = errno != EAGAIN && errno != EWOULDBLOCK;
+            break;
+        }
+    }
+
+    size_t offset = 0;
+    while (buf.size() - offset >= sizeof(uint32_t)) {
+        uint32_t len;
+        memcpy(&len, buf.data() + offset, sizeof(len));
+        if (len > METRICS_RELAY_MAX_FRAME) {
+            logger_error("[Metrics] invalid frame of %u bytes, dropping the worker connection", len);
+            closed = true;
+            break;
+        }
+        if (buf.size() - offset - sizeof(len) < len) {
+            break;  // incomplete
+        }
+
+        uint32_t worker_id;
+        std::vector<MetricFamily> families;
+        if (metrics_relay_decode(buf.data() + offset + sizeof(len), len, worker_id, families)) {
+            merged->update(worker_id, std::move(families));
+        } else {
+            logger_warn("[Metrics] discarding a malformed snapshot");
+        }
+        offset += sizeof(len) + len;
+    }
+    buf.erase(buf.begin(), buf.begin() + offset);
+
+    lk.unlock();
+
+    if (closed) {
+        close_conn(fd);
+    }
+}
+
+void MetricsCollector::close_conn(int fd) {
+    reactor->remove(fd);
+    close(fd);
+
+    std::lock_guard<std::mutex> guard(lock);
+    conns.erase(fd);
+}
@@ -0,0 +1,144 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#ifndef METRICS_RELAY_HPP
+#define METRICS_RELAY_HPP
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include <prometheus/collectable.h>
+#include <prometheus/metric_family.h>
+
+#include "reactor.hpp"
+
+using namespace prometheus;
+
+#define METRICS_RELAY_PERIOD_MS 1000            // default time between two snapshots pushed by a worker
+#define METRICS_RELAY_MAX_FRAME (64 << 20)      // larger frames are taken as a corrupted stream
+
+bool metrics_relay_encode(uint32_t worker_id, const std::vector<MetricFamily> &families, std::string &frame);
+bool metrics_relay_decode(const uint8_t *buf, size_t len, uint32_t &worker_id, std::vector<MetricFamily> &families);
+
+/*
+    Pushes the metrics of a worker process to the coordinator (see MetricsCollector) over a Unix domain socket.
+
+    Each snapshot is the whole content of the collectable (e.g. the prometheus registry of the worker), sent as a
+    single frame every period. Counters and histograms are cumulative, so a lost snapshot only delays the values
+    seen by the coordinator. The relay connects lazily and reconnects on the next period if the coordinator is not
+    reachable. Snapshots are taken and sent in the reactor thread.
+*/
+class MetricsRelay {
+
+private:
+
+    std::mutex lock;    // guards the socket and the timer, flush() might run from another thread
+
+    Reactor *reactor;
+    std::weak_ptr<Collectable> collectable;
+    std::string path;
+    uint32_t worker_id;
+    unsigned long period_us;
+
+    int fd;
+    reactor_timer_t timer;
+    bool stopped;
+
+    bool connect_socket();
+    bool push();
+    void tick();
+
+public:
+
+    MetricsRelay(Reactor *reactor, std::shared_ptr<Collectable> collectable, const std::string &path,
+                 uint32_t worker_id, unsigned long period_ms = METRICS_RELAY_PERIOD_MS);
+
+    ~MetricsRelay();
+
+    void start();
+
+    void stop();
+
+    bool flush();
+
+};
+
+/*
+    Merges the last snapshot of each worker into a single collectable, exposed by the coordinator.
+
+    Each worker runs its own E2 nodes and shards, so the series of different workers might only differ by
+    their shard index. The merged series are therefore labelled with the WORKER that produced them, and
+    families with the same name are exposed once, with the series of all workers.
+*/
+class MergedCollectable : public Collectable {
+
+private:
+
+    mutable std::mutex lock;
+    std::map<uint32_t, std::vector<MetricFamily>> snapshots;    // ordered by worker
+
+public:
+
+    void update(uint32_t worker_id, std::vector<MetricFamily> &&families);
+
+    void remove(uint32_t worker_id);
+
+    size_t workers() const;
+
+    std::vector<MetricFamily> Collect() const override;
+
+};
+
+/*
+    Receives the snapshots pushed by the MetricsRelay of each worker and hands them to a MergedCollectable.
+
+    It listens on a Unix domain socket, and all connections are served by a single reactor. The snapshot of
+    a worker is kept when its connection closes, so the final values of a finished worker are still exposed.
+*/
+class MetricsCollector {
+
+private:
+
+    std::mutex lock;
+
+    Reactor *reactor;
+    std::shared_ptr<MergedCollectable> merged;
+    std::string path;
+    int listen_fd;
+
+    std::unordered_map<int, std::vector<uint8_t>> conns;    // bytes received and not decoded yet, by socket
+
+    void handle_accept(uint32_t events);
+    void handle_read(int fd, uint32_t events);
+    void close_conn(int fd);
+
+public:
+
+    MetricsCollector(Reactor *reactor, std::shared_ptr<MergedCollectable> merged, const std::string &path);
+
+    ~MetricsCollector();
+
+    bool start();
+
+};
+
+#endif
@@ -0,0 +1,155 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#include "ramp_scheduler.hpp"
+#include "logger.h"
+
+/*
+    A rate of 0 (or less) starts all nodes right away
+*/
+RampScheduler::RampScheduler(Reactor *reactor, double rate, unsigned long jitter_us, unsigned int max_inflight,
+                             unsigned int seed, Gauge *inflight_gauge, Gauge *all_seconds) : rng(seed) {
+    this->reactor = reactor;
+    this->interval_ns = rate > 0 ? (unsigned long) (1000000000.0 / rate) : 0;
+    this->jitter_us = jitter_us;
+    this->max_inflight = max_inflight;
+    this->inflight_gauge = inflight_gauge;
+    this->all_seconds = all_seconds;
+
+    total = 0;
+    inflight = 0;
+    connected = 0;
+    failed = 0;
+    has_due = false;
+    waiting_slot = false;
+    idle = false;
+    startup_done = false;
+    batch_total = 0;
+}
+
+/*
+    Adds a node to start. Nodes added after start() are started by the reactor thread at the same pace.
+*/
+void RampScheduler::add(RampStart start) {
+    std::lock_guard<std::mutex> guard(lock);
+    pending.push_back(start);
+    total++;
+    if (batch_total++ == 0) {
+        batch_start = std::chrono::steady_clock::now();    // start() overrides it for the nodes added before it
+    }
+
+    if (idle) {
+        idle = false;
+        reactor->schedule(0, std::bind(&RampScheduler::pump, this));
+    }
+}
+
+/*
+    Starts the ramp in the reactor thread
+*/
+void RampScheduler::start() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        start_time = std::chrono::steady_clock::now();
+        batch_start = start_time;
+        next_start = start_time;
+    }
+
+    logger_info("[Ramp] Starting %u E2 nodes at %.1f nodes/s with %lu us of jitter and %u in-flight E2 setups at most",
+                total, interval_ns > 0 ? 1000000000.0 / interval_ns : 0.0, jitter_us, max_inflight);
+
+    reactor->schedule(0, std::bind(&RampScheduler::pump, this));
+}
+
+/*
+    Starts the nodes that are due, and schedules itself for the next one. Runs in the reactor thread.
+*/
+void RampScheduler::pump() {
+    std::unique_lock<std::mutex> lk(lock);
+
+    while (!pending.empty()) {
+        if (max_inflight > 0 && inflight >= max_inflight) {
+            waiting_slot = true;    // finished() pumps again
+            return;
+        }
+
+        if (!has_due) {
+            next_due = next_start;
+            if (jitter_us > 0) {
+                next_due += std::chrono::microseconds(std::uniform_int_distribution<unsigned long>(0, jitter_us)(rng));
+            }
+            has_due = true;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now < next_due) {
+            unsigned long delay_us = std::chrono::duration_cast<std::chrono::microseconds>(next_due - now).count();
+            reactor->schedule(delay_us, std::bind(&RampScheduler::pump, this));
+            return;
+        }
+
+        RampStart start = pending.front();
+        pending.pop_front();
+        has_due = false;
+        inflight++;
+        inflight_gauge->Set(inflight);
+
+        // counts from the actual start without its jitter, so nodes held back (e.g. by max_inflight) do not start in a burst
+        if (interval_ns > 0) {
+            next_start = now - (next_due - next_start) + std::chrono::nanoseconds(interval_ns);
+        }
+
+        lk.unlock();
+        start();    // might call finished() right away if the node cannot connect
+        lk.lock();
+    }
+
+    idle = true;
+}
+
+/*
+    Reports that a started node has finished its E2 setup, either connected or failed.
+    Nodes that have not been started by this scheduler must not be reported.
+*/
+void RampScheduler::finished(bool connected) {
+    std::unique_lock<std::mutex> lk(lock);
+
+    inflight--;
+    inflight_gauge->Set(inflight);
+    if (connected) {
+        this->connected++;
+    } else {
+        failed++;
+    }
+
+    if (waiting_slot) {
+        waiting_slot = false;
+        reactor->schedule(0, std::bind(&RampScheduler::pump, this));
+    }
+
+    if (this->connected + failed == total) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - batch_start).count();
+        if (!startup_done) {
+            all_seconds->Set(elapsed);
+            startup_done = true;
+        }
+        logger_force(LOGGER_INFO, "[Ramp] All %u E2 nodes have finished the E2 setup in %.3f seconds (%u connected, %u failed since start)",
+                     batch_total, elapsed, this->connected, failed);
+        batch_total = 0;
+    }
+}
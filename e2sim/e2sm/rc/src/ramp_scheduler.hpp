@@ -0,0 +1,93 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#ifndef RAMP_SCHEDULER_HPP
+#define RAMP_SCHEDULER_HPP
+
+#include <deque>
+#include <mutex>
+#include <random>
+#include <chrono>
+#include <functional>
+#include <prometheus/gauge.h>
+
+#include "reactor.hpp"
+
+using namespace prometheus;
+
+typedef std::function<void()> RampStart;     // starts connecting an E2 node
+
+/*
+    Starts connecting E2 nodes at a controlled pace, so the RIC does not receive all E2 setups at once.
+
+    Nodes are started in the order they are added, at most rate nodes per second. Each start is delayed
+    by a random jitter, drawn from a seeded generator so runs are reproducible. At most max_inflight nodes
+    are connecting at the same time, so each node has to report the outcome of its E2 setup (see finished)
+    to let the next ones start. The pace is kept by a single reactor, so no thread is created.
+
+    Once all nodes have finished their E2 setup, the time from start() is set to the all_seconds gauge.
+    Nodes added after start() (e.g. reconnecting to another E2Term on handover) are paced the same way,
+    but they do not change the all_seconds gauge.
+*/
+class RampScheduler {
+
+private:
+
+    std::mutex lock;
+
+    Reactor *reactor;
+    unsigned long interval_ns;      // time between two starts, 0 starts them right away
+    unsigned long jitter_us;        // maximum random delay of each start
+    unsigned int max_inflight;      // 0 does not limit the nodes connecting at the same time
+    std::mt19937 rng;
+
+    std::deque<RampStart> pending;  // nodes not started yet
+    unsigned int total;
+    unsigned int inflight;          // started nodes whose E2 setup has not finished yet
+    unsigned int connected;
+    unsigned int failed;
+
+    std::chrono::steady_clock::time_point start_time;
+    std::chrono::steady_clock::time_point next_start;   // earliest start of the next node, without jitter
+    std::chrono::steady_clock::time_point next_due;     // start of the next node, with jitter
+    bool has_due;                   // next_due has been drawn for the next node
+    bool waiting_slot;              // the next node waits for a node to finish its E2 setup
+    bool idle;                      // started and out of pending nodes, so add() pumps again
+    bool startup_done;              // all nodes added before start() have finished their E2 setup
+    std::chrono::steady_clock::time_point batch_start;  // first start of the nodes of batch_total
+    unsigned int batch_total;       // nodes added since all previous ones have finished their E2 setup
+
+    Gauge *inflight_gauge;
+    Gauge *all_seconds;
+
+    void pump();
+
+public:
+
+    RampScheduler(Reactor *reactor, double rate, unsigned long jitter_us, unsigned int max_inflight,
+                  unsigned int seed, Gauge *inflight_gauge, Gauge *all_seconds);
+
+    void add(RampStart start);
+
+    void start();
+
+    void finished(bool connected);
+
+};
+
+#endif
@@ -47,16 +47,17 @@ extern "C"
 #include "e2sim.hpp"
 #include "e2sim_defs.h"
 #include "encode_e2ap.hpp"
+#include "fast_aper.hpp"
 
 using namespace std;
 using namespace prometheus;
 
-void callback_rc_subscription_request(E2AP_PDU_t *sub_req_pdu, E2Sim *e2sim, InsertLoopCallback run_insert_loop, e2sm_rc_subscription_t *current_sub) {
+void callback_rc_subscription_request(E2AP_PDU_t *sub_req_pdu, E2Sim *e2sim, AddSubscriptionCallback add_subscription, InsertLoopCallback run_insert_loop) {
     // Record RIC Request ID
     // Go through RIC action to be Setup List
-    // Find first entry with INSERT action Type
-    // Record ricActionID
+    // Add a generator for each entry with INSERT action Type
     // Encode subscription response
+    // Start the generators
 
     logger_trace("Calling %s", __func__);
 
@@ -78,6 +79,7 @@ void callback_rc_subscription_request(E2AP_PDU_t *sub_req_pdu, E2Sim *e2sim, Ins
     long reqActionId;
     long reqFunctionId;
 
+    std::vector<long> actionIdsInsert;
     std::vector<long> actionIdsAccept;
     std::vector<long> actionIdsReject;
 
@@ -115,16 +117,13 @@ void callback_rc_subscription_request(E2AP_PDU_t *sub_req_pdu, E2Sim *e2sim, Ins
                 RICactions_ToBeSetup_List_t actionList = subDetails.ricAction_ToBeSetup_List;
                 // We are ignoring the trigger definition
 
-                // We identify the first action whose type is INSERT
-                // That is the only one accepted; all others are rejected
+                // Each action whose type is INSERT gets its own generator; all others are rejected
 
                 int actionCount = actionList.list.count;
                 logger_debug("action count %d", actionCount);
 
                 auto **item_array = actionList.list.array;
 
-                bool foundAction = false;
-
                 for (int i = 0; i < actionCount; i++)
                 {
 
@@ -134,11 +133,9 @@ void callback_rc_subscription_request(E2AP_PDU_t *sub_req_pdu, E2Sim *e2sim, Ins
 
                     reqActionId = actionId;
 
-                    if (!foundAction && actionType == RICactionType_insert)
+                    if (actionType == RICactionType_insert)
                     {
-                        logger_trace("adding accept");
-                        actionIdsAccept.push_back(reqActionId);
-                        foundAction = true;
+                        actionIdsInsert.push_back(reqActionId);
                     }
                     else
                     {
@@ -161,6 +158,22 @@ void callback_rc_subscription_request(E2AP_PDU_t *sub_req_pdu, E2Sim *e2sim, Ins
 
     logger_debug("requestorId %ld\tinstanceId %ld", reqRequestorId, reqInstanceId);
 
+    bool duplicate = false;
+    for (long actionId : actionIdsInsert)
+    {
+        if (add_subscription(reqRequestorId, reqInstanceId, reqFunctionId, actionId))
+        {
+            logger_trace("adding accept");
+            actionIdsAccept.push_back(actionId);
+        }
+        else
+        {
+            logger_trace("adding reject");
+            actionIdsReject.push_back(actionId);
+            duplicate = true;
+        }
+    }
+
     for (int i = 0; i < actionIdsAccept.size(); i++)
     {
         logger_debug("Accepted Action ID %d %ld", i, actionIdsAccept.at(i));
@@ -171,47 +184,62 @@ void callback_rc_subscription_request(E2AP_PDU_t *sub_req_pdu, E2Sim *e2sim, Ins
         logger_warn("Rejected Action ID %d %ld", i, actionIdsReject.at(i));
     }
 
-    E2AP_PDU *e2ap_pdu = (E2AP_PDU *)calloc(1, sizeof(E2AP_PDU));
-
     long *accept_array = &actionIdsAccept[0];
     long *reject_array = &actionIdsReject[0];
     int accept_size = actionIdsAccept.size();
     int reject_size = actionIdsReject.size();
 
-    if (accept_size > 0)
+    uint8_t encoded[FAST_APER_RESPONSE_SIZE];
+    ssize_t encoded_len = -1;
+    if (accept_size > 0 && reject_size == 0)    // the fast encoder only writes responses with no rejected actions
+    {
+        encoded_len = encoding::fast_encode_subscription_response(encoded, sizeof(encoded), reqFunctionId,
+                                                                  reqRequestorId, reqInstanceId, accept_array, accept_size);
+    }
+
+    E2AP_PDU *e2ap_pdu = NULL;
+    if (encoded_len > 0 && (size_t)encoded_len <= sizeof(encoded))
     {
-        encoding::generate_e2ap_subscription_response_success(e2ap_pdu, accept_array, reject_array, accept_size, reject_size, reqRequestorId, reqInstanceId);
+        e2sim->send_encoded_sctp_data(encoded, encoded_len, E2AP_STREAM_CONTROL, NULL);
+    }
+    else if (accept_size > 0)
+    {
+        e2ap_pdu = (E2AP_PDU *)calloc(1, sizeof(E2AP_PDU));
+        encoding::generate_e2ap_subscription_response_success(e2ap_pdu, accept_array, reject_array, accept_size, reject_size, reqRequestorId, reqInstanceId, reqFunctionId);
     }
     else
     {
-        logger_error("RIC subscription error. Cause: action id not supported.");
+        e2ap_pdu = (E2AP_PDU *)calloc(1, sizeof(E2AP_PDU));
         Cause_t cause;
         cause.present = Cause_PR_ricRequest;
-        cause.choice.ricRequest = CauseRICrequest_action_not_supported;
+        if (duplicate) {
+            logger_error("RIC subscription error. Cause: duplicate action.");
+            cause.choice.ricRequest = CauseRICrequest_duplicate_action;
+        } else {
+            logger_error("RIC subscription error. Cause: action id not supported.");
+            cause.choice.ricRequest = CauseRICrequest_action_not_supported;
+        }
 
         encoding::generate_e2ap_subscription_response_failure(e2ap_pdu, reqRequestorId, reqInstanceId, reqFunctionId, &cause, nullptr);
     }
 
-    e2sim->encode_and_send_sctp_data(e2ap_pdu, NULL);    // timestamp for subscription request is not relevant for now
+    if (e2ap_pdu != NULL)
+    {
+        e2sim->encode_and_send_sctp_data(e2ap_pdu, NULL);    // timestamp for subscription request is not relevant for now
+    }
 
     logger_trace("callback_rc_subscription_request has finished");
 
-    // Start thread for sending REPORT messages
+    // Start sending INSERT messages, run_insert_loop only schedules the generators so it does not block the reactor
     if (accept_size > 0) {  // we only call the simulation if the RIC subscription has succeeded
-        current_sub->reqRequestorId = reqRequestorId;
-        current_sub->reqInstanceId = reqInstanceId;
-        current_sub->reqFunctionId = reqFunctionId;
-        current_sub->reqActionId = reqActionId;
-
-        logger_trace("about to call run_insert_loop thread");
-        std::thread th(run_insert_loop, reqRequestorId, reqInstanceId, reqFunctionId, reqActionId);
-        th.detach();
-        logger_debug("run_insert_loop thread has spawned with reqRequestorId=%ld, reqInstanceId=%ld, reqFunctionId=%ld, reqActionId=%ld",
-                    reqRequestorId, reqInstanceId, reqFunctionId, reqActionId);
+        logger_trace("about to start run_insert_loop");
+        run_insert_loop(reqRequestorId, reqInstanceId);
+        logger_debug("run_insert_loop has started %d generators with reqRequestorId=%ld, reqInstanceId=%ld, reqFunctionId=%ld",
+                    accept_size, reqRequestorId, reqInstanceId, reqFunctionId);
     }
 }
 
-void callback_rc_subscription_delete_request(E2AP_PDU_t *sub_req_pdu, E2Sim *e2sim, volatile bool *ok2run) {
+void callback_rc_subscription_delete_request(E2AP_PDU_t *sub_req_pdu, E2Sim *e2sim, DeleteSubscriptionCallback delete_subscription) {
     long reqRequestorId;
     long reqInstanceId;
     long reqFunctionId;
@@ -273,20 +301,30 @@ void callback_rc_subscription_delete_request(E2AP_PDU_t *sub_req_pdu, E2Sim *e2s
 
     logger_debug("requestorId %ld\tinstanceId %ld\tfunctionId %ld", reqRequestorId, reqInstanceId, reqFunctionId);
 
-    E2AP_PDU *e2ap_pdu = (E2AP_PDU *)calloc(1, sizeof(E2AP_PDU));
+    uint8_t encoded[FAST_APER_RESPONSE_SIZE];
+    ssize_t encoded_len = encoding::fast_encode_subscription_delete_response(encoded, sizeof(encoded), reqFunctionId,
+                                                                             reqRequestorId, reqInstanceId);
 
-    encoding::generate_e2ap_subscription_delete_response_success(e2ap_pdu, reqFunctionId, reqRequestorId, reqInstanceId);
-
-    *ok2run = false;
+    delete_subscription(reqRequestorId, reqInstanceId);   // only stops the generators of this subscription
 
     logger_info("Sending RIC-SUBSCRIPTION-DELETE-RESPONSE");
 
-    e2sim->encode_and_send_sctp_data(e2ap_pdu, NULL);    // timestamp for subscription delete request is not relevant for now
+    // timestamp for subscription delete request is not relevant for now
+    if (encoded_len > 0 && (size_t)encoded_len <= sizeof(encoded))
+    {
+        e2sim->send_encoded_sctp_data(encoded, encoded_len, E2AP_STREAM_CONTROL, NULL);
+    }
+    else
+    {
+        E2AP_PDU *e2ap_pdu = (E2AP_PDU *)calloc(1, sizeof(E2AP_PDU));
+        encoding::generate_e2ap_subscription_delete_response_success(e2ap_pdu, reqFunctionId, reqRequestorId, reqInstanceId);
+        e2sim->encode_and_send_sctp_data(e2ap_pdu, NULL);
+    }
 
     logger_trace("callback_rc_subscription_delete_request has finished");
 }
 
-void callback_rc_control_request(E2AP_PDU_t *ctrl_req_pdu, struct timespec *recv_ts, unsigned long num2send, Histogram *histogram, Gauge *gauge, std::unordered_map<unsigned int, unsigned long> *sent_ts_map, std::unordered_map<unsigned int, unsigned long> *recv_ts_map) {
+void callback_rc_control_request(E2AP_PDU_t *ctrl_req_pdu, struct timespec *recv_ts, struct timespec *recv_kts, unsigned long num2send, Histogram *histogram, Gauge *gauge, Histogram *kernel_histogram, std::unordered_map<unsigned int, unsigned long> *sent_ts_map, std::unordered_map<unsigned int, unsigned long> *recv_ts_map, std::unordered_map<unsigned int, unsigned long> *recv_kts_map, FailoverTracker *failover) {
     logger_trace("Calling %s", __func__);
 
     RICcontrolRequest_t orig_req =
@@ -347,6 +385,22 @@ void callback_rc_control_request(E2AP_PDU_t *ctrl_req_pdu, struct timespec *recv
                 histogram->Observe(seconds);
                 gauge->Set(seconds);
 
+                /*
+                    the kernel timestamp excludes our own receiving delays (e.g. epoll wake up and batch
+                    processing), so the difference between both histograms is the simulator overhead
+                */
+                if (recv_kts && kernel_histogram) {
+                    unsigned long recv_kns = elapsed_nanoseconds(*recv_kts);
+                    kernel_histogram->Observe(elapsed_seconds(sent_ns, recv_kns));
+                    if (num2send != UNLIMITED_MESSAGES) {
+                        recv_kts_map->emplace(cpid, recv_kns);
+                    }
+                }
+
+                if (failover) {
+                    failover->control_received(cpid, sent_ns, recv_ns);
+                }
+
                 break;
             }
             case RICcontrolRequest_IEs__value_PR_RICcontrolAckRequest:
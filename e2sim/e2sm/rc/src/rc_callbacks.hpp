@@ -28,20 +28,15 @@ extern "C" {
 
 #include "e2sim.hpp"
 #include "e2sim_rc.hpp"
+#include "failover_tracker.hpp"
 
 #define DEFAULT_REPORT_WAIT 5       // time (seconds) to wait for generate file reports
 #define DEFAULT_LOOP_INTERVAL 1000  // time (milliseconds) between each insert message that is sent to the RIC
+#define DEFAULT_BATCH_FLUSH 1000    // time (microseconds) a batched insert message waits to be sent
 #define UNLIMITED_MESSAGES 0        // simulation sends unlimited messages (infinite loop)
 
 using namespace prometheus;
 
-typedef struct {
-    long reqRequestorId;
-    long reqInstanceId;
-    long reqActionId;
-    long reqFunctionId;
-} e2sm_rc_subscription_t;
-
 static inline unsigned long elapsed_nanoseconds(struct timespec ts) {
     return ts.tv_sec * 1000000000 + ts.tv_nsec;
 }
@@ -50,10 +45,10 @@ static inline double elapsed_seconds(unsigned long sent_ns, unsigned long recv_n
     return (recv_ns - sent_ns) / 1000000000.0;     // converting to seconds
 }
 
-void callback_rc_subscription_request(E2AP_PDU_t *sub_req_pdu, E2Sim *e2sim, InsertLoopCallback run_insert_loop, e2sm_rc_subscription_t *current_sub);
+void callback_rc_subscription_request(E2AP_PDU_t *sub_req_pdu, E2Sim *e2sim, AddSubscriptionCallback add_subscription, InsertLoopCallback run_insert_loop);
 
-void callback_rc_subscription_delete_request(E2AP_PDU_t *pdu, E2Sim *e2sim, volatile bool *ok2run);
+void callback_rc_subscription_delete_request(E2AP_PDU_t *pdu, E2Sim *e2sim, DeleteSubscriptionCallback delete_subscription);
 
-void callback_rc_control_request(E2AP_PDU_t *pdu, struct timespec *recv_ts, unsigned long num2send, Histogram *histogram, Gauge *gauge, std::unordered_map<unsigned int, unsigned long> *sent_ts_map, std::unordered_map<unsigned int, unsigned long> *recv_ts_map);
+void callback_rc_control_request(E2AP_PDU_t *pdu, struct timespec *recv_ts, struct timespec *recv_kts, unsigned long num2send, Histogram *histogram, Gauge *gauge, Histogram *kernel_histogram, std::unordered_map<unsigned int, unsigned long> *sent_ts_map, std::unordered_map<unsigned int, unsigned long> *recv_ts_map, std::unordered_map<unsigned int, unsigned long> *recv_kts_map, FailoverTracker *failover);
 
 #endif
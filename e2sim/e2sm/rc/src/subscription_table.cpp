@@ -0,0 +1,131 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#include "subscription_table.hpp"
+
+SubscriptionTable::SubscriptionTable() {
+    count = 0;
+}
+
+/*
+    Adds a generator for an action of a RIC subscription.
+
+    Returns nullptr if the action of this subscription already has a generator
+*/
+InsertGenerator SubscriptionTable::add(long reqRequestorId, long reqInstanceId, long reqFunctionId, long reqActionId) {
+    std::vector<InsertGenerator> &actions = subscriptions[{reqRequestorId, reqInstanceId}];
+    for (auto &generator : actions) {
+        if (generator->reqActionId == reqActionId) {
+            return nullptr;
+        }
+    }
+
+    InsertGenerator generator = std::make_shared<insert_generator_t>();
+    generator->reqRequestorId = reqRequestorId;
+    generator->reqInstanceId = reqInstanceId;
+    generator->reqFunctionId = reqFunctionId;
+    generator->reqActionId = reqActionId;
+    generator->interval_ms = 0;
+
+    actions.push_back(generator);
+    count++;
+
+    return generator;
+}
+
+/*
+    Returns the generators of the actions of a RIC subscription
+*/
+std::vector<InsertGenerator> SubscriptionTable::get(long reqRequestorId, long reqInstanceId) {
+    auto it = subscriptions.find({reqRequestorId, reqInstanceId});
+    if (it == subscriptions.end()) {
+        return {};
+    }
+    return it->second;
+}
+
+/*
+    Removes a RIC subscription, returning the generators of its actions so the caller can stop them
+*/
+std::vector<InsertGenerator> SubscriptionTable::remove(long reqRequestorId, long reqInstanceId) {
+    std::vector<InsertGenerator> removed;
+
+    auto it = subscriptions.find({reqRequestorId, reqInstanceId});
+    if (it != subscriptions.end()) {
+        removed.swap(it->second);
+        subscriptions.erase(it);
+        count -= removed.size();
+    }
+
+    return removed;
+}
+
+std::vector<InsertGenerator> SubscriptionTable::remove_all() {
+    std::vector<InsertGenerator> removed;
+
+    for (auto &subscription : subscriptions) {
+        removed.insert(removed.end(), subscription.second.begin(), subscription.second.end());
+    }
+    subscriptions.clear();
+    count = 0;
+
+    return removed;
+}
+
+/*
+    Removes the actions subscribed through an E2Sim, returning their generators so the caller can stop them
+*/
+std::vector<InsertGenerator> SubscriptionTable::remove_subscribed_by(const void *e2sim) {
+    std::vector<InsertGenerator> removed;
+
+    for (auto it = subscriptions.begin(); it != subscriptions.end(); ) {
+        std::vector<InsertGenerator> &actions = it->second;
+        for (auto action = actions.begin(); action != actions.end(); ) {
+            if ((*action)->subscribed_e2sim == e2sim) {
+                removed.push_back(*action);
+                action = actions.erase(action);
+            } else {
+                action++;
+            }
+        }
+
+        if (actions.empty()) {
+            it = subscriptions.erase(it);
+        } else {
+            it++;
+        }
+    }
+    count -= removed.size();
+
+    return removed;
+}
+
+/*
+    Returns the number of generators, i.e. accepted actions of all RIC subscriptions
+*/
+size_t SubscriptionTable::size() {
+    return count;
+}
+
+/*
+    Returns the metrics label of a generator: requestor/instance/action
+*/
+std::string generator_label(const InsertGenerator &generator) {
+    return std::to_string(generator->reqRequestorId) + "/" + std::to_string(generator->reqInstanceId) + "/" +
+            std::to_string(generator->reqActionId);
+}
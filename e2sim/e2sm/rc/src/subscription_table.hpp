@@ -0,0 +1,105 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+#ifndef SUBSCRIPTION_TABLE_HPP
+#define SUBSCRIPTION_TABLE_HPP
+
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <string>
+#include <prometheus/counter.h>
+
+#include "reactor.hpp"
+#include "indication_template.hpp"
+
+using namespace prometheus;
+
+// identifies a RIC subscription
+typedef struct {
+    long reqRequestorId;
+    long reqInstanceId;
+} ric_request_id_t;
+
+// INSERT generator of an accepted action of a RIC subscription, guarded by the lock of its node
+typedef struct {
+    long reqRequestorId;
+    long reqInstanceId;
+    long reqFunctionId;
+    long reqActionId;
+    unsigned long interval_ms;      // time between each INSERT of the generator
+    uint16_t seqNum = 0;            // RIC indication SN, each generator has its own sequence
+    unsigned long sent = 0;         // INSERT messages sent by the generator
+    reactor_timer_t timer = 0;      // next INSERT of the generator
+    bool ok2run = true;             // the subscription has not been deleted
+    bool running = false;           // the generator is scheduled in the shard of its node
+    Counter *inserts = nullptr;     // INSERT messages sent, labelled with the subscription and action
+    IndicationTemplate ind_template;    // pre-encoded INSERT, patched with the SN and call process ID of each message
+    const void *template_e2sim = nullptr;   // E2Sim ind_template has been built for, it changes on E2Term handover
+    const void *subscribed_e2sim = nullptr; // E2Sim whose E2Term has subscribed the action
+    unsigned long validated = 0;    // INSERTs counted by the validation policy (see ValidationScope)
+} insert_generator_t;
+
+typedef std::shared_ptr<insert_generator_t> InsertGenerator;
+
+/*
+    RIC subscriptions of an E2 node keyed by RIC request ID, each one with an INSERT generator
+    per accepted action, so many xApps can subscribe to the same node at once.
+
+    The table only holds the generators, which are run and stopped by the caller. It is not thread-safe.
+*/
+class SubscriptionTable {
+
+private:
+
+    struct request_id_hash {
+        size_t operator()(const ric_request_id_t &id) const {
+            return std::hash<long>()(id.reqRequestorId) ^ (std::hash<long>()(id.reqInstanceId) << 1);
+        }
+    };
+
+    struct request_id_equal {
+        bool operator()(const ric_request_id_t &a, const ric_request_id_t &b) const {
+            return a.reqRequestorId == b.reqRequestorId && a.reqInstanceId == b.reqInstanceId;
+        }
+    };
+
+    std::unordered_map<ric_request_id_t, std::vector<InsertGenerator>, request_id_hash, request_id_equal> subscriptions;
+    size_t count;
+
+public:
+
+    SubscriptionTable();
+
+    InsertGenerator add(long reqRequestorId, long reqInstanceId, long reqFunctionId, long reqActionId);
+
+    std::vector<InsertGenerator> get(long reqRequestorId, long reqInstanceId);
+
+    std::vector<InsertGenerator> remove(long reqRequestorId, long reqInstanceId);
+
+    std::vector<InsertGenerator> remove_all();
+
+    std::vector<InsertGenerator> remove_subscribed_by(const void *e2sim);
+
+    size_t size();
+
+};
+
+std::string generator_label(const InsertGenerator &generator);
+
+#endif
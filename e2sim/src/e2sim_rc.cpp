@@ -21,10 +21,14 @@
 #include <getopt.h>
 #include <functional>
 #include <csignal>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
 #include <prometheus/registry.h>
 #include <prometheus/exposer.h>
 #include <prometheus/histogram.h>
 #include <cpprest/http_listener.h>
+#include <cpprest/http_client.h>
 #include <cpprest/uri.h>
 #include <cpprest/json.h>
 
@@ -32,10 +36,14 @@
 
 #include "e2sim_rc.hpp"
 #include "e2sim.hpp"
+#include "shard_pool.hpp"
+#include "ramp_scheduler.hpp"
+#include "metrics_relay.hpp"
 #include "logger.h"
 #include "rc_callbacks.hpp"
 #include "encode_rc.hpp"
 #include "encode_e2ap.hpp"
+#include "fast_aper.hpp"
 #include "e2sim_defs.h"
 
 extern "C" {
@@ -58,19 +66,20 @@ extern "C" {
 args_t cmd_args;        // command line arguments
 metrics_t metrics;
 
-std::unordered_map<unsigned int, unsigned long> sent_ts_map; // timestamp of sent messages (INSERT) in nanoseconds
-std::unordered_map<unsigned int, unsigned long> recv_ts_map; // timestamp of received messages (CONTROL) in nanoseconds
-
-volatile bool ok2run;   // controls if the experiment should keep running
-
 std::unique_ptr<web::http::experimental::listener::http_listener> listener;
-std::vector<E2Sim *> e2sims;
-
-uint16_t seqNum = 0;        // guarded by seqNumCpidLock
-unsigned int cpid = 0;      // guarded by seqNumCpidLock
-std::mutex seqNumCpidLock;
-
-e2sm_rc_subscription_t current_subscription;    // stores the received subscription to use in e2term handover
+std::unique_ptr<web::http::experimental::listener::http_listener> validation_listener;
+std::vector<std::unique_ptr<e2node_t>> nodes;   // simulated E2 nodes, built before the http listener starts
+UringTransport *uring_transport = NULL;   // sends and receives the SCTP data of all e2sims, NULL uses epoll
+ShardPool *shards = NULL;       // runs the E2 nodes, each node is bound to a single shard
+std::vector<shard_metrics_t> shard_metrics;     // indexed by shard
+std::atomic<unsigned int> failed_nodes(0);      // E2 nodes that have given up the E2 setup
+RampScheduler *ramp = NULL;     // paces the connection of the E2 nodes on startup and on E2Term handover
+std::atomic<unsigned int> handovers_pending(0);     // E2 nodes whose handover has not finished yet
+std::atomic<unsigned int> handovers_done(0);        // E2 nodes moved to the new E2Term
+std::atomic<unsigned int> handovers_failed(0);      // E2 nodes whose new E2Term has not accepted the E2 setup
+MetricsRelay *relay = NULL;     // pushes the metrics of a worker process to its coordinator
+std::vector<pid_t> workers;     // running worker processes, only set in the coordinator
+unsigned int worker_count = 0;  // workers forked by the coordinator, worker i listens on port 8091+i
 
 int main(int argc, char *argv[]) {
     using namespace std::placeholders;
@@ -82,36 +91,60 @@ int main(int argc, char *argv[]) {
     sigprocmask(SIG_BLOCK, &monitored_signals, NULL);    // from now all new threads inherit this signal mask
 
     cmd_args = parse_input_options(argc, argv);
+    validation_set_policy(cmd_args.validation);
+
+    if (cmd_args.processes > 1 && fork_workers()) {
+        return run_coordinator(monitored_signals);
+    }
 
     logger_force(LOGGER_INFO, "Starting E2 Simulator for E2SM-RC");
 
     init_prometheus(metrics);
-    start_http_listener();
 
-    E2Sim *e2sim = new E2Sim(cmd_args.mcc.c_str(), cmd_args.mnc.c_str(), cmd_args.gnb_id);
-    e2sims.emplace_back(e2sim);
+    if (cmd_args.uring) {
+        uring_transport = UringTransport::get_default();
+        if (uring_transport == NULL) {
+            logger_warn("io_uring is not available, falling back to epoll");
+        } else {
+            uring_transport->setSubmitPolicy(cmd_args.submit_batch, cmd_args.submit_us);
+        }
+    }
 
-    encoded_ran_function_t *reg_func = encode_ran_function_definition();
-    e2sim->register_e2sm(1, reg_func);
+    shards = new ShardPool(cmd_args.shards, cmd_args.cpus);
+    ramp = new RampScheduler(shards->get(0), cmd_args.ramp_rate, cmd_args.ramp_jitter * 1000UL, cmd_args.ramp_inflight,
+                             cmd_args.simulation_id, metrics.setup_inflight, metrics.setup_all);
 
-    // first insert_cb takes 2 seconds to the xApp to reply due to subscription and routing setup
-    InsertLoopCallback insert_cb = std::bind(&run_insert_loop, _1, _2, _3, _4, e2sim, 2);
+    for (unsigned int i = 0; i < cmd_args.num_nodes; i++) {
+        e2node_t *node = new e2node_t();
+        node->gnb_id = cmd_args.gnb_id + i;
+        node->shard_id = i % shards->size();
+        node->shard = shards->get(node->shard_id);
+        nodes.emplace_back(node);
 
-    SubscriptionCallback subscription_request_cb = std::bind(&callback_rc_subscription_request, _1, e2sim, insert_cb, &current_subscription);
-    e2sim->register_subscription_callback(1, subscription_request_cb);
+        init_node_metrics(node);
 
-    SubscriptionDeleteCallback subscription_delete_cb = std::bind(&callback_rc_subscription_delete_request, _1, e2sim, &ok2run);
-    e2sim->register_subscription_delete_callback(1, subscription_delete_cb);
+        // first insert_cb takes 2 seconds to the xApp to reply due to subscription and routing setup
+        node->e2sim = create_e2sim(node, 2);
 
-    ControlCallback control_request_cb = std::bind(&callback_rc_control_request, _1, _2, cmd_args.num2send, metrics.histogram, metrics.gauge, &sent_ts_map, &recv_ts_map);
-    e2sim->register_control_callback(1, control_request_cb);
-    // TODO e2sim->register_e2ap_removal_callback...
+        ramp->add(std::bind(&start_node, node));
+    }
+
+    init_shard_metrics();
+    ramp->start();
+
+    if (cmd_args.worker_id >= 0) {
+        relay = new MetricsRelay(Reactor::get_default(), metrics.registry, cmd_args.metrics_socket, cmd_args.worker_id);
+        relay->start();
+    }
+
+    logger_force(LOGGER_INFO, "Simulating %u E2 nodes (gNodeB IDs %u..%u) on %u shards",
+                 cmd_args.num_nodes, cmd_args.gnb_id, cmd_args.gnb_id + cmd_args.num_nodes - 1, shards->size());
 
-    e2sim->run(cmd_args.server_ip.c_str(), cmd_args.server_port);
+    start_http_listener();
 
     do {
         int ret_val = sigwait(&monitored_signals, &delivered_signal);	// we just wait for a signal to proceed
-        if (ret_val == -1) {
+        if (ret_val != 0) {
             logger_error("sigwait failed");
         } else {
             switch (delivered_signal) {
@@ -130,19 +163,180 @@ int main(int argc, char *argv[]) {
 
     shutdown_http_listener();
 
-    for(E2Sim *e2sim : e2sims) {
-        e2sim->shutdown();  // async
+    for (auto &node : nodes) {
+        {
+            std::lock_guard<std::mutex> guard(node->lock);
+            for (auto &generator : node->subscriptions.remove_all()) {
+                generator->ok2run = false;
+            }
+        }
+        for (E2Sim *e2sim : node->e2sims) {
+            e2sim->shutdown();  // async
+        }
+    }
+
+    if (relay) {
+        relay->stop();
     }
+    shards->stop();     // waits for running handlers and insert loops, which might still reference e2sims
+    delete ramp;
 
-    for(E2Sim *e2sim : e2sims) {
-        delete e2sim;   // sync: unfortunately this has to run here to shutdown all running e2sims quickly
+    if (relay) {
+        relay->flush(); // final values, e.g. the latencies of the last control loops
+        delete relay;
     }
 
+    for (auto &node : nodes) {
+        for (E2Sim *e2sim : node->e2sims) {
+            delete e2sim;   // sync: unfortunately this has to run here to shutdown all running e2sims quickly
+        }
+    }
+
+    delete shards;
+
     logger_force(LOGGER_INFO, "E2 Simulator has finished");
 
     return 0;
 }
 
+/*
+    Forks one worker process per slice of the E2 nodes. Each worker runs a consecutive range of gNodeB IDs and
+    connects to the next endpoint of --e2terms, round-robin. It must run before any thread is created.
+
+    Returns true in the coordinator, false in the workers
+*/
+bool fork_workers() {
+    unsigned int count = std::min(cmd_args.processes, cmd_args.num_nodes);
+    unsigned int base = cmd_args.num_nodes / count;
+    unsigned int extra = cmd_args.num_nodes % count;
+    uint32_t gnb_id = cmd_args.gnb_id;
+    pid_t coordinator = getpid();
+
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned int num_nodes = base + (i < extra ? 1 : 0);
+
+        pid_t pid = fork();
+        if (pid == -1) {
+            logger_error("unable to fork worker %u: %s", i, strerror(errno));
+            break;  // still coordinates the workers already running
+        }
+
+        if (pid == 0) {
+            prctl(PR_SET_PDEATHSIG, SIGTERM);   // workers do not outlive their coordinator
+            if (getppid() != coordinator) {
+                exit(EXIT_FAILURE);
+            }
+
+            cmd_args.worker_id = i;
+            cmd_args.gnb_id = gnb_id;
+            cmd_args.num_nodes = num_nodes;
+            if (!cmd_args.e2terms.empty()) {
+                split_endpoint(cmd_args.e2terms[i % cmd_args.e2terms.size()], cmd_args.server_ip, cmd_args.server_port);
+            }
+            if (cmd_args.shards == 0 && cmd_args.cpus.empty()) {    // workers share the CPUs instead of taking one shard per CPU each
+                cmd_args.shards = std::max(1U, std::thread::hardware_concurrency() / count);
+            }
+            return false;
+        }
+
+        logger_info("Worker %u (pid %d) runs %u E2 nodes (gNodeB IDs %u..%u)", i, pid, num_nodes, gnb_id, gnb_id + num_nodes - 1);
+        workers.push_back(pid);
+        gnb_id += num_nodes;
+    }
+    worker_count = workers.size();
+
+    return true;
+}
+
+/*
+    Runs the coordinator of the worker processes until all of them have finished. It merges the metrics pushed
+    by the workers into a single prometheus endpoint, and forwards SIGINT and SIGTERM to the workers.
+
+    Returns the exit status of the coordinator, which fails if any worker has failed
+*/
+int run_coordinator(sigset_t &monitored_signals) {
+    int exit_status = workers.empty() ? EXIT_FAILURE : EXIT_SUCCESS;
+
+    logger_force(LOGGER_INFO, "Coordinating %zu worker processes for %u E2 nodes (gNodeB IDs %u..%u)",
+                 workers.size(), cmd_args.num_nodes, cmd_args.gnb_id, cmd_args.gnb_id + cmd_args.num_nodes - 1);
+
+    metrics.registry = std::make_shared<Registry>();
+    Gauge &running = BuildGauge()
+                        .Name("rc_fleet_workers")
+                        .Help("Worker processes of the coordinator still running")
+                        .Labels({{"HOSTNAME", get_hostname()}})
+                        .Register(*metrics.registry)
+                        .Add({{"SIM_ID", std::to_string(cmd_args.simulation_id)}});
+    running.Set(workers.size());
+
+    std::shared_ptr<MergedCollectable> merged = std::make_shared<MergedCollectable>();
+    MetricsCollector collector(Reactor::get_default(), merged, cmd_args.metrics_socket);
+    if (!collector.start()) {
+        logger_error("unable to collect the metrics of the workers, only the coordinator metrics are exposed");
+    }
+
+    metrics.exposer = std::make_shared<Exposer>("0.0.0.0:8080", 1);
+    metrics.exposer->RegisterCollectable(metrics.registry);
+    metrics.exposer->RegisterCollectable(merged);
+
+    bool listening = true;
+    try {
+        start_http_listener();  // forwards the RESTCONF requests to all workers
+    } catch (std::exception const &e) {
+        logger_error("unable to forward RESTCONF requests, each worker i still listens on port 8091+i. Reason = %s", e.what());
+        listening = false;
+    }
+
+    while (!workers.empty()) {
+        int delivered_signal;
+        if (sigwait(&monitored_signals, &delivered_signal) != 0) {
+            logger_error("sigwait failed");
+            continue;
+        }
+
+        switch (delivered_signal) {
+            case SIGCHLD:
+            {
+                pid_t pid;
+                int status;
+                while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+                    auto it = std::find(workers.begin(), workers.end(), pid);
+                    if (it == workers.end()) {
+                        continue;
+                    }
+                    workers.erase(it);
+
+                    if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS) {
+                        logger_info("Worker pid %d has finished", pid);
+                    } else {
+                        logger_error("Worker pid %d has failed with status 0x%x", pid, status);
+                        exit_status = EXIT_FAILURE;
+                    }
+                }
+                running.Set(workers.size());
+                break;
+            }
+            case SIGINT:
+            case SIGTERM:
+                logger_info("%s was received, stopping %zu workers", strsignal(delivered_signal), workers.size());
+                for (pid_t pid : workers) {
+                    kill(pid, SIGTERM);
+                }
+                break;
+            default:
+                logger_warn("sigwait returned signal %d (%s). Ignored!", delivered_signal, strsignal(delivered_signal));
+        }
+    }
+
+    if (listening) {
+        shutdown_http_listener();
+    }
+
+    logger_force(LOGGER_INFO, "E2 Simulator coordinator has finished");
+
+    return exit_status;
+}
+
 args_t parse_input_options(int argc, char *argv[]) {
     args_t args;
     args.server_ip = DEFAULT_SCTP_IP;
@@ -151,9 +345,33 @@ args_t parse_input_options(int argc, char *argv[]) {
     args.report_wait = DEFAULT_REPORT_WAIT;
     args.num2send = UNLIMITED_MESSAGES;
     args.gnb_id = 1;
+    args.num_nodes = 1;
+    args.shards = 0;
     args.simulation_id = 0;
     args.mcc = "001";
     args.mnc = "01";
+    args.single_stream = false;
+    args.batch_size = 1;
+    args.batch_flush = DEFAULT_BATCH_FLUSH;
+    args.kernel_timestamps = false;
+    args.uring = false;
+    args.submit_batch = URING_SUBMIT_BATCH;
+    args.submit_us = URING_SUBMIT_US;
+    args.queue_policy = SEND_QUEUE_BLOCK;
+    args.queue_messages = SEND_QUEUE_MAX_MESSAGES;
+    args.queue_bytes = SEND_QUEUE_MAX_BYTES;
+    args.setup.max_attempts = E2_SETUP_MAX_ATTEMPTS;
+    args.setup.timeout_ms = E2_SETUP_TIMEOUT_MS;
+    args.setup.backoff_ms = E2_SETUP_BACKOFF_MS;
+    args.setup.backoff_max_ms = E2_SETUP_BACKOFF_MAX_MS;
+    args.ramp_rate = 0;
+    args.ramp_jitter = 0;
+    args.ramp_inflight = 0;
+    args.processes = 1;
+    args.metrics_socket = "/tmp/e2sim-rc-" + std::to_string(getpid()) + ".sock";
+    args.worker_id = -1;
+    args.validation.mode = VALIDATION_ALWAYS;
+    args.validation.n = 1;
 
     static struct option long_options[] =
     {
@@ -162,9 +380,38 @@ args_t parse_input_options(int argc, char *argv[]) {
         {"wait_report", required_argument, 0, 'w'},
         {"num2send", required_argument, 0, 'n'},
         {"nodebid", required_argument, 0, 'b'},
+        {"nodebid-start", required_argument, 0, 'b'},
+        {"nodes", required_argument, 0, 'N'},
+        {"workers", required_argument, 0, 'W'},
+        {"cpus", required_argument, 0, 'C'},
         {"mcc", required_argument, 0, 'm'},
         {"mnc", required_argument, 0, 'c'},
         {"simulation", required_argument, 0, 's'},
+        {"single-stream", no_argument, 0, 'S'},
+        {"batch", required_argument, 0, 'B'},
+        {"flush", required_argument, 0, 'F'},
+        {"local", required_argument, 0, 'L'},
+        {"peers", required_argument, 0, 'P'},
+        {"transport", required_argument, 0, 'T'},
+        {"transport-file", required_argument, 0, 'f'},
+        {"kernel-timestamps", no_argument, 0, 'K'},
+        {"backend", required_argument, 0, 'e'},
+        {"submit-batch", required_argument, 0, 'u'},
+        {"submit-wait", required_argument, 0, 'U'},
+        {"queue-policy", required_argument, 0, 'q'},
+        {"queue-messages", required_argument, 0, 'Q'},
+        {"queue-bytes", required_argument, 0, 'z'},
+        {"setup-attempts", required_argument, 0, 'A'},
+        {"setup-timeout", required_argument, 0, 't'},
+        {"setup-backoff", required_argument, 0, 'k'},
+        {"ramp-rate", required_argument, 0, 'r'},
+        {"ramp-jitter", required_argument, 0, 'j'},
+        {"ramp-inflight", required_argument, 0, 'R'},
+        {"sub-interval", required_argument, 0, 'I'},
+        {"processes", required_argument, 0, 'X'},
+        {"e2terms", required_argument, 0, 'E'},
+        {"metrics-socket", required_argument, 0, 'M'},
+        {"validation", required_argument, 0, 'V'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -172,7 +419,7 @@ args_t parse_input_options(int argc, char *argv[]) {
     int c;
     while(1) {
         int option_index = 0;
-        c = getopt_long(argc, argv, "i:p:w:n:b:m:c:s:h", long_options, &option_index);
+        c = getopt_long(argc, argv, "i:p:w:n:b:N:W:C:m:c:s:SB:F:L:P:T:f:Ke:u:U:q:Q:z:A:t:k:r:j:R:I:X:E:M:V:h", long_options, &option_index);
         if (c == -1)
             break;
 
@@ -193,6 +440,18 @@ args_t parse_input_options(int argc, char *argv[]) {
                     args.gnb_id = strtoumax(optarg, NULL, 10);
                 }
                 break;
+            case 'N':
+                args.num_nodes = strtoul(optarg, NULL, 10);
+                break;
+            case 'W':
+                args.shards = strtoul(optarg, NULL, 10);
+                break;
+            case 'C':
+                if (!shard_pool_parse_cpus(optarg, args.cpus)) {
+                    fprintf(stderr, "invalid CPU list %s, expected e.g. 0-3,8\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
             case 'm':
                 args.mcc = optarg;
                 break;
@@ -202,6 +461,118 @@ args_t parse_input_options(int argc, char *argv[]) {
             case 's':
                 args.simulation_id = strtoumax(optarg, NULL, 10);
                 break;
+            case 'S':
+                args.single_stream = true;
+                break;
+            case 'B':
+                args.batch_size = strtoul(optarg, NULL, 10);
+                break;
+            case 'F':
+                args.batch_flush = strtoul(optarg, NULL, 10);
+                break;
+            case 'L':
+                args.local_addrs = split_addresses(optarg);
+                break;
+            case 'P':
+                args.peer_addrs = split_addresses(optarg);
+                break;
+            case 'T':
+                if (!sctp_profile_parse(args.transport, optarg)) {
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'f':
+                if (!sctp_profile_load(args.transport, optarg)) {
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'K':
+                args.kernel_timestamps = true;
+                break;
+            case 'e':
+                if (strcmp(optarg, "uring") == 0) {
+                    args.uring = true;
+                } else if (strcmp(optarg, "epoll") == 0) {
+                    args.uring = false;
+                } else {
+                    fprintf(stderr, "invalid backend %s, expected epoll or uring\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'u':
+                args.submit_batch = strtoul(optarg, NULL, 10);
+                break;
+            case 'U':
+                args.submit_us = strtoul(optarg, NULL, 10);
+                break;
+            case 'q':
+                if (!send_queue_parse_policy(optarg, args.queue_policy)) {
+                    fprintf(stderr, "invalid queue policy %s, expected block, drop-oldest, drop-newest, or shed-class\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'Q':
+                args.queue_messages = strtoul(optarg, NULL, 10);
+                break;
+            case 'z':
+                args.queue_bytes = strtoul(optarg, NULL, 10);
+                break;
+            case 'A':
+                args.setup.max_attempts = strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                args.setup.timeout_ms = strtoul(optarg, NULL, 10);
+                break;
+            case 'k':
+            {
+                char *end;
+                args.setup.backoff_ms = strtoul(optarg, &end, 10);
+                if (*end == ',') {
+                    args.setup.backoff_max_ms = strtoul(end + 1, NULL, 10);
+                } else if (args.setup.backoff_max_ms < args.setup.backoff_ms) {
+                    args.setup.backoff_max_ms = args.setup.backoff_ms;
+                }
+                break;
+            }
+            case 'r':
+                args.ramp_rate = strtod(optarg, NULL);
+                break;
+            case 'j':
+                args.ramp_jitter = strtoul(optarg, NULL, 10);
+                break;
+            case 'R':
+                args.ramp_inflight = strtoul(optarg, NULL, 10);
+                break;
+            case 'I':
+            {
+                char *ptr = optarg;
+                args.sub_intervals.clear();
+                while (*ptr != '\0') {
+                    args.sub_intervals.push_back(strtoul(ptr, &ptr, 10));
+                    if (*ptr == ',') {
+                        ptr++;
+                    } else if (*ptr != '\0') {
+                        fprintf(stderr, "invalid subscription intervals %s\n", optarg);
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                break;
+            }
+            case 'X':
+                args.processes = strtoul(optarg, NULL, 10);
+                break;
+            case 'E':
+                args.e2terms = split_addresses(optarg);
+                break;
+            case 'M':
+                args.metrics_socket = optarg;
+                break;
+            case 'V':
+                if (!validation_parse_policy(optarg, args.validation)) {
+                    fprintf(stderr, "invalid validation policy %s, expected always, sample:N, first:N, or off\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
             case 'w':
                 args.report_wait = atoi(optarg);
                 if (args.num2send == UNLIMITED_MESSAGES) {
@@ -220,72 +591,711 @@ args_t parse_input_options(int argc, char *argv[]) {
                     "  -m  --mcc          gNodeB Mobile Country Code\n"
                     "  -c  --mnc          gNodeB Mobile Network Code\n"
                     "  -b  --nodebid      gNodeB Identity 0..2^29-1 (e.g. 15 or 0xF)\n"
+                    "      --nodebid-start  Same as --nodebid, gNodeB Identity of the first E2 node\n"
+                    "  -N  --nodes        Number of simulated E2 nodes, each one with its own SCTP association\n"
+                    "                     and gNodeB Identity starting from --nodebid-start (default 1)\n"
+                    "  -W  --workers      Shards running the E2 nodes, each one a thread owning a disjoint set of nodes\n"
+                    "                     (default one per CPU given by --cpus, or one per hardware thread)\n"
+                    "  -C  --cpus         Comma-separated CPUs or CPU ranges the shards are pinned to, round-robin (e.g. 0-3,8)\n"
                     "  -w  --wait4report  Wait seconds for draining replies and generate the final report\n"
                     "                     Requires --num2send argument\n"
                     "  -s  --simulation   Simulation ID for prometheus reports (0..2^32-1)\n"
-                    "  -h  --help         Display this information and quit\n\n", argv[0]);
+                    "  -S  --single-stream  Send all E2AP messages on SCTP stream 0 (default is one stream per message class)\n"
+                    "  -B  --batch        Maximum number of insert messages sent together in a single syscall (default 1, no batching)\n"
+                    "  -F  --flush        Maximum time in microseconds a batched insert message waits to be sent (default %d)\n"
+                    "  -L  --local        Comma-separated local addresses of a multihomed SCTP association (e.g. 10.0.0.1,10.1.0.1)\n"
+                    "  -P  --peers        Comma-separated additional E2Term addresses of a multihomed SCTP association\n"
+                    "  -T  --transport    SCTP transport option as key=value, can be repeated (e.g. -T nodelay=1 -T hb_interval=1000)\n"
+                    "                     Keys: nodelay sndbuf rcvbuf rto_initial rto_min rto_max hb_interval path_max_retrans\n"
+                    "                           ostreams instreams init_attempts init_timeout maxseg (times in ms, \"default\" keeps the kernel value)\n"
+                    "  -f  --transport-file  File with one SCTP transport option per line as key=value\n"
+                    "                     Transport options are applied in the given order, so later ones override the previous ones\n"
+                    "  -K  --kernel-timestamps  Also measures the Insert-Control loop latency using kernel receive timestamps\n"
+                    "                     which excludes the scheduling and queueing delays of this simulator\n"
+                    "  -e  --backend      Backend that sends and receives the SCTP data: epoll (default) or uring\n"
+                    "  -u  --submit-batch  Messages queued before an io_uring submission (default %d, submits each message right away)\n"
+                    "  -U  --submit-wait  Maximum time in microseconds a queued message waits for an io_uring submission (default %d)\n"
+                    "  -q  --queue-policy  What to do with messages that do not fit in a full send queue\n"
+                    "                     block (default, pauses the INSERT generators until the queue drains), drop-oldest,\n"
+                    "                     drop-newest, or shed-class (drops indications first)\n"
+                    "  -Q  --queue-messages  Maximum number of messages waiting for room in the socket buffer or io_uring window (default %d)\n"
+                    "  -z  --queue-bytes  Maximum number of bytes waiting for room in the socket buffer or io_uring window (default %d)\n"
+                    "  -A  --setup-attempts  E2-SETUP-REQUESTs sent before an E2 node gives up, 0 retries forever (default %d)\n"
+                    "  -t  --setup-timeout  Time in milliseconds to wait for each E2-SETUP-RESPONSE (default %d)\n"
+                    "  -k  --setup-backoff  Time in milliseconds to wait before resending a failed E2-SETUP-REQUEST as initial[,max]\n"
+                    "                     The wait doubles on each failed attempt up to max (default %d,%d)\n"
+                    "  -r  --ramp-rate    E2 nodes that start connecting per second on startup and E2Term handover (default 0, all at once)\n"
+                    "  -j  --ramp-jitter  Maximum random delay in milliseconds added to the start of each E2 node (default 0)\n"
+                    "                     The random delays are seeded with the simulation ID, so runs are reproducible\n"
+                    "  -R  --ramp-inflight  Maximum number of E2 nodes waiting for their E2 setup at the same time (default 0, unlimited)\n"
+                    "  -I  --sub-interval  Comma-separated intervals in milliseconds of the INSERT generators of each E2 node\n"
+                    "                     Each accepted INSERT action of a RIC subscription gets the next one, round-robin (default --interval)\n"
+                    "  -X  --processes    Worker processes running the E2 nodes, each one a consecutive range of gNodeB IDs (default 1)\n"
+                    "                     This process coordinates the workers and exposes their merged metrics on port 8080.\n"
+                    "                     Its RESTCONF requests on port 8090 are forwarded to all workers, which also listen\n"
+                    "                     on port 8091+i each\n"
+                    "  -E  --e2terms      Comma-separated E2Term endpoints as address[:port] assigned to the workers, round-robin\n"
+                    "                     (default e2term-address and --port)\n"
+                    "  -M  --metrics-socket  Unix domain socket the workers push their metrics to (default /tmp/e2sim-rc-<pid>.sock)\n"
+                    "  -V  --validation   Which INSERTs have their ASN.1 constraints checked: always (default), sample:N (one in\n"
+                    "                     every N of each subscription), first:N (the first N of each subscription), or off\n"
+                    "                     Can be changed at runtime on /restconf/operations/validation (port 8090)\n"
+                    "  -h  --help         Display this information and quit\n\n", argv[0], DEFAULT_BATCH_FLUSH, URING_SUBMIT_BATCH, URING_SUBMIT_US,
+                    SEND_QUEUE_MAX_MESSAGES, SEND_QUEUE_MAX_BYTES, E2_SETUP_MAX_ATTEMPTS, E2_SETUP_TIMEOUT_MS,
+                    E2_SETUP_BACKOFF_MS, E2_SETUP_BACKOFF_MAX_MS);
                 exit(EXIT_FAILURE);
         }
     }
 
-    if (optind < argc) {    // we only expect one non-option argument (i.e. the server address)
-        args.server_ip = argv[optind];
+    if (optind < argc) {    // we only expect one non-option argument (i.e. the server address)
+        args.server_ip = argv[optind];
+    }
+
+    if (args.num_nodes == 0 || (uint64_t)args.gnb_id + args.num_nodes > (1 << 29)) {
+        fprintf(stderr, "invalid number of nodes %u, gNodeB identities must fit in 0..2^29-1\n", args.num_nodes);
+        exit(EXIT_FAILURE);
+    }
+
+    if (args.processes == 0) {
+        fprintf(stderr, "invalid number of processes, at least one is required\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return args;
+}
+
+/*
+    Exports the effective SCTP transport profile of e2sim as one gauge per option
+*/
+void export_transport_profile(e2node_t *node, E2Sim *e2sim) {
+    sctp_profile_for_each(e2sim->get_transport_profile(), [node](const char *key, int value) {
+        metrics.transport_family->Add({
+            {"GNODEB_ID", std::to_string(node->gnb_id)},
+            {"SIM_ID", std::to_string(cmd_args.simulation_id)},
+            {"OPTION", key}
+        }).Set(value);
+    });
+}
+
+/*
+    Splits a comma-separated list of addresses, ignoring empty entries
+*/
+std::vector<std::string> split_addresses(const char *list) {
+    std::vector<std::string> addrs;
+    std::stringstream ss(list);
+    std::string addr;
+
+    while (std::getline(ss, addr, ',')) {
+        if (!addr.empty()) {
+            addrs.push_back(addr);
+        }
+    }
+
+    return addrs;
+}
+
+/*
+    Splits an endpoint given as address[:port], or [IPv6 address][:port], keeping port unchanged if not given
+*/
+void split_endpoint(const std::string &endpoint, std::string &address, int &port) {
+    size_t sep = std::string::npos;
+
+    if (!endpoint.empty() && endpoint[0] == '[') {
+        size_t end = endpoint.find(']');
+        address = endpoint.substr(1, end == std::string::npos ? std::string::npos : end - 1);
+        if (end != std::string::npos && end + 1 < endpoint.size() && endpoint[end + 1] == ':') {
+            sep = end + 1;
+        }
+    } else {
+        sep = endpoint.find(':');
+        if (sep != std::string::npos && endpoint.find(':', sep + 1) != std::string::npos) {
+            sep = std::string::npos;    // bare IPv6 address
+        }
+        address = endpoint.substr(0, sep);
+    }
+
+    if (sep != std::string::npos) {
+        port = atoi(endpoint.c_str() + sep + 1);
+    }
+}
+
+std::string get_hostname() {
+    char *pod_env = std::getenv("HOSTNAME");
+    if (pod_env != NULL) {
+        return pod_env;
+    }
+    return "unknown-e2sim-hostname";
+}
+
+/*
+    Builds the prometheus configuration and exposes its metrics on port 8080
+*/
+void init_prometheus(metrics_t &metrics) {
+    std::string hostname = get_hostname();
+
+    // the families of the shards do not depend on the E2Term, so they only take the hostname
+    const Labels labels = {{"HOSTNAME", hostname},
+                           {"E2TERM", cmd_args.server_ip + ":" + std::to_string(cmd_args.server_port)},
+                           {"SCTP_STREAMS", cmd_args.single_stream ? "single" : "multi"}
+                          };
+    const Labels shard_labels = {{"HOSTNAME", hostname}};
+
+    metrics.registry = std::make_shared<Registry>();
+    metrics.hist_family = &BuildHistogram()
+                            .Name("rc_control_loop_seconds")
+                            .Help("E2SM-RC Insert-Control Loop metrics")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.gauge_family = &BuildGauge()
+                            .Name("rc_control_loop_latency_seconds")
+                            .Help("Current E2SM-RC Insert-Control Loop latency")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.kernel_hist_family = &BuildHistogram()
+                            .Name("rc_control_loop_kernel_seconds")
+                            .Help("E2SM-RC Insert-Control Loop metrics using kernel receive timestamps")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.send_allocs_family = &BuildGauge()
+                            .Name("rc_send_buffer_allocations")
+                            .Help("Heap allocations of the E2AP send buffer since the E2 connection has started")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.failover_family = &BuildHistogram()
+                            .Name("rc_path_failover_seconds")
+                            .Help("Time the E2SM-RC Insert-Control Loop takes to recover from a primary SCTP path failure")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.failures_family = &BuildCounter()
+                            .Name("rc_path_failures")
+                            .Help("Number of primary SCTP path failures")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.failover_delayed_family = &BuildCounter()
+                            .Name("rc_path_failover_delayed_indications")
+                            .Help("Insert messages delayed by primary SCTP path failures")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.failover_lost_family = &BuildCounter()
+                            .Name("rc_path_failover_lost_indications")
+                            .Help("Insert messages lost on primary SCTP path failures")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.transport_family = &BuildGauge()
+                            .Name("rc_sctp_transport_option")
+                            .Help("Effective value of each SCTP transport option, -1 if unknown")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.queue_depth_family = &BuildGauge()
+                            .Name("rc_send_queue_depth")
+                            .Help("Messages waiting for room in the SCTP socket buffer")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.queue_bytes_family = &BuildGauge()
+                            .Name("rc_send_queue_bytes")
+                            .Help("Bytes waiting for room in the SCTP socket buffer")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.queue_drops_family = &BuildCounter()
+                            .Name("rc_send_queue_drops")
+                            .Help("Messages dropped by the send queue policy or by a failed SCTP association")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.queue_delay_family = &BuildHistogram()
+                            .Name("rc_send_queue_delay_seconds")
+                            .Help("Time messages wait in the send queue for room in the SCTP socket buffer")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.setup_family = &BuildHistogram()
+                            .Name("rc_e2_setup_seconds")
+                            .Help("Time from connecting to the E2Term until the E2 setup is done, including retries")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.setup_retries_family = &BuildCounter()
+                            .Name("rc_e2_setup_retries")
+                            .Help("Failed E2-SETUP-REQUESTs that have been retried")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.setup_failures_family = &BuildCounter()
+                            .Name("rc_e2_setup_failures")
+                            .Help("Number of times the E2 setup has been given up")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.setup_response_family = &BuildHistogram()
+                            .Name("rc_e2_setup_response_seconds")
+                            .Help("Time the E2Term takes to answer an E2-SETUP-REQUEST")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.setup_inflight_family = &BuildGauge()
+                            .Name("rc_e2_setup_inflight")
+                            .Help("E2 nodes started by the startup ramp that are still waiting for their E2 setup")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.setup_all_family = &BuildGauge()
+                            .Name("rc_e2_setup_all_seconds")
+                            .Help("Time from startup until all E2 nodes have finished their E2 setup")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.subscriptions_family = &BuildGauge()
+                            .Name("rc_subscriptions")
+                            .Help("Number of INSERT generators of an E2 node, one per accepted action of its RIC subscriptions")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.subscription_inserts_family = &BuildCounter()
+                            .Name("rc_subscription_inserts")
+                            .Help("INSERT messages sent by the generator of an action of a RIC subscription")
+                            .Labels(labels)
+                            .Register(*metrics.registry);
+
+    metrics.shard_busy_family = &BuildGauge()
+                            .Name("rc_shard_busy_ratio")
+                            .Help("Fraction of time a shard has spent running its E2 nodes in the last second")
+                            .Labels(shard_labels)
+                            .Register(*metrics.registry);
+
+    metrics.shard_nodes_family = &BuildGauge()
+                            .Name("rc_shard_nodes")
+                            .Help("Number of E2 nodes bound to a shard")
+                            .Labels(shard_labels)
+                            .Register(*metrics.registry);
+
+    metrics.shard_events_family = &BuildCounter()
+                            .Name("rc_shard_events")
+                            .Help("Socket events handled by a shard")
+                            .Labels(shard_labels)
+                            .Register(*metrics.registry);
+
+    metrics.shard_tasks_family = &BuildCounter()
+                            .Name("rc_shard_tasks")
+                            .Help("Timers run by a shard (e.g. insert messages and metric updates)")
+                            .Labels(shard_labels)
+                            .Register(*metrics.registry);
+
+    metrics.shard_timers_family = &BuildGauge()
+                            .Name("rc_shard_timers")
+                            .Help("Timers waiting in the timer wheel of a shard")
+                            .Labels(shard_labels)
+                            .Register(*metrics.registry);
+
+    metrics.shard_arena_allocs_family = &BuildCounter()
+                            .Name("rc_shard_arena_allocs")
+                            .Help("ASN.1 allocations of a shard served by its per-message arena")
+                            .Labels(shard_labels)
+                            .Register(*metrics.registry);
+
+    metrics.shard_heap_allocs_family = &BuildCounter()
+                            .Name("rc_shard_heap_allocs")
+                            .Help("ASN.1 allocations of a shard served by the heap (i.e. outside of an arena scope)")
+                            .Labels(shard_labels)
+                            .Register(*metrics.registry);
+
+    metrics.shard_arena_high_water_family = &BuildGauge()
+                            .Name("rc_shard_arena_high_water_bytes")
+                            .Help("Most bytes a single message has taken from the arena of a shard")
+                            .Labels(shard_labels)
+                            .Register(*metrics.registry);
+
+    metrics.shard_validation_checks_family = &BuildCounter()
+                            .Name("rc_shard_validation_checks")
+                            .Help("ASN.1 constraint checks run by a shard")
+                            .Labels(shard_labels)
+                            .Register(*metrics.registry);
+
+    metrics.shard_validation_skipped_family = &BuildCounter()
+                            .Name("rc_shard_validation_skipped")
+                            .Help("ASN.1 constraint checks of a shard skipped by the validation policy")
+                            .Labels(shard_labels)
+                            .Register(*metrics.registry);
+
+    metrics.shard_validation_violations_family = &BuildCounter()
+                            .Name("rc_shard_validation_violations")
+                            .Help("ASN.1 constraint checks of a shard that failed")
+                            .Labels(shard_labels)
+                            .Register(*metrics.registry);
+
+    if (cmd_args.worker_id < 0) {   // workers push their metrics to the coordinator instead
+        metrics.exposer = std::make_shared<Exposer>("0.0.0.0:8080", 1);
+        metrics.exposer->RegisterCollectable(metrics.registry);
+    }
+
+    metrics.buckets = std::make_shared<Histogram::BucketBoundaries>();
+    metrics.buckets->assign({0.001, 0.002, 0.003, 0.004, 0.005, 0.006, 0.007, 0.008, 0.009, 0.01, 0.02, 0.05, 0.1});
+
+    metrics.failover_buckets = std::make_shared<Histogram::BucketBoundaries>();
+    metrics.failover_buckets->assign({0.01, 0.05, 0.1, 0.25, 0.5, 1, 2, 5, 10, 30, 60});
+
+    metrics.queue_delay_buckets = std::make_shared<Histogram::BucketBoundaries>();
+    metrics.queue_delay_buckets->assign({0.00001, 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1});
+
+    metrics.setup_buckets = std::make_shared<Histogram::BucketBoundaries>();
+    metrics.setup_buckets->assign({0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 2, 5, 10, 30, 60});
+
+    std::string sim_id = std::to_string(cmd_args.simulation_id);
+    metrics.setup_response = &metrics.setup_response_family->Add({{"SIM_ID", sim_id}}, *metrics.setup_buckets);
+    metrics.setup_inflight = &metrics.setup_inflight_family->Add({{"SIM_ID", sim_id}}, 0.0);
+    metrics.setup_all = &metrics.setup_all_family->Add({{"SIM_ID", sim_id}}, 0.0);
+}
+
+/*
+    Adds the metrics of an E2 node to the prometheus families, labelled with the gNodeB ID of the node
+*/
+void init_node_metrics(e2node_t *node) {
+    node_metrics_t &m = node->metrics;
+    std::string gnb_id = std::to_string(node->gnb_id);
+    std::string sim_id = std::to_string(cmd_args.simulation_id);
+
+    m.histogram = &metrics.hist_family->Add({
+            {"GNODEB_ID", gnb_id},
+            {"SIM_ID", sim_id}
+        }, *metrics.buckets);
+
+    if (cmd_args.kernel_timestamps) {
+        m.kernel_histogram = &metrics.kernel_hist_family->Add({
+                {"GNODEB_ID", gnb_id},
+                {"SIM_ID", sim_id}
+            }, *metrics.buckets);
+    }
+
+    m.gauge = &metrics.gauge_family->Add({
+            {"GNODEB_ID", gnb_id},
+            {"SIM_ID", sim_id}
+        }, 0.0);
+
+    m.send_allocs = &metrics.send_allocs_family->Add({
+            {"GNODEB_ID", gnb_id},
+            {"SIM_ID", sim_id}
+        }, 0.0);
+
+    m.failover_hist = &metrics.failover_family->Add({
+            {"GNODEB_ID", gnb_id},
+            {"SIM_ID", sim_id}
+        }, *metrics.failover_buckets);
+
+    m.failures = &metrics.failures_family->Add({
+            {"GNODEB_ID", gnb_id},
+            {"SIM_ID", sim_id}
+        });
+
+    m.failover_delayed = &metrics.failover_delayed_family->Add({
+            {"GNODEB_ID", gnb_id},
+            {"SIM_ID", sim_id}
+        });
+
+    m.failover_lost = &metrics.failover_lost_family->Add({
+            {"GNODEB_ID", gnb_id},
+            {"SIM_ID", sim_id}
+        });
+
+    m.failover = std::make_shared<FailoverTracker>(m.failover_hist, m.failures, m.failover_delayed, m.failover_lost);
+
+    m.queue_depth = &metrics.queue_depth_family->Add({
+            {"GNODEB_ID", gnb_id},
+            {"SIM_ID", sim_id}
+        }, 0.0);
+
+    m.queue_bytes = &metrics.queue_bytes_family->Add({
+            {"GNODEB_ID", gnb_id},
+            {"SIM_ID", sim_id}
+        }, 0.0);
+
+    const char *classes[E2AP_NUM_STREAMS] = {"global", "control", "indication"};   // indexed by E2AP_STREAM_*
+    for (int i = 0; i < E2AP_NUM_STREAMS; i++) {
+        m.queue_drops[i] = &metrics.queue_drops_family->Add({
+                {"GNODEB_ID", gnb_id},
+                {"SIM_ID", sim_id},
+                {"CLASS", classes[i]}
+            });
+    }
+
+    m.queue_delay = &metrics.queue_delay_family->Add({
+            {"GNODEB_ID", gnb_id},
+            {"SIM_ID", sim_id}
+        }, *metrics.queue_delay_buckets);
+
+    m.setup = &metrics.setup_family->Add({
+            {"GNODEB_ID", gnb_id},
+            {"SIM_ID", sim_id}
+        }, *metrics.setup_buckets);
+
+    m.setup_retries = &metrics.setup_retries_family->Add({
+            {"GNODEB_ID", gnb_id},
+            {"SIM_ID", sim_id}
+        });
+
+    m.setup_failures = &metrics.setup_failures_family->Add({
+            {"GNODEB_ID", gnb_id},
+            {"SIM_ID", sim_id}
+        });
+
+    m.subscriptions = &metrics.subscriptions_family->Add({
+            {"GNODEB_ID", gnb_id},
+            {"SIM_ID", sim_id}
+        }, 0.0);
+}
+
+/*
+    Adds the load metrics of each shard and starts updating them every second on the shard itself
+*/
+void init_shard_metrics() {
+    std::string sim_id = std::to_string(cmd_args.simulation_id);
+
+    shard_metrics.resize(shards->size());
+    for (unsigned int i = 0; i < shards->size(); i++) {
+        shard_metrics_t &m = shard_metrics[i];
+        int cpu = shards->get_cpu(i);
+        std::map<std::string, std::string> labels = {
+            {"SHARD", std::to_string(i)},
+            {"CPU", cpu < 0 ? "any" : std::to_string(cpu)},
+            {"SIM_ID", sim_id}
+        };
+
+        m.busy = &metrics.shard_busy_family->Add(labels, 0.0);
+        m.nodes = &metrics.shard_nodes_family->Add(labels, 0.0);
+        m.events = &metrics.shard_events_family->Add(labels);
+        m.tasks = &metrics.shard_tasks_family->Add(labels);
+        m.timers = &metrics.shard_timers_family->Add(labels, 0.0);
+        m.arena_allocs = &metrics.shard_arena_allocs_family->Add(labels);
+        m.heap_allocs = &metrics.shard_heap_allocs_family->Add(labels);
+        m.arena_high_water = &metrics.shard_arena_high_water_family->Add(labels, 0.0);
+        m.validation_checks = &metrics.shard_validation_checks_family->Add(labels);
+        m.validation_skipped = &metrics.shard_validation_skipped_family->Add(labels);
+        m.validation_violations = &metrics.shard_validation_violations_family->Add(labels);
+        m.last = shards->get(i)->get_stats();
+    }
+
+    for (auto &node : nodes) {
+        shard_metrics[node->shard_id].nodes->Increment();
+    }
+
+    for (unsigned int i = 0; i < shards->size(); i++) {
+        shards->get(i)->schedule(1000000UL, std::bind(&update_shard_metrics, i));
+    }
+}
+
+/*
+    Updates the load metrics of a shard with its stats since the last update, and schedules the next update.
+    Runs in the shard thread, so the update of an overloaded shard is also delayed.
+*/
+void update_shard_metrics(unsigned int shard_id) {
+    shard_metrics_t &m = shard_metrics[shard_id];
+    Reactor *shard = shards->get(shard_id);
+    reactor_stats_t stats = shard->get_stats();
+
+    unsigned long busy = stats.busy_ns - m.last.busy_ns;
+    unsigned long total = busy + stats.idle_ns - m.last.idle_ns;
+    if (total > 0) {
+        m.busy->Set((double) busy / total);
+    }
+    m.events->Increment(stats.events - m.last.events);
+    m.tasks->Increment(stats.tasks - m.last.tasks);
+    m.timers->Set(stats.timers);
+    m.last = stats;
+
+    asn_arena_stats_t arena;    // the arena is per thread, so this reads the one of the shard
+    asn_arena_get_stats(&arena);
+    m.arena_allocs->Increment(arena.allocs - m.last_arena.allocs);
+    m.heap_allocs->Increment(arena.heap_allocs - m.last_arena.heap_allocs);
+    m.arena_high_water->Set(arena.high_water);
+    m.last_arena = arena;
+
+    validation_stats_t validation = validation_get_stats();
+    m.validation_checks->Increment(validation.checks - m.last_validation.checks);
+    m.validation_skipped->Increment(validation.skipped - m.last_validation.skipped);
+    m.validation_violations->Increment(validation.violations - m.last_validation.violations);
+    m.last_validation = validation;
+
+    shard->schedule(1000000UL, std::bind(&update_shard_metrics, shard_id));
+}
+
+/*
+    Updates the send queue metrics with a message that has left the send queue of an E2Sim
+*/
+void update_send_queue_metrics(node_metrics_t *node_metrics, const send_queue_event_t &event) {
+    node_metrics->queue_depth->Set(event.depth);
+    node_metrics->queue_bytes->Set(event.bytes);
+
+    if (event.dropped) {
+        if (event.msg_class < E2AP_NUM_STREAMS) {
+            node_metrics->queue_drops[event.msg_class]->Increment();
+        }
+    } else {
+        node_metrics->queue_delay->Observe(event.delay_ns / 1000000000.0);
+    }
+}
+
+/*
+    Updates the E2 setup metrics of the node with a transition of the E2 setup of e2sim.
+    Once the E2 setup of all nodes has been given up, the simulator has nothing left to do, so it stops.
+*/
+void handle_e2_setup_event(e2node_t *node, E2Sim *e2sim, const e2_setup_event_t &event) {
+    if (event.response_ns > 0) {
+        metrics.setup_response->Observe(event.response_ns / 1000000000.0);
+    }
+
+    switch (event.state) {
+        case E2_SETUP_DONE:
+        {
+            node->metrics.setup->Observe(event.setup_ns / 1000000000.0);
+            export_transport_profile(node, e2sim);
+
+            bool ramping;
+            bool handover;
+            size_t generators;
+            {
+                std::lock_guard<std::mutex> guard(node->lock);
+                ramping = node->ramping == e2sim;
+                handover = node->handover == e2sim;
+                if (ramping) {
+                    node->ramping = nullptr;
+                }
+                if (handover) {
+                    node->handover = nullptr;
+                    node->e2sim = e2sim;    // the running generators send their next INSERT through the new E2Term
+                }
+                generators = node->subscriptions.size();
+            }
+            if (handover) {
+                logger_debug("%zu INSERT generators of gNodeB %u moved to the new E2Term", generators, node->gnb_id);
+                finish_handover(true);
+            }
+            if (ramping || handover) {
+                ramp->finished(true);
+            }
+            break;
+        }
+
+        case E2_SETUP_BACKOFF:
+            node->metrics.setup_retries->Increment();
+            break;
+
+        case E2_SETUP_FAILED:
+        {
+            node->metrics.setup_failures->Increment();
+            logger_error("gNodeB %u has given up the E2 setup after %u attempts: %s", node->gnb_id, event.attempts, event.reason);
+
+            bool ramping;
+            bool handover;
+            {
+                std::lock_guard<std::mutex> guard(node->lock);
+                ramping = node->ramping == e2sim;
+                handover = node->handover == e2sim;
+                if (ramping) {
+                    node->ramping = nullptr;
+                }
+                if (handover) {
+                    node->handover = nullptr;
+                }
+                if (node->e2sim == e2sim && !node->setup_failed) {    // a failed E2Term handover keeps the node running
+                    node->setup_failed = true;
+                    if (++failed_nodes == cmd_args.num_nodes) {
+                        logger_fatal("all E2 nodes have given up the E2 setup. Closing the application...");
+                        kill(getpid(), SIGTERM);    // main drives the shutdown on SIGTERM
+                    }
+                }
+            }
+            if (handover) {
+                finish_handover(false);
+            }
+            if (ramping || handover) {
+                ramp->finished(false);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+/*
+    Starts connecting the E2 node to the E2Term. Called by the startup ramp.
+*/
+void start_node(e2node_t *node) {
+    E2Sim *e2sim;
+    {
+        std::lock_guard<std::mutex> guard(node->lock);
+        node->ramping = node->e2sim;
+        e2sim = node->e2sim;
     }
 
-    return args;
+    e2sim->run_async(cmd_args.server_ip.c_str(), cmd_args.server_port);
 }
 
 /*
-    Builds the prometheus configuration and exposes its metrics on port 8080
+    Creates an E2Sim for the E2 node with all command line settings and E2SM-RC callbacks.
+    Its insert loop starts sleep_seconds after the RIC subscription is accepted.
 */
-void init_prometheus(metrics_t &metrics) {
-    std::string hostname = "unknown-e2sim-hostname";
-    char *pod_env = std::getenv("HOSTNAME");
-    if(pod_env != NULL) {
-        hostname = pod_env;
+E2Sim *create_e2sim(e2node_t *node, int sleep_seconds) {
+    using namespace std::placeholders;
+
+    E2Sim *e2sim = new E2Sim(cmd_args.mcc.c_str(), cmd_args.mnc.c_str(), node->gnb_id, node->shard);
+    e2sim->setMultistream(!cmd_args.single_stream);
+    e2sim->setTimestamping(cmd_args.kernel_timestamps);
+    e2sim->setBatching(cmd_args.batch_size, cmd_args.batch_flush);
+    e2sim->setLocalAddresses(cmd_args.local_addrs);
+    e2sim->setPeerAddresses(cmd_args.peer_addrs);
+    e2sim->setTransportProfile(cmd_args.transport);
+    e2sim->setTransport(uring_transport);
+    e2sim->register_path_event_callback(std::bind(&FailoverTracker::path_event, node->metrics.failover.get(), _1, _2, _3, _4));
+    e2sim->setSendQueue(cmd_args.queue_policy, cmd_args.queue_messages, cmd_args.queue_bytes);
+    e2sim->register_send_queue_callback(std::bind(&update_send_queue_metrics, &node->metrics, _1));
+    e2sim->register_writable_callback(std::bind(&resume_generators, node));
+    e2sim->setSetupPolicy(cmd_args.setup);
+    e2sim->register_e2_setup_callback(std::bind(&handle_e2_setup_event, node, e2sim, _1));
+
+    {
+        std::lock_guard<std::mutex> guard(node->lock);
+        node->e2sims.emplace_back(e2sim);
     }
 
-    metrics.registry = std::make_shared<Registry>();
-    metrics.hist_family = &BuildHistogram()
-                            .Name("rc_control_loop_seconds")
-                            .Help("E2SM-RC Insert-Control Loop metrics")
-                            .Labels({{"HOSTNAME", hostname},
-                                     {"E2TERM", cmd_args.server_ip + ":" + std::to_string(cmd_args.server_port)}
-                                    })
-                            .Register(*metrics.registry);
+    // all nodes share the same encoded RAN function definition
+    RanFunctionRef reg_func = RanFunctionRegistry::get_default()->get("E2SM-RC", &encode_ran_function_definition);
+    if (reg_func) {
+        e2sim->register_e2sm(1, reg_func);
+    }
 
-    metrics.gauge_family = &BuildGauge()
-                            .Name("rc_control_loop_latency_seconds")
-                            .Help("Current E2SM-RC Insert-Control Loop latency")
-                            .Labels({{"HOSTNAME", hostname},
-                                     {"E2TERM", cmd_args.server_ip + ":" + std::to_string(cmd_args.server_port)}
-                                    })
-                            .Register(*metrics.registry);
+    AddSubscriptionCallback add_cb = std::bind(&add_subscription, _1, _2, _3, _4, node, e2sim);
+    InsertLoopCallback insert_cb = std::bind(&run_insert_loop, _1, _2, node, sleep_seconds);
 
-    metrics.exposer = std::make_shared<Exposer>("0.0.0.0:8080", 1);
-    metrics.exposer->RegisterCollectable(metrics.registry);
+    SubscriptionCallback subscription_request_cb = std::bind(&callback_rc_subscription_request, _1, e2sim, add_cb, insert_cb);
+    e2sim->register_subscription_callback(1, subscription_request_cb);
 
-    metrics.buckets = std::make_shared<Histogram::BucketBoundaries>();
-    metrics.buckets->assign({0.001, 0.002, 0.003, 0.004, 0.005, 0.006, 0.007, 0.008, 0.009, 0.01, 0.02, 0.05, 0.1});
+    DeleteSubscriptionCallback delete_cb = std::bind(&delete_subscription, _1, _2, node);
+    SubscriptionDeleteCallback subscription_delete_cb = std::bind(&callback_rc_subscription_delete_request, _1, e2sim, delete_cb);
+    e2sim->register_subscription_delete_callback(1, subscription_delete_cb);
 
-    // TODO: e2node_instance should be registered per thread (next line should be called within each spawned thread)
-    // for now we call it here due e2sim only runs a single e2node instance
-    metrics.histogram = &metrics.hist_family->Add({
-            {"GNODEB_ID", std::to_string(cmd_args.gnb_id)},
-            {"SIM_ID", std::to_string(cmd_args.simulation_id)}
-        }, *metrics.buckets);
+    ControlCallback control_request_cb = std::bind(&callback_rc_control_request, _1, _2, _3, cmd_args.num2send,
+            node->metrics.histogram, node->metrics.gauge, node->metrics.kernel_histogram,
+            &node->sent_ts_map, &node->recv_ts_map, &node->recv_kts_map, node->metrics.failover.get());
+    e2sim->register_control_callback(1, control_request_cb);
+    // TODO e2sim->register_e2ap_removal_callback...
 
-    metrics.gauge = &metrics.gauge_family->Add({
-            {"GNODEB_ID", std::to_string(cmd_args.gnb_id)},
-            {"SIM_ID", std::to_string(cmd_args.simulation_id)}
-        }, 0.0);
+    return e2sim;
 }
 
 encoded_ran_function_t *encode_ran_function_definition() {
     using namespace std::placeholders;
 
-    asn_codec_ctx_t *opt_cod;
-
     E2SM_RC_RANFunctionDefinition_t *ranfunc_def =
         (E2SM_RC_RANFunctionDefinition_t *)calloc(1, sizeof(E2SM_RC_RANFunctionDefinition_t));
     encode_rc_function_definition(ranfunc_def);
@@ -294,12 +1304,17 @@ encoded_ran_function_t *encode_ran_function_definition() {
     size_t e2smbuffer_size = 8192;
 
     asn_enc_rval_t er =
-        asn_encode_to_buffer(opt_cod,
+        asn_encode_to_buffer(NULL,
                              ATS_ALIGNED_BASIC_PER,
                              &asn_DEF_E2SM_RC_RANFunctionDefinition,
                              ranfunc_def, e2smbuffer, e2smbuffer_size);
 
     logger_debug("er encoded is %ld", er.encoded);
+    if (er.encoded < 0 || (size_t)er.encoded > e2smbuffer_size) {
+        logger_error("unable to encode E2SM-RC RAN function definition: %s", er.failed_type ? er.failed_type->name : "buffer too small");
+        ASN_STRUCT_FREE(asn_DEF_E2SM_RC_RANFunctionDefinition, ranfunc_def);
+        return NULL;
+    }
     logger_trace("after encoding message");
     logger_debug("here is encoded message %s", e2smbuffer);
 
@@ -323,101 +1338,109 @@ encoded_ran_function_t *encode_ran_function_definition() {
 
     This callback is intented to receive the first control message while the handover is ongoing
 
-    It will drive the old run_insert_loop down and set the regular control callback for the following messages
+    It will move the insert loop of the node to e2sim and set the regular control callback for the following messages
 */
-void callback_receive_1st_control_handover(E2AP_PDU_t *ctrl_req_pdu, struct timespec *recv_ts, E2Sim *e2sim, std::string old_e2term_addr, int old_e2term_port, InsertLoopCallback insert_cb) {
+void callback_receive_1st_control_handover(E2AP_PDU_t *ctrl_req_pdu, struct timespec *recv_ts, struct timespec *recv_kts, e2node_t *node, E2Sim *e2sim, std::string old_e2term_addr, int old_e2term_port) {
     using namespace std::placeholders;
 
     logger_force(LOGGER_TRACE, "in func %s", __func__);
 
-    ControlCallback control_request_cb = std::bind(&callback_rc_control_request, _1, _2, cmd_args.num2send, metrics.histogram, metrics.gauge, &sent_ts_map, &recv_ts_map);
+    ControlCallback control_request_cb = std::bind(&callback_rc_control_request, _1, _2, _3, cmd_args.num2send,
+            node->metrics.histogram, node->metrics.gauge, node->metrics.kernel_histogram,
+            &node->sent_ts_map, &node->recv_ts_map, &node->recv_kts_map, node->metrics.failover.get());
     e2sim->register_control_callback(1, control_request_cb);   // change the control callback to the regular one
 
     // call manually first control callback
-    control_request_cb(ctrl_req_pdu, recv_ts);
-
-    logger_force(LOGGER_TRACE, "about to call run_insert_loop thread in %s", __func__);
-    std::thread th(insert_cb, current_subscription.reqRequestorId, current_subscription.reqInstanceId,
-                    current_subscription.reqFunctionId, current_subscription.reqActionId);
-    th.detach();
-    logger_force(LOGGER_TRACE, "run_insert_loop thread has spawned in %s with reqRequestorId=%ld, reqInstanceId=%ld, reqFunctionId=%ld, reqActionId=%ld",
-                __func__, current_subscription.reqRequestorId, current_subscription.reqInstanceId,
-                    current_subscription.reqFunctionId, current_subscription.reqActionId);
+    control_request_cb(ctrl_req_pdu, recv_ts, recv_kts);
 
     E2Sim *old_sim = NULL;
-    std::vector<E2Sim*>::iterator it;
-    for (it = e2sims.begin(); it != e2sims.end(); it++) {
-        if (it.operator*()->is_e2term_endpoint(old_e2term_addr, old_e2term_port)) {
-            old_sim = it.operator*();
-            break;
+    {
+        std::lock_guard<std::mutex> guard(node->lock);
+        node->e2sim = e2sim;    // the next INSERT goes through the new E2Term
+
+        std::vector<E2Sim*>::iterator it;
+        for (it = node->e2sims.begin(); it != node->e2sims.end(); it++) {
+            if ((*it)->is_e2term_endpoint(old_e2term_addr, old_e2term_port)) {
+                old_sim = *it;
+                node->e2sims.erase(it);
+                break;
+            }
         }
     }
 
     if (old_sim) {
-        logger_force(LOGGER_TRACE, "about to shutdown old E2Sim");
-        old_sim->shutdown();
-
-        e2sims.erase(it);
-        delete old_sim;
+        logger_force(LOGGER_TRACE, "about to retire old E2Sim");
+        retire_e2sim(node, old_sim);
     } else {
-        logger_force(LOGGER_ERROR, "old E2Sim not found in e2sims");
+        logger_force(LOGGER_ERROR, "old E2Sim not found in the E2Sims of gNodeB %u", node->gnb_id);
     }
 
-    ok2run = false; // this will stop the old run_insert_loop, which will release seqNumCpidLock mutex for the new run_insert_loop
-
     logger_force(LOGGER_TRACE, "end of func %s", __func__);
 }
 
-void drive_e2term_handover(std::string old_e2term_addr, int old_e2term_port, std::string new_e2term_addr, int new_e2term_port) {
-    using namespace std::placeholders;
-    bool new_connection = false;
-
-    logger_trace("in func %s", __func__);
-
-    E2Sim *e2sim = NULL;
-    for (E2Sim *sim : e2sims) {
-        if (sim->is_e2term_endpoint(new_e2term_addr, new_e2term_port)) {
-            e2sim = sim;
-            break;
-        }
+/*
+    Accounts for an E2 node that has finished its E2Term handover
+*/
+void finish_handover(bool moved) {
+    if (moved) {
+        handovers_done++;
+    } else {
+        handovers_failed++;
     }
 
-    if (e2sim == NULL) {
-        new_connection = true;
-        e2sim = new E2Sim(cmd_args.mcc.c_str(), cmd_args.mnc.c_str(), cmd_args.gnb_id);
-        e2sims.emplace_back(e2sim);
-
-        encoded_ran_function_t *reg_func = encode_ran_function_definition();
-        e2sim->register_e2sm(1, reg_func);
-
+    if (--handovers_pending == 0) {
+        logger_force(LOGGER_INFO, "E2Term handover has finished: %u E2 nodes moved, %u failed",
+                     handovers_done.load(), handovers_failed.load());
     }
+}
 
-    InsertLoopCallback insert_cb = std::bind(&run_insert_loop, _1, _2, _3, _4, e2sim, 0);
+/*
+    Moves the insert loop of the node to the E2Sim connected to the new E2Term. Called by the ramp.
 
-    SubscriptionCallback subscription_request_cb = std::bind(&callback_rc_subscription_request, _1, e2sim, insert_cb, &current_subscription);
-    e2sim->register_subscription_callback(1, subscription_request_cb);
+    A new E2Sim is connected if the node is not connected to the new E2Term yet, and the insert loop
+    only moves once its E2 setup is done (see handle_e2_setup_event). The node keeps sending through
+    the old E2Term if the E2 setup with the new one fails.
+*/
+void start_handover(e2node_t *node, std::string new_e2term_addr, int new_e2term_port) {
+    logger_trace("in func %s", __func__);
 
-    SubscriptionDeleteCallback subscription_delete_cb = std::bind(&callback_rc_subscription_delete_request, _1, e2sim, &ok2run);
-    e2sim->register_subscription_delete_callback(1, subscription_delete_cb);
+    E2Sim *e2sim = NULL;
+    bool connecting = false;    // a previous handover is still connecting to the same E2Term
+    {
+        std::lock_guard<std::mutex> guard(node->lock);
+        for (E2Sim *sim : node->e2sims) {
+            if (sim->is_e2term_endpoint(new_e2term_addr, new_e2term_port)) {
+                e2sim = sim;
+                break;
+            }
+        }
 
-    // ControlCallback control_request_cb = std::bind(&callback_receive_1st_control_handover, _1, _2, e2sim, old_e2term_addr, old_e2term_port, insert_cb);
-    ControlCallback control_request_cb = std::bind(&callback_rc_control_request, _1, _2, cmd_args.num2send, metrics.histogram, metrics.gauge, &sent_ts_map, &recv_ts_map);
-    e2sim->register_control_callback(1, control_request_cb);
-    // TODO e2sim->register_e2ap_removal_callback...
+        if (e2sim != NULL) {
+            connecting = e2sim == node->handover;
+            if (!connecting) {
+                node->e2sim = e2sim;    // already connected, so the running generators move right away
+            }
+        }
+    }
 
-    if (new_connection) {
-        e2sim->run(new_e2term_addr.c_str(), new_e2term_port);
+    if (e2sim != NULL) {
+        if (connecting) {
+            logger_warn("gNodeB %u is still connecting to %s:%d", node->gnb_id, new_e2term_addr.c_str(), new_e2term_port);
+        } else {
+            logger_debug("INSERT generators of gNodeB %u moved to %s:%d", node->gnb_id, new_e2term_addr.c_str(), new_e2term_port);
+        }
+        finish_handover(!connecting);
+        ramp->finished(!connecting);
+        return;
     }
 
-    logger_trace("about to call run_insert_loop thread in %s", __func__);
-    std::thread th(insert_cb, current_subscription.reqRequestorId, current_subscription.reqInstanceId,
-                    current_subscription.reqFunctionId, current_subscription.reqActionId);
-    th.detach();
-    logger_debug("run_insert_loop thread has spawned in %s with reqRequestorId=%ld, reqInstanceId=%ld, reqFunctionId=%ld, reqActionId=%ld",
-                __func__, current_subscription.reqRequestorId, current_subscription.reqInstanceId,
-                    current_subscription.reqFunctionId, current_subscription.reqActionId);
+    e2sim = create_e2sim(node, 0);
+    {
+        std::lock_guard<std::mutex> guard(node->lock);
+        node->handover = e2sim;
+    }
 
-    ok2run = false;
+    e2sim->run_async(new_e2term_addr.c_str(), new_e2term_port);   // the transport profile is exported once the E2 setup is done
 }
 
 void handle_error(pplx::task<void>& t, const utility::string_t msg) {
@@ -445,7 +1468,9 @@ void handle_error(pplx::task<void>& t, const utility::string_t msg) {
         }
     }
 
-    Replies HTTP status code 204 on success
+    The E2 nodes are added to the ramp, which connects them to the new E2Term at the pace of the startup
+    (see --ramp-rate), so this replies HTTP status code 202 right away with the number of E2 nodes to move.
+    The progress is replied by get_handover_progress.
 */
 void handle_e2term_handover(web::http::http_request request) {
     auto answer = web::json::value::object();
@@ -466,9 +1491,14 @@ void handle_e2term_handover(web::http::http_request request) {
                 auto to_port = to.at(U("port")).as_integer();
                 logger_info("E2Term handover from %s:%d to %s:%d", from_addr.c_str(), from_port, to_addr.c_str(), to_port);
 
-                drive_e2term_handover(from_addr.c_str(), from_port, to_addr.c_str(), to_port);
+                handovers_pending += nodes.size();
+                for (auto &node : nodes) {
+                    ramp->add(std::bind(&start_handover, node.get(), to_addr, to_port));
+                }
 
-                request.reply(web::http::status_codes::NoContent)
+                auto reply = web::json::value::object();
+                reply[U("nodes")] = web::json::value::number((uint32_t) nodes.size());
+                request.reply(web::http::status_codes::Accepted, reply)
                     .then([](pplx::task<void> t) {
                         handle_error(t, "handle reply exception");
                     });
@@ -486,10 +1516,160 @@ void handle_e2term_handover(web::http::http_request request) {
         }).wait();
 }
 
+/*
+    Replies the progress of the E2Term handovers as JSON:
+
+    {
+        pending: E2 nodes whose handover has not finished yet,
+        done: E2 nodes moved to the new E2Term,
+        failed: E2 nodes that kept the old E2Term
+    }
+*/
+void get_handover_progress(web::http::http_request request) {
+    auto answer = web::json::value::object();
+    answer[U("pending")] = web::json::value::number(handovers_pending.load());
+    answer[U("done")] = web::json::value::number(handovers_done.load());
+    answer[U("failed")] = web::json::value::number(handovers_failed.load());
+
+    request.reply(web::http::status_codes::OK, answer)
+        .then([](pplx::task<void> t) {
+            handle_error(t, "handle reply exception");
+        });
+}
+
+/*
+    Replies the validation policy of the INSERTs as JSON (see set_validation_policy)
+*/
+void get_validation_policy(web::http::http_request request) {
+    auto answer = web::json::value::object();
+    answer[U("policy")] = web::json::value::string(
+            utility::conversions::to_string_t(validation_policy_name(validation_get_policy())));
+
+    request.reply(web::http::status_codes::OK, answer)
+        .then([](pplx::task<void> t) {
+            handle_error(t, "handle reply exception");
+        });
+}
+
+/*
+    Sets the validation policy of the INSERTs, which applies from their next message on:
+
+    {
+        policy: always | off | sample:N | first:N
+    }
+
+    Replies HTTP status code 204 on success, or 400 if the policy is invalid
+*/
+void set_validation_policy(web::http::http_request request) {
+    request
+        .extract_json()
+        .then([request](pplx::task<web::json::value> task) {
+            web::http::status_code status = web::http::status_codes::NoContent;
+            try {
+                auto body = task.get();
+                auto spec = body.at(U("policy")).as_string();
+
+                validation_policy_t policy;
+                if (validation_parse_policy(spec.c_str(), policy)) {
+                    validation_set_policy(policy);
+                    logger_info("Validation policy set to %s", validation_policy_name(policy).c_str());
+                } else {
+                    logger_error("invalid validation policy %s", spec.c_str());
+                    status = web::http::status_codes::BadRequest;
+                }
+
+            } catch (std::exception const &e) { // http_exception and json_exception inherits from exception
+                logger_error("unable to process JSON payload from http request. Reason = %s", e.what());
+                status = web::http::status_codes::BadRequest;
+            }
+
+            request.reply(status)
+                .then([](pplx::task<void> t) {
+                    handle_error(t, "http reply exception");
+                });
+
+        }).wait();
+}
+
+/*
+    Forwards a RESTCONF request received by the coordinator to the same path of all workers, so a single request
+    changes the whole fleet (e.g. its validation policy or E2Term). Replies the answer of each worker as JSON:
+
+    {
+        workers: [
+            {
+                worker: worker index,
+                status: HTTP status code of the worker, 0 if it has not answered,
+                reply: JSON reply of the worker, if any
+            }
+        ]
+    }
+
+    Replies HTTP status code 200 if all workers have succeeded, or 502 otherwise
+*/
+void forward_to_workers(web::http::http_request request, utility::string_t path) {
+    using namespace web::http;
+
+    web::json::value body = web::json::value::null();
+    if (request.method() == methods::POST) {
+        try {
+            body = request.extract_json().get();
+        } catch (std::exception const &e) {
+            logger_error("unable to process JSON payload from http request. Reason = %s", e.what());
+            request.reply(status_codes::BadRequest)
+                .then([](pplx::task<void> t) {
+                    handle_error(t, "http reply exception");
+                });
+            return;
+        }
+    }
+
+    client::http_client_config config;
+    config.set_timeout(std::chrono::seconds(5));
+
+    auto answers = web::json::value::array(worker_count);
+    bool succeeded = true;
+    for (unsigned int i = 0; i < worker_count; i++) {
+        auto answer = web::json::value::object();
+        answer[U("worker")] = web::json::value::number(i);
+        answer[U("status")] = web::json::value::number(0);
+
+        try {
+            utility::string_t url = U("http://127.0.0.1:") + utility::conversions::to_string_t(std::to_string(8091 + i));
+            client::http_client client(url, config);
+            http_response response = request.method() == methods::POST ?
+                    client.request(methods::POST, path, body).get() : client.request(methods::GET, path).get();
+
+            answer[U("status")] = web::json::value::number(response.status_code());
+            if (response.status_code() >= 300) {
+                succeeded = false;
+            }
+            auto reply = response.extract_json(true).get();     // empty on 204
+            if (!reply.is_null()) {
+                answer[U("reply")] = reply;
+            }
+
+        } catch (std::exception const &e) {
+            logger_error("unable to forward %s to worker %u. Reason = %s", path.c_str(), i, e.what());
+            succeeded = false;
+        }
+
+        answers[i] = answer;
+    }
+
+    auto result = web::json::value::object();
+    result[U("workers")] = answers;
+    request.reply(succeeded ? status_codes::OK : status_codes::BadGateway, result)
+        .then([](pplx::task<void> t) {
+            handle_error(t, "handle reply exception");
+        });
+}
+
 void shutdown_http_listener() {
     logger_info("Shutting down HTTP Listener");
 
     try {
+        validation_listener->close().wait();
         listener->close().wait();
     } catch (std::exception const &e) {
         logger_error("shutdown http listener exception: %s", e.what());
@@ -506,20 +1686,38 @@ void start_http_listener() {
     using namespace http;
     using namespace http::experimental::listener;
 
-    utility::string_t address = U("http://0.0.0.0:8090/restconf/operations/handover");
-    uri_builder uri(address);
+    int port = cmd_args.worker_id < 0 ? 8090 : 8091 + cmd_args.worker_id;     // workers of a coordinator cannot share a port
+    utility::string_t base = U("http://0.0.0.0:") + utility::conversions::to_string_t(std::to_string(port));
+    uri_builder uri(base + U("/restconf/operations/handover"));
+    uri_builder validation_uri(base + U("/restconf/operations/validation"));
 
     auto addr = uri.to_uri().to_string();
-    if (!uri::validate(addr)) {
+    auto validation_addr = validation_uri.to_uri().to_string();
+    if (!uri::validate(addr) || !uri::validate(validation_addr)) {
         throw std::runtime_error("unable starting up the http listener due to invalid URI: " + addr);
     }
 
     listener = std::make_unique<web::http::experimental::listener::http_listener>(addr);
-    listener->support(methods::POST, &handle_e2term_handover);
+    validation_listener = std::make_unique<web::http::experimental::listener::http_listener>(validation_addr);
+    if (worker_count > 0) {     // coordinator, the workers run the E2 nodes
+        using namespace std::placeholders;
+        for (auto &method : {methods::GET, methods::POST}) {
+            listener->support(method, std::bind(&forward_to_workers, _1, U("/restconf/operations/handover")));
+            validation_listener->support(method, std::bind(&forward_to_workers, _1, U("/restconf/operations/validation")));
+        }
+    } else {
+        listener->support(methods::GET, &get_handover_progress);
+        listener->support(methods::POST, &handle_e2term_handover);
+        validation_listener->support(methods::GET, &get_validation_policy);
+        validation_listener->support(methods::POST, &set_validation_policy);
+    }
     try {
         listener
             ->open()
             .wait();        // non-blocking operation
+        validation_listener
+            ->open()
+            .wait();
 
     } catch (std::exception const &e) {
         logger_error("startup http listener exception: %s", e.what());
@@ -527,121 +1725,392 @@ void start_http_listener() {
     }
 }
 
-void run_insert_loop(long reqRequestorId, long reqInstanceId, long ranFunctionId, long reqActionId, E2Sim *e2sim, int sleep_seconds) {
-    struct timespec sent_time;  // timestamp of the sent message
-    unsigned long sent_ns;  // sent_time in nanoseconds
+/*
+    Adds an INSERT generator for an action of a RIC subscription, with the next interval of --sub-interval.
+    The generator only starts sending once run_insert_loop is called for its subscription.
+
+    Returns false if the action of this subscription already has a generator
+*/
+bool add_subscription(long reqRequestorId, long reqInstanceId, long ranFunctionId, long reqActionId, e2node_t *node, E2Sim *e2sim) {
+    std::lock_guard<std::mutex> guard(node->lock);
+
+    InsertGenerator generator = node->subscriptions.add(reqRequestorId, reqInstanceId, ranFunctionId, reqActionId);
+    if (!generator) {
+        logger_warn("action %ld of RIC subscription %ld/%ld already exists in gNodeB %u",
+                    reqActionId, reqRequestorId, reqInstanceId, node->gnb_id);
+        return false;
+    }
+    generator->subscribed_e2sim = e2sim;
+
+    if (cmd_args.sub_intervals.empty()) {
+        generator->interval_ms = cmd_args.loop_interval;
+    } else {
+        generator->interval_ms = cmd_args.sub_intervals[node->generators_added % cmd_args.sub_intervals.size()];
+    }
+    node->generators_added++;
+
+    generator->inserts = &metrics.subscription_inserts_family->Add({
+            {"GNODEB_ID", std::to_string(node->gnb_id)},
+            {"SIM_ID", std::to_string(cmd_args.simulation_id)},
+            {"SUBSCRIPTION", generator_label(generator)}
+        });
+    node->metrics.subscriptions->Set(node->subscriptions.size());
+
+    logger_info("gNodeB %u sends INSERT every %lu ms for action %ld of RIC subscription %ld/%ld",
+                node->gnb_id, generator->interval_ms, reqActionId, reqRequestorId, reqInstanceId);
+
+    return true;
+}
+
+/*
+    Starts the generators of a RIC subscription on the shard of the node, which send their first INSERT after sleep_seconds
+*/
+void run_insert_loop(long reqRequestorId, long reqInstanceId, e2node_t *node, int sleep_seconds) {
 
     logger_trace("in %s function", __func__);
 
-    /*
-        We have to wait for the subscription response to reach the xapp before sending messages.
-        The "E2Sim -> E2Term -> xApp" subscription response requires about 2 seconds to
-        setup the RIC and allow the xApp to process incoming messages.
-        Should we do not wait, then all messages sent within these 2 seconds will also include the
-        latency of the subscription setup (i.e. xApps don't receive any INSERT message prior the subscription has finished).
-    */
-    std::this_thread::sleep_for(std::chrono::seconds(sleep_seconds));
+    std::lock_guard<std::mutex> guard(node->lock);
+
+    for (auto &generator : node->subscriptions.get(reqRequestorId, reqInstanceId)) {
+        if (generator->running || !generator->ok2run) {
+            continue;
+        }
+        generator->running = true;
+        node->running_generators++;
+
+        /*
+            We have to wait for the subscription response to reach the xapp before sending messages.
+            The "E2Sim -> E2Term -> xApp" subscription response requires about 2 seconds to
+            setup the RIC and allow the xApp to process incoming messages.
+            Should we do not wait, then all messages sent within these 2 seconds will also include the
+            latency of the subscription setup (i.e. xApps don't receive any INSERT message prior the subscription has finished).
+        */
+        generator->timer = node->shard->schedule(sleep_seconds * 1000000UL, std::bind(&send_insert, node, generator));
+    }
+}
 
-    OCTET_STRING_t *ostr_cpid = (OCTET_STRING_t *) calloc(1, sizeof(OCTET_STRING_t));
-    ostr_cpid->buf = (uint8_t *) calloc(1, sizeof(cpid));
-    ostr_cpid->size = sizeof(cpid);
+/*
+    Encodes the E2SM-RC indication header and message of the INSERTs sent on e2sim into header and msg.
+    Their buffers come from the arena within an arena scope, ready to be moved into the E2AP PDU.
 
-    logger_debug("about to lock in %s", __func__);
-    std::lock_guard<std::mutex> guard(seqNumCpidLock);  // required to lock to block insert loop to new e2term start before this loop finishes
-    logger_debug("lock acquired in %s", __func__);
+    Returns false on error, then nothing is allocated
+*/
+bool encode_insert_payload(E2Sim *e2sim, OCTET_STRING_t *header, OCTET_STRING_t *msg) {
+    E2SM_RC_IndicationHeader_t *ind_header =
+            (E2SM_RC_IndicationHeader_t *) asn_arena_calloc(1, sizeof(E2SM_RC_IndicationHeader_t));
+    E2SM_RC_IndicationMessage_t *ind_msg =
+            (E2SM_RC_IndicationMessage_t *) asn_arena_calloc(1, sizeof(E2SM_RC_IndicationMessage_t));
+
+    // TODO Huff: these encode_rc_indication_* functions should return a boolean value
+    PLMNIdentity_t *plmn_cpy = e2sim->get_plmn_id_cpy();
+    encode_rc_indication_header(ind_header, plmn_cpy);    // invalidates plmn_cpy variable
+
+    plmn_cpy = e2sim->get_plmn_id_cpy();
+    BIT_STRING_t *gnb_cpy = e2sim->get_gnb_id_cpy();
+    encode_rc_indication_message(ind_msg, plmn_cpy, gnb_cpy); // invalidates plmn_cpy and gnb_cpy variables
+
+    bool ok = encoding::encode_to_octet_string(&asn_DEF_E2SM_RC_IndicationHeader, ind_header, header);
+    logger_trace("after encoding header");
+    ASN_STRUCT_FREE(asn_DEF_E2SM_RC_IndicationHeader, ind_header);
+
+    if (ok) {
+        ok = encoding::encode_to_octet_string(&asn_DEF_E2SM_RC_IndicationMessage, ind_msg, msg);
+        logger_trace("after encoding message");
+        if (!ok) {
+            ASN_STRUCT_RESET(asn_DEF_OCTET_STRING, header);
+        }
+    }
+    ASN_STRUCT_FREE(asn_DEF_E2SM_RC_IndicationMessage, ind_msg);
 
-    ok2run = true;  // on handoff this will only get here after the old run_insert_loop sets ok2run to false and gets out of this function
-    while (ok2run && (cmd_args.num2send == UNLIMITED_MESSAGES || cpid < cmd_args.num2send)) {
+    return ok;
+}
 
-        E2SM_RC_IndicationHeader_t *ind_header =
-                (E2SM_RC_IndicationHeader_t *) calloc(1, sizeof(E2SM_RC_IndicationHeader_t));
-        E2SM_RC_IndicationMessage_t *ind_msg =
-                (E2SM_RC_IndicationMessage_t *) calloc(1, sizeof(E2SM_RC_IndicationMessage_t));
+/*
+    Encodes the INSERT of a generator once for e2sim, so each message only patches its SN and call process ID.
+    Generators whose template cannot be built fall back to encoding each INSERT in full.
+*/
+void build_insert_template(insert_generator_t &generator, E2Sim *e2sim) {
+    generator.template_e2sim = e2sim;
 
-        // TODO Huff: these encode_rc_indication_* functions should return a boolean value
-        PLMNIdentity_t *plmn_cpy = e2sim->get_plmn_id_cpy();
-        encode_rc_indication_header(ind_header, plmn_cpy);    // invalidates plmn_cpy variable
+    AsnArenaScope arena;    // also releases the payload, which the template copies
+    ValidationScope validation(generator.validated);    // the template is checked once, as its first INSERT
 
-        plmn_cpy = e2sim->get_plmn_id_cpy();
-        BIT_STRING_t *gnb_cpy = e2sim->get_gnb_id_cpy();
-        encode_rc_indication_message(ind_msg, plmn_cpy, gnb_cpy); // invalidates plmn_cpy and gnb_cpy variables
+    OCTET_STRING_t header;
+    OCTET_STRING_t msg;
+    if (!encode_insert_payload(e2sim, &header, &msg)) {
+        generator.ind_template.reset();
+        return;
+    }
 
-        asn_codec_ctx_t *opt_cod;
+    if (generator.ind_template.build(RICindicationType_insert, generator.reqRequestorId, generator.reqInstanceId,
+                                     generator.reqFunctionId, generator.reqActionId, header.buf, header.size,
+                                     msg.buf, msg.size, sizeof(unsigned int))) {
+        logger_info("INSERT template of subscription %ld,%ld action %ld is %zu bytes", generator.reqRequestorId,
+                    generator.reqInstanceId, generator.reqActionId, generator.ind_template.size());
+    }
+}
 
-        uint8_t e2sm_header_buffer[8192] = {0, };
-        size_t e2sm_header_buffer_size = 8192;
+/*
+    Sends an INSERT message of a generator and schedules its next one after the generator interval,
+    or stops the generator if its subscription has been deleted or it has sent all messages
+*/
+void send_insert(e2node_t *node, InsertGenerator generator) {
+    std::unique_lock<std::mutex> lk(node->lock);
+
+    generator->timer = 0;
+    if (!generator->ok2run || (cmd_args.num2send != UNLIMITED_MESSAGES && generator->sent >= cmd_args.num2send)) {
+        bool finished = stop_generator(node, generator);
+        lk.unlock();
+        if (finished) {
+            finish_insert_loop(node);
+        }
+        return;
+    }
 
-        asn_enc_rval_t er_header =
-            asn_encode_to_buffer(opt_cod,
-                    ATS_ALIGNED_BASIC_PER,
-                    &asn_DEF_E2SM_RC_IndicationHeader,
-                    ind_header, e2sm_header_buffer, e2sm_header_buffer_size);
+    E2Sim *e2sim = node->e2sim;
+    insert_generator_t &sub = *generator;
 
-        logger_debug("er encded is %ld", er_header.encoded);
-        logger_trace("after encoding header");
+    if (e2sim->is_send_queue_full()) {  // block policy: waits for the queue to drain without blocking the shard
+        node->parked.push_back(generator);
+        return;
+    }
 
-        ASN_STRUCT_FREE(asn_DEF_E2SM_RC_IndicationHeader, ind_header);
+    if (sub.template_e2sim != e2sim) {
+        build_insert_template(sub, e2sim);
+    }
 
-        uint8_t e2sm_msg_buffer[8192] = {0, };
-        size_t e2sm_msg_buffer_size = 8192;
+    unsigned int sent_cpid = node->cpid;
+    SentCallback sent_cb = [node, sent_cpid](struct timespec *sent_time) {
+        node->sent_ts_map[sent_cpid] = elapsed_nanoseconds(*sent_time);  // store the sent timespec in the map (in nanoseconds)
+        node->metrics.failover->insert_sent(sent_cpid);
+    };
 
-        asn_enc_rval_t er_msg =
-            asn_encode_to_buffer(opt_cod,
-                    ATS_ALIGNED_BASIC_PER,
-                    &asn_DEF_E2SM_RC_IndicationMessage,
-                    ind_msg, e2sm_msg_buffer, e2sm_msg_buffer_size);
+    logger_info("Sending RIC-INDICATION type INSERT");
 
-        logger_debug("er encded is %ld", er_msg.encoded);
-        logger_trace("after encoding message");
+    // only the SN and the call process ID change between the INSERTs of a generator
+    const uint8_t *encoded = sub.ind_template.patch(sub.seqNum, (uint8_t *) &node->cpid, sizeof(node->cpid));
+    if (encoded != NULL) {
+        e2sim->queue_encoded_sctp_data(encoded, sub.ind_template.size(), E2AP_STREAM_INDICATION, sent_cb);
 
-        ASN_STRUCT_FREE(asn_DEF_E2SM_RC_IndicationMessage, ind_msg);
+    } else {    // full encoding
+        AsnArenaScope arena;    // releases the E2SM and E2AP structures of the INSERT at once
+        ValidationScope validation(sub.validated);
 
-        // call process id
-        memcpy(ostr_cpid->buf, &cpid, sizeof(cpid));
+        OCTET_STRING_t e2sm_header;
+        OCTET_STRING_t e2sm_msg;
 
-        E2AP_PDU_t *pdu = (E2AP_PDU_t *) calloc(1, sizeof(E2AP_PDU_t));
-        encoding::generate_e2ap_indication_request_parameterized(pdu, RICindicationType_insert, reqRequestorId,
-                reqInstanceId, ranFunctionId, reqActionId, seqNum,
-                e2sm_header_buffer, er_header.encoded,
-                e2sm_msg_buffer, er_msg.encoded, ostr_cpid);
+        if (!encode_insert_payload(e2sim, &e2sm_header, &e2sm_msg)) {
+            logger_error("unable to encode the E2SM-RC payload of the INSERT of gNodeB %u", node->gnb_id);
 
-        logger_info("Sending RIC-INDICATION type INSERT");
+        } else {
+            // the fast encoder writes the E2AP PDU around the payload with no asn1c structures, falling back to them if needed
+            size_t size = e2sm_header.size + e2sm_msg.size + sizeof(node->cpid) + FAST_APER_INDICATION_OVERHEAD;
+            uint8_t *encoded = (uint8_t *) asn_arena_malloc(size);
+            ssize_t len = -1;
+            if (encoded != NULL) {
+                len = encoding::fast_encode_indication(encoded, size, RICindicationType_insert, sub.reqRequestorId,
+                        sub.reqInstanceId, sub.reqFunctionId, sub.reqActionId, sub.seqNum, e2sm_header.buf,
+                        e2sm_header.size, e2sm_msg.buf, e2sm_msg.size, (uint8_t *) &node->cpid, sizeof(node->cpid));
+            }
+
+            if (len > 0 && (size_t) len <= size) {
+                e2sim->queue_encoded_sctp_data(encoded, len, E2AP_STREAM_INDICATION, sent_cb);
+                ASN_STRUCT_RESET(asn_DEF_OCTET_STRING, &e2sm_header);
+                ASN_STRUCT_RESET(asn_DEF_OCTET_STRING, &e2sm_msg);
+
+            } else {
+                // call process id, copied into the pdu
+                OCTET_STRING_t ostr_cpid;
+                memset(&ostr_cpid, 0, sizeof(ostr_cpid));
+                ostr_cpid.buf = (uint8_t *) &node->cpid;
+                ostr_cpid.size = sizeof(node->cpid);
+
+                E2AP_PDU_t *pdu = (E2AP_PDU_t *) asn_arena_calloc(1, sizeof(E2AP_PDU_t));
+                encoding::generate_e2ap_indication_request_parameterized(pdu, RICindicationType_insert, sub.reqRequestorId,
+                        sub.reqInstanceId, sub.reqFunctionId, sub.reqActionId, sub.seqNum,
+                        &e2sm_header, &e2sm_msg, &ostr_cpid);   // the pdu takes the payload, with no copies
+
+                e2sim->encode_and_queue_sctp_data(pdu, sent_cb);
+            }
+            asn_arena_free(encoded);
+        }
+    }
+
+    send_stats_t stats = e2sim->get_send_stats();
+    node->metrics.send_allocs->Set(stats.allocations);
+    node->metrics.queue_depth->Set(stats.queue_depth);
+    node->metrics.queue_bytes->Set(stats.queue_bytes);
+
+    sub.inserts->Increment();
+    sub.seqNum++;
+    sub.sent++;
+    node->cpid++;
+
+    sub.timer = node->shard->schedule(sub.interval_ms * 1000UL, std::bind(&send_insert, node, generator));
+}
+
+/*
+    Schedules the next INSERT of the generators of the node parked on a full send queue.
+    Runs with the send path of an E2Sim locked, so the generators are resumed by a task of the shard.
+*/
+void resume_generators(e2node_t *node) {
+    node->shard->schedule(0, [node] {
+        std::lock_guard<std::mutex> guard(node->lock);
+        for (auto &generator : node->parked) {
+            generator->timer = node->shard->schedule(0, std::bind(&send_insert, node, generator));
+        }
+        node->parked.clear();
+    });
+}
+
+/*
+    Marks a generator as no longer scheduled. Requires the lock of the node.
+
+    Returns true if it was the last running generator of the node
+*/
+bool stop_generator(e2node_t *node, const InsertGenerator &generator) {
+    if (!generator->running) {
+        return false;
+    }
+
+    generator->running = false;
+    generator->timer = 0;
+    node->running_generators--;
+
+    return node->running_generators == 0;
+}
+
+/*
+    Deletes a RIC subscription of the node, cancelling the pending INSERT of each of its generators,
+    so they stop right away rather than on their next interval. Other subscriptions keep running.
+*/
+void delete_subscription(long reqRequestorId, long reqInstanceId, e2node_t *node) {
+    bool finished = false;
+    {
+        std::lock_guard<std::mutex> guard(node->lock);
+
+        std::vector<InsertGenerator> removed = node->subscriptions.remove(reqRequestorId, reqInstanceId);
+        if (removed.empty()) {
+            logger_warn("RIC subscription %ld/%ld not found in gNodeB %u", reqRequestorId, reqInstanceId, node->gnb_id);
+            return;
+        }
 
-        e2sim->encode_and_send_sctp_data(pdu, &sent_time);   // timespec to store the timestamp of this message
-        sent_ns = elapsed_nanoseconds(sent_time);           // store the sent timespec in the map (in nanoseconds)
-        sent_ts_map[cpid] = sent_ns;
+        finished = cancel_generators(node, removed);
+        node->metrics.subscriptions->Set(node->subscriptions.size());
+    }
+
+    if (finished) {
+        finish_insert_loop(node);
+    }
+}
+
+/*
+    Cancels the pending INSERT of each generator removed from the subscriptions of the node,
+    so they stop right away rather than on their next interval. Requires the lock of the node.
+
+    Returns true if the last running generator of the node has stopped
+*/
+bool cancel_generators(e2node_t *node, std::vector<InsertGenerator> &removed) {
+    bool finished = false;
+
+    for (auto &generator : removed) {
+        generator->ok2run = false;
+        metrics.subscription_inserts_family->Remove(generator->inserts);
+        generator->inserts = nullptr;
+
+        // if the INSERT is already running, send_insert stops the generator itself
+        auto parked = std::find(node->parked.begin(), node->parked.end(), generator);
+        if (parked != node->parked.end()) {
+            node->parked.erase(parked);
+            finished |= stop_generator(node, generator);
+        } else if (generator->running && node->shard->cancel(generator->timer, false)) {
+            finished |= stop_generator(node, generator);
+        }
+    }
+
+    return finished;
+}
 
-        seqNum++;
-        cpid++;
+/*
+    Stops the generators subscribed through an E2Sim the node no longer sends on, and deletes it.
+    Both run in the shard of the node, so no INSERT is using the E2Sim by then.
+*/
+void retire_e2sim(e2node_t *node, E2Sim *old_sim) {
+    node->shard->schedule(0, [node, old_sim] {
+        bool finished;
+        {
+            std::lock_guard<std::mutex> guard(node->lock);
+
+            std::vector<InsertGenerator> removed = node->subscriptions.remove_subscribed_by(old_sim);
+            finished = cancel_generators(node, removed);
+            node->metrics.subscriptions->Set(node->subscriptions.size());
+
+            // the other parked generators wait for room in the send queue of the old E2Sim, which is going away
+            for (auto &generator : node->parked) {
+                generator->timer = node->shard->schedule(0, std::bind(&send_insert, node, generator));
+            }
+            node->parked.clear();
+        }
 
-        if(cmd_args.loop_interval > 0) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(cmd_args.loop_interval));
+        if (finished) {
+            finish_insert_loop(node);
         }
+
+        old_sim->shutdown();
+        delete old_sim;
+    });
+}
+
+/*
+    Reports the send statistics of the node once all of its generators have stopped
+*/
+void finish_insert_loop(e2node_t *node) {
+    E2Sim *e2sim;
+    {
+        std::lock_guard<std::mutex> guard(node->lock);
+        e2sim = node->e2sim;
     }
 
-    ASN_STRUCT_FREE(asn_DEF_OCTET_STRING, ostr_cpid);
+    send_stats_t stats = e2sim->get_send_stats();
+    logger_info("E2Sim of gNodeB %u has sent %lu messages in %lu batches with %lu send buffer allocations (%zu bytes)",
+                node->gnb_id, stats.messages, stats.batches, stats.allocations, stats.buffer_size);
+    logger_info("E2Sim of gNodeB %u has queued %lu messages, dropped %lu, and paused its generators %lu times on a full send queue (policy %s)",
+                node->gnb_id, stats.queued, stats.dropped, stats.blocked, send_queue_policy_name(cmd_args.queue_policy));
 
-    logger_debug("%s has finished", __func__);
+    logger_debug("insert loop of gNodeB %u has finished", node->gnb_id);
 
     if (cmd_args.num2send != UNLIMITED_MESSAGES) { // we do not generate the timestamp report file when running on infinite loop
-        std::this_thread::sleep_for(std::chrono::seconds(cmd_args.report_wait));   // wait for all messages coming back
-        save_timestamp_report();
+        // wait for all messages coming back
+        node->shard->schedule(cmd_args.report_wait * 1000000UL, std::bind(&save_timestamp_report, node));
     }
 }
 
-void save_timestamp_report() {
+/*
+    Stores the latencies of the node in /tmp/e2sim_report.log, or in /tmp/e2sim_report_<gNodeB ID>.log
+    when simulating more than one E2 node or running as a worker process
+*/
+void save_timestamp_report(e2node_t *node) {
     std::fstream io_file;
     unsigned long latency;
     unsigned long sent;
     unsigned long recv;
 
-    io_file.open("/tmp/e2sim_report.log", std::ios::in|std::ios::out|std::ios::trunc);
+    std::string filename = "/tmp/e2sim_report.log";
+    if (cmd_args.num_nodes > 1 || cmd_args.worker_id >= 0) {
+        filename = "/tmp/e2sim_report_" + std::to_string(node->gnb_id) + ".log";
+    }
+
+    std::unordered_map<unsigned int, unsigned long> &sent_ts_map = node->sent_ts_map;
+    std::unordered_map<unsigned int, unsigned long> &recv_ts_map = node->recv_ts_map;
+    std::unordered_map<unsigned int, unsigned long> &recv_kts_map = node->recv_kts_map;
+
+    io_file.open(filename, std::ios::in|std::ios::out|std::ios::trunc);
     if (!io_file) {
         logger_error("unable to open file to store the latency report: %s", strerror(errno));
         return;
     }
 
-    io_file << "cpid\tlatency(mu-sec)\n";
+    io_file << "cpid\tlatency(mu-sec)\tkernel-latency(mu-sec)\n";
 
     for (size_t i = 0; i < recv_ts_map.size(); i++) {
         try {
@@ -653,12 +2122,19 @@ void save_timestamp_report() {
         }
 
         latency = (recv - sent) / 1000;     // converting to mu-sec
-        io_file << i << "\t" << latency << std::endl;
+        io_file << i << "\t" << latency << "\t";
+
+        auto kernel_recv = recv_kts_map.find(i);
+        if (kernel_recv != recv_kts_map.end()) {
+            io_file << (kernel_recv->second - sent) / 1000 << std::endl;
+        } else {
+            io_file << "-" << std::endl;     // kernel timestamps are disabled
+        }
 
         logger_debug("sent: %lu, recv: %lu, latency: %lu", sent, recv, latency);
     }
 
     io_file.close();
 
-    logger_force(LOGGER_INFO, "Simulation done!");
+    logger_force(LOGGER_INFO, "Simulation of gNodeB %u done!", node->gnb_id);
 }
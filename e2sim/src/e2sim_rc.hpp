@@ -22,23 +22,127 @@
 #include <prometheus/family.h>
 #include <prometheus/exposer.h>
 #include <prometheus/histogram.h>
+#include <prometheus/counter.h>
 #include <functional>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include <signal.h>
 
 #include "e2sim.hpp"
+#include "failover_tracker.hpp"
+#include "subscription_table.hpp"
+#include "asn_arena.h"
+#include "validation_policy.hpp"
 
 using namespace prometheus;
 
-// helper for prometheus metrics
+// helper for prometheus metrics, families are shared by all E2 nodes, as well as the metrics of the startup ramp
 typedef struct {
     std::shared_ptr<Registry> registry;
     Family<Histogram> *hist_family;
     std::shared_ptr<Exposer> exposer;
-    Histogram *histogram = nullptr;
     std::shared_ptr<Histogram::BucketBoundaries> buckets;
     Family<Gauge> *gauge_family;
-    Gauge *gauge = nullptr;
+    Family<Histogram> *kernel_hist_family;
+    Family<Gauge> *send_allocs_family;
+    Family<Histogram> *failover_family;
+    std::shared_ptr<Histogram::BucketBoundaries> failover_buckets;
+    Family<Counter> *failures_family;
+    Family<Counter> *failover_delayed_family;
+    Family<Counter> *failover_lost_family;
+    Family<Gauge> *transport_family;    // effective values of the SCTP transport profile, one gauge per option
+    Family<Gauge> *queue_depth_family;
+    Family<Gauge> *queue_bytes_family;
+    Family<Counter> *queue_drops_family;
+    Family<Histogram> *queue_delay_family;
+    std::shared_ptr<Histogram::BucketBoundaries> queue_delay_buckets;
+    Family<Histogram> *setup_family;
+    std::shared_ptr<Histogram::BucketBoundaries> setup_buckets;
+    Family<Counter> *setup_retries_family;
+    Family<Counter> *setup_failures_family;
+    Family<Histogram> *setup_response_family;
+    Family<Gauge> *setup_inflight_family;
+    Family<Gauge> *setup_all_family;
+    Family<Gauge> *subscriptions_family;
+    Family<Counter> *subscription_inserts_family;   // one counter per INSERT generator, removed on subscription delete
+    Histogram *setup_response;      // time the E2Term takes to answer an E2-SETUP-REQUEST, of all E2 nodes
+    Gauge *setup_inflight;          // E2 nodes started by the ramp and still connecting
+    Gauge *setup_all;               // time the ramp took to finish the E2 setup of all E2 nodes
+    Family<Gauge> *shard_busy_family;
+    Family<Gauge> *shard_nodes_family;
+    Family<Counter> *shard_events_family;
+    Family<Counter> *shard_tasks_family;
+    Family<Gauge> *shard_timers_family;
+    Family<Counter> *shard_arena_allocs_family;
+    Family<Counter> *shard_heap_allocs_family;
+    Family<Gauge> *shard_arena_high_water_family;
+    Family<Counter> *shard_validation_checks_family;
+    Family<Counter> *shard_validation_skipped_family;
+    Family<Counter> *shard_validation_violations_family;
 } metrics_t;
 
+// load of a shard, labelled with its index and CPU
+typedef struct {
+    Gauge *busy = nullptr;          // fraction of time the shard has run handlers and tasks in the last period
+    Gauge *nodes = nullptr;         // E2 nodes bound to the shard
+    Counter *events = nullptr;
+    Counter *tasks = nullptr;
+    Gauge *timers = nullptr;        // timers waiting in the shard (e.g. insert loops and E2 setup retries)
+    Counter *arena_allocs = nullptr;    // ASN.1 allocations served by the arena of the shard thread
+    Counter *heap_allocs = nullptr;     // ASN.1 allocations that went to the heap
+    Gauge *arena_high_water = nullptr;  // most bytes a single message has taken from the arena
+    Counter *validation_checks = nullptr;       // constraint checks run by the shard
+    Counter *validation_skipped = nullptr;      // constraint checks skipped by the validation policy
+    Counter *validation_violations = nullptr;   // constraint checks that failed
+    reactor_stats_t last = {};      // stats of the previous period, only touched by the shard thread
+    asn_arena_stats_t last_arena = {};
+    validation_stats_t last_validation = {};
+} shard_metrics_t;
+
+// metrics of a single E2 node, labelled with its gNodeB ID
+typedef struct {
+    Histogram *histogram = nullptr;
+    Gauge *gauge = nullptr;
+    Histogram *kernel_histogram = nullptr;  // same loop as histogram, but received messages are stamped by the kernel
+    Gauge *send_allocs = nullptr;   // heap allocations of the E2Sim send path, constant on steady state
+    Histogram *failover_hist = nullptr;
+    Counter *failures = nullptr;
+    Counter *failover_delayed = nullptr;
+    Counter *failover_lost = nullptr;
+    std::shared_ptr<FailoverTracker> failover;
+    Gauge *queue_depth = nullptr;   // messages waiting for room in the socket buffer
+    Gauge *queue_bytes = nullptr;
+    Counter *queue_drops[E2AP_NUM_STREAMS] = {nullptr};   // dropped messages per E2AP class
+    Histogram *queue_delay = nullptr;   // time messages wait in the send queue
+    Histogram *setup = nullptr;     // time from connecting to the E2Term until the E2 setup is done
+    Counter *setup_retries = nullptr;
+    Counter *setup_failures = nullptr;
+    Gauge *subscriptions = nullptr; // INSERT generators of the node, one per accepted action of its RIC subscriptions
+} node_metrics_t;
+
+// state of a simulated E2 node, each one with its own SCTP associations
+typedef struct {
+    uint32_t gnb_id;                // gNodeB Identity
+    Reactor *shard = nullptr;       // runs the associations, timers and insert loop of the node
+    unsigned int shard_id = 0;
+    std::vector<E2Sim *> e2sims;    // one per E2Term, guarded by lock
+    E2Sim *e2sim = nullptr;         // E2Sim the insert loop sends on, it changes on E2Term handover, guarded by lock
+    node_metrics_t metrics;
+    SubscriptionTable subscriptions;    // RIC subscriptions and their INSERT generators, guarded by lock
+    unsigned int generators_added = 0;  // picks the interval of each new generator, guarded by lock
+    unsigned int running_generators = 0;    // generators scheduled in the shard, guarded by lock
+    std::vector<InsertGenerator> parked;    // running generators waiting for room in the send queue, guarded by lock
+    bool setup_failed = false;      // the E2Sim of the node has given up the E2 setup, guarded by lock
+    E2Sim *ramping = nullptr;       // E2Sim started by the startup ramp and still connecting, guarded by lock
+    E2Sim *handover = nullptr;      // E2Sim connecting to the new E2Term of a handover, guarded by lock
+    unsigned int cpid = 0;          // shared by all generators, so CONTROLs are matched to their INSERT, guarded by lock
+    std::mutex lock;
+    std::unordered_map<unsigned int, unsigned long> sent_ts_map;    // timestamp of sent messages (INSERT) in nanoseconds
+    std::unordered_map<unsigned int, unsigned long> recv_ts_map;    // timestamp of received messages (CONTROL) in nanoseconds
+    std::unordered_map<unsigned int, unsigned long> recv_kts_map;   // kernel timestamp of received messages (CONTROL) in nanoseconds
+} e2node_t;
+
 // helper for command line input arguments
 typedef struct {
     std::string server_ip;          // E2Term IP
@@ -46,19 +150,72 @@ typedef struct {
     int report_wait;                // time (seconds) to wait before store latencies report into file
     unsigned long loop_interval;    // time (milliseconds) between each insert message that is sent to the RIC
     unsigned long num2send;         // number of messages to send in the simulation
-    uint32_t gnb_id;                // gNodeB Identity
+    uint32_t gnb_id;                // gNodeB Identity of the first E2 node
+    unsigned int num_nodes;         // number of simulated E2 nodes, with consecutive gNodeB identities
+    unsigned int shards;            // threads running the E2 nodes, each one owning a disjoint set of nodes (0 is one per CPU)
+    std::vector<int> cpus;          // CPUs the shards are pinned to, round-robin (empty does not pin)
     uint32_t simulation_id;         // Simulation ID for prometheus reports
     std::string mcc;                // gNodeB Mobile Country Code
     std::string mnc;                // gNodeB Mobile Network Code
+    bool single_stream;             // sends all E2AP messages on SCTP stream 0
+    unsigned int batch_size;        // maximum number of insert messages sent in a single batch (batching is disabled if <= 1)
+    unsigned long batch_flush;      // time (microseconds) a batched insert message waits to be sent
+    std::vector<std::string> local_addrs;   // local addresses of the SCTP association (multihoming)
+    std::vector<std::string> peer_addrs;    // additional E2Term addresses of the SCTP association (multihoming)
+    bool kernel_timestamps;         // also measures the latency using the kernel receive timestamps
+    sctp_profile_t transport;       // SCTP transport profile (e.g. nodelay, socket buffers, RTO, heartbeat)
+    bool uring;                     // sends and receives the SCTP data through io_uring instead of epoll
+    unsigned int submit_batch;      // queued messages that trigger an io_uring submission (1 submits each message right away)
+    unsigned long submit_us;        // time (microseconds) a queued message waits for an io_uring submission
+    send_queue_policy_e queue_policy;   // what to do with messages that do not fit in a full send queue
+    size_t queue_messages;          // maximum number of messages waiting in the send queue
+    size_t queue_bytes;             // maximum number of bytes waiting in the send queue
+    e2_setup_policy_t setup;        // retries and backoff of the E2-SETUP-REQUEST
+    double ramp_rate;               // E2 nodes started per second (0 starts all of them at once)
+    unsigned long ramp_jitter;      // maximum random delay (milliseconds) of the start of each E2 node
+    unsigned int ramp_inflight;     // maximum number of E2 nodes connecting at the same time (0 does not limit)
+    std::vector<unsigned long> sub_intervals;   // interval (milliseconds) of each new generator of a node, round-robin (empty uses loop_interval)
+    unsigned int processes;         // worker processes forked by the coordinator, each one running a range of the E2 nodes (1 does not fork)
+    std::vector<std::string> e2terms;   // E2Term endpoints as address[:port] assigned to the workers, round-robin (empty uses server_ip)
+    std::string metrics_socket;     // Unix domain socket the workers push their metrics to
+    validation_policy_t validation; // which INSERTs have their ASN.1 constraints checked
+    int worker_id;                  // index of this worker process, -1 if not forked by a coordinator
 } args_t;
 
-typedef std::function<void(long requestorId, long instanceId, long ranFunctionId, long actionId)> InsertLoopCallback;
+typedef std::function<bool(long requestorId, long instanceId, long ranFunctionId, long actionId)> AddSubscriptionCallback;  // false rejects the action
+typedef std::function<void(long requestorId, long instanceId)> InsertLoopCallback;         // starts the generators of a subscription
+typedef std::function<void(long requestorId, long instanceId)> DeleteSubscriptionCallback;
 
 void init_prometheus(metrics_t &metrics);
+void init_node_metrics(e2node_t *node);
+void init_shard_metrics();
+void update_shard_metrics(unsigned int shard_id);
+void export_transport_profile(e2node_t *node, E2Sim *e2sim);
+void update_send_queue_metrics(node_metrics_t *node_metrics, const send_queue_event_t &event);
+void handle_e2_setup_event(e2node_t *node, E2Sim *e2sim, const e2_setup_event_t &event);
+void start_node(e2node_t *node);
+void start_handover(e2node_t *node, std::string new_e2term_addr, int new_e2term_port);
+void finish_handover(bool moved);
 args_t parse_input_options(int argc, char *argv[]);
+std::vector<std::string> split_addresses(const char *list);
+void split_endpoint(const std::string &endpoint, std::string &address, int &port);
+std::string get_hostname();
+bool fork_workers();
+int run_coordinator(sigset_t &monitored_signals);
 encoded_ran_function_t *encode_ran_function_definition();
-void run_insert_loop(long requestorId, long instanceId, long ranFunctionId, long actionId, E2Sim *e2sim, int sleep_seconds);
-void save_timestamp_report();
+E2Sim *create_e2sim(e2node_t *node, int sleep_seconds);
+bool add_subscription(long requestorId, long instanceId, long ranFunctionId, long actionId, e2node_t *node, E2Sim *e2sim);
+void run_insert_loop(long requestorId, long instanceId, e2node_t *node, int sleep_seconds);
+bool encode_insert_payload(E2Sim *e2sim, OCTET_STRING_t *header, OCTET_STRING_t *msg);
+void build_insert_template(insert_generator_t &generator, E2Sim *e2sim);
+void send_insert(e2node_t *node, InsertGenerator generator);
+void resume_generators(e2node_t *node);
+bool stop_generator(e2node_t *node, const InsertGenerator &generator);
+bool cancel_generators(e2node_t *node, std::vector<InsertGenerator> &removed);
+void retire_e2sim(e2node_t *node, E2Sim *old_sim);
+void delete_subscription(long requestorId, long instanceId, e2node_t *node);
+void finish_insert_loop(e2node_t *node);
+void save_timestamp_report(e2node_t *node);
 void start_http_listener();
 void shutdown_http_listener();
 
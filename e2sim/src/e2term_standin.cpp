@@ -0,0 +1,427 @@
+/*****************************************************************************
+#                                                                            *
+# Copyright 2023 Alexandre Huff                                              *
+#                                                                            *
+# Licensed under the Apache License, Version 2.0 (the "License");            *
+# you may not use this file except in compliance with the License.           *
+# You may obtain a copy of the License at                                    *
+#                                                                            *
+#      http://www.apache.org/licenses/LICENSE-2.0                            *
+#                                                                            *
+# Unless required by applicable law or agreed to in writing, software        *
+# distributed under the License is distributed on an "AS IS" BASIS,          *
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+# See the License for the specific language governing permissions and        *
+# limitations under the License.                                             *
+#                                                                            *
+******************************************************************************/
+
+/*
+    Minimal E2Term stand-in to run the simulator on a single box without a RIC, e.g. to test a coordinator
+    with its workers. It accepts any number of SCTP associations, answers each E2-SETUP-REQUEST with an
+    E2-SETUP-RESPONSE followed by a RIC-SUBSCRIPTION-REQUEST of INSERT actions for each RAN function of the
+    E2 node, and answers each INSERT RIC-INDICATION with a RIC-CONTROL-REQUEST of its call process ID. It only
+    counts the other E2AP messages it receives.
+
+    The E2SM event trigger, control header and control message are placeholder octets, as the E2SM-RC
+    callbacks of the simulator do not read them.
+
+    Messages that do not fit in the socket buffer wait in a bounded queue of their association until it is
+    writable, so the reactor thread never blocks. Messages that do not fit in that queue either are dropped
+    and reported on exit, as the latencies measured by the simulator are not reliable on such runs.
+*/
+
+#include <getopt.h>
+#include <csignal>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+
+#include "reactor.hpp"
+#include "send_queue.hpp"
+#include "e2sim_sctp.hpp"
+#include "e2ap_message_handler.hpp"
+#include "encode_e2ap.hpp"
+#include "logger.h"
+#include "e2sim_defs.h"
+
+extern "C" {
+    #include "E2AP-PDU.h"
+    #include "ProcedureCode.h"
+    #include "ProtocolIE-Field.h"
+    #include "RANfunctions-List.h"
+}
+
+#define STANDIN_REQUESTOR_ID 1
+#define STANDIN_INSTANCE_ID 1
+#define STANDIN_MAX_ACTIONS 16  // maxofRICactionID of E2AP
+
+typedef struct {
+    int fd;
+    sctp_recv_ring_t *ring;
+    int ostreams;   // number of outbound SCTP streams of the association
+    SendQueue pending;  // messages waiting for room in the socket buffer
+    bool watching;      // the socket is watched for room in its buffer
+} standin_conn_t;
+
+Reactor *reactor = NULL;
+int server_fd = -1;
+pdu_buffer_t setup_response;    // encoded once, all E2 nodes receive the same response
+std::unordered_map<int, standin_conn_t> conns;  // only touched by the reactor thread
+std::atomic<unsigned long> setups(0);
+std::atomic<unsigned long> messages(0);
+std::atomic<unsigned long> subscriptions(0);
+std::atomic<unsigned long> controls(0);
+std::atomic<unsigned long> drops(0);
+int action_count = 1;
+const uint8_t placeholder[] = {0x00};    // E2SM octets not decoded by the simulator
+
+void close_connection(int fd) {
+    auto it = conns.find(fd);
+    if (it == conns.end()) {
+        return;
+    }
+
+    reactor->remove(fd);
+    close(fd);
+    sctp_recv_ring_free(it->second.ring);
+    conns.erase(it);
+
+    logger_info("[E2Term] association %d closed, %zu remaining", fd, conns.size());
+}
+
+/*
+    Starts or stops watching the socket of the association for room in its buffer
+*/
+void watch_writable(standin_conn_t &conn, bool watch) {
+    if (conn.watching == watch) {
+        return;
+    }
+
+    try {
+        reactor->modify(conn.fd, watch ? EPOLLIN | EPOLLOUT : EPOLLIN);
+        conn.watching = watch;
+    } catch (const std::runtime_error &e) {
+        logger_error("[E2Term] unable to watch association %d: %s", conn.fd, e.what());
+    }
+}
+
+/*
+    Hands a message to the socket of the association without blocking, or queues it if the socket buffer is full
+    or other messages are already waiting.
+
+    Returns false if the message has been dropped
+*/
+bool send_message(int fd, const uint8_t *buf, size_t len, uint16_t stream) {
+    auto it = conns.find(fd);
+    if (it == conns.end()) {
+        return false;
+    }
+    standin_conn_t &conn = it->second;
+
+    if (conn.pending.empty()) {     // otherwise the message would overtake the queued ones
+        int sock = fd;
+        if (sctp_send_data(sock, buf, len, NULL, stream, MSG_DONTWAIT) > 0) {
+            return true;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            drops++;
+            return false;
+        }
+    }
+
+    if (!conn.pending.has_room(len)) {
+        logger_warn("[E2Term] pending queue of association %d is full, dropping a message of %zu bytes", fd, len);
+        drops++;
+        return false;
+    }
+
+    conn.pending.push(buf, len, stream, stream, nullptr);
+    watch_writable(conn, true);
+
+    return true;
+}
+
+/*
+    Sends the queued messages of the association until its socket buffer is full again
+*/
+void flush_pending(standin_conn_t &conn) {
+    while (!conn.pending.empty()) {
+        queued_msg_t &msg = conn.pending.front();
+        int sock = conn.fd;
+        if (sctp_send_data(sock, msg.data.data(), msg.data.size(), NULL, msg.stream, MSG_DONTWAIT) <= 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            drops++;
+        }
+        conn.pending.pop();
+    }
+
+    watch_writable(conn, false);
+}
+
+/*
+    Sends a RIC-SUBSCRIPTION-REQUEST of action_count INSERT actions for each RAN function added by the E2 node
+*/
+void send_subscriptions(int fd, E2setupRequest_t *setup_req) {
+    std::vector<long> ran_functions;
+
+    for (int i = 0; i < setup_req->protocolIEs.list.count; i++) {
+        E2setupRequestIEs_t *ie = setup_req->protocolIEs.list.array[i];
+        if (ie->value.present != E2setupRequestIEs__value_PR_RANfunctions_List) {
+            continue;
+        }
+        RANfunctions_List_t *funcs = &ie->value.choice.RANfunctions_List;
+        for (int j = 0; j < funcs->list.count; j++) {
+            RANfunction_ItemIEs_t *item = (RANfunction_ItemIEs_t *) funcs->list.array[j];
+            ran_functions.push_back(item->value.choice.RANfunction_Item.ranFunctionID);
+        }
+    }
+
+    for (long ran_function : ran_functions) {
+        E2AP_PDU_t *pdu = (E2AP_PDU_t *) calloc(1, sizeof(E2AP_PDU_t));
+        encoding::generate_e2ap_subscription_request_parameterized(pdu, STANDIN_REQUESTOR_ID, STANDIN_INSTANCE_ID, ran_function,
+                RICactionType_insert, action_count, placeholder, sizeof(placeholder));
+
+        pdu_buffer_t buffer;
+        pdu_buffer_init(&buffer);
+        // same stream as the E2-SETUP-RESPONSE, so the E2 node does not receive the subscription before the setup
+        if (e2ap_encode_pdu(pdu, buffer) > 0 && send_message(fd, buffer.buf, buffer.len, E2AP_STREAM_GLOBAL)) {
+            subscriptions++;
+            logger_debug("[E2Term] sent RIC-SUBSCRIPTION-REQUEST of RAN function %ld on association %d", ran_function, fd);
+        } else {
+            logger_error("[E2Term] unable to send RIC-SUBSCRIPTION-REQUEST of RAN function %ld on association %d", ran_function, fd);
+        }
+        pdu_buffer_release(&buffer);
+        ASN_STRUCT_FREE(asn_DEF_E2AP_PDU, pdu);
+    }
+}
+
+/*
+    Answers an INSERT RIC-INDICATION with a RIC-CONTROL-REQUEST of the same RIC request, RAN function and call process ID
+*/
+void send_control(int fd, RICindication_t *indication) {
+    RICrequestID_t *request_id = NULL;
+    long ran_function = -1;
+    OCTET_STRING_t *call_proc_id = NULL;
+    bool insert = false;
+
+    for (int i = 0; i < indication->protocolIEs.list.count; i++) {
+        RICindication_IEs_t *ie = indication->protocolIEs.list.array[i];
+        switch (ie->value.present) {
+            case RICindication_IEs__value_PR_RICrequestID:
+                request_id = &ie->value.choice.RICrequestID;
+                break;
+            case RICindication_IEs__value_PR_RANfunctionID:
+                ran_function = ie->value.choice.RANfunctionID;
+                break;
+            case RICindication_IEs__value_PR_RICindicationType:
+                insert = ie->value.choice.RICindicationType == RICindicationType_insert;
+                break;
+            case RICindication_IEs__value_PR_RICcallProcessID:
+                call_proc_id = &ie->value.choice.RICcallProcessID;
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (!insert) {
+        return;
+    }
+    if (request_id == NULL || ran_function == -1 || call_proc_id == NULL) {
+        logger_warn("[E2Term] INSERT RIC-INDICATION with missing IEs on association %d", fd);
+        return;
+    }
+
+    E2AP_PDU_t *pdu = (E2AP_PDU_t *) calloc(1, sizeof(E2AP_PDU_t));
+    encoding::generate_e2ap_control_request_parameterized(pdu, request_id->ricRequestorID, request_id->ricInstanceID, ran_function,
+            call_proc_id, placeholder, sizeof(placeholder), placeholder, sizeof(placeholder));
+
+    auto it = conns.find(fd);
+    int stream = it != conns.end() && it->second.ostreams > E2AP_STREAM_CONTROL ? E2AP_STREAM_CONTROL : E2AP_STREAM_GLOBAL;
+
+    pdu_buffer_t buffer;
+    pdu_buffer_init(&buffer);
+    if (e2ap_encode_pdu(pdu, buffer) > 0 && send_message(fd, buffer.buf, buffer.len, stream)) {
+        controls++;
+        logger_debug("[E2Term] sent RIC-CONTROL-REQUEST of RAN function %ld on association %d", ran_function, fd);
+    } else {
+        logger_error("[E2Term] unable to send RIC-CONTROL-REQUEST of RAN function %ld on association %d", ran_function, fd);
+    }
+    pdu_buffer_release(&buffer);
+    ASN_STRUCT_FREE(asn_DEF_E2AP_PDU, pdu);
+}
+
+void handle_message(int fd, const uint8_t *buf, size_t len) {
+    E2AP_PDU_t *pdu = NULL;
+    asn_dec_rval_t rval = asn_decode(nullptr, ATS_ALIGNED_BASIC_PER, &asn_DEF_E2AP_PDU, (void **) &pdu, buf, len);
+
+    messages++;
+
+    if (rval.code != RC_OK) {
+        logger_warn("[E2Term] unable to decode a message of %zu bytes on association %d", len, fd);
+
+    } else if (pdu->present == E2AP_PDU_PR_initiatingMessage) {
+        InitiatingMessage_t *init_msg = pdu->choice.initiatingMessage;
+
+        if (init_msg->procedureCode == ProcedureCode_id_E2setup) {
+            if (send_message(fd, setup_response.buf, setup_response.len, E2AP_STREAM_GLOBAL)) {
+                setups++;
+                logger_debug("[E2Term] sent E2-SETUP-RESPONSE on association %d", fd);
+                send_subscriptions(fd, &init_msg->value.choice.E2setupRequest);
+            } else {
+                logger_error("[E2Term] unable to send E2-SETUP-RESPONSE on association %d", fd);
+            }
+
+        } else if (init_msg->procedureCode == ProcedureCode_id_RICindication) {
+            send_control(fd, &init_msg->value.choice.RICindication);
+        }
+    }
+
+    ASN_STRUCT_FREE(asn_DEF_E2AP_PDU, pdu);
+}
+
+void handle_data(int fd, uint32_t events) {
+    auto it = conns.find(fd);
+    if (it == conns.end()) {
+        return;
+    }
+
+    if (events & EPOLLOUT) {
+        flush_pending(it->second);
+    }
+
+    if (!(events & EPOLLIN)) {
+        if (events & (EPOLLERR | EPOLLHUP)) {
+            close_connection(fd);
+        }
+        return;
+    }
+
+    int sock = fd;
+    int ret = sctp_receive_batch(sock, it->second.ring,
+                [fd](const uint8_t *buf, size_t len, uint16_t stream, struct timespec *ts, struct timespec *kernel_ts) {
+                    handle_message(fd, buf, len);
+                });
+
+    if (ret == -1) {
+        close_connection(fd);
+    }
+}
+
+void handle_accept(uint32_t events) {
+    while (true) {
+        int fd = accept4(server_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                logger_error("[E2Term] unable to accept an association: %s", strerror(errno));
+            }
+            return;
+        }
+
+        standin_conn_t &conn = conns[fd];
+        conn.fd = fd;
+        conn.ring = sctp_recv_ring_alloc();
+        conn.ostreams = sctp_get_num_ostreams(fd);
+        conn.pending.configure(SEND_QUEUE_DROP_NEWEST, 0, 0);  // default limits
+        conn.watching = false;
+
+        reactor->add(fd, EPOLLIN, std::bind(&handle_data, fd, std::placeholders::_1));
+        logger_info("[E2Term] association %d accepted, %zu running", fd, conns.size());
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::string address = DEFAULT_SCTP_IP;
+    int port = E2AP_SCTP_PORT;
+
+    sigset_t monitored_signals;
+    sigemptyset(&monitored_signals);
+    sigaddset(&monitored_signals, SIGINT);
+    sigaddset(&monitored_signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &monitored_signals, NULL);    // from now all new threads inherit this signal mask
+
+    static struct option long_options[] =
+    {
+        {"port", required_argument, 0, 'p'},
+        {"actions", required_argument, 0, 'a'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "p:a:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'a':
+                action_count = atoi(optarg);
+                if (action_count < 1 || action_count > STANDIN_MAX_ACTIONS) {
+                    fprintf(stderr, "invalid number of actions: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'h':
+            case '?':
+            default:
+                fprintf(stderr,
+                    "\nUsage: %s [options] [listen-address]\n\n"
+                    "Answers the E2 setup of each E2 node connected to listen-address (default %s), subscribes\n"
+                    "its RAN functions, and answers each INSERT indication with a control request\n\n"
+                    "Options:\n"
+                    "  -p  --port         SCTP port number (default %d)\n"
+                    "  -a  --actions      INSERT actions of each subscription (default 1)\n"
+                    "  -h  --help         Display this information and quit\n\n", argv[0], DEFAULT_SCTP_IP, E2AP_SCTP_PORT);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind < argc) {
+        address = argv[optind];
+    }
+
+    // the response only has constant IEs, so it is encoded once and its PDU is kept for the whole run
+    E2AP_PDU_t *res_pdu = (E2AP_PDU_t *) calloc(1, sizeof(E2AP_PDU_t));
+    encoding::generate_e2ap_setup_response(res_pdu);
+    pdu_buffer_init(&setup_response);
+    if (e2ap_encode_pdu(res_pdu, setup_response) <= 0) {
+        logger_error("[E2Term] unable to encode the E2-SETUP-RESPONSE");
+        exit(EXIT_FAILURE);
+    }
+
+    server_fd = sctp_start_server(address.c_str(), port);   // exits on error
+    fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL) | O_NONBLOCK);
+
+    reactor = Reactor::get_default();
+    reactor->add(server_fd, EPOLLIN, &handle_accept);
+
+    int delivered_signal;
+    if (sigwait(&monitored_signals, &delivered_signal) == 0) {
+        logger_info("%s was received", strsignal(delivered_signal));
+    }
+
+    reactor->stop();
+    for (auto &conn : conns) {
+        close(conn.first);
+        sctp_recv_ring_free(conn.second.ring);
+    }
+    close(server_fd);
+    pdu_buffer_release(&setup_response);
+
+    logger_force(LOGGER_INFO, "E2Term stand-in has finished: %lu E2 setups answered, %lu subscriptions and "
+                 "%lu control requests sent, %lu messages received, %lu messages dropped",
+                 setups.load(), subscriptions.load(), controls.load(), messages.load(), drops.load());
+    if (drops > 0) {
+        logger_force(LOGGER_WARN, "E2Term stand-in has dropped %lu messages, so the latencies of this run are not reliable",
+                     drops.load());
+    }
+
+    return 0;
+}